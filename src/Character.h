@@ -85,9 +85,9 @@ public:
 
     /** The unicode character value for this character.
      *
-     * if RE_EXTENDED_CHAR is set, character is a hash code which can be used to
-     * look up the unicode character sequence in the ExtendedCharTable used to
-     * create the sequence.
+     * if RE_EXTENDED_CHAR is set, character is a key which can be used to
+     * look up the unicode character sequence in the GraphemePool of the
+     * screen which created the sequence, see GraphemePool::lookup().
      */
     uint character;
 
@@ -51,57 +51,31 @@
 #include "konsoleprivate_export.h"
 
 
-struct Range {
-    uint first, last;
-};
-
-struct RangeLut {
-    int8_t width;
-    const Range * const lut;
-    int size;
-};
-
 enum {
     InvalidWidth = INT8_MIN,
 };
 
 
-static constexpr const int8_t DIRECT_LUT[] = {«!fmt "% d":«direct-lut:
+// Two-stage lookup table: TRIE_INDEX has the number of the block of
+// TRIE_BLOCKS with the widths of every 2^TRIE_BLOCK_BITS code points
+static constexpr const int TRIE_BLOCK_BITS = «trie-block-bits»;
+
+static constexpr const «trie-index-type» TRIE_INDEX[] = {«!fmt "%3d":«trie-index:
     «!repeat 32:«:«»,»»
 »»};
 
-«ranges-luts:«:
-static constexpr const Range «name»[] = {«!fmt "%#.6x":«ranges:
-    «!repeat 8:«:{«first»,«last»},»»
+static constexpr const int8_t TRIE_BLOCKS[] = {«!fmt "% d":«trie-blocks:
+    «!repeat 32:«:«»,»»
 »»};
-»»
 
-static constexpr const RangeLut RANGE_LUT_LIST[] = {«ranges-lut-list:
-    «:{«!fmt "% d":«width»», «!fmt "%-16s":«name»», «size»},»
-»};
-static constexpr const int RANGE_LUT_LIST_SIZE = «ranges-lut-list-size»;
+static constexpr const uint TRIE_SIZE = (sizeof(TRIE_INDEX) / sizeof(TRIE_INDEX[0])) << TRIE_BLOCK_BITS;
+static constexpr const int DEFAULT_WIDTH = «default-width»;
 
 
 int KONSOLEPRIVATE_EXPORT characterWidth(uint ucs4) {
-    if(Q_LIKELY(ucs4 < sizeof(DIRECT_LUT))) {
-        return DIRECT_LUT[ucs4];
-    }
-
-    for(auto rl = RANGE_LUT_LIST; rl->lut != nullptr; ++rl) {
-        int l = 0;
-        int r = rl->size - 1;
-        while(l <= r) {
-            const int m = (l + r) / 2;
-            if(rl->lut[m].last < ucs4) {
-                l = m + 1;
-            } else if(rl->lut[m].first > ucs4) {
-                r = m - 1;
-            } else {
-                return rl->width;
-            }
-        }
+    if(Q_UNLIKELY(ucs4 >= TRIE_SIZE)) {
+        return DEFAULT_WIDTH;
     }
-
-    return RANGE_LUT_LIST[RANGE_LUT_LIST_SIZE - 1].width;
+    const int block = TRIE_INDEX[ucs4 >> TRIE_BLOCK_BITS];
+    return TRIE_BLOCKS[(block << TRIE_BLOCK_BITS) | (ucs4 & ((1 << TRIE_BLOCK_BITS) - 1))];
 }
-
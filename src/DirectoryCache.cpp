@@ -0,0 +1,188 @@
+/*
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+    02110-1301  USA.
+*/
+
+// Own
+#include "DirectoryCache.h"
+
+// Qt
+#include <QDir>
+#include <QFileSystemWatcher>
+#include <QTimer>
+
+// Konsole
+#include "Session.h"
+
+using namespace Konsole;
+
+// changes to the directory within this time are picked up by one listing,
+// so a directory which is being filled is not listed over and over again
+static const int REFRESH_DELAY = 1000;
+
+DirectoryListingThread::DirectoryListingThread(const QString &directory, QObject *parent)
+    : QThread(parent)
+    , _directory(directory)
+    , _canonicalPath(QString())
+    , _files(QSet<QString>())
+{
+}
+
+QString DirectoryListingThread::directory() const
+{
+    return _directory;
+}
+
+QString DirectoryListingThread::canonicalPath() const
+{
+    return _canonicalPath;
+}
+
+QSet<QString> DirectoryListingThread::files() const
+{
+    return _files;
+}
+
+void DirectoryListingThread::run()
+{
+    const QDir dir(_directory);
+    _canonicalPath = dir.canonicalPath() + QLatin1Char('/');
+    _files = dir.entryList(QDir::Files).toSet();
+}
+
+DirectoryCache::DirectoryCache(QObject *parent)
+    : QObject(parent)
+    , _directory(QString())
+    , _canonicalPath(QString())
+    , _files(QSet<QString>())
+    , _watcher(new QFileSystemWatcher(this))
+    , _refreshTimer(new QTimer(this))
+    , _listing(nullptr)
+    , _refreshPending(false)
+{
+    _refreshTimer->setSingleShot(true);
+    _refreshTimer->setInterval(REFRESH_DELAY);
+    connect(_refreshTimer, &QTimer::timeout, this, &Konsole::DirectoryCache::refresh);
+
+    connect(_watcher, &QFileSystemWatcher::directoryChanged, this, [this]() {
+        if (!_refreshTimer->isActive()) {
+            _refreshTimer->start();
+        }
+    });
+}
+
+DirectoryCache::~DirectoryCache()
+{
+    // a listing of a slow file system is not waited for, the thread
+    // deletes itself when it has finished
+    if (_listing != nullptr) {
+        disconnect(_listing, nullptr, this, nullptr);
+        _listing->setParent(nullptr);
+        connect(_listing, &QThread::finished, _listing, &QObject::deleteLater);
+        // finished() may have been emitted already, deleting the thread
+        // drops the queued call of deleteLater() as well
+        if (_listing->isFinished()) {
+            _listing->wait();
+            delete _listing;
+        }
+    }
+}
+
+DirectoryCache *DirectoryCache::forSession(Session *session)
+{
+    auto cache = session->findChild<DirectoryCache *>(QString(), Qt::FindDirectChildrenOnly);
+    if (cache == nullptr) {
+        cache = new DirectoryCache(session);
+        connect(session, &Konsole::Session::currentDirectoryChanged, cache, &Konsole::DirectoryCache::setDirectory);
+        cache->setDirectory(session->currentWorkingDirectory());
+    }
+    return cache;
+}
+
+QString DirectoryCache::directory() const
+{
+    return _directory;
+}
+
+QString DirectoryCache::canonicalPath() const
+{
+    return _canonicalPath;
+}
+
+QSet<QString> DirectoryCache::files() const
+{
+    return _files;
+}
+
+void DirectoryCache::setDirectory(const QString &directory)
+{
+    if (directory == _directory) {
+        return;
+    }
+
+    if (!_watcher->directories().isEmpty()) {
+        _watcher->removePaths(_watcher->directories());
+    }
+    _refreshTimer->stop();
+
+    _directory = directory;
+
+    // the files of the previous directory must not be found in this one
+    _canonicalPath.clear();
+    if (!_files.isEmpty()) {
+        _files.clear();
+        emit updated();
+    }
+
+    if (!_directory.isEmpty()) {
+        _watcher->addPath(_directory);
+        refresh();
+    }
+}
+
+void DirectoryCache::refresh()
+{
+    if (_listing != nullptr) {
+        _refreshPending = true;
+        return;
+    }
+
+    _refreshPending = false;
+    if (_directory.isEmpty()) {
+        return;
+    }
+
+    _listing = new DirectoryListingThread(_directory, this);
+    connect(_listing, &QThread::finished, this, &Konsole::DirectoryCache::listingFinished);
+    _listing->start(QThread::LowPriority);
+}
+
+void DirectoryCache::listingFinished()
+{
+    DirectoryListingThread *listing = _listing;
+    _listing = nullptr;
+    listing->deleteLater();
+
+    // a listing of the previous directory is dropped
+    if (listing->directory() == _directory) {
+        _canonicalPath = listing->canonicalPath();
+        _files = listing->files();
+        emit updated();
+    }
+
+    if (_refreshPending) {
+        refresh();
+    }
+}
@@ -0,0 +1,124 @@
+/*
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+    02110-1301  USA.
+*/
+
+#ifndef DIRECTORYCACHE_H
+#define DIRECTORYCACHE_H
+
+// Qt
+#include <QObject>
+#include <QSet>
+#include <QString>
+#include <QThread>
+
+// Konsole
+#include "konsoleprivate_export.h"
+
+class QFileSystemWatcher;
+class QTimer;
+
+namespace Konsole {
+class Session;
+
+/**
+ * Lists the files of a directory in a thread of its own.  The results
+ * may be read once the thread has finished.
+ */
+class KONSOLEPRIVATE_EXPORT DirectoryListingThread : public QThread
+{
+    Q_OBJECT
+
+public:
+    explicit DirectoryListingThread(const QString &directory, QObject *parent = nullptr);
+
+    /** Returns the directory which is listed. */
+    QString directory() const;
+    /** Returns the canonical path of the directory, followed by a '/'. */
+    QString canonicalPath() const;
+    /** Returns the names of the files in the directory. */
+    QSet<QString> files() const;
+
+protected:
+    void run() Q_DECL_OVERRIDE;
+
+private:
+    const QString _directory;
+    QString _canonicalPath;
+    QSet<QString> _files;
+};
+
+/**
+ * Keeps the names of the files in the current directory of a session, so
+ * that they can be looked up without touching the file system.
+ *
+ * The directory is listed in the background whenever it changes, either
+ * because the session moved to another directory or because files were
+ * added to or removed from it.  Until the listing has finished the
+ * previous names (or none, after a change of directory) are returned.
+ */
+class KONSOLEPRIVATE_EXPORT DirectoryCache : public QObject
+{
+    Q_OBJECT
+
+public:
+    explicit DirectoryCache(QObject *parent = nullptr);
+    ~DirectoryCache() Q_DECL_OVERRIDE;
+
+    /**
+     * Returns the cache of the current directory of @p session, which is
+     * shared by all filters of the session.  It is created on first use.
+     */
+    static DirectoryCache *forSession(Session *session);
+
+    /** Returns the directory whose files are cached. */
+    QString directory() const;
+
+    /**
+     * Returns the canonical path of the directory followed by a '/', or
+     * an empty string if it has not been listed yet.
+     */
+    QString canonicalPath() const;
+
+    /** Returns the names of the files in the directory. */
+    QSet<QString> files() const;
+
+public Q_SLOTS:
+    /** Sets the directory whose files are cached and lists it. */
+    void setDirectory(const QString &directory);
+
+Q_SIGNALS:
+    /** Emitted when the cached names of the files have changed. */
+    void updated();
+
+private Q_SLOTS:
+    void refresh();
+    void listingFinished();
+
+private:
+    Q_DISABLE_COPY(DirectoryCache)
+
+    QString _directory;
+    QString _canonicalPath;
+    QSet<QString> _files;
+
+    QFileSystemWatcher *_watcher;
+    QTimer *_refreshTimer;
+    DirectoryListingThread *_listing;
+    bool _refreshPending;
+};
+}
+
+#endif // DIRECTORYCACHE_H
@@ -1568,6 +1568,9 @@ void EditProfileDialog::setupScrollingPage(const Profile::Ptr &profile)
     const int historySize = profile->historySize();
     _scrollingUi->historySizeWidget->setLineCount(historySize);
 
+    // setup scrollback file size spinner
+    _scrollingUi->historySizeWidget->setFileSize(profile->property<int>(Profile::HistoryFileSize));
+
     // setup scrollpageamount type radio
     auto scrollFullPage = profile->property<int>(Profile::ScrollFullPage);
 
@@ -1581,6 +1584,8 @@ void EditProfileDialog::setupScrollingPage(const Profile::Ptr &profile)
     // signals and slots
     connect(_scrollingUi->historySizeWidget, &Konsole::HistorySizeWidget::historySizeChanged, this,
             &Konsole::EditProfileDialog::historySizeChanged);
+    connect(_scrollingUi->historySizeWidget, &Konsole::HistorySizeWidget::historyFileSizeChanged, this,
+            &Konsole::EditProfileDialog::historyFileSizeChanged);
 }
 
 void EditProfileDialog::historySizeChanged(int lineCount)
@@ -1588,6 +1593,11 @@ void EditProfileDialog::historySizeChanged(int lineCount)
     updateTempProfileProperty(Profile::HistorySize, lineCount);
 }
 
+void EditProfileDialog::historyFileSizeChanged(int megabytes)
+{
+    updateTempProfileProperty(Profile::HistoryFileSize, megabytes);
+}
+
 void EditProfileDialog::historyModeChanged(Enum::HistoryModeEnum mode)
 {
     updateTempProfileProperty(Profile::HistoryMode, mode);
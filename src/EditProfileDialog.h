@@ -172,6 +172,7 @@ private Q_SLOTS:
     void historyModeChanged(Enum::HistoryModeEnum mode);
 
     void historySizeChanged(int);
+    void historyFileSizeChanged(int);
 
     void scrollFullPage();
     void scrollHalfPage();
@@ -22,8 +22,20 @@
 // Own
 #include "Emulation.h"
 
+// System
+#include <cstring>
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
 // Qt
+#include <QElapsedTimer>
+#include <QGuiApplication>
 #include <QKeyEvent>
+#include <QMutexLocker>
+#include <QScreen>
+#include <QThread>
+#include <QtAlgorithms>
 
 // Konsole
 #include "KeyboardTranslator.h"
@@ -33,25 +45,57 @@
 
 using namespace Konsole;
 
+// history lines rewrapped on each turn of the event loop after a resize
+static const int REWRAP_HISTORY_LINES = 10000;
+
+static qint64 monotonicClock()
+{
+    QElapsedTimer timer;
+    timer.start();
+    return timer.msecsSinceReference();
+}
+
+// states of Emulation::_activity
+enum {
+    NoActivity = 0,       // the next output is signalled
+    ActivityReceived = 1, // output was received since the last check
+    ActivityTaken = 2     // the output was signalled or found by the last check,
+                          // none was received since then
+};
+
 Emulation::Emulation() :
     _windows(QList<ScreenWindow *>()),
     _currentScreen(nullptr),
     _codec(nullptr),
     _decoder(nullptr),
+    _decoderIsClean(true),
     _keyTranslator(nullptr),
     _usesMouseTracking(false),
     _bracketedPasteMode(false),
-    _bulkTimer1(new QTimer(this)),
-    _bulkTimer2(new QTimer(this)),
-    _imageSizeInitialized(false)
+    _frameTimer(),
+    _clock(monotonicClock),
+    _lastFrame(-1),
+    _frameInterval(0),
+    _frameStatistics({0, 0, 0}),
+    _rewrapTimer(),
+    _imageSizeInitialized(false),
+    _lock(nullptr),
+    _updatePending(0),
+    _activity(NoActivity)
 {
     // create screens with a default size
     _screen[0] = new Screen(40, 80);
     _screen[1] = new Screen(40, 80);
     _currentScreen = _screen[0];
 
-    QObject::connect(&_bulkTimer1, &QTimer::timeout, this, &Konsole::Emulation::showBulk);
-    QObject::connect(&_bulkTimer2, &QTimer::timeout, this, &Konsole::Emulation::showBulk);
+    // programs using the alternate screen redraw it when the size changes
+    _screen[0]->setReflowLines(true);
+
+    _frameTimer.setSingleShot(true);
+    QObject::connect(&_frameTimer, &QTimer::timeout, this, &Konsole::Emulation::showBulk);
+    setMaximumFrameRate(0);
+
+    QObject::connect(&_rewrapTimer, &QTimer::timeout, this, &Konsole::Emulation::rewrapHistory);
 
     // listen for mouse status changes
     connect(this, &Konsole::Emulation::programRequestsMouseTracking, this,
@@ -75,6 +119,16 @@ bool Emulation::programBracketedPasteMode() const
     return _bracketedPasteMode;
 }
 
+void Emulation::rewrapHistory()
+{
+    QMutexLocker locker(_lock);
+
+    if (!_screen[0]->rewrapHistory(REWRAP_HISTORY_LINES)) {
+        _rewrapTimer.stop();
+    }
+    bufferedUpdate();
+}
+
 void Emulation::bracketedPasteModeChanged(bool bracketedPasteMode)
 {
     _bracketedPasteMode = bracketedPasteMode;
@@ -83,7 +137,12 @@ void Emulation::bracketedPasteModeChanged(bool bracketedPasteMode)
 ScreenWindow *Emulation::createWindow()
 {
     auto window = new ScreenWindow(_currentScreen);
-    _windows << window;
+    window->setLock(_lock);
+    {
+        // the windows are switched to the other screen by receiveData()
+        QMutexLocker locker(_lock);
+        _windows << window;
+    }
 
     connect(window, &Konsole::ScreenWindow::selectionChanged, this,
             &Konsole::Emulation::bufferedUpdate);
@@ -96,6 +155,75 @@ ScreenWindow *Emulation::createWindow()
     return window;
 }
 
+void Emulation::enableLocking()
+{
+    if (_lock != nullptr) {
+        return;
+    }
+
+    _lock = new QMutex(QMutex::Recursive);
+    foreach (ScreenWindow *window, _windows) {
+        window->setLock(_lock);
+    }
+}
+
+QMutex *Emulation::lock() const
+{
+    return _lock;
+}
+
+void Emulation::setMaximumFrameRate(int framesPerSecond)
+{
+    if (framesPerSecond <= 0) {
+        // without a screen, e.g. in tests, assume a common refresh rate
+        const QScreen *screen = QGuiApplication::primaryScreen();
+        framesPerSecond = screen != nullptr ? qRound(screen->refreshRate()) : 60;
+    }
+
+    _frameInterval = qMax(1, qRound(1000.0 / qMax(1, framesPerSecond)));
+}
+
+int Emulation::frameInterval() const
+{
+    return _frameInterval;
+}
+
+void Emulation::setClock(Clock clock)
+{
+    _clock = clock;
+    _lastFrame = -1;
+}
+
+Emulation::FrameStatistics Emulation::frameStatistics() const
+{
+    QMutexLocker locker(_lock);
+    return _frameStatistics;
+}
+
+bool Emulation::takeActivity()
+{
+    forever {
+        const int activity = _activity.loadAcquire();
+        if (activity == ActivityReceived) {
+            if (_activity.testAndSetOrdered(ActivityReceived, ActivityTaken)) {
+                return true;
+            }
+        } else if (activity == ActivityTaken) {
+            // no output since the last call, report the next one
+            if (_activity.testAndSetOrdered(ActivityTaken, NoActivity)) {
+                return false;
+            }
+        } else {
+            return false;
+        }
+    }
+}
+
+bool Emulation::calledFromOtherThread() const
+{
+    return QThread::currentThread() != thread();
+}
+
 void Emulation::checkScreenInUse()
 {
     emit primaryScreenInUse(_currentScreen == _screen[0]);
@@ -103,6 +231,7 @@ void Emulation::checkScreenInUse()
 
 void Emulation::checkSelectedText()
 {
+    QMutexLocker locker(_lock);
     QString text = _currentScreen->selectedText(Screen::PreserveLineBreaks);
     emit selectionChanged(text);
 }
@@ -116,10 +245,12 @@ Emulation::~Emulation()
     delete _screen[0];
     delete _screen[1];
     delete _decoder;
+    delete _lock;
 }
 
 void Emulation::setScreen(int index)
 {
+    QMutexLocker locker(_lock);
     Screen *oldScreen = _currentScreen;
     _currentScreen = _screen[index & 1];
     if (_currentScreen != oldScreen) {
@@ -135,12 +266,15 @@ void Emulation::setScreen(int index)
 
 void Emulation::clearHistory()
 {
+    QMutexLocker locker(_lock);
     _screen[0]->setScroll(_screen[0]->getScroll(), false);
 }
 
 void Emulation::setHistory(const HistoryType &history)
 {
+    QMutexLocker locker(_lock);
     _screen[0]->setScroll(history);
+    _rewrapTimer.start();
 
     showBulk();
 }
@@ -153,10 +287,12 @@ const HistoryType &Emulation::history() const
 void Emulation::setCodec(const QTextCodec *codec)
 {
     if (codec != nullptr) {
+        QMutexLocker locker(_lock);
         _codec = codec;
 
         delete _decoder;
         _decoder = _codec->makeDecoder();
+        _decoderIsClean = true;
 
         emit useUtf8Request(utf8());
     } else {
@@ -213,6 +349,13 @@ void Emulation::receiveChar(uint c)
     }
 }
 
+void Emulation::receiveAsciiRun(const char *text, int length)
+{
+    for (int i = 0; i < length; i++) {
+        receiveChar(static_cast<uchar>(text[i]));
+    }
+}
+
 void Emulation::sendKeyEvent(QKeyEvent *ev)
 {
     emit stateSet(NOTIFYNORMAL);
@@ -230,72 +373,203 @@ void Emulation::sendMouseEvent(int /*buttons*/, int /*column*/, int /*row*/, int
     // default implementation does nothing
 }
 
+static inline bool isPrintableAscii(char c)
+{
+    return c >= 0x20 && c < 0x7f;
+}
+
+// returns the number of printable ASCII characters at the start of 'text'
+static int printableAsciiRunLength(const char *text, int length)
+{
+    int i = 0;
+#if defined(__SSE2__)
+    // the comparisons are signed, so bytes >= 0x80 fail the lower bound
+    const __m128i lowerBound = _mm_set1_epi8(0x1f);
+    const __m128i upperBound = _mm_set1_epi8(0x7f);
+    for (; i + 16 <= length; i += 16) {
+        const __m128i chunk = _mm_loadu_si128(reinterpret_cast<const __m128i *>(text + i));
+        const __m128i printable = _mm_and_si128(_mm_cmpgt_epi8(chunk, lowerBound),
+                                                _mm_cmplt_epi8(chunk, upperBound));
+        const uint mask = static_cast<uint>(_mm_movemask_epi8(printable));
+        if (mask != 0xffff) {
+            return i + static_cast<int>(qCountTrailingZeroBits(~mask));
+        }
+    }
+#endif
+    while (i < length && isPrintableAscii(text[i])) {
+        i++;
+    }
+    return i;
+}
+
+// returns false if 'text' ends with an incomplete UTF-8 sequence or if that
+// can't be decided because the sequence started in an earlier buffer
+static bool endsOnUtf8Boundary(const char *text, int length)
+{
+    int i = length - 1;
+    int continuationBytes = 0;
+    while (i >= 0 && continuationBytes < 4 && (static_cast<uchar>(text[i]) & 0xc0) == 0x80) {
+        i--;
+        continuationBytes++;
+    }
+    if (i < 0) {
+        return false;
+    }
+
+    const uchar lead = static_cast<uchar>(text[i]);
+    int expected;
+    if (lead < 0x80) {
+        expected = 0;
+    } else if ((lead & 0xe0) == 0xc0) {
+        expected = 1;
+    } else if ((lead & 0xf0) == 0xe0) {
+        expected = 2;
+    } else if ((lead & 0xf8) == 0xf0) {
+        expected = 3;
+    } else {
+        // not a valid lead byte, the decoder has already rejected it
+        return true;
+    }
+    return continuationBytes >= expected;
+}
+
 /*
    We are doing code conversion from locale to unicode first.
+
+   In UTF-8 each byte from 0x20 to 0x7e stands for itself and never occurs
+   inside a multibyte sequence, so runs of these bytes are passed on without
+   going through the codec.  Only the bytes in between are decoded.
 */
 
 void Emulation::receiveData(const char *text, int length)
 {
-    emit stateSet(NOTIFYACTIVITY);
+    QMutexLocker locker(_lock);
+
+    _frameStatistics.chunksReceived++;
+
+    // only the first output after an idle period is signalled, the
+    // receiver checks for more with takeActivity()
+    int activity = _activity.loadAcquire();
+    while (activity != ActivityReceived) {
+        const int newActivity = activity == NoActivity ? ActivityTaken : ActivityReceived;
+        if (_activity.testAndSetOrdered(activity, newActivity)) {
+            if (activity == NoActivity) {
+                emit stateSet(NOTIFYACTIVITY);
+            }
+            break;
+        }
+        activity = _activity.loadAcquire();
+    }
 
     bufferedUpdate();
 
-    QVector<uint> unicodeText = _decoder->toUnicode(text, length).toUcs4();
+    int pos = 0;
+    while (pos < length) {
+        const bool utf8Codec = utf8();
+
+        if (utf8Codec && _decoderIsClean) {
+            const int runLength = printableAsciiRunLength(text + pos, length - pos);
+            if (runLength > 0) {
+                receiveAsciiRun(text + pos, runLength);
+                pos += runLength;
+                continue;
+            }
+        }
+
+        // decode everything up to the start of the next printable run; when
+        // the decoder holds part of a sequence from the previous buffer this
+        // is just the next character, which terminates the sequence
+        int end = length;
+        if (utf8Codec) {
+            end = pos + 1;
+            while (end < length && !isPrintableAscii(text[end])) {
+                end++;
+            }
+        }
+
+        const QVector<uint> unicodeText = _decoder->toUnicode(text + pos, end - pos).toUcs4();
+        _decoderIsClean = !utf8Codec || endsOnUtf8Boundary(text + pos, end - pos);
+        pos = end;
 
-    //send characters to terminal emulator
-    for (auto &&i : unicodeText) {
-        receiveChar(i);
+        //send characters to terminal emulator
+        for (auto &&i : unicodeText) {
+            receiveChar(i);
+        }
     }
 
     //look for z-modem indicator
     //-- someone who understands more about z-modems that I do may be able to move
     //this check into the above for loop?
-    for (int i = 0; i < length; i++) {
-        if (text[i] == '\030') {
-            if (length - i - 1 > 3) {
-                if (qstrncmp(text + i + 1, "B00", 3) == 0) {
-                    emit zmodemDownloadDetected();
-                } else if (qstrncmp(text + i + 1, "B01", 3) == 0) {
-                    emit zmodemUploadDetected();
-                }
+    const char *zmodem = static_cast<const char *>(memchr(text, '\030', length));
+    while (zmodem != nullptr) {
+        const int i = zmodem - text;
+        if (length - i - 1 > 3) {
+            if (qstrncmp(text + i + 1, "B00", 3) == 0) {
+                emit zmodemDownloadDetected();
+            } else if (qstrncmp(text + i + 1, "B01", 3) == 0) {
+                emit zmodemUploadDetected();
             }
         }
+        zmodem = static_cast<const char *>(memchr(zmodem + 1, '\030', length - i - 1));
     }
 }
 
 void Emulation::writeToStream(TerminalCharacterDecoder *decoder, int startLine, int endLine)
 {
+    QMutexLocker locker(_lock);
     _currentScreen->writeLinesToStream(decoder, startLine, endLine);
 }
 
 int Emulation::lineCount() const
 {
+    QMutexLocker locker(_lock);
+
     // sum number of lines currently on _screen plus number of lines in history
     return _currentScreen->getLines() + _currentScreen->getHistLines();
 }
 
 void Emulation::showBulk()
 {
-    _bulkTimer1.stop();
-    _bulkTimer2.stop();
+    _frameTimer.stop();
+    _lastFrame = _clock();
 
+    // the screen windows and their views take their image of the screens
+    // while the emulation is locked
+    QMutexLocker locker(_lock);
+    _frameStatistics.framesEmitted++;
     emit outputChanged();
 
     _currentScreen->resetScrolledLines();
     _currentScreen->resetDroppedLines();
 }
 
+/*
+   The views are updated at most once per frame interval.  The first update
+   after an idle period is shown at once, so that echoing typed characters
+   is not delayed, while a flood of output is drawn at the frame rate
+   however it is split into chunks.
+*/
+
 void Emulation::bufferedUpdate()
 {
-    static const int BULK_TIMEOUT1 = 10;
-    static const int BULK_TIMEOUT2 = 40;
+    // forward the updates requested by another thread, at most one
+    // of them is pending at a time
+    if (calledFromOtherThread()) {
+        if (_updatePending.testAndSetOrdered(0, 1)) {
+            QMetaObject::invokeMethod(this, "bufferedUpdate", Qt::QueuedConnection);
+        }
+        return;
+    }
+    _updatePending.store(0);
 
-    _bulkTimer1.setSingleShot(true);
-    _bulkTimer1.start(BULK_TIMEOUT1);
-    if (!_bulkTimer2.isActive()) {
-        _bulkTimer2.setSingleShot(true);
-        _bulkTimer2.start(BULK_TIMEOUT2);
+    if (_frameTimer.isActive()) {
+        QMutexLocker locker(_lock);
+        _frameStatistics.framesSkipped++;
+        return;
     }
+
+    const qint64 sinceLastFrame = _lastFrame != -1 ? _clock() - _lastFrame : _frameInterval;
+    _frameTimer.start(static_cast<int>(qMax(qint64(0), _frameInterval - sinceLastFrame)));
 }
 
 char Emulation::eraseChar() const
@@ -309,6 +583,8 @@ void Emulation::setImageSize(int lines, int columns)
         return;
     }
 
+    QMutexLocker locker(_lock);
+
     QSize screenSize[2] = {
         QSize(_screen[0]->getColumns(),
               _screen[0]->getLines()),
@@ -327,6 +603,7 @@ void Emulation::setImageSize(int lines, int columns)
     } else {
         _screen[0]->resizeImage(lines, columns);
         _screen[1]->resizeImage(lines, columns);
+        _rewrapTimer.start();
 
         emit imageSizeChanged(lines, columns);
 
@@ -342,5 +619,6 @@ void Emulation::setImageSize(int lines, int columns)
 
 QSize Emulation::imageSize() const
 {
+    QMutexLocker locker(_lock);
     return {_currentScreen->getColumns(), _currentScreen->getLines()};
 }
@@ -24,6 +24,7 @@
 #define EMULATION_H
 
 // Qt
+#include <QAtomicInt>
 #include <QSize>
 #include <QTextCodec>
 #include <QTimer>
@@ -33,6 +34,7 @@
 #include "konsoleprivate_export.h"
 
 class QKeyEvent;
+class QMutex;
 
 namespace Konsole {
 class KeyboardTranslator;
@@ -130,6 +132,55 @@ public:
      */
     ScreenWindow *createWindow();
 
+    /**
+     * Allows receiveData() to be called from another thread, see
+     * EmulationThread.  Afterwards the emulation and its screen windows
+     * hold lock() while they access the screens.
+     */
+    void enableLocking();
+    /** Returns the lock created by enableLocking(), or nullptr */
+    QMutex *lock() const;
+
+    /**
+     * Sets how often per second the views are updated at most while
+     * output is received.  If @p framesPerSecond is 0 or less, the refresh
+     * rate of the primary screen is used, which is also the default.
+     */
+    void setMaximumFrameRate(int framesPerSecond);
+    /** Returns the minimum time between two updates of the views in milliseconds */
+    int frameInterval() const;
+
+    /** A monotonic clock in milliseconds */
+    typedef qint64 (*Clock)();
+    /**
+     * Sets the clock which measures the time since the last update of the
+     * views, so that tests do not depend on the time passing.
+     */
+    void setClock(Clock clock);
+
+    /** Counters of the output received and of the updates of the views */
+    struct FrameStatistics {
+        /** Number of chunks of output passed to receiveData() */
+        quint64 chunksReceived;
+        /** Number of times outputChanged() was emitted */
+        quint64 framesEmitted;
+        /** Number of updates merged into an update which was already scheduled */
+        quint64 framesSkipped;
+    };
+    /** Returns the counters since the emulation was created */
+    FrameStatistics frameStatistics() const;
+
+    /**
+     * Returns true if more output was received since stateSet(NOTIFYACTIVITY)
+     * was emitted or since the previous call.  Receivers of the signal
+     * call this regularly while the terminal is active, instead of being
+     * told about every chunk of output.
+     *
+     * If it returns false, the next output is reported by
+     * stateSet(NOTIFYACTIVITY) again.
+     */
+    bool takeActivity();
+
     /** Returns the size of the screen image which the emulation produces */
     QSize imageSize() const;
 
@@ -256,6 +307,9 @@ public Q_SLOTS:
      * character buffer using the current codec(), and then calls receiveChar() for
      * each unicode character in the resulting buffer.
      *
+     * When the codec is UTF-8, runs of printable ASCII characters are not decoded
+     * but passed to receiveAsciiRun() directly.
+     *
      * receiveData() also starts a timer which causes the outputChanged() signal
      * to be emitted when it expires.  The timer allows multiple updates in quick
      * succession to be buffered into a single outputChanged() signal emission.
@@ -296,6 +350,9 @@ Q_SIGNALS:
     /**
      * Emitted when the activity state of the emulation is set.
      *
+     * NOTIFYACTIVITY is only emitted for the first output after a period
+     * without output, see takeActivity().
+     *
      * @param state The new activity state, one of NOTIFYNORMAL, NOTIFYACTIVITY
      * or NOTIFYBELL
      */
@@ -456,6 +513,19 @@ protected:
      */
     virtual void receiveChar(uint c);
 
+    /**
+     * Processes a run of printable ASCII characters (0x20 to 0x7e) which
+     * receiveData() was able to pass by the codec.  See receiveData()
+     *
+     * The default implementation calls receiveChar() for each character.
+     * Emulations can reimplement this to hand the whole run to the screen
+     * at once while they are not in the middle of an escape sequence.
+     *
+     * @param text The characters of the run.
+     * @param length The length of @p text
+     */
+    virtual void receiveAsciiRun(const char *text, int length);
+
     /**
      * Sets the active screen.  The terminal has two screens, primary and alternate.
      * The primary screen is used by default.  When certain interactive programs such
@@ -472,6 +542,14 @@ protected:
 
     void setCodec(EmulationCodec codec);
 
+    /**
+     * Returns true if the caller runs in another thread than the one the
+     * emulation belongs to, which is the case for receiveData() when it
+     * is called by an EmulationThread.  Timers can not be started from
+     * there.
+     */
+    bool calledFromOtherThread() const;
+
     QList<ScreenWindow *> _windows;
 
     Screen *_currentScreen;  // pointer to the screen which is currently active,
@@ -486,13 +564,16 @@ protected:
     //the current text codec.  (this allows for rendering of non-ASCII characters in text files etc.)
     const QTextCodec *_codec;
     QTextDecoder *_decoder;
+    // false if _decoder may hold an incomplete multibyte sequence, in
+    // which case the next byte has to be passed through it
+    bool _decoderIsClean;
     const KeyboardTranslator *_keyTranslator; // the keyboard layout
 
 protected Q_SLOTS:
     /**
      * Schedules an update of attached views.
-     * Repeated calls to bufferedUpdate() in close succession will result in only a single update,
-     * much like the Qt buffered update of widgets.
+     * Repeated calls to bufferedUpdate() in close succession will result in only a single update
+     * per frame interval, much like the Qt buffered update of widgets.  See setMaximumFrameRate()
      */
     void bufferedUpdate();
 
@@ -503,22 +584,32 @@ protected Q_SLOTS:
     void checkSelectedText();
 
 private Q_SLOTS:
-    // triggered by timer, causes the emulation to send an updated screen image to each
-    // view
+    // triggered by the frame timer, causes the emulation to send an updated screen
+    // image to each view
     void showBulk();
 
     void setUsesMouseTracking(bool usesMouseTracking);
 
     void bracketedPasteModeChanged(bool bracketedPasteMode);
 
+    // rewraps a part of the history of the primary screen after a resize
+    void rewrapHistory();
+
 private:
     Q_DISABLE_COPY(Emulation)
 
     bool _usesMouseTracking;
     bool _bracketedPasteMode;
-    QTimer _bulkTimer1;
-    QTimer _bulkTimer2;
+    QTimer _frameTimer;        // shows the next frame, see bufferedUpdate()
+    Clock _clock;              // see setClock()
+    qint64 _lastFrame;         // time at which the last frame was shown, or -1
+    int _frameInterval;        // in milliseconds, see setMaximumFrameRate()
+    FrameStatistics _frameStatistics;
+    QTimer _rewrapTimer;       // see rewrapHistory()
     bool _imageSizeInitialized;
+    QMutex *_lock; // see enableLocking()
+    QAtomicInt _updatePending; // bufferedUpdate() was requested by another thread
+    QAtomicInt _activity;      // see takeActivity()
 };
 }
 
@@ -0,0 +1,120 @@
+/*
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+    02110-1301  USA.
+*/
+
+// Own
+#include "EmulationThread.h"
+
+// Qt
+#include <QMutexLocker>
+
+// Konsole
+#include "Emulation.h"
+#include "Enumeration.h"
+
+using namespace Konsole;
+
+// the output is interpreted in slices of this size, so the lock of the
+// emulation is released regularly for the views and for input
+static const int SLICE_LENGTH = 4096;
+
+EmulationThread::EmulationThread(Emulation *emulation, QObject *parent)
+    : QThread(parent)
+    , _emulation(emulation)
+    , _mutex()
+    , _dataAdded()
+    , _data()
+    , _pendingBytes(0)
+    , _backlogFull(false)
+    , _stopped(false)
+{
+    // the signals of the emulation are queued to the objects in the user
+    // interface thread, so their arguments need to be known to Qt
+    qRegisterMetaType<Enum::CursorShapeEnum>("Enum::CursorShapeEnum");
+}
+
+EmulationThread::~EmulationThread()
+{
+    stop();
+    wait();
+}
+
+void EmulationThread::addData(const char *data, int length)
+{
+    bool backlogFull = false;
+    {
+        QMutexLocker locker(&_mutex);
+        _data.enqueue(QByteArray(data, length));
+        _pendingBytes += length;
+        if (!_backlogFull && _pendingBytes > MaxPendingBytes) {
+            _backlogFull = true;
+            backlogFull = true;
+        }
+        _dataAdded.wakeOne();
+    }
+
+    if (backlogFull) {
+        emit backlogChanged(true);
+    }
+}
+
+int EmulationThread::pendingBytes()
+{
+    QMutexLocker locker(&_mutex);
+    return _pendingBytes;
+}
+
+void EmulationThread::stop()
+{
+    QMutexLocker locker(&_mutex);
+    _stopped = true;
+    _dataAdded.wakeOne();
+}
+
+void EmulationThread::run()
+{
+    forever {
+        QByteArray data;
+        {
+            QMutexLocker locker(&_mutex);
+            while (_data.isEmpty() && !_stopped) {
+                _dataAdded.wait(&_mutex);
+            }
+            if (_stopped) {
+                return;
+            }
+            data = _data.dequeue();
+        }
+
+        for (int pos = 0; pos < data.size(); pos += SLICE_LENGTH) {
+            _emulation->receiveData(data.constData() + pos, qMin(SLICE_LENGTH, data.size() - pos));
+        }
+
+        bool backlogWorkedOff = false;
+        {
+            QMutexLocker locker(&_mutex);
+            _pendingBytes -= data.size();
+            if (_backlogFull && _pendingBytes <= MaxPendingBytes / 4) {
+                _backlogFull = false;
+                backlogWorkedOff = true;
+            }
+        }
+
+        if (backlogWorkedOff) {
+            emit backlogChanged(false);
+        }
+    }
+}
@@ -0,0 +1,93 @@
+/*
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+    02110-1301  USA.
+*/
+
+#ifndef EMULATIONTHREAD_H
+#define EMULATIONTHREAD_H
+
+// Qt
+#include <QByteArray>
+#include <QMutex>
+#include <QQueue>
+#include <QThread>
+#include <QWaitCondition>
+
+// Konsole
+#include "konsoleprivate_export.h"
+
+namespace Konsole {
+class Emulation;
+
+/**
+ * Passes the output of a terminal program to an Emulation in a thread of
+ * its own, so that interpreting a large amount of output does not block
+ * the user interface or the other sessions.
+ *
+ * The emulation has to be locked, see Emulation::enableLocking().  The
+ * views take their image of the screen in the user interface thread while
+ * holding that lock, so they always see the screen between two chunks of
+ * output.
+ *
+ * Output which has not been interpreted yet is queued.  backlogChanged()
+ * is emitted when the queue becomes too long, and again when it has been
+ * worked off, so that reading from the terminal can be suspended meanwhile.
+ */
+class KONSOLEPRIVATE_EXPORT EmulationThread : public QThread
+{
+    Q_OBJECT
+
+public:
+    explicit EmulationThread(Emulation *emulation, QObject *parent = nullptr);
+    ~EmulationThread() Q_DECL_OVERRIDE;
+
+    /** Queues @p length bytes of output from @p data to be interpreted. */
+    void addData(const char *data, int length);
+
+    /** Returns the number of bytes which have not been interpreted yet. */
+    int pendingBytes();
+
+    /**
+     * Stops the thread after the chunk of output which is interpreted at
+     * the moment, the remaining output is dropped.
+     */
+    void stop();
+
+    /** Size of the queue at which backlogChanged() is emitted */
+    static const int MaxPendingBytes = 1024 * 1024;
+
+Q_SIGNALS:
+    /**
+     * Emitted with true when more than MaxPendingBytes are queued, and
+     * with false when the queue has been shortened to a quarter of that.
+     */
+    void backlogChanged(bool full);
+
+protected:
+    void run() Q_DECL_OVERRIDE;
+
+private:
+    Emulation *_emulation;
+
+    QMutex _mutex;
+    QWaitCondition _dataAdded;
+    QQueue<QByteArray> _data;
+    int _pendingBytes;
+    bool _backlogFull;
+    bool _stopped;
+};
+}
+
+#endif // EMULATIONTHREAD_H
@@ -47,7 +47,11 @@ public:
          * Typically this means that lines are recorded to
          * a file as they are scrolled off-screen.
          */
-        UnlimitedHistory = 2
+        UnlimitedHistory = 2,
+        /** Output is recorded to a file of a fixed size.  Once the file
+         * is full, the oldest part of the output is lost.
+         */
+        FixedSizeFileHistory = 3
     };
 
     /**
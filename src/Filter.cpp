@@ -22,11 +22,13 @@
 
 #include "konsoledebug.h"
 
+// System
+#include <algorithm>
+
 // Qt
 #include <QAction>
 #include <QApplication>
 #include <QClipboard>
-#include <QDir>
 #include <QFile>
 #include <QMimeDatabase>
 #include <QString>
@@ -38,6 +40,7 @@
 #include <KRun>
 
 // Konsole
+#include "DirectoryCache.h"
 #include "Session.h"
 #include "TerminalCharacterDecoder.h"
 
@@ -214,22 +217,16 @@ void Filter::getLineColumn(int position, int &startLine, int &startColumn)
     Q_ASSERT(_linePositions);
     Q_ASSERT(_buffer);
 
-    for (int i = 0; i < _linePositions->count(); i++) {
-        int nextLine = 0;
-
-        if (i == _linePositions->count() - 1) {
-            nextLine = _buffer->length() + 1;
-        } else {
-            nextLine = _linePositions->value(i + 1);
-        }
-
-        if (_linePositions->value(i) <= position && position < nextLine) {
-            startLine = i;
-            startColumn = Character::stringWidth(buffer()->mid(_linePositions->value(i),
-                                                     position - _linePositions->value(i)));
-            return;
-        }
+    // the last line which starts at or before position
+    const auto next = std::upper_bound(_linePositions->constBegin(), _linePositions->constEnd(), position);
+    if (next == _linePositions->constBegin() || position > _buffer->length()) {
+        return;
     }
+
+    const int i = static_cast<int>(next - _linePositions->constBegin()) - 1;
+    startLine = i;
+    startColumn = Character::stringWidth(buffer()->mid(_linePositions->value(i),
+                                                       position - _linePositions->value(i)));
 }
 
 const QString *Filter::buffer()
@@ -321,7 +318,9 @@ void Filter::HotSpot::setType(Type type)
 }
 
 RegExpFilter::RegExpFilter() :
-    _searchText(QRegularExpression())
+    _searchText(QRegularExpression()),
+    _requiredLiterals(QVector<QStringList>()),
+    _lineMatches(QHash<QString, QVector<Match> >())
 {
 }
 
@@ -346,6 +345,7 @@ void RegExpFilter::setRegExp(const QRegularExpression &regExp)
 {
     _searchText = regExp;
     _searchText.optimize();
+    _lineMatches.clear();
 }
 
 QRegularExpression RegExpFilter::regExp() const
@@ -353,6 +353,52 @@ QRegularExpression RegExpFilter::regExp() const
     return _searchText;
 }
 
+// literals are looked up by their first character in a table of this size,
+// the last entry holds the literals which do not start with an ASCII character
+static const int LITERAL_TABLE_SIZE = 129;
+
+static inline int literalTableIndex(QChar c)
+{
+    return qMin(static_cast<int>(c.unicode()), LITERAL_TABLE_SIZE - 1);
+}
+
+void RegExpFilter::setRequiredLiterals(const QStringList &literals)
+{
+    _requiredLiterals.clear();
+    _lineMatches.clear();
+
+    for (const QString &literal : literals) {
+        // every line contains the empty string
+        if (literal.isEmpty()) {
+            _requiredLiterals.clear();
+            return;
+        }
+
+        if (_requiredLiterals.isEmpty()) {
+            _requiredLiterals.resize(LITERAL_TABLE_SIZE);
+        }
+        _requiredLiterals[literalTableIndex(literal[0])].append(literal);
+    }
+}
+
+bool RegExpFilter::mayMatch(const QString &line) const
+{
+    if (_requiredLiterals.isEmpty()) {
+        return true;
+    }
+
+    const int length = line.length();
+    for (int i = 0; i < length; i++) {
+        const QStringList &literals = _requiredLiterals.at(literalTableIndex(line.at(i)));
+        for (const QString &literal : literals) {
+            if (literal.length() <= length - i && line.midRef(i, literal.length()) == literal) {
+                return true;
+            }
+        }
+    }
+    return false;
+}
+
 void RegExpFilter::process()
 {
     const QString *text = buffer();
@@ -363,25 +409,55 @@ void RegExpFilter::process()
         return;
     }
 
-    QRegularExpressionMatchIterator iterator(_searchText.globalMatch(*text));
-    while (iterator.hasNext()) {
-        QRegularExpressionMatch match(iterator.next());
+    // only the matches of lines which are still in the buffer are kept
+    QHash<QString, QVector<Match> > previousLineMatches;
+    previousLineMatches.swap(_lineMatches);
 
-        int startLine = 0;
-        int endLine = 0;
-        int startColumn = 0;
-        int endColumn = 0;
+    int lineStart = 0;
+    while (lineStart < text->length()) {
+        int lineEnd = text->indexOf(QLatin1Char('\n'), lineStart);
+        if (lineEnd == -1) {
+            lineEnd = text->length();
+        }
+        const QString line = text->mid(lineStart, lineEnd - lineStart);
+
+        auto matches = _lineMatches.constFind(line);
+        if (matches == _lineMatches.constEnd()) {
+            const auto previousMatches = previousLineMatches.constFind(line);
+            if (previousMatches != previousLineMatches.constEnd()) {
+                matches = _lineMatches.insert(line, *previousMatches);
+            } else {
+                QVector<Match> lineMatches;
+                if (mayMatch(line)) {
+                    QRegularExpressionMatchIterator iterator(_searchText.globalMatch(line));
+                    while (iterator.hasNext()) {
+                        QRegularExpressionMatch match(iterator.next());
+                        lineMatches.append({match.capturedStart(), match.capturedEnd(), match.capturedTexts()});
+                    }
+                }
+                matches = _lineMatches.insert(line, lineMatches);
+            }
+        }
 
-        getLineColumn(match.capturedStart(), startLine, startColumn);
-        getLineColumn(match.capturedEnd(), endLine, endColumn);
+        for (const Match &match : qAsConst(*matches)) {
+            int startLine = 0;
+            int endLine = 0;
+            int startColumn = 0;
+            int endColumn = 0;
 
-        RegExpFilter::HotSpot *spot = newHotSpot(startLine, startColumn,
-                                                 endLine, endColumn, match.capturedTexts());
-        if (spot == nullptr) {
-            continue;
+            getLineColumn(lineStart + match.start, startLine, startColumn);
+            getLineColumn(lineStart + match.end, endLine, endColumn);
+
+            RegExpFilter::HotSpot *spot = newHotSpot(startLine, startColumn,
+                                                     endLine, endColumn, match.capturedTexts);
+            if (spot == nullptr) {
+                continue;
+            }
+
+            addHotSpot(spot);
         }
 
-        addHotSpot(spot);
+        lineStart = lineEnd + 1;
     }
 }
 
@@ -471,6 +547,9 @@ const QRegularExpression UrlFilter::CompleteUrlRegExp(QLatin1Char('(') + FullUrl
 UrlFilter::UrlFilter()
 {
     setRegExp(CompleteUrlRegExp);
+    // every full url contains one of the first two, every email address the last
+    setRequiredLiterals(QStringList() << QStringLiteral("://") << QStringLiteral("www.")
+                                      << QStringLiteral("@"));
 }
 
 UrlFilter::HotSpot::~HotSpot()
@@ -545,11 +624,26 @@ RegExpFilter::HotSpot *FileFilter::newHotSpot(int startLine, int startColumn, in
     return new FileFilter::HotSpot(startLine, startColumn, endLine, endColumn, capturedTexts, _dirPath + filename);
 }
 
+DirectoryCache *FileFilter::directoryCache() const
+{
+    return _directoryCache;
+}
+
 void FileFilter::process()
 {
-    const QDir dir(_session->currentWorkingDirectory());
-    _dirPath = dir.canonicalPath() + QLatin1Char('/');
-    _currentFiles = dir.entryList(QDir::Files).toSet();
+    // the directory is listed in the background, the file system is
+    // never accessed while the hotspots are updated
+    if (_directoryCache.isNull()) {
+        _dirPath.clear();
+        _currentFiles.clear();
+        return;
+    }
+
+    _dirPath = _directoryCache->canonicalPath();
+    _currentFiles = _directoryCache->files();
+    if (_currentFiles.isEmpty()) {
+        return;
+    }
 
     RegExpFilter::process();
 }
@@ -601,8 +695,31 @@ static QString createFileRegex(const QStringList &patterns, const QString &fileP
     );
 }
 
+// returns strings of which every file name matched by createFileRegex() with
+// the same arguments contains one, the names which contain a dot (such as
+// all names with a known extension) are covered by the dot
+static QStringList requiredFileLiterals(const QStringList &patterns, const QString &filePattern)
+{
+    QStringList names;
+    names << patterns.filter(QRegularExpression(QStringLiteral("^\\*") + filePattern + QStringLiteral("$")));
+    names << patterns.filter(QRegularExpression(QStringLiteral("^") + filePattern + QStringLiteral("+\\*$")));
+    names << patterns.filter(QRegularExpression(QStringLiteral("^") + filePattern + QStringLiteral("$")));
+    names.replaceInStrings(QStringLiteral("*"), QString());
+
+    QStringList literals;
+    literals << QStringLiteral(".");
+    for (const QString &name : qAsConst(names)) {
+        if (!name.contains(QLatin1Char('.'))) {
+            literals << name;
+        }
+    }
+    literals.removeDuplicates();
+    return literals;
+}
+
 FileFilter::FileFilter(Session *session) :
     _session(session)
+    , _directoryCache(session != nullptr ? DirectoryCache::forSession(session) : nullptr)
     , _dirPath(QString())
     , _currentFiles(QSet<QString>())
 {
@@ -624,6 +741,7 @@ FileFilter::FileFilter(Session *session) :
     QString regex = QLatin1String("(") + noSpaceRegex + QLatin1String(")|(") + spaceRegex + QLatin1String(")");
 
     setRegExp(QRegularExpression(regex, QRegularExpression::DontCaptureOption));
+    setRequiredLiterals(requiredFileLiterals(patterns, validFilename));
 }
 
 FileFilter::HotSpot::~HotSpot()
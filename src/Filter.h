@@ -21,6 +21,7 @@
 #define FILTER_H
 
 // Qt
+#include <QHash>
 #include <QList>
 #include <QSet>
 #include <QObject>
@@ -28,13 +29,16 @@
 #include <QStringList>
 #include <QRegularExpression>
 #include <QMultiHash>
+#include <QVector>
 
 // Konsole
 #include "Character.h"
+#include "konsoleprivate_export.h"
 
 class QAction;
 
 namespace Konsole {
+class DirectoryCache;
 class Session;
 
 /**
@@ -55,7 +59,7 @@ class Session;
  * When processing the text they should create instances of Filter::HotSpot subclasses for sections of interest
  * and add them to the filter's list of hotspots using addHotSpot()
  */
-class Filter
+class KONSOLEPRIVATE_EXPORT Filter
 {
 public:
     /**
@@ -181,7 +185,7 @@ private:
  * Subclasses can reimplement newHotSpot() to return custom hotspot types when matches for the regular expression
  * are found.
  */
-class RegExpFilter : public Filter
+class KONSOLEPRIVATE_EXPORT RegExpFilter : public Filter
 {
 public:
     /**
@@ -214,9 +218,23 @@ public:
     /** Returns the regular expression which the filter searches for in blocks of text */
     QRegularExpression regExp() const;
 
+    /**
+     * Sets strings of which every match of the regular expression contains at
+     * least one.  Lines which contain none of them are not searched, looking
+     * for the strings is much faster than running the regular expression.
+     * The strings are compared case sensitively.
+     *
+     * By default, or if @p literals is empty, every line is searched.
+     */
+    void setRequiredLiterals(const QStringList &literals);
+
     /**
      * Reimplemented to search the filter's text buffer for text matching regExp()
      *
+     * The buffer is searched line by line, a match does not continue in the next
+     * line unless the line is wrapped.  The matches of each line are kept until
+     * the next call, so lines which are still in the buffer are not searched again.
+     *
      * If regexp matches the empty string, then process() will return immediately
      * without finding results.
      */
@@ -231,7 +249,23 @@ protected:
                                               int endColumn, const QStringList &capturedTexts);
 
 private:
+    // a match of the regular expression in a line of the buffer
+    struct Match {
+        int start;
+        int end;
+        QStringList capturedTexts;
+    };
+
+    // returns true if the line contains one of the required literals
+    bool mayMatch(const QString &line) const;
+
     QRegularExpression _searchText;
+    // the required literals by their first character, the characters
+    // from 128 on share the last entry; empty if every line is searched
+    QVector<QStringList> _requiredLiterals;
+    // the matches in the lines searched by the last call of process(),
+    // keyed by the text of the line
+    QHash<QString, QVector<Match> > _lineMatches;
 };
 
 class FilterObject;
@@ -314,6 +348,13 @@ public:
 
     explicit FileFilter(Session *session);
 
+    /**
+     * Returns the cache of the files in the current directory of the
+     * session.  updated() is emitted by it when the hotspots may have
+     * changed although the text did not.
+     */
+    DirectoryCache *directoryCache() const;
+
     void process() Q_DECL_OVERRIDE;
 
 protected:
@@ -321,6 +362,7 @@ protected:
 
 private:
     QPointer<Session> _session;
+    QPointer<DirectoryCache> _directoryCache;
     QString _dirPath;
     QSet<QString> _currentFiles;
 };
@@ -358,7 +400,7 @@ private:
  * The hotSpots() and hotSpotsAtLine() method return all of the hotspots in the text and on
  * a given line respectively.
  */
-class FilterChain : protected QList<Filter *>
+class KONSOLEPRIVATE_EXPORT FilterChain : protected QList<Filter *>
 {
 public:
     virtual ~FilterChain();
@@ -389,7 +431,7 @@ public:
 };
 
 /** A filter chain which processes character images from terminal displays */
-class TerminalImageFilterChain : public FilterChain
+class KONSOLEPRIVATE_EXPORT TerminalImageFilterChain : public FilterChain
 {
 public:
     TerminalImageFilterChain();
@@ -0,0 +1,78 @@
+/*
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+    02110-1301  USA.
+*/
+
+// Own
+#include "GlyphRunCache.h"
+
+// System
+#include <climits>
+
+// Qt
+#include <QPainter>
+#include <QTextLayout>
+
+using namespace Konsole;
+
+GlyphRunCache::GlyphRunCache(int maxTexts) :
+    _glyphRuns(maxTexts)
+{
+}
+
+bool GlyphRunCache::drawText(QPainter &painter, const QPointF &position, const QString &text)
+{
+    const Key key = {text, painter.font()};
+    const QList<QGlyphRun> *cachedRuns = _glyphRuns.object(key);
+    if (cachedRuns != nullptr) {
+        for (const QGlyphRun &run : *cachedRuns) {
+            painter.drawGlyphRun(position, run);
+        }
+        return true;
+    }
+
+    QTextOption option;
+    option.setWrapMode(QTextOption::NoWrap);
+    option.setTextDirection(Qt::LeftToRight);
+
+    QTextLayout layout(text, key.font, painter.device());
+    layout.setTextOption(option);
+    layout.beginLayout();
+    QTextLine line = layout.createLine();
+    if (line.isValid()) {
+        // the largest width QTextLine handles, the text is never wrapped
+        line.setLineWidth(INT_MAX / 256);
+        // place the baseline at the origin
+        line.setPosition(QPointF(0, -line.ascent()));
+    }
+    layout.endLayout();
+
+    const QList<QGlyphRun> runs = layout.glyphRuns();
+    for (const QGlyphRun &run : runs) {
+        painter.drawGlyphRun(position, run);
+    }
+    _glyphRuns.insert(key, new QList<QGlyphRun>(runs));
+    return false;
+}
+
+void GlyphRunCache::clear()
+{
+    _glyphRuns.clear();
+}
+
+int GlyphRunCache::count() const
+{
+    return _glyphRuns.count();
+}
@@ -0,0 +1,88 @@
+/*
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+    02110-1301  USA.
+*/
+
+#ifndef GLYPHRUNCACHE_H
+#define GLYPHRUNCACHE_H
+
+// Qt
+#include <QCache>
+#include <QFont>
+#include <QGlyphRun>
+#include <QList>
+#include <QString>
+
+// Konsole
+#include "konsoleprivate_export.h"
+
+class QPainter;
+class QPointF;
+
+namespace Konsole
+{
+/**
+ * A cache of shaped text, used to draw the fragments of the terminal
+ * image which are painted again and again, like prompts, status bars
+ * and the borders of text user interfaces, without shaping them each
+ * time.
+ *
+ * The glyph runs of a text are cached for the font they were shaped
+ * with.  The least recently used runs are dropped when the cache is full.
+ */
+class KONSOLEPRIVATE_EXPORT GlyphRunCache
+{
+public:
+    explicit GlyphRunCache(int maxTexts = DefaultMaxTexts);
+
+    /**
+     * Draws @p text left to right with the font and the pen of @p painter,
+     * with the start of its baseline at @p position.
+     *
+     * Returns true if the glyph runs of the text were found in the cache,
+     * and false if the text had to be shaped.
+     */
+    bool drawText(QPainter &painter, const QPointF &position, const QString &text);
+
+    /** Drops all cached glyph runs. */
+    void clear();
+
+    /** Number of texts which are cached */
+    int count() const;
+
+    /** Default number of texts cached */
+    static const int DefaultMaxTexts = 1024;
+
+private:
+    struct Key {
+        QString text;
+        QFont font;
+
+        bool operator==(const Key &other) const
+        {
+            return text == other.text && font == other.font;
+        }
+
+        friend uint qHash(const Key &key, uint seed = 0)
+        {
+            return qHash(key.text, seed) ^ qHash(key.font, seed);
+        }
+    };
+
+    QCache<Key, QList<QGlyphRun> > _glyphRuns;
+};
+}
+
+#endif // GLYPHRUNCACHE_H
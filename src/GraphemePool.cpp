@@ -0,0 +1,216 @@
+/*
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+    02110-1301  USA.
+*/
+
+// Own
+#include "GraphemePool.h"
+
+// Konsole
+#include "konsoledebug.h"
+
+using namespace Konsole;
+
+QAtomicPointer<GraphemePool> GraphemePool::_pools[GraphemePool::MaxPools];
+quint8 GraphemePool::_poolGenerations[GraphemePool::MaxPools];
+QMutex GraphemePool::_poolsMutex;
+int GraphemePool::_nextPool = 1;
+
+GraphemePool::GraphemePool() :
+    _number(0),
+    _firstGeneration(0),
+    _generations(QVector<quint8>()),
+    _freeEntries(QVector<uint>()),
+    _droppedSequences(QVector<uint *>()),
+    _rejectedSequences(0),
+    _compactionDelay(0),
+    _mutex(),
+    _entries(QMultiHash<uint, uint>())
+{
+    // the numbers of destroyed pools are reused as late as possible, in
+    // case keys of their sequences are still around
+    QMutexLocker locker(&_poolsMutex);
+    for (int i = 0; i < MaxPools - 1; i++) {
+        const int number = _nextPool;
+        _nextPool = _nextPool % (MaxPools - 1) + 1;
+        if (_pools[number].testAndSetOrdered(nullptr, this)) {
+            // keys of the last pool with the number do not match the
+            // entries of this one, unless they have been reused a lot
+            _poolGenerations[number] = (_poolGenerations[number] + 1) & ((1 << GenerationBits) - 1);
+            _number = number;
+            _firstGeneration = _poolGenerations[number];
+            return;
+        }
+    }
+    qCDebug(KonsoleDebug) << "Too many grapheme pools, combining characters will not be displayed";
+}
+
+GraphemePool::~GraphemePool()
+{
+    if (_number != 0) {
+        _pools[_number].storeRelease(nullptr);
+    }
+
+    for (int chunk = 0; chunk < MaxChunks; chunk++) {
+        QAtomicPointer<uint> *entries = _chunks[chunk].loadAcquire();
+        if (entries == nullptr) {
+            continue;
+        }
+        for (int i = 0; i < ChunkSize; i++) {
+            delete[] entries[i].loadAcquire();
+        }
+        delete[] entries;
+    }
+    for (uint *sequence : qAsConst(_droppedSequences)) {
+        delete[] sequence;
+    }
+}
+
+uint GraphemePool::add(const uint *unicodePoints, ushort length)
+{
+    if (_number == 0 || length == 0) {
+        return 0;
+    }
+
+    QMutexLocker locker(&_mutex);
+
+    uint hash = 0;
+    for (ushort i = 0; i < length; i++) {
+        hash = 31 * hash + unicodePoints[i];
+    }
+    for (auto it = _entries.constFind(hash); it != _entries.constEnd() && it.key() == hash; ++it) {
+        if (matches(it.value(), unicodePoints, length)) {
+            return key(it.value());
+        }
+    }
+
+    // reuse the entries dropped by compact() first
+    uint index;
+    if (!_freeEntries.isEmpty()) {
+        index = _freeEntries.takeLast();
+        _generations[index] = (_generations[index] + 1) & ((1 << GenerationBits) - 1);
+    } else if (_generations.size() < MaxSequences) {
+        index = _generations.size();
+        _generations.append(_firstGeneration);
+    } else {
+        _rejectedSequences++;
+        return 0;
+    }
+
+    const uint chunk = index >> ChunkBits;
+    if (_chunks[chunk].loadAcquire() == nullptr) {
+        _chunks[chunk].storeRelease(new QAtomicPointer<uint>[ChunkSize]);
+    }
+
+    auto sequence = new uint[length + 2];
+    sequence[0] = _generations[index];
+    sequence[1] = length;
+    for (ushort i = 0; i < length; i++) {
+        sequence[i + 2] = unicodePoints[i];
+    }
+    entry(index).storeRelease(sequence);
+    _entries.insert(hash, index);
+
+    return key(index);
+}
+
+const uint *GraphemePool::lookup(uint key, ushort &length)
+{
+    length = 0;
+
+    const GraphemePool *pool = _pools[key >> (GenerationBits + IndexBits)].loadAcquire();
+    if (pool == nullptr) {
+        return nullptr;
+    }
+
+    const uint index = key & (MaxSequences - 1);
+    const QAtomicPointer<uint> *entries = pool->_chunks[index >> ChunkBits].loadAcquire();
+    if (entries == nullptr) {
+        return nullptr;
+    }
+
+    // the key of a dropped sequence, or of a destroyed pool whose number
+    // was reused, has another generation than the entry
+    const uint *sequence = entries[index & (ChunkSize - 1)].loadAcquire();
+    if (sequence == nullptr || sequence[0] != ((key >> IndexBits) & ((1 << GenerationBits) - 1))) {
+        return nullptr;
+    }
+
+    length = ushort(sequence[1]);
+    return sequence + 2;
+}
+
+bool GraphemePool::shouldCompact() const
+{
+    QMutexLocker locker(&_mutex);
+    return _freeEntries.isEmpty() && _generations.size() == MaxSequences
+           && _rejectedSequences >= _compactionDelay;
+}
+
+void GraphemePool::compact(const QSet<uint> &usedKeys)
+{
+    QMutexLocker locker(&_mutex);
+
+    for (uint *sequence : qAsConst(_droppedSequences)) {
+        delete[] sequence;
+    }
+    _droppedSequences.clear();
+
+    for (auto it = _entries.begin(); it != _entries.end();) {
+        const uint index = it.value();
+        if (usedKeys.contains(key(index))) {
+            ++it;
+            continue;
+        }
+        _droppedSequences.append(entry(index).loadAcquire());
+        entry(index).storeRelease(nullptr);
+        _freeEntries.append(index);
+        it = _entries.erase(it);
+    }
+
+    // reading the history again is not worth it if little was freed
+    _rejectedSequences = 0;
+    _compactionDelay = _freeEntries.size() < MaxSequences / 8 ? MaxSequences / 8 : 0;
+}
+
+int GraphemePool::count() const
+{
+    QMutexLocker locker(&_mutex);
+    return _entries.size();
+}
+
+uint GraphemePool::key(uint index) const
+{
+    return (_number << (GenerationBits + IndexBits)) | (uint(_generations[index]) << IndexBits) | index;
+}
+
+QAtomicPointer<uint> &GraphemePool::entry(uint index) const
+{
+    return _chunks[index >> ChunkBits].loadAcquire()[index & (ChunkSize - 1)];
+}
+
+bool GraphemePool::matches(uint index, const uint *unicodePoints, ushort length) const
+{
+    const uint *sequence = entry(index).loadAcquire();
+    if (sequence[1] != length) {
+        return false;
+    }
+    for (ushort i = 0; i < length; i++) {
+        if (sequence[i + 2] != unicodePoints[i]) {
+            return false;
+        }
+    }
+    return true;
+}
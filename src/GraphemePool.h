@@ -0,0 +1,144 @@
+/*
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+    02110-1301  USA.
+*/
+
+#ifndef GRAPHEMEPOOL_H
+#define GRAPHEMEPOOL_H
+
+// Qt
+#include <QAtomicPointer>
+#include <QMultiHash>
+#include <QMutex>
+#include <QSet>
+#include <QVector>
+
+// Konsole
+#include "konsoleprivate_export.h"
+
+namespace Konsole
+{
+/**
+ * A pool of the sequences of unicode characters which are displayed in a
+ * single cell, like a letter followed by combining characters.  A
+ * Character with the RE_EXTENDED_CHAR rendition holds the key of its
+ * sequence instead of a code point.
+ *
+ * Every Screen has a pool for the sequences on the screen and in its
+ * history, which is released together with the screen.  Looking up a key
+ * is a constant time operation which needs no lock, from any thread.
+ * Adding sequences and compacting the pool are serialized by the pool.
+ *
+ * The key of a sequence tells the pool it belongs to, lookup() finds
+ * it without a pointer to the pool.  It also holds the generation of its
+ * entry, so the key of a sequence which was dropped by compact() or
+ * whose pool was destroyed is not taken for the sequence which reuses
+ * the entry.
+ */
+class KONSOLEPRIVATE_EXPORT GraphemePool
+{
+public:
+    GraphemePool();
+    ~GraphemePool();
+
+    /**
+     * Adds a sequence of unicode characters to the pool and returns the
+     * key which is used to look it up with lookup().  If the pool
+     * contains the sequence already, the key of the existing sequence is
+     * returned.
+     *
+     * Returns 0 if the pool is full, see compact().
+     *
+     * @param unicodePoints An array of unicode character points
+     * @param length Length of @p unicodePoints
+     */
+    uint add(const uint *unicodePoints, ushort length);
+
+    /**
+     * Returns the sequence of unicode characters of @p key, which was
+     * returned by add() of any pool which still exists, and sets
+     * @p length to its length.  Returns nullptr and sets @p length to 0
+     * if the key is unknown.
+     */
+    static const uint *lookup(uint key, ushort &length);
+
+    /**
+     * Returns true if the pool is full and compact() should be called.
+     * After a compaction which freed few entries, this is only true again
+     * once many sequences have been rejected, since finding the keys in
+     * use means reading the whole screen.
+     */
+    bool shouldCompact() const;
+
+    /**
+     * Drops the sequences whose keys are not in @p usedKeys, so that
+     * their entries can be reused.  The keys of the other sequences stay
+     * valid.  The memory of dropped sequences is freed by the next
+     * compaction, in case another thread still reads them.
+     */
+    void compact(const QSet<uint> &usedKeys);
+
+    /** Number of sequences in the pool */
+    int count() const;
+
+    /** Maximum number of sequences in a pool */
+    static const int MaxSequences = 1 << 16;
+
+private:
+    Q_DISABLE_COPY(GraphemePool)
+
+    // a key holds the number of its pool in the highest bits, then the
+    // generation of its entry and the index of the entry in the others
+    static const int IndexBits = 16;
+    static const int GenerationBits = 3;
+    static const int PoolBits = 32 - GenerationBits - IndexBits;
+    static const int MaxPools = 1 << PoolBits;
+    // the entries are allocated in chunks
+    static const int ChunkBits = 10;
+    static const int ChunkSize = 1 << ChunkBits;
+    static const int MaxChunks = MaxSequences / ChunkSize;
+
+    uint key(uint index) const;
+    QAtomicPointer<uint> &entry(uint index) const;
+    bool matches(uint index, const uint *unicodePoints, ushort length) const;
+
+    // the pools by their number, 0 is never used so no key is 0
+    static QAtomicPointer<GraphemePool> _pools[MaxPools];
+    // the generations the entries of the last pools with a number start with
+    static quint8 _poolGenerations[MaxPools];
+    static QMutex _poolsMutex;
+    static int _nextPool;
+
+    uint _number;
+    quint8 _firstGeneration;
+    // the entries point to the generation of the entry, the length of the
+    // sequence and its code points, which never change
+    QAtomicPointer<QAtomicPointer<uint>> _chunks[MaxChunks];
+    // the generations of the entries, and the entries dropped by compact()
+    QVector<quint8> _generations;
+    QVector<uint> _freeEntries;
+    // the sequences dropped by the last compact()
+    QVector<uint *> _droppedSequences;
+    int _rejectedSequences;
+    int _compactionDelay;
+
+    // serializes add() and compact()
+    mutable QMutex _mutex;
+    // the entries of the sequences by their hashes
+    QMultiHash<uint, uint> _entries;
+};
+}
+
+#endif // GRAPHEMEPOOL_H
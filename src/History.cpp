@@ -26,8 +26,10 @@
 
 // System
 #include <cerrno>
+#include <climits>
 #include <cstdlib>
 #include <cstdio>
+#include <cstring>
 #include <sys/types.h>
 
 // KDE
@@ -59,16 +61,12 @@ Q_GLOBAL_STATIC(QString, historyFileLocation)
    at constant costs.
 */
 
-// History File ///////////////////////////////////////////
-HistoryFile::HistoryFile() :
-    _length(0),
-    _fileMap(nullptr),
-    _readWriteBalance(0)
+// Returns the directory for the history files.
+// Determine the temp directory once
+// This has the down-side that users must restart to
+// load changes.
+static QString historyFileDirectory()
 {
-    // Determine the temp directory once
-    // This class is called 3 times for each "unlimited" scrollback.
-    // This has the down-side that users must restart to
-    // load changes.
     if (!historyFileLocation.exists()) {
         QString fileLocation;
         KSharedConfigPtr appConfig = KSharedConfig::openConfig();
@@ -106,7 +104,17 @@ HistoryFile::HistoryFile() :
         }
         *historyFileLocation() = fileLocation;
     }
-    const QString tmpDir = *historyFileLocation();
+    return *historyFileLocation();
+}
+
+// History File ///////////////////////////////////////////
+HistoryFile::HistoryFile() :
+    _length(0),
+    _fileMap(nullptr),
+    _readWriteBalance(0)
+{
+    // This class is called 3 times for each "unlimited" scrollback.
+    const QString tmpDir = historyFileDirectory();
     const QString tmpFormat = tmpDir + QLatin1Char('/') + QLatin1String("konsole-XXXXXX.history");
     _tmpFile.setFileTemplate(tmpFormat);
     if (_tmpFile.open()) {
@@ -311,6 +319,202 @@ void HistoryScrollFile::addLine(bool previousWrapped)
     _lineflags.add(reinterpret_cast<char *>(&flags), sizeof(char));
 }
 
+// History Scroll Ring File //////////////////////////////////////
+
+/*
+   The ring file is a fixed number of segments of SegmentSize bytes in
+   a single memory mapped temporary file.  Lines are appended to the
+   current segment: its line index, one quint32 per line, grows from
+   the start of the segment and the cells of the lines grow down from
+   its end.  An index entry is the offset of the line's cells, with the
+   wrapped flag in the highest bit; a line ends where the previous one
+   begins.
+
+   When the current segment is full, the next one is started.  Once all
+   segments are in use, the oldest segment is reclaimed and its lines
+   are dropped, so the file never grows beyond its initial size.
+
+   Lines are numbered absolutely while the ring wraps around; the
+   segments know the number of their first line, so finding a line
+   needs a binary search over the few segments at most.
+*/
+
+static const quint32 WRAPPED_LINE = 0x80000000u;
+
+static int ringSegmentCount(int megabytes)
+{
+    return qMax(2, megabytes * (1024 * 1024 / HistoryScrollRingFile::SegmentSize));
+}
+
+HistoryScrollRingFile::HistoryScrollRingFile(int megabytes) :
+    HistoryScroll(new HistoryTypeRingFile(megabytes)),
+    _fileMap(nullptr),
+    _segments(QVector<Segment>(ringSegmentCount(megabytes))),
+    _oldestSegment(0),
+    _currentSegment(0),
+    _lastSegment(0),
+    _firstLine(0),
+    _nextLine(0),
+    _pendingCells(QVector<Character>())
+{
+    const QString tmpFormat = historyFileDirectory() + QLatin1Char('/') + QLatin1String("konsole-XXXXXX.history");
+    _file.setFileTemplate(tmpFormat);
+    if (_file.open()) {
+        _file.setAutoRemove(true);
+        const qint64 size = static_cast<qint64>(_segments.size()) * SegmentSize;
+        if (_file.resize(size)) {
+            _fileMap = _file.map(0, size);
+        }
+    }
+    if (_fileMap == nullptr) {
+        qCWarning(KonsoleDebug) << "Unable to map scrollback file" << _file.fileName() << ", no lines will be kept";
+    }
+
+    _segments[0].firstLine = 0;
+    _segments[0].lineCount = 0;
+    _segments[0].top = SegmentSize;
+}
+
+HistoryScrollRingFile::~HistoryScrollRingFile()
+{
+    if (_fileMap != nullptr) {
+        _file.unmap(_fileMap);
+    }
+}
+
+uchar *HistoryScrollRingFile::segmentData(int segment) const
+{
+    return _fileMap + static_cast<qint64>(segment) * SegmentSize;
+}
+
+quint32 *HistoryScrollRingFile::lineIndex(int segment) const
+{
+    return reinterpret_cast<quint32 *>(segmentData(segment));
+}
+
+int HistoryScrollRingFile::segmentOf(qint64 line)
+{
+    const Segment &last = _segments.at(_lastSegment);
+    if (line >= last.firstLine && line < last.firstLine + last.lineCount) {
+        return _lastSegment;
+    }
+
+    // the segments from the oldest to the current one hold ascending lines
+    const int count = _segments.size();
+    int low = 0;
+    int high = (_currentSegment - _oldestSegment + count) % count;
+    while (low < high) {
+        const int middle = (low + high + 1) / 2;
+        if (_segments.at((_oldestSegment + middle) % count).firstLine <= line) {
+            low = middle;
+        } else {
+            high = middle - 1;
+        }
+    }
+    _lastSegment = (_oldestSegment + low) % count;
+    return _lastSegment;
+}
+
+int HistoryScrollRingFile::getLines()
+{
+    return static_cast<int>(_nextLine - _firstLine);
+}
+
+int HistoryScrollRingFile::getLineLen(int lineno)
+{
+    if (lineno < 0 || lineno >= getLines()) {
+        return 0;
+    }
+    const qint64 line = _firstLine + lineno;
+    const int segment = segmentOf(line);
+    const int i = static_cast<int>(line - _segments.at(segment).firstLine);
+    const quint32 *index = lineIndex(segment);
+    const quint32 end = (i == 0) ? static_cast<quint32>(SegmentSize) : (index[i - 1] & ~WRAPPED_LINE);
+    return (end - (index[i] & ~WRAPPED_LINE)) / sizeof(Character);
+}
+
+bool HistoryScrollRingFile::isWrappedLine(int lineno)
+{
+    if (lineno < 0 || lineno >= getLines()) {
+        return false;
+    }
+    const qint64 line = _firstLine + lineno;
+    const int segment = segmentOf(line);
+    return (lineIndex(segment)[line - _segments.at(segment).firstLine] & WRAPPED_LINE) != 0u;
+}
+
+void HistoryScrollRingFile::getCells(int lineno, int colno, int count, Character res[])
+{
+    if (count <= 0 || lineno < 0 || lineno >= getLines()) {
+        return;
+    }
+    Q_ASSERT(colno + count <= getLineLen(lineno));
+    const qint64 line = _firstLine + lineno;
+    const int segment = segmentOf(line);
+    const quint32 offset = lineIndex(segment)[line - _segments.at(segment).firstLine] & ~WRAPPED_LINE;
+    memcpy(res, segmentData(segment) + offset + colno * sizeof(Character), count * sizeof(Character));
+}
+
+void HistoryScrollRingFile::addCells(const Character text[], int count)
+{
+    const int size = _pendingCells.size();
+    _pendingCells.resize(size + count);
+    memcpy(_pendingCells.data() + size, text, count * sizeof(Character));
+}
+
+void HistoryScrollRingFile::addCellsVector(const QVector<Character> &cells)
+{
+    if (_pendingCells.isEmpty()) {
+        _pendingCells = cells;
+    } else {
+        _pendingCells += cells;
+    }
+}
+
+void HistoryScrollRingFile::startSegment()
+{
+    const int count = _segments.size();
+    _currentSegment = (_currentSegment + 1) % count;
+
+    // reclaim the oldest segment once the ring is full
+    if (_currentSegment == _oldestSegment) {
+        _firstLine += _segments.at(_oldestSegment).lineCount;
+        _oldestSegment = (_oldestSegment + 1) % count;
+    }
+
+    Segment &segment = _segments[_currentSegment];
+    segment.firstLine = _nextLine;
+    segment.lineCount = 0;
+    segment.top = SegmentSize;
+}
+
+void HistoryScrollRingFile::addLine(bool previousWrapped)
+{
+    if (_fileMap == nullptr) {
+        _pendingCells.clear();
+        return;
+    }
+
+    // a line has to fit into an empty segment next to its index entry
+    const int maxCells = (SegmentSize - sizeof(quint32)) / sizeof(Character);
+    const int cellCount = qMin(_pendingCells.size(), maxCells);
+    const quint32 size = cellCount * sizeof(Character);
+
+    Segment *segment = &_segments[_currentSegment];
+    if (segment->top < (segment->lineCount + 1) * sizeof(quint32) + size) {
+        startSegment();
+        segment = &_segments[_currentSegment];
+    }
+
+    segment->top -= size;
+    memcpy(segmentData(_currentSegment) + segment->top, _pendingCells.constData(), size);
+    lineIndex(_currentSegment)[segment->lineCount] = segment->top | (previousWrapped ? WRAPPED_LINE : 0u);
+    segment->lineCount++;
+    _nextLine++;
+
+    _pendingCells.clear();
+}
+
 // History Scroll None //////////////////////////////////////
 
 HistoryScrollNone::HistoryScrollNone() :
@@ -355,249 +559,477 @@ void HistoryScrollNone::addLine(bool)
 ////////////////////////////////////////////////////////////////
 // Compact History Scroll //////////////////////////////////////
 ////////////////////////////////////////////////////////////////
-void *CompactHistoryBlock::allocate(size_t size)
+// size of the blocks lines are allocated from, larger lines get a block of their own
+static const size_t BLOCK_LENGTH = 4096 * 64; // 256kb
+// initial size of the line index, it grows up to the maximum line count
+static const int MIN_LINE_INDEX = 256;
+
+CompactHistoryBlockList::CompactHistoryBlockList() :
+    _blocks(QVector<CompactHistoryBlock *>()),
+    _spareBlock(nullptr)
 {
-    Q_ASSERT(size > 0);
-    if (_tail - _blockStart + size > _blockLength) {
-        return nullptr;
-    }
-
-    void *block = _tail;
-    _tail += size;
-    ////qDebug() << "allocated " << length << " bytes at address " << block;
-    _allocCount++;
-    return block;
 }
 
-void CompactHistoryBlock::deallocate()
+CompactHistoryBlockList::~CompactHistoryBlockList()
 {
-    _allocCount--;
-    Q_ASSERT(_allocCount >= 0);
+    qDeleteAll(_blocks);
+    delete _spareBlock;
 }
 
 void *CompactHistoryBlockList::allocate(size_t size)
 {
-    CompactHistoryBlock *block;
-    if (list.isEmpty() || list.last()->remaining() < size) {
-        block = new CompactHistoryBlock();
-        list.append(block);
-        ////qDebug() << "new block created, remaining " << block->remaining() << "number of blocks=" << list.size();
-    } else {
-        block = list.last();
-        ////qDebug() << "old block used, remaining " << block->remaining();
+    if (_blocks.isEmpty() || _blocks.last()->remaining() < size) {
+        // an unused block is the last block, it only can be too small
+        if (!_blocks.isEmpty() && !_blocks.last()->isInUse()) {
+            delete _blocks.takeLast();
+        }
+
+        CompactHistoryBlock *block;
+        if (size > BLOCK_LENGTH) {
+            block = new CompactHistoryBlock((size + 4095) & ~size_t(4095));
+        } else if (_spareBlock != nullptr) {
+            block = _spareBlock;
+            _spareBlock = nullptr;
+        } else {
+            block = new CompactHistoryBlock(BLOCK_LENGTH);
+        }
+        _blocks.append(block);
     }
-    return block->allocate(size);
+    return _blocks.last()->allocate(size);
 }
 
-void CompactHistoryBlockList::deallocate(void *ptr)
+void CompactHistoryBlockList::deallocateOldest()
 {
-    Q_ASSERT(!list.isEmpty());
+    Q_ASSERT(!_blocks.isEmpty());
 
-    int i = 0;
-    CompactHistoryBlock *block = list.at(i);
-    while (i < list.size() && !block->contains(ptr)) {
-        i++;
-        block = list.at(i);
+    CompactHistoryBlock *block = _blocks.first();
+    block->deallocate();
+    if (block->isInUse()) {
+        return;
     }
 
-    Q_ASSERT(i < list.size());
+    if (_blocks.size() == 1) {
+        block->reset();
+    } else {
+        _blocks.removeFirst();
+        if (_spareBlock == nullptr && block->length() == BLOCK_LENGTH) {
+            block->reset();
+            _spareBlock = block;
+        } else {
+            delete block;
+        }
+    }
+}
 
-    block->deallocate();
+size_t CompactHistoryLine::allocationSize(int length, int formatLength)
+{
+    // keep the next allocation aligned for the character values
+    const size_t size = sizeof(uint) * length + sizeof(CharacterFormat) * formatLength;
+    return (size + sizeof(uint) - 1) & ~(sizeof(uint) - 1);
+}
+
+void CompactHistoryLine::getCharacters(Character *array, int size, int startColumn) const
+{
+    Q_ASSERT(startColumn >= 0 && size >= 0);
+    Q_ASSERT(startColumn + size <= _length);
+
+    const CharacterFormat *formats = formatArray();
+    int formatPos = 0;
+    while ((formatPos + 1) < _formatLength && startColumn >= formats[formatPos + 1].startPos) {
+        formatPos++;
+    }
 
-    if (!block->isInUse()) {
-        list.removeAt(i);
-        delete block;
-        ////qDebug() << "block deleted, new size = " << list.size();
+    for (int i = startColumn; i < size + startColumn; i++) {
+        if ((formatPos + 1) < _formatLength && i >= formats[formatPos + 1].startPos) {
+            formatPos++;
+        }
+        Character &r = array[i - startColumn];
+        r.character = _text[i];
+        r.rendition = formats[formatPos].rendition;
+        r.foregroundColor = formats[formatPos].fgColor;
+        r.backgroundColor = formats[formatPos].bgColor;
+        r.isRealCharacter = formats[formatPos].isRealCharacter;
     }
 }
 
-CompactHistoryBlockList::~CompactHistoryBlockList()
+CompactHistoryScroll::CompactHistoryScroll(unsigned int maxLineCount) :
+    HistoryScroll(new CompactHistoryType(maxLineCount)),
+    _lines(),
+    _firstLine(0),
+    _lineCount(0),
+    _blockList(),
+    _maxLineCount(0)
 {
-    qDeleteAll(list.begin(), list.end());
-    list.clear();
+    ////qDebug() << "scroll of length " << maxLineCount << " created";
+    setMaxNbLines(maxLineCount);
 }
 
-void *CompactHistoryLine::operator new(size_t size, CompactHistoryBlockList &blockList)
+CompactHistoryScroll::~CompactHistoryScroll() = default;
+
+void CompactHistoryScroll::addCellsVector(const TextLine &cells)
 {
-    return blockList.allocate(size);
+    addCells(cells.constData(), cells.size());
 }
 
-CompactHistoryLine::CompactHistoryLine(const TextLine &line, CompactHistoryBlockList &bList) :
-    _blockListRef(bList),
-    _formatArray(nullptr),
-    _text(nullptr),
-    _formatLength(0),
-    _wrapped(false)
+void CompactHistoryScroll::addCells(const Character a[], int count)
 {
-    _length = line.size();
+    if (_maxLineCount == 0) {
+        return;
+    }
+    if (_lineCount == static_cast<int>(_maxLineCount)) {
+        removeFirstLine();
+    } else if (_lineCount == _lines.size()) {
+        growLineIndex();
+    }
 
-    if (!line.isEmpty()) {
-        _formatLength = 1;
-        int k = 1;
+    CompactHistoryLine &newLine = line(_lineCount);
+    _lineCount++;
 
-        // count number of different formats in this text line
-        Character c = line[0];
-        while (k < _length) {
-            if (!(line[k].equalsFormat(c))) {
-                _formatLength++; // format change detected
-                c = line[k];
-            }
-            k++;
-        }
+    newLine._text = nullptr;
+    newLine._length = count;
+    newLine._formatLength = 0;
+    newLine._wrapped = false;
+    if (count == 0) {
+        return;
+    }
 
-        ////qDebug() << "number of different formats in string: " << _formatLength;
-        _formatArray = static_cast<CharacterFormat *>(_blockListRef.allocate(sizeof(CharacterFormat) * _formatLength));
-        Q_ASSERT(_formatArray != nullptr);
-        _text = static_cast<uint *>(_blockListRef.allocate(sizeof(uint) * line.size()));
-        Q_ASSERT(_text != nullptr);
-
-        _length = line.size();
-        _wrapped = false;
-
-        // record formats and their positions in the format array
-        c = line[0];
-        _formatArray[0].setFormat(c);
-        _formatArray[0].startPos = 0;                      // there's always at least 1 format (for the entire line, unless a change happens)
-
-        k = 1;                                            // look for possible format changes
-        int j = 1;
-        while (k < _length && j < _formatLength) {
-            if (!(line[k].equalsFormat(c))) {
-                c = line[k];
-                _formatArray[j].setFormat(c);
-                _formatArray[j].startPos = k;
-                ////qDebug() << "format entry " << j << " at pos " << _formatArray[j].startPos << " " << &(_formatArray[j].startPos) ;
-                j++;
-            }
-            k++;
+    // count number of different formats in this text line
+    int formatLength = 1;
+    for (int k = 1; k < count; k++) {
+        if (!a[k].equalsFormat(a[k - 1])) {
+            formatLength++;
         }
+    }
 
-        // copy character values
-        for (int i = 0; i < line.size(); i++) {
-            _text[i] = line[i].character;
-            ////qDebug() << "char " << i << " at mem " << &(text[i]);
+    newLine._formatLength = formatLength;
+    newLine._text = static_cast<uint *>(_blockList.allocate(CompactHistoryLine::allocationSize(count, formatLength)));
+
+    // copy character values and record formats and their positions
+    auto *formats = const_cast<CharacterFormat *>(newLine.formatArray());
+    formats[0].setFormat(a[0]);
+    formats[0].startPos = 0;
+    newLine._text[0] = a[0].character;
+    int j = 1;
+    for (int k = 1; k < count; k++) {
+        if (!a[k].equalsFormat(a[k - 1])) {
+            formats[j].setFormat(a[k]);
+            formats[j].startPos = k;
+            j++;
         }
+        newLine._text[k] = a[k].character;
     }
-    ////qDebug() << "line created, length " << length << " at " << &(length);
 }
 
-CompactHistoryLine::~CompactHistoryLine()
+void CompactHistoryScroll::addLine(bool previousWrapped)
 {
-    if (_length > 0) {
-        _blockListRef.deallocate(_text);
-        _blockListRef.deallocate(_formatArray);
+    if (_lineCount > 0) {
+        line(_lineCount - 1)._wrapped = previousWrapped;
     }
-    _blockListRef.deallocate(this);
 }
 
-void CompactHistoryLine::getCharacter(int index, Character &r)
+int CompactHistoryScroll::getLines()
 {
-    Q_ASSERT(index < _length);
-    int formatPos = 0;
-    while ((formatPos + 1) < _formatLength && index >= _formatArray[formatPos + 1].startPos) {
-        formatPos++;
+    return _lineCount;
+}
+
+int CompactHistoryScroll::getLineLen(int lineNumber)
+{
+    if ((lineNumber < 0) || (lineNumber >= _lineCount)) {
+        return 0;
     }
+    return line(lineNumber)._length;
+}
 
-    r.character = _text[index];
-    r.rendition = _formatArray[formatPos].rendition;
-    r.foregroundColor = _formatArray[formatPos].fgColor;
-    r.backgroundColor = _formatArray[formatPos].bgColor;
-    r.isRealCharacter = _formatArray[formatPos].isRealCharacter;
+void CompactHistoryScroll::getCells(int lineNumber, int startColumn, int count, Character buffer[])
+{
+    if (count == 0) {
+        return;
+    }
+    Q_ASSERT(lineNumber >= 0 && lineNumber < _lineCount);
+    line(lineNumber).getCharacters(buffer, count, startColumn);
 }
 
-void CompactHistoryLine::getCharacters(Character *array, int size, int startColumn)
+void CompactHistoryScroll::setMaxNbLines(unsigned int lineCount)
 {
-    Q_ASSERT(startColumn >= 0 && size >= 0);
-    Q_ASSERT(startColumn + size <= static_cast<int>(getLength()));
+    _maxLineCount = lineCount;
 
-    for (int i = startColumn; i < size + startColumn; i++) {
-        getCharacter(i, array[i - startColumn]);
+    while (_lineCount > static_cast<int>(lineCount)) {
+        removeFirstLine();
     }
+    ////qDebug() << "set max lines to: " << _maxLineCount;
 }
 
-CompactHistoryScroll::CompactHistoryScroll(unsigned int maxLineCount) :
-    HistoryScroll(new CompactHistoryType(maxLineCount)),
-    _lines(),
-    _blockList()
+bool CompactHistoryScroll::isWrappedLine(int lineNumber)
 {
-    ////qDebug() << "scroll of length " << maxLineCount << " created";
-    setMaxNbLines(maxLineCount);
+    Q_ASSERT(lineNumber >= 0 && lineNumber < _lineCount);
+    return line(lineNumber)._wrapped;
 }
 
-CompactHistoryScroll::~CompactHistoryScroll()
+void CompactHistoryScroll::removeFirstLine()
 {
-    qDeleteAll(_lines.begin(), _lines.end());
-    _lines.clear();
+    Q_ASSERT(_lineCount > 0);
+    if (_lines[_firstLine]._length > 0) {
+        _blockList.deallocateOldest();
+    }
+    _firstLine = (_firstLine + 1) % _lines.size();
+    _lineCount--;
 }
 
-void CompactHistoryScroll::addCellsVector(const TextLine &cells)
+void CompactHistoryScroll::growLineIndex()
 {
-    CompactHistoryLine *line;
-    line = new(_blockList) CompactHistoryLine(cells, _blockList);
+    const int size = qMin(static_cast<int>(qMin(_maxLineCount, 0x7fffffffu)), qMax(MIN_LINE_INDEX, _lines.size() * 2));
 
-    if (_lines.size() > static_cast<int>(_maxLineCount)) {
-        delete _lines.takeAt(0);
+    // move the lines to the start of the new index
+    QVector<CompactHistoryLine> lines(size);
+    for (int i = 0; i < _lineCount; i++) {
+        lines[i] = line(i);
     }
-    _lines.append(line);
+    _lines.swap(lines);
+    _firstLine = 0;
 }
 
-void CompactHistoryScroll::addCells(const Character a[], int count)
+//////////////////////////////////////////////////////////////////////
+// Compressed History Scroll /////////////////////////////////////////
+//////////////////////////////////////////////////////////////////////
+
+/*
+   Once there are twice SegmentLines recent lines, the oldest
+   SegmentLines of them are sealed into a segment.  A segment starts
+   with the palette of the styles its cells use, then stores per line
+   its length, wrapped flag and the runs of equally styled cells with
+   the IDs of their styles and whether they hold extended characters,
+   followed by the character values of the line.  Numbers are stored as
+   variable length integers, so plain ASCII output takes about a byte
+   per cell before the segment is compressed with qCompress().
+
+   Reading a sealed line decompresses its segment.  The last few
+   decoded segments are cached, since the display and searches read
+   consecutive lines.  Their cells keep the IDs of the styles instead of
+   whole Characters, which halves the memory of the cache.  The palette
+   of a segment holds the styles of its cells, and goes with it.
+*/
+
+// recent lines are kept until two segments can be filled
+static const int RECENT_LINES = 2 * CompressedHistoryScroll::SegmentLines;
+// decoded segments kept in the cache
+static const int DECODED_SEGMENTS = 8;
+
+static void appendNumber(QByteArray &data, uint number)
 {
-    TextLine newLine(count);
-    qCopy(a, a + count, newLine.begin());
-    addCellsVector(newLine);
+    while (number >= 0x80) {
+        data.append(static_cast<char>((number & 0x7f) | 0x80));
+        number >>= 7;
+    }
+    data.append(static_cast<char>(number));
 }
 
-void CompactHistoryScroll::addLine(bool previousWrapped)
+static uint readNumber(const char *&data)
 {
-    CompactHistoryLine *line = _lines.last();
-    ////qDebug() << "last line at address " << line;
-    line->setWrapped(previousWrapped);
+    uint number = 0;
+    int shift = 0;
+    while ((*data & 0x80) != 0) {
+        number |= static_cast<uint>(*data++ & 0x7f) << shift;
+        shift += 7;
+    }
+    return number | (static_cast<uint>(*data++) << shift);
 }
 
-int CompactHistoryScroll::getLines()
+CompressedHistoryScroll::CompressedHistoryScroll() :
+    HistoryScroll(new CompressedHistoryType()),
+    _recentLines(RECENT_LINES),
+    _decodedSegments(DECODED_SEGMENTS)
 {
-    return _lines.size();
 }
 
-int CompactHistoryScroll::getLineLen(int lineNumber)
+CompressedHistoryScroll::~CompressedHistoryScroll() = default;
+
+int CompressedHistoryScroll::getLines()
 {
-    if ((lineNumber < 0) || (lineNumber >= _lines.size())) {
-        //qDebug() << "requested line invalid: 0 < " << lineNumber << " < " <<_lines.size();
-        //Q_ASSERT(lineNumber >= 0 && lineNumber < _lines.size());
+    return _segments.size() * SegmentLines + _recentLines.getLines();
+}
+
+int CompressedHistoryScroll::getLineLen(int lineNumber)
+{
+    const int sealedLines = _segments.size() * SegmentLines;
+    if (lineNumber >= sealedLines) {
+        return _recentLines.getLineLen(lineNumber - sealedLines);
+    }
+    if (lineNumber < 0) {
         return 0;
     }
-    CompactHistoryLine *line = _lines[lineNumber];
-    ////qDebug() << "request for line at address " << line;
-    return line->getLength();
+    const DecodedSegment *decoded = segment(lineNumber / SegmentLines);
+    const int i = lineNumber % SegmentLines;
+    return decoded->lineStart[i + 1] - decoded->lineStart[i];
 }
 
-void CompactHistoryScroll::getCells(int lineNumber, int startColumn, int count, Character buffer[])
+void CompressedHistoryScroll::getCells(int lineNumber, int startColumn, int count, Character buffer[])
 {
     if (count == 0) {
         return;
     }
-    Q_ASSERT(lineNumber < _lines.size());
-    CompactHistoryLine *line = _lines[lineNumber];
-    Q_ASSERT(startColumn >= 0);
-    Q_ASSERT(static_cast<unsigned int>(startColumn) <= line->getLength() - count);
-    line->getCharacters(buffer, count, startColumn);
+    const int sealedLines = _segments.size() * SegmentLines;
+    if (lineNumber >= sealedLines) {
+        _recentLines.getCells(lineNumber - sealedLines, startColumn, count, buffer);
+        return;
+    }
+    Q_ASSERT(lineNumber >= 0);
+    const DecodedSegment *decoded = segment(lineNumber / SegmentLines);
+    const int start = decoded->lineStart[lineNumber % SegmentLines] + startColumn;
+    Q_ASSERT(start + count <= decoded->lineStart[lineNumber % SegmentLines + 1]);
+    for (int i = 0; i < count; i++) {
+        buffer[i] = decoded->styles.character(decoded->cells[start + i]);
+    }
 }
 
-void CompactHistoryScroll::setMaxNbLines(unsigned int lineCount)
+bool CompressedHistoryScroll::isWrappedLine(int lineNumber)
 {
-    _maxLineCount = lineCount;
+    const int sealedLines = _segments.size() * SegmentLines;
+    if (lineNumber >= sealedLines) {
+        return _recentLines.isWrappedLine(lineNumber - sealedLines);
+    }
+    if (lineNumber < 0) {
+        return false;
+    }
+    return segment(lineNumber / SegmentLines)->wrapped.testBit(lineNumber % SegmentLines);
+}
+
+void CompressedHistoryScroll::addCells(const Character a[], int count)
+{
+    _recentLines.addCells(a, count);
+}
+
+void CompressedHistoryScroll::addCellsVector(const TextLine &cells)
+{
+    _recentLines.addCellsVector(cells);
+}
 
-    while (_lines.size() > static_cast<int>(lineCount)) {
-        delete _lines.takeAt(0);
+void CompressedHistoryScroll::addLine(bool previousWrapped)
+{
+    _recentLines.addLine(previousWrapped);
+
+    if (_recentLines.getLines() >= RECENT_LINES) {
+        sealSegment();
     }
-    ////qDebug() << "set max lines to: " << _maxLineCount;
 }
 
-bool CompactHistoryScroll::isWrappedLine(int lineNumber)
+void CompressedHistoryScroll::sealSegment()
 {
-    Q_ASSERT(lineNumber < _lines.size());
-    return _lines[lineNumber]->isWrapped();
+    StylePalette styles;
+    QByteArray lines;
+    TextLine line;
+    QVector<StylePalette::Cell> cells;
+    for (int i = 0; i < SegmentLines; i++) {
+        const int length = _recentLines.getLineLen(i);
+        line.resize(length);
+        _recentLines.getCells(i, 0, length, line.data());
+        cells.resize(length);
+        for (int k = 0; k < length; k++) {
+            cells[k] = styles.intern(line[k]);
+        }
+
+        appendNumber(lines, length);
+        lines.append(_recentLines.isWrappedLine(i) ? '\1' : '\0');
+
+        // runs of equally styled cells, a run also ends where extended
+        // characters begin or end, which is stored in the lowest bit
+        const auto spanStyle = [&cells](int k) {
+            return (static_cast<quint32>(cells[k].style) << 1) | cells[k].extended;
+        };
+        int spanCount = length > 0 ? 1 : 0;
+        for (int k = 1; k < length; k++) {
+            if (spanStyle(k) != spanStyle(k - 1)) {
+                spanCount++;
+            }
+        }
+        appendNumber(lines, spanCount);
+        int spanStart = 0;
+        for (int k = 1; k <= length; k++) {
+            if (k == length || spanStyle(k) != spanStyle(spanStart)) {
+                appendNumber(lines, k - spanStart);
+                appendNumber(lines, spanStyle(spanStart));
+                spanStart = k;
+            }
+        }
+
+        for (int k = 0; k < length; k++) {
+            appendNumber(lines, cells[k].character);
+        }
+    }
+
+    QByteArray data;
+    appendNumber(data, styles.count());
+    for (int id = 0; id < styles.count(); id++) {
+        const Character &style = styles.style(id);
+        appendNumber(data, style.rendition);
+        data.append(reinterpret_cast<const char *>(&style.foregroundColor), sizeof(CharacterColor));
+        data.append(reinterpret_cast<const char *>(&style.backgroundColor), sizeof(CharacterColor));
+        data.append(style.isRealCharacter ? '\1' : '\0');
+    }
+    data.append(lines);
+    _segments.append(qCompress(data));
+
+    // drop the sealed lines from the recent ones
+    _recentLines.setMaxNbLines(RECENT_LINES - SegmentLines);
+    _recentLines.setMaxNbLines(RECENT_LINES);
+}
+
+const CompressedHistoryScroll::DecodedSegment *CompressedHistoryScroll::segment(int index)
+{
+    DecodedSegment *decoded = _decodedSegments.object(index);
+    if (decoded != nullptr) {
+        return decoded;
+    }
+
+    const QByteArray data = qUncompress(_segments.at(index));
+    const char *p = data.constData();
+
+    decoded = new DecodedSegment;
+
+    // the styles are distinct, so they get the same IDs again
+    const int styleCount = readNumber(p);
+    for (int id = 0; id < styleCount; id++) {
+        Character style;
+        style.rendition = readNumber(p);
+        memcpy(&style.foregroundColor, p, sizeof(CharacterColor));
+        p += sizeof(CharacterColor);
+        memcpy(&style.backgroundColor, p, sizeof(CharacterColor));
+        p += sizeof(CharacterColor);
+        style.isRealCharacter = *p++ != '\0';
+        decoded->styles.intern(style);
+    }
+
+    decoded->lineStart.resize(SegmentLines + 1);
+    decoded->wrapped.resize(SegmentLines);
+    decoded->lineStart[0] = 0;
+    for (int i = 0; i < SegmentLines; i++) {
+        const int length = readNumber(p);
+        decoded->wrapped.setBit(i, *p++ != '\0');
+
+        const int start = decoded->cells.size();
+        decoded->cells.resize(start + length);
+        decoded->lineStart[i + 1] = start + length;
+        StylePalette::Cell *cells = decoded->cells.data() + start;
+
+        const int spanCount = readNumber(p);
+        int k = 0;
+        for (int span = 0; span < spanCount; span++) {
+            const int spanLength = readNumber(p);
+            const quint32 style = readNumber(p);
+            Q_ASSERT((style >> 1) < static_cast<quint32>(styleCount));
+            for (int end = k + spanLength; k < end; k++) {
+                cells[k].style = style >> 1;
+                cells[k].extended = style & 1;
+            }
+        }
+
+        for (k = 0; k < length; k++) {
+            cells[k].character = readNumber(p);
+        }
+    }
+    Q_ASSERT(p == data.constData() + data.size());
+
+    _decodedSegments.insert(index, decoded);
+    return decoded;
 }
 
 //////////////////////////////////////////////////////////////////////
@@ -607,6 +1039,11 @@ bool CompactHistoryScroll::isWrappedLine(int lineNumber)
 HistoryType::HistoryType() = default;
 HistoryType::~HistoryType() = default;
 
+int HistoryType::fileSize() const
+{
+    return 0;
+}
+
 //////////////////////////////
 
 HistoryTypeNone::HistoryTypeNone() = default;
@@ -629,23 +1066,9 @@ int HistoryTypeNone::maximumLineCount() const
 
 //////////////////////////////
 
-HistoryTypeFile::HistoryTypeFile(const QString &fileName) :
-    _fileName(fileName)
-{
-}
-
-bool HistoryTypeFile::isEnabled() const
-{
-    return true;
-}
-
-HistoryScroll *HistoryTypeFile::scroll(HistoryScroll *old) const
+// copies all lines of a history scroll to an empty one
+static void copyLines(HistoryScroll *old, HistoryScroll *newScroll)
 {
-    if (dynamic_cast<HistoryFile *>(old) != nullptr) {
-        return old; // Unchanged.
-    }
-    HistoryScroll *newScroll = new HistoryScrollFile(_fileName);
-
     Character line[LINE_SIZE];
     int lines = (old != nullptr) ? old->getLines() : 0;
     for (int i = 0; i < lines; i++) {
@@ -662,6 +1085,26 @@ HistoryScroll *HistoryTypeFile::scroll(HistoryScroll *old) const
             newScroll->addLine(old->isWrappedLine(i));
         }
     }
+}
+
+HistoryTypeFile::HistoryTypeFile(const QString &fileName) :
+    _fileName(fileName)
+{
+}
+
+bool HistoryTypeFile::isEnabled() const
+{
+    return true;
+}
+
+HistoryScroll *HistoryTypeFile::scroll(HistoryScroll *old) const
+{
+    if (dynamic_cast<HistoryFile *>(old) != nullptr) {
+        return old; // Unchanged.
+    }
+    HistoryScroll *newScroll = new HistoryScrollFile(_fileName);
+
+    copyLines(old, newScroll);
 
     delete old;
     return newScroll;
@@ -674,6 +1117,72 @@ int HistoryTypeFile::maximumLineCount() const
 
 //////////////////////////////
 
+HistoryTypeRingFile::HistoryTypeRingFile(int megabytes) :
+    _megabytes(megabytes)
+{
+}
+
+bool HistoryTypeRingFile::isEnabled() const
+{
+    return true;
+}
+
+int HistoryTypeRingFile::maximumLineCount() const
+{
+    // every line takes an entry of the line index of its segment
+    const qint64 lines = static_cast<qint64>(ringSegmentCount(_megabytes))
+                         * (HistoryScrollRingFile::SegmentSize / sizeof(quint32));
+    return static_cast<int>(qMin(lines, static_cast<qint64>(INT_MAX)));
+}
+
+int HistoryTypeRingFile::fileSize() const
+{
+    return _megabytes;
+}
+
+HistoryScroll *HistoryTypeRingFile::scroll(HistoryScroll *old) const
+{
+    auto *oldRing = dynamic_cast<HistoryScrollRingFile *>(old);
+    if (oldRing != nullptr && static_cast<const HistoryTypeRingFile &>(oldRing->getType()).fileSize() == _megabytes) {
+        return old; // Unchanged.
+    }
+    HistoryScroll *newScroll = new HistoryScrollRingFile(_megabytes);
+
+    copyLines(old, newScroll);
+
+    delete old;
+    return newScroll;
+}
+
+//////////////////////////////
+
+CompressedHistoryType::CompressedHistoryType() = default;
+
+bool CompressedHistoryType::isEnabled() const
+{
+    return true;
+}
+
+int CompressedHistoryType::maximumLineCount() const
+{
+    return -1;
+}
+
+HistoryScroll *CompressedHistoryType::scroll(HistoryScroll *old) const
+{
+    if (dynamic_cast<CompressedHistoryScroll *>(old) != nullptr) {
+        return old; // Unchanged.
+    }
+    HistoryScroll *newScroll = new CompressedHistoryScroll();
+
+    copyLines(old, newScroll);
+
+    delete old;
+    return newScroll;
+}
+
+//////////////////////////////
+
 CompactHistoryType::CompactHistoryType(unsigned int nbLines) :
     _maxLines(nbLines)
 {
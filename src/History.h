@@ -25,6 +25,8 @@
 #include <sys/mman.h>
 
 // Qt
+#include <QBitArray>
+#include <QCache>
 #include <QList>
 #include <QVector>
 #include <QTemporaryFile>
@@ -33,6 +35,7 @@
 
 // Konsole
 #include "Character.h"
+#include "StylePalette.h"
 
 namespace Konsole {
 /*
@@ -143,6 +146,56 @@ private:
     HistoryFile _lineflags; // flags Row(unsigned char)
 };
 
+//////////////////////////////////////////////////////////////////////
+// File-based history with a fixed size: a memory mapped ring of segments
+//////////////////////////////////////////////////////////////////////
+
+class KONSOLEPRIVATE_EXPORT HistoryScrollRingFile : public HistoryScroll
+{
+public:
+    explicit HistoryScrollRingFile(int megabytes);
+    ~HistoryScrollRingFile() Q_DECL_OVERRIDE;
+
+    int  getLines() Q_DECL_OVERRIDE;
+    int  getLineLen(int lineno) Q_DECL_OVERRIDE;
+    void getCells(int lineno, int colno, int count, Character res[]) Q_DECL_OVERRIDE;
+    bool isWrappedLine(int lineno) Q_DECL_OVERRIDE;
+
+    void addCells(const Character text[], int count) Q_DECL_OVERRIDE;
+    void addCellsVector(const QVector<Character> &cells) Q_DECL_OVERRIDE;
+    void addLine(bool previousWrapped = false) Q_DECL_OVERRIDE;
+
+    // size of the segments the file is divided into
+    static const int SegmentSize = 1024 * 1024;
+
+private:
+    // a part of the file holding consecutive lines; the line index
+    // grows from the start of the segment, the cells from its end
+    struct Segment {
+        qint64 firstLine;   // absolute number of the first line
+        int lineCount;
+        quint32 top;        // offset of the cells of the last line
+    };
+
+    int segmentOf(qint64 line);
+    quint32 *lineIndex(int segment) const;
+    uchar *segmentData(int segment) const;
+    void startSegment();
+
+    QTemporaryFile _file;
+    uchar *_fileMap;
+    QVector<Segment> _segments;
+    int _oldestSegment;
+    int _currentSegment;
+    int _lastSegment; // segment of the previous lookup
+
+    qint64 _firstLine; // absolute number of the oldest line
+    qint64 _nextLine;  // absolute number of the next line to add
+
+    // cells of the line which is completed by the next addLine()
+    QVector<Character> _pendingCells;
+};
+
 //////////////////////////////////////////////////////////////////////
 // Nothing-based history (no history :-)
 //////////////////////////////////////////////////////////////////////
@@ -202,117 +255,122 @@ public:
 class CompactHistoryBlock
 {
 public:
-    CompactHistoryBlock() :
-        _blockLength(4096 * 64), // 256kb
-        _head(static_cast<quint8 *>(mmap(nullptr, _blockLength, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANON, -1, 0))),
-        _tail(nullptr),
-        _blockStart(nullptr),
+    explicit CompactHistoryBlock(size_t blockLength) :
+        _blockLength(blockLength),
+        _blockStart(static_cast<quint8 *>(mmap(nullptr, _blockLength, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANON, -1, 0))),
+        _tail(_blockStart),
         _allocCount(0)
     {
-        Q_ASSERT(_head != MAP_FAILED);
-        _tail = _blockStart = _head;
+        Q_ASSERT(_blockStart != MAP_FAILED);
     }
 
-    virtual ~CompactHistoryBlock()
+    ~CompactHistoryBlock()
     {
-        //free(_blockStart);
         munmap(_blockStart, _blockLength);
     }
 
-    virtual unsigned int remaining()
+    size_t remaining() const
     {
         return _blockStart + _blockLength - _tail;
     }
 
-    virtual unsigned  length()
+    size_t length() const
     {
         return _blockLength;
     }
 
-    virtual void *allocate(size_t size);
-    virtual bool contains(void *addr)
+    void *allocate(size_t size)
+    {
+        Q_ASSERT(size <= remaining());
+        void *block = _tail;
+        _tail += size;
+        _allocCount++;
+        return block;
+    }
+
+    void deallocate()
     {
-        return addr >= _blockStart && addr < (_blockStart + _blockLength);
+        _allocCount--;
+        Q_ASSERT(_allocCount >= 0);
     }
 
-    virtual void deallocate();
-    virtual bool isInUse()
+    bool isInUse() const
     {
         return _allocCount != 0;
     }
 
+    // forget all allocations, so the block can be reused
+    void reset()
+    {
+        _tail = _blockStart;
+        _allocCount = 0;
+    }
+
 private:
+    Q_DISABLE_COPY(CompactHistoryBlock)
+
     size_t _blockLength;
-    quint8 *_head;
-    quint8 *_tail;
     quint8 *_blockStart;
+    quint8 *_tail;
     int _allocCount;
 };
 
+/**
+ * A ring of blocks the lines of a CompactHistoryScroll are allocated from.
+ *
+ * Lines are allocated from the newest block and released in the order
+ * they were allocated, so the oldest block is the only one that can
+ * become unused.  An unused block is kept for reuse instead of being
+ * unmapped, so a full history does not allocate any memory.
+ */
 class CompactHistoryBlockList
 {
 public:
-    CompactHistoryBlockList() :
-        list(QList<CompactHistoryBlock *>())
-    {
-    }
-
+    CompactHistoryBlockList();
     ~CompactHistoryBlockList();
 
     void *allocate(size_t size);
-    void deallocate(void *);
-    int length()
+    // releases the oldest allocation that is still in use
+    void deallocateOldest();
+    int length() const
     {
-        return list.size();
+        return _blocks.size();
     }
 
 private:
-    QList<CompactHistoryBlock *> list;
+    Q_DISABLE_COPY(CompactHistoryBlockList)
+
+    // blocks from the oldest to the newest one
+    QVector<CompactHistoryBlock *> _blocks;
+    // an unused block of the default size
+    CompactHistoryBlock *_spareBlock;
 };
 
+/**
+ * A line of a CompactHistoryScroll.  Its characters and formats are
+ * stored in one allocation from the block list: the character values
+ * first, followed by the formats.
+ */
 class CompactHistoryLine
 {
 public:
-    CompactHistoryLine(const TextLine &, CompactHistoryBlockList &blockList);
-    virtual ~CompactHistoryLine();
+    void getCharacters(Character *array, int size, int startColumn) const;
 
-    // custom new operator to allocate memory from custom pool instead of heap
-    static void *operator new(size_t size, CompactHistoryBlockList &blockList);
-    static void operator delete(void *)
+    const CharacterFormat *formatArray() const
     {
-        /* do nothing, deallocation from pool is done in destructor*/
+        return reinterpret_cast<const CharacterFormat *>(_text + _length);
     }
 
-    virtual void getCharacters(Character *array, int size, int startColumn);
-    virtual void getCharacter(int index, Character &r);
-    virtual bool isWrapped() const
-    {
-        return _wrapped;
-    }
-
-    virtual void setWrapped(bool value)
-    {
-        _wrapped = value;
-    }
+    static size_t allocationSize(int length, int formatLength);
 
-    virtual unsigned int getLength() const
-    {
-        return _length;
-    }
-
-protected:
-    CompactHistoryBlockList &_blockListRef;
-    CharacterFormat *_formatArray;
+    uint *_text;
     quint16 _length;
-    uint    *_text;
     quint16 _formatLength;
     bool _wrapped;
 };
 
 class KONSOLEPRIVATE_EXPORT CompactHistoryScroll : public HistoryScroll
 {
-    typedef QList<CompactHistoryLine *> HistoryArray;
-
 public:
     explicit CompactHistoryScroll(unsigned int maxLineCount = 1000);
     ~CompactHistoryScroll() Q_DECL_OVERRIDE;
@@ -329,13 +387,65 @@ public:
     void setMaxNbLines(unsigned int lineCount);
 
 private:
-    bool hasDifferentColors(const TextLine &line) const;
-    HistoryArray _lines;
+    CompactHistoryLine &line(int lineNumber)
+    {
+        return _lines[(_firstLine + lineNumber) % _lines.size()];
+    }
+
+    void removeFirstLine();
+    void growLineIndex();
+
+    // circular index of the lines, _lineCount of them starting at _firstLine
+    QVector<CompactHistoryLine> _lines;
+    int _firstLine;
+    int _lineCount;
     CompactHistoryBlockList _blockList;
 
     unsigned int _maxLineCount;
 };
 
+//////////////////////////////////////////////////////////////////////
+// History in compressed segments (no limitation in length)
+// Recent lines are kept in a CompactHistoryScroll, older lines are
+// sealed into compressed segments of SegmentLines lines each
+//////////////////////////////////////////////////////////////////////
+
+class KONSOLEPRIVATE_EXPORT CompressedHistoryScroll : public HistoryScroll
+{
+public:
+    CompressedHistoryScroll();
+    ~CompressedHistoryScroll() Q_DECL_OVERRIDE;
+
+    int  getLines() Q_DECL_OVERRIDE;
+    int  getLineLen(int lineNumber) Q_DECL_OVERRIDE;
+    void getCells(int lineNumber, int startColumn, int count, Character buffer[]) Q_DECL_OVERRIDE;
+    bool isWrappedLine(int lineNumber) Q_DECL_OVERRIDE;
+
+    void addCells(const Character a[], int count) Q_DECL_OVERRIDE;
+    void addCellsVector(const TextLine &cells) Q_DECL_OVERRIDE;
+    void addLine(bool previousWrapped = false) Q_DECL_OVERRIDE;
+
+    // number of lines in a sealed segment
+    static const int SegmentLines = 1024;
+
+private:
+    // a sealed segment as it is used for reading
+    struct DecodedSegment {
+        StylePalette styles;
+        QVector<StylePalette::Cell> cells;
+        QVector<int> lineStart; // SegmentLines + 1 offsets into cells
+        QBitArray wrapped;
+    };
+
+    const DecodedSegment *segment(int index);
+    void sealSegment();
+
+    CompactHistoryScroll _recentLines;
+    QVector<QByteArray> _segments;
+    // the most recently used decoded segments
+    QCache<int, DecodedSegment> _decodedSegments;
+};
+
 //////////////////////////////////////////////////////////////////////
 // History type
 //////////////////////////////////////////////////////////////////////
@@ -368,6 +478,11 @@ public:
     {
         return maximumLineCount() == -1;
     }
+    /**
+     * Returns the size of the history file in megabytes if the lines are
+     * kept in a file of a fixed size, otherwise 0.
+     */
+    virtual int fileSize() const;
 };
 
 class KONSOLEPRIVATE_EXPORT HistoryTypeNone : public HistoryType
@@ -395,6 +510,37 @@ protected:
     QString _fileName;
 };
 
+class KONSOLEPRIVATE_EXPORT HistoryTypeRingFile : public HistoryType
+{
+public:
+    explicit HistoryTypeRingFile(int megabytes);
+
+    bool isEnabled() const Q_DECL_OVERRIDE;
+    /**
+     * Returns the number of empty lines the file can hold.  Longer lines
+     * take more space, once the file is full the oldest lines are lost.
+     */
+    int maximumLineCount() const Q_DECL_OVERRIDE;
+
+    HistoryScroll *scroll(HistoryScroll *) const Q_DECL_OVERRIDE;
+
+    int fileSize() const Q_DECL_OVERRIDE;
+
+protected:
+    int _megabytes;
+};
+
+class KONSOLEPRIVATE_EXPORT CompressedHistoryType : public HistoryType
+{
+public:
+    CompressedHistoryType();
+
+    bool isEnabled() const Q_DECL_OVERRIDE;
+    int maximumLineCount() const Q_DECL_OVERRIDE;
+
+    HistoryScroll *scroll(HistoryScroll *) const Q_DECL_OVERRIDE;
+};
+
 class KONSOLEPRIVATE_EXPORT CompactHistoryType : public HistoryType
 {
 public:
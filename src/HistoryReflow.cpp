@@ -0,0 +1,317 @@
+/*
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+    02110-1301  USA.
+*/
+
+// Own
+#include "HistoryReflow.h"
+
+// System
+#include <algorithm>
+
+// Konsole
+#include "History.h"
+
+using namespace Konsole;
+
+HistoryReflow::HistoryReflow() :
+    _history(nullptr),
+    _columns(0),
+    _begin(0),
+    _end(0),
+    _logicalLines(QVector<LogicalLine>())
+{
+}
+
+void HistoryReflow::setHistory(HistoryScroll *history)
+{
+    _history = history;
+    _begin = 0;
+    _end = 0;
+    _logicalLines.clear();
+}
+
+void HistoryReflow::reflow(int columns, int maxLines)
+{
+    Q_ASSERT(columns > 0);
+
+    _columns = columns;
+    _begin = _history->getLines();
+    _end = _begin;
+    _logicalLines.clear();
+
+    rewrapOlderLines(maxLines);
+}
+
+int HistoryReflow::rewrapOlderLines(int maxLines)
+{
+    const int oldLines = getLines();
+
+    int rewrapped = 0;
+    while (_begin > 0 && rewrapped < maxLines) {
+        // very long lines are split into pieces
+        int first = _begin - 1;
+        while (first > 0 && _begin - first < MaxWrappedLines && _history->isWrappedLine(first - 1)) {
+            first--;
+        }
+
+        LogicalLine logicalLine = wrapLogicalLine(first, _begin);
+        logicalLine.presentedLines = rewrappedLines() + rowCount(logicalLine);
+        logicalLine.storedLines = _end - first;
+        _logicalLines.append(logicalLine);
+
+        rewrapped += _begin - first;
+        _begin = first;
+    }
+
+    return getLines() - oldLines;
+}
+
+bool HistoryReflow::hasOlderLines() const
+{
+    return _begin > 0;
+}
+
+void HistoryReflow::lineAdded(int droppedLines)
+{
+    if (droppedLines <= 0 || _end == 0) {
+        return;
+    }
+
+    _begin -= droppedLines;
+    _end -= droppedLines;
+    if (_begin >= 0) {
+        return;
+    }
+
+    // lines which were rewrapped have been dropped
+    _begin = 0;
+    if (_end <= 0) {
+        _end = 0;
+        _logicalLines.clear();
+        return;
+    }
+
+    while (!_logicalLines.isEmpty() && _logicalLines.last().storedLines > _end) {
+        _logicalLines.removeLast();
+        const int newerLines = _logicalLines.isEmpty() ? 0 : _logicalLines.last().storedLines;
+        if (newerLines < _end) {
+            // the oldest logical line has lost its first lines
+            LogicalLine logicalLine = wrapLogicalLine(0, _end - newerLines);
+            logicalLine.presentedLines = rewrappedLines() + rowCount(logicalLine);
+            logicalLine.storedLines = _end;
+            _logicalLines.append(logicalLine);
+        }
+    }
+}
+
+int HistoryReflow::getLines() const
+{
+    if (_history == nullptr) {
+        return 0;
+    }
+    return _begin + rewrappedLines() + _history->getLines() - _end;
+}
+
+int HistoryReflow::getLineLen(int line) const
+{
+    if (line < _begin) {
+        return _history->getLineLen(line);
+    }
+
+    line -= _begin;
+    if (line >= rewrappedLines()) {
+        return _history->getLineLen(line - rewrappedLines() + _end);
+    }
+
+    int row = 0;
+    const int logicalLine = findLogicalLine(line, &row);
+    const LogicalLine &wrapped = _logicalLines[logicalLine];
+    const int end = row < rowCount(wrapped) - 1 ? rowStart(wrapped, row + 1) : wrapped.cells;
+    return qMax(0, end - rowStart(wrapped, row));
+}
+
+void HistoryReflow::getCells(int line, int column, int count, Character buffer[]) const
+{
+    if (line < _begin) {
+        _history->getCells(line, column, count, buffer);
+        return;
+    }
+
+    line -= _begin;
+    if (line >= rewrappedLines()) {
+        _history->getCells(line - rewrappedLines() + _end, column, count, buffer);
+        return;
+    }
+
+    int row = 0;
+    const int logicalLine = findLogicalLine(line, &row);
+    const LogicalLine &wrapped = _logicalLines[logicalLine];
+
+    // the cells may come from two or more of the stored lines, starting
+    // with the one which holds the first cell
+    int offset = rowStart(wrapped, row) + column;
+    int storedLine = firstStoredLine(logicalLine);
+    if (!wrapped.lineStarts.isEmpty()) {
+        const auto lineStart = std::upper_bound(wrapped.lineStarts.constBegin(), wrapped.lineStarts.constEnd(), offset) - 1;
+        storedLine += static_cast<int>(lineStart - wrapped.lineStarts.constBegin());
+        offset -= *lineStart;
+    }
+    for (; count > 0 && storedLine < _end; storedLine++) {
+        const int length = _history->getLineLen(storedLine);
+        if (offset >= length) {
+            offset -= length;
+            continue;
+        }
+
+        const int cells = qMin(count, length - offset);
+        _history->getCells(storedLine, offset, cells, buffer);
+        buffer += cells;
+        count -= cells;
+        offset = 0;
+    }
+}
+
+bool HistoryReflow::isWrappedLine(int line) const
+{
+    if (line < _begin) {
+        return _history->isWrappedLine(line);
+    }
+
+    line -= _begin;
+    if (line >= rewrappedLines()) {
+        return _history->isWrappedLine(line - rewrappedLines() + _end);
+    }
+
+    int row = 0;
+    const int logicalLine = findLogicalLine(line, &row);
+    if (row < rowCount(_logicalLines[logicalLine]) - 1) {
+        return true;
+    }
+
+    // the newest logical line may continue in the lines added afterwards
+    const int newerLines = logicalLine > 0 ? _logicalLines[logicalLine - 1].storedLines : 0;
+    return _history->isWrappedLine(_end - newerLines - 1);
+}
+
+void HistoryReflow::presentedLines(int storedLine, int *first, int *last) const
+{
+    if (storedLine < _begin) {
+        *first = storedLine;
+        *last = storedLine;
+        return;
+    }
+    if (storedLine >= _end) {
+        *first = storedLine - _end + _begin + rewrappedLines();
+        *last = *first;
+        return;
+    }
+
+    // stored lines counted backwards from the newest rewrapped line
+    const int linesFromEnd = _end - 1 - storedLine;
+    const auto logicalLine = std::upper_bound(_logicalLines.constBegin(), _logicalLines.constEnd(), linesFromEnd,
+                                              [](int lines, const LogicalLine &other) {
+        return lines < other.storedLines;
+    });
+    Q_ASSERT(logicalLine != _logicalLines.constEnd());
+
+    const int newerLines = logicalLine != _logicalLines.constBegin() ? (logicalLine - 1)->presentedLines : 0;
+    *first = _begin + rewrappedLines() - logicalLine->presentedLines;
+    *last = _begin + rewrappedLines() - newerLines - 1;
+}
+
+QVector<int> HistoryReflow::rowStarts(const Character *cells, int count, int columns)
+{
+    QVector<int> starts;
+    starts.append(0);
+
+    int start = 0;
+    while (count - start > columns) {
+        int end = start + columns;
+        while (end > start + 1 && !cells[end].isRealCharacter) {
+            end--;
+        }
+        starts.append(end);
+        start = end;
+    }
+
+    return starts;
+}
+
+HistoryReflow::LogicalLine HistoryReflow::wrapLogicalLine(int first, int last) const
+{
+    LogicalLine logicalLine;
+
+    QVector<Character> cells;
+    for (int line = first; line < last; line++) {
+        if (last - first > 1) {
+            logicalLine.lineStarts.append(cells.size());
+        }
+        const int length = _history->getLineLen(line);
+        cells.resize(cells.size() + length);
+        _history->getCells(line, 0, length, cells.data() + cells.size() - length);
+    }
+
+    logicalLine.cells = cells.size();
+    logicalLine.rowStarts = rowStarts(cells.constData(), cells.size(), _columns);
+
+    // most lines have no double width character at a row end
+    bool full = true;
+    for (int row = 0; row < logicalLine.rowStarts.size() && full; row++) {
+        full = logicalLine.rowStarts[row] == row * _columns;
+    }
+    if (full) {
+        logicalLine.rowStarts.clear();
+    }
+
+    return logicalLine;
+}
+
+int HistoryReflow::rowCount(const LogicalLine &logicalLine) const
+{
+    if (!logicalLine.rowStarts.isEmpty()) {
+        return logicalLine.rowStarts.size();
+    }
+    return qMax(1, (logicalLine.cells + _columns - 1) / _columns);
+}
+
+int HistoryReflow::rowStart(const LogicalLine &logicalLine, int row) const
+{
+    return logicalLine.rowStarts.isEmpty() ? row * _columns : logicalLine.rowStarts[row];
+}
+
+int HistoryReflow::rewrappedLines() const
+{
+    return _logicalLines.isEmpty() ? 0 : _logicalLines.last().presentedLines;
+}
+
+int HistoryReflow::findLogicalLine(int line, int *row) const
+{
+    // lines counted backwards from the newest rewrapped line
+    const int linesFromEnd = rewrappedLines() - 1 - line;
+    const auto logicalLine = std::upper_bound(_logicalLines.constBegin(), _logicalLines.constEnd(), linesFromEnd,
+                                              [](int lines, const LogicalLine &other) {
+        return lines < other.presentedLines;
+    });
+    Q_ASSERT(logicalLine != _logicalLines.constEnd());
+
+    *row = logicalLine->presentedLines - 1 - linesFromEnd;
+    return static_cast<int>(logicalLine - _logicalLines.constBegin());
+}
+
+int HistoryReflow::firstStoredLine(int logicalLine) const
+{
+    return _end - _logicalLines[logicalLine].storedLines;
+}
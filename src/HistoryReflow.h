@@ -0,0 +1,145 @@
+/*
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+    02110-1301  USA.
+*/
+
+#ifndef HISTORYREFLOW_H
+#define HISTORYREFLOW_H
+
+// Qt
+#include <QVector>
+
+// Konsole
+#include "Character.h"
+#include "konsoleprivate_export.h"
+
+namespace Konsole
+{
+class HistoryScroll;
+
+/**
+ * Presents the lines of a HistoryScroll rewrapped at the width of the
+ * screen, without changing what the history stores.
+ *
+ * The lines of the history are stored at the width the screen had when
+ * they were added.  After a change of width, reflow() joins wrapped lines
+ * into logical lines and presents each of them as many lines of the new
+ * width as it needs.  Only the newest lines are rewrapped at once, so that
+ * a resize does not depend on the size of the history: the older lines
+ * are presented as stored until rewrapOlderLines() gets to them.
+ *
+ * Lines added to the history after reflow() are presented as stored, they
+ * have the width of the screen already.
+ *
+ * A logical line of more than MaxWrappedLines stored lines is rewrapped
+ * in pieces of at most that many, each of which starts a new row, so
+ * that the work for a piece does not depend on the length of the line.
+ *
+ * The accessors take and return line numbers as presented, in the same
+ * way as those of HistoryScroll.
+ */
+class KONSOLEPRIVATE_EXPORT HistoryReflow
+{
+public:
+    HistoryReflow();
+
+    /** Sets the history whose lines are presented, as they are stored. */
+    void setHistory(HistoryScroll *history);
+
+    /**
+     * Starts presenting the lines of the history rewrapped at @p columns.
+     * The newest lines, at least @p maxLines of the stored lines if there
+     * are as many, are rewrapped at once.
+     */
+    void reflow(int columns, int maxLines);
+
+    /**
+     * Rewraps at least @p maxLines of the older stored lines which are
+     * still presented as stored, if there are as many.  Returns by how many
+     * lines getLines() has changed.
+     */
+    int rewrapOlderLines(int maxLines);
+
+    /** Returns true if there are stored lines left for rewrapOlderLines(). */
+    bool hasOlderLines() const;
+
+    /**
+     * Updates the presented lines after a line has been added to the
+     * history, and the @p droppedLines oldest stored lines removed.
+     */
+    void lineAdded(int droppedLines);
+
+    int getLines() const;
+    int getLineLen(int line) const;
+    void getCells(int line, int column, int count, Character buffer[]) const;
+    bool isWrappedLine(int line) const;
+
+    /**
+     * Returns in @p first and @p last the presented lines which show the
+     * stored line @p storedLine.  For a rewrapped line these are all lines
+     * of its logical line.
+     */
+    void presentedLines(int storedLine, int *first, int *last) const;
+
+    /**
+     * Returns the offsets in @p cells at which the rows start when the
+     * @p count cells are wrapped at @p columns.  A double width character
+     * which does not fit at the end of a row starts the next one, as in
+     * Screen::displayCharacter(), so that it is not separated from its
+     * placeholder.  There is always at least one row.
+     */
+    static QVector<int> rowStarts(const Character *cells, int count, int columns);
+
+    /** Maximum number of stored lines which are rewrapped together */
+    static const int MaxWrappedLines = 256;
+
+private:
+    // a stored line and its wrapped continuations, up to MaxWrappedLines,
+    // which are rewrapped together
+    struct LogicalLine {
+        int cells;
+        // the following two count the lines of this and all newer logical
+        // lines, so that logical lines can be added in front of the oldest
+        // and dropped without renumbering the others
+        int presentedLines;
+        int storedLines;
+        // the offsets at which the rows start, empty if all rows but the
+        // last one are full
+        QVector<int> rowStarts;
+        // the offsets at which the stored lines start, empty if there is
+        // only one
+        QVector<int> lineStarts;
+    };
+
+    LogicalLine wrapLogicalLine(int first, int last) const;
+    int rowCount(const LogicalLine &logicalLine) const;
+    int rowStart(const LogicalLine &logicalLine, int row) const;
+    int rewrappedLines() const;
+    // finds the logical line and the row in it of a rewrapped line, counted
+    // from the first rewrapped line
+    int findLogicalLine(int line, int *row) const;
+    int firstStoredLine(int logicalLine) const;
+
+    HistoryScroll *_history;
+    int _columns;
+    // stored lines from _begin up to _end are presented rewrapped, the
+    // logical lines are kept from the newest to the oldest
+    int _begin;
+    int _end;
+    QVector<LogicalLine> _logicalLines;
+};
+}
+
+#endif // HISTORYREFLOW_H
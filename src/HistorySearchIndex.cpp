@@ -0,0 +1,430 @@
+/*
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+    02110-1301  USA.
+*/
+
+// Own
+#include "HistorySearchIndex.h"
+
+// System
+#include <algorithm>
+#include <cstring>
+
+// Qt
+#include <QTextStream>
+
+// Konsole
+#include "GraphemePool.h"
+#include "Screen.h"
+#include "TerminalCharacterDecoder.h"
+
+using namespace Konsole;
+
+// a block is extended up to this size to end with a line which is not wrapped
+static const int MAX_BLOCK_LINES = 16 * HistorySearchIndex::BlockLines;
+// blocks which may match are searched together up to this size
+static const int MAX_SEARCH_LINES = 16 * HistorySearchIndex::BlockLines;
+
+HistorySearchIndex::HistorySearchIndex(const Screen *screen) :
+    _screen(screen),
+    _blocks(QVector<Block>()),
+    _blockOpen(false),
+    _addedLines(0),
+    _storedLines(0),
+    _unindexedLines(0),
+    _allCells(),
+    _realCells()
+{
+}
+
+void HistorySearchIndex::reset(int storedLines)
+{
+    _blocks.clear();
+    _blockOpen = false;
+    _addedLines = storedLines;
+    _storedLines = storedLines;
+    _unindexedLines = storedLines;
+    _allCells.count = 0;
+    _realCells.count = 0;
+}
+
+void HistorySearchIndex::addLine(const Character *cells, int count, bool wrapped, int storedLines)
+{
+    if (!_blockOpen) {
+        Block block;
+        block.firstLine = _addedLines;
+        block.lineCount = 0;
+        memset(block.trigrams, 0, sizeof(block.trigrams));
+        _blocks.append(block);
+        _blockOpen = true;
+    }
+
+    // the characters as PlainTextDecoder::decodeLine() writes them, the
+    // non-real ones may be left out depending on where a line ends
+    for (int i = 0; i < count;) {
+        const Character &cell = cells[i];
+        if ((cell.rendition & RE_EXTENDED_CHAR) != 0) {
+            ushort length = 0;
+            const uint *chars = GraphemePool::lookup(cell.character, length);
+            if (chars == nullptr) {
+                i++;
+                continue;
+            }
+            const QString s = QString::fromUcs4(chars, length);
+            for (const QChar c : s) {
+                addChar(_allCells, c);
+                addChar(_realCells, c);
+            }
+            i += qMax(1, Character::stringWidth(s));
+            continue;
+        }
+
+        if (QChar::requiresSurrogates(cell.character)) {
+            addChar(_allCells, QChar(QChar::highSurrogate(cell.character)));
+            addChar(_allCells, QChar(QChar::lowSurrogate(cell.character)));
+            if (cell.isRealCharacter) {
+                addChar(_realCells, QChar(QChar::highSurrogate(cell.character)));
+                addChar(_realCells, QChar(QChar::lowSurrogate(cell.character)));
+            }
+        } else {
+            addChar(_allCells, QChar(cell.character));
+            if (cell.isRealCharacter) {
+                addChar(_realCells, QChar(cell.character));
+            }
+        }
+        i += qMax(1, cell.width());
+    }
+
+    // a match never continues after a line break
+    if (!wrapped) {
+        _allCells.count = 0;
+        _realCells.count = 0;
+    }
+
+    Block &block = _blocks.last();
+    block.lineCount++;
+    _addedLines++;
+
+    // end the block with a line which is not wrapped, so that most
+    // matches are in one block
+    if ((block.lineCount >= BlockLines && !wrapped) || block.lineCount >= MAX_BLOCK_LINES) {
+        _blockOpen = false;
+    }
+
+    // forget the blocks which left the history
+    _storedLines = storedLines;
+    const qint64 firstLine = _addedLines - _storedLines;
+    int dropped = 0;
+    while (dropped < _blocks.size() - 1 && _blocks[dropped].firstLine + _blocks[dropped].lineCount <= firstLine) {
+        dropped++;
+    }
+    if (dropped > 0) {
+        _blocks.remove(0, dropped);
+    }
+}
+
+void HistorySearchIndex::addChar(Context &context, QChar c)
+{
+    if (context.count == 2) {
+        const uint bit = trigramBit(context.chars[0], context.chars[1], c);
+        _blocks.last().trigrams[bit / 64] |= quint64(1) << (bit % 64);
+        context.chars[0] = context.chars[1];
+        context.chars[1] = c;
+    } else {
+        context.chars[context.count++] = c;
+    }
+}
+
+int HistorySearchIndex::findLine(const QRegularExpression &regExp, int fromLine, int toLine, bool forwards) const
+{
+    const QVector<QPair<int, int> > ranges = candidateRanges(regExp, fromLine, toLine);
+    for (int i = 0; i < ranges.size(); i++) {
+        const QPair<int, int> &range = ranges[forwards ? i : ranges.size() - 1 - i];
+        QList<int> linePositions;
+        const QString text = plainText(range.first, range.second, &linePositions);
+        const int line = findInText(regExp, text, linePositions, forwards);
+        if (line != -1) {
+            return qMin(range.first + line, range.second);
+        }
+    }
+    return -1;
+}
+
+QVector<QPair<int, int> > HistorySearchIndex::candidateRanges(const QRegularExpression &regExp, int fromLine, int toLine) const
+{
+    QVector<QPair<int, int> > ranges;
+    if (fromLine > toLine) {
+        return ranges;
+    }
+
+    auto addRange = [&ranges, fromLine, toLine](int first, int last) {
+        first = qMax(first, fromLine);
+        last = qMin(last, toLine);
+        if (first > last) {
+            return;
+        }
+        if (!ranges.isEmpty() && first <= ranges.last().second + 1) {
+            if (last - ranges.last().first < MAX_SEARCH_LINES) {
+                ranges.last().second = qMax(ranges.last().second, last);
+                return;
+            }
+            // a match may continue from the previous range
+            first = qMin(first, ranges.last().second);
+        }
+        ranges.append(qMakePair(first, last));
+    };
+    auto addLines = [&addRange](int first, int last) {
+        for (int line = first; line <= last; line += BlockLines) {
+            addRange(line, qMin(last, line + BlockLines - 1));
+        }
+    };
+
+    int first = 0;
+    int last = 0;
+    if (presentedLines(_addedLines - _storedLines, _unindexedLines - 1, &first, &last)) {
+        addLines(first, last);
+    }
+
+    // the blocks which may contain a match, alone or with a neighbour
+    const QVector<uint> trigrams = requiredTrigrams(regExp);
+    for (int i = 0; i < _blocks.size(); i++) {
+        const Block &block = _blocks[i];
+        const bool candidate = containsAll(trigrams, block, i > 0 ? &_blocks[i - 1] : nullptr)
+                               || containsAll(trigrams, block, i + 1 < _blocks.size() ? &_blocks[i + 1] : nullptr);
+        if (candidate && presentedLines(block.firstLine, block.firstLine + block.lineCount - 1, &first, &last)) {
+            addRange(first, last);
+        }
+    }
+
+    // the lines of the screen
+    addLines(_screen->getHistLines(), toLine);
+
+    return ranges;
+}
+
+bool HistorySearchIndex::containsAll(const QVector<uint> &trigrams, const Block &block, const Block *neighbour) const
+{
+    for (const uint bit : trigrams) {
+        const quint64 mask = quint64(1) << (bit % 64);
+        if ((block.trigrams[bit / 64] & mask) == 0
+            && (neighbour == nullptr || (neighbour->trigrams[bit / 64] & mask) == 0)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+bool HistorySearchIndex::presentedLines(qint64 first, qint64 last, int *fromLine, int *toLine) const
+{
+    // the stored lines which are left in the history
+    const qint64 firstLine = _addedLines - _storedLines;
+    first = qMax(first, firstLine);
+    if (first > last) {
+        return false;
+    }
+
+    int unused = 0;
+    _screen->presentedHistoryLines(static_cast<int>(first - firstLine), fromLine, &unused);
+    _screen->presentedHistoryLines(static_cast<int>(last - firstLine), &unused, toLine);
+    return true;
+}
+
+QString HistorySearchIndex::plainText(int fromLine, int toLine, QList<int> *linePositions) const
+{
+    QString string;
+    QTextStream stream(&string);
+
+    PlainTextDecoder decoder;
+    decoder.setRecordLinePositions(linePositions != nullptr);
+    decoder.begin(&stream);
+    _screen->writeLinesToStream(&decoder, fromLine, toLine);
+    decoder.end();
+
+    if (linePositions != nullptr) {
+        *linePositions = decoder.linePositions();
+    }
+    return string;
+}
+
+int HistorySearchIndex::findInText(const QRegularExpression &regExp, const QString &text,
+                                   const QList<int> &linePositions, bool forwards)
+{
+    // line number search below assumes that the buffer ends with a new-line
+    const QString string = text + QLatin1Char('\n');
+
+    const int pos = forwards ? string.indexOf(regExp) : string.lastIndexOf(regExp);
+    if (pos == -1) {
+        return -1;
+    }
+
+    int newLines = 0;
+    while (newLines < linePositions.count() && linePositions[newLines] <= pos) {
+        newLines++;
+    }
+
+    // ignore the new line at the start of the buffer
+    return newLines - 1;
+}
+
+QVector<int> HistorySearchIndex::findLinesInText(const QRegularExpression &regExp, const QString &text,
+                                                const QList<int> &linePositions, const QAtomicInt *cancelled)
+{
+    QVector<int> lines;
+    if (linePositions.isEmpty()) {
+        return lines;
+    }
+
+    const QString string = text + QLatin1Char('\n');
+    int line = 0;
+    QRegularExpressionMatchIterator matches = regExp.globalMatch(string);
+    while (matches.hasNext() && (cancelled == nullptr || cancelled->loadAcquire() == 0)) {
+        const int pos = matches.next().capturedStart();
+        while (line + 1 < linePositions.count() && linePositions[line + 1] <= pos) {
+            line++;
+        }
+        if (lines.isEmpty() || lines.last() != line) {
+            lines.append(line);
+        }
+    }
+    return lines;
+}
+
+/*
+   Returns the trigrams of the literal text every match of the regular
+   expression contains.  Only literals outside of groups, classes and
+   alternatives are used, and only trigrams of ASCII characters, so
+   case insensitive matching is covered by folding the case in
+   trigramBit().  An empty result means every block may match.
+*/
+QVector<uint> HistorySearchIndex::requiredTrigrams(const QRegularExpression &regExp)
+{
+    const QString pattern = regExp.pattern();
+    QVector<uint> result;
+
+    // inline options may change how literals match
+    if ((regExp.patternOptions() & QRegularExpression::ExtendedPatternSyntaxOption) != 0
+        || pattern.contains(QLatin1String("(?")) || pattern.contains(QLatin1String("(*"))) {
+        return result;
+    }
+
+    QString run;
+    auto addRun = [&run, &result]() {
+        for (int i = 2; i < run.size(); i++) {
+            if (run[i - 2].unicode() < 128 && run[i - 1].unicode() < 128 && run[i].unicode() < 128
+                && run[i - 2] != QLatin1Char('\n') && run[i - 1] != QLatin1Char('\n') && run[i] != QLatin1Char('\n')) {
+                result.append(trigramBit(run[i - 2], run[i - 1], run[i]));
+            }
+        }
+        run.clear();
+    };
+
+    int depth = 0;
+    for (int i = 0; i < pattern.size(); i++) {
+        QChar c = pattern[i];
+        switch (c.unicode()) {
+        case '\\':
+            if (i + 1 == pattern.size()) {
+                return QVector<uint>();
+            }
+            c = pattern[++i];
+            if (c.isLetterOrNumber()) {
+                // escapes with arguments are not parsed
+                if (!QStringLiteral("dDwWsSbBhHvVRNnrtfeaAzZGKX").contains(c)) {
+                    return QVector<uint>();
+                }
+                addRun();
+                continue;
+            }
+            break;
+        case '|':
+            return QVector<uint>();
+        case '(':
+            depth++;
+            addRun();
+            continue;
+        case ')':
+            depth--;
+            addRun();
+            continue;
+        case '[':
+            i++;
+            if (i < pattern.size() && pattern[i] == QLatin1Char('^')) {
+                i++;
+            }
+            if (i < pattern.size() && pattern[i] == QLatin1Char(']')) {
+                i++;
+            }
+            while (i < pattern.size() && pattern[i] != QLatin1Char(']')) {
+                if (pattern[i] == QLatin1Char('\\')) {
+                    i++;
+                }
+                i++;
+            }
+            addRun();
+            continue;
+        case '{':
+            while (i < pattern.size() && pattern[i] != QLatin1Char('}')) {
+                i++;
+            }
+            Q_FALLTHROUGH();
+        case '?':
+        case '*':
+            // the previous character is optional
+            run.chop(1);
+            addRun();
+            continue;
+        case '+':
+        case '.':
+        case '^':
+        case '$':
+            addRun();
+            continue;
+        default:
+            break;
+        }
+
+        if (depth == 0) {
+            run.append(c);
+        } else {
+            addRun();
+        }
+    }
+    addRun();
+
+    std::sort(result.begin(), result.end());
+    result.erase(std::unique(result.begin(), result.end()), result.end());
+    return result;
+}
+
+uint HistorySearchIndex::trigramBit(QChar a, QChar b, QChar c)
+{
+    // fold the case of ASCII characters, and of the two characters
+    // which match ASCII letters when ignoring the case
+    auto fold = [](QChar ch) -> uint {
+        const uint u = ch.unicode();
+        if (u >= 'A' && u <= 'Z') {
+            return u + ('a' - 'A');
+        } else if (u == 0x212a) { // KELVIN SIGN
+            return 'k';
+        } else if (u == 0x017f) { // LATIN SMALL LETTER LONG S
+            return 's';
+        }
+        return u;
+    };
+
+    uint hash = fold(a) * 0x9e3779b1u ^ fold(b) * 0x85ebca77u ^ fold(c) * 0xc2b2ae3du;
+    hash ^= hash >> 15;
+    return hash % TrigramBits;
+}
@@ -0,0 +1,154 @@
+/*
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+    02110-1301  USA.
+*/
+
+#ifndef HISTORYSEARCHINDEX_H
+#define HISTORYSEARCHINDEX_H
+
+// Qt
+#include <QAtomicInt>
+#include <QRegularExpression>
+#include <QVector>
+
+// Konsole
+#include "Character.h"
+#include "konsoleprivate_export.h"
+
+namespace Konsole
+{
+class Screen;
+
+/**
+ * An index of the lines in the history of a Screen which allows
+ * searching the output without decoding all of it.
+ *
+ * The history is split into blocks of about BlockLines lines.  For each
+ * block the index records which trigrams (sequences of three characters)
+ * occur in its plain text.  A search only decodes the blocks which,
+ * together with one of their neighbours, contain all trigrams the regular
+ * expression requires, so that a match may continue from one block into
+ * the next.
+ *
+ * The screen adds each line to the index as it enters the history, see
+ * addLine().  The blocks are kept in the lines as stored, which do not
+ * change when the history is rewrapped, and are mapped to the lines as
+ * presented when a search is made.  The lines of the screen itself, and
+ * the lines a history started with when it was replaced, are always
+ * decoded.
+ */
+class KONSOLEPRIVATE_EXPORT HistorySearchIndex
+{
+public:
+    explicit HistorySearchIndex(const Screen *screen);
+
+    /**
+     * Indexes a line which has been added to the history, made of the
+     * @p count cells @p cells.  @p wrapped is true if the line continues
+     * in the next one.  The history stores @p storedLines lines now, the
+     * lines which left it are forgotten.
+     */
+    void addLine(const Character *cells, int count, bool wrapped, int storedLines);
+
+    /**
+     * Searches the lines from @p fromLine to @p toLine (inclusive) for
+     * @p regExp and returns the first line with a match if @p forwards is
+     * true, otherwise the last one.  Returns -1 if there is no match.
+     *
+     * Lines are numbered like in the screen, where 0 is the first line of
+     * the history.
+     */
+    int findLine(const QRegularExpression &regExp, int fromLine, int toLine, bool forwards) const;
+
+    /**
+     * Returns the ranges of lines from @p fromLine to @p toLine which may
+     * contain a match of @p regExp, in ascending order.  Ranges of lines
+     * which are not indexed are always included.  A range which is split
+     * because of its size overlaps the next one by a line.
+     */
+    QVector<QPair<int, int> > candidateRanges(const QRegularExpression &regExp, int fromLine, int toLine) const;
+
+    /**
+     * Returns the plain text of the lines from @p fromLine to @p toLine,
+     * as it is searched.  The positions at which the lines start are
+     * stored in @p linePositions.
+     */
+    QString plainText(int fromLine, int toLine, QList<int> *linePositions) const;
+
+    /**
+     * Searches the plain text of lines returned by plainText() and returns
+     * the line of the first (or last) match counted from the first line
+     * of the text, or -1 if there is no match.
+     */
+    static int findInText(const QRegularExpression &regExp, const QString &text,
+                          const QList<int> &linePositions, bool forwards);
+
+    /**
+     * Like findInText(), but returns all lines with a match in ascending
+     * order.  The search stops early when @p cancelled becomes non-zero.
+     */
+    static QVector<int> findLinesInText(const QRegularExpression &regExp, const QString &text,
+                                        const QList<int> &linePositions, const QAtomicInt *cancelled = nullptr);
+
+    /**
+     * Forgets the indexed lines, used when the history is replaced.  The
+     * @p storedLines lines the new history starts with are not indexed.
+     */
+    void reset(int storedLines);
+
+    /** Number of lines in a block */
+    static const int BlockLines = 64;
+
+private:
+    // bits of the trigram set of a block
+    static const int TrigramBits = 8192;
+
+    struct Block {
+        qint64 firstLine; // counted from the first line added since reset()
+        int lineCount;
+        quint64 trigrams[TrigramBits / 64];
+    };
+
+    // the last two characters of the text of a logical line
+    struct Context {
+        QChar chars[2];
+        int count;
+    };
+
+    void addChar(Context &context, QChar c);
+    bool containsAll(const QVector<uint> &trigrams, const Block &block, const Block *neighbour) const;
+    // the range of lines of the screen which show stored lines, counted like Block::firstLine
+    bool presentedLines(qint64 first, qint64 last, int *fromLine, int *toLine) const;
+
+    static QVector<uint> requiredTrigrams(const QRegularExpression &regExp);
+    static uint trigramBit(QChar a, QChar b, QChar c);
+
+    const Screen *_screen;
+    // the last block is still added to until _blockOpen is false
+    QVector<Block> _blocks;
+    bool _blockOpen;
+    qint64 _addedLines;
+    int _storedLines;
+    // the lines the history had on reset(), which are not indexed
+    qint64 _unindexedLines;
+    // the context with all cells of a line, and with only the real ones,
+    // since the cells after the last real character of a line are not
+    // decoded, and where a line ends depends on how it is wrapped
+    Context _allCells;
+    Context _realCells;
+};
+}
+
+#endif // HISTORYSEARCHINDEX_H
@@ -86,6 +86,16 @@ void HistorySizeDialog::setLineCount(int lines)
     _ui->historySizeWidget->setLineCount(lines);
 }
 
+void HistorySizeDialog::setFileSize(int megabytes)
+{
+    _ui->historySizeWidget->setFileSize(megabytes);
+}
+
+int HistorySizeDialog::fileSize() const
+{
+    return _ui->historySizeWidget->fileSize();
+}
+
 QSize HistorySizeDialog::sizeHint() const {
     return QSize(_ui->tempWarningWidget->sizeHint().width(), 0);
 }
@@ -52,6 +52,12 @@ public:
     /** See HistorySizeWidget::lineCount. */
     int lineCount() const;
 
+    /** See HistorySizeWidget::setFileSize. */
+    void setFileSize(int megabytes);
+
+    /** See HistorySizeWidget::fileSize. */
+    int fileSize() const;
+
     QSize sizeHint() const override;
 
 private:
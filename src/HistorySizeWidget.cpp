@@ -50,6 +50,7 @@ HistorySizeWidget::HistorySizeWidget(QWidget *parent) :
     auto modeGroup = new QButtonGroup(this);
     modeGroup->addButton(_ui->noHistoryButton);
     modeGroup->addButton(_ui->fixedSizeHistoryButton);
+    modeGroup->addButton(_ui->fixedSizeFileHistoryButton);
     modeGroup->addButton(_ui->unlimitedHistoryButton);
     connect(modeGroup,
             static_cast<void (QButtonGroup::*)(QAbstractButton *)>(&QButtonGroup::buttonClicked),
@@ -62,6 +63,19 @@ HistorySizeWidget::HistorySizeWidget(QWidget *parent) :
             static_cast<void (KPluralHandlingSpinBox::*)(int)>(&KPluralHandlingSpinBox::valueChanged),
             this, &Konsole::HistorySizeWidget::historySizeChanged);
 
+    _ui->fixedSizeFileHistoryButton->setFocusProxy(_ui->historyFileSizeSpinner);
+    connect(_ui->fixedSizeFileHistoryButton, &QRadioButton::clicked,
+            _ui->historyFileSizeSpinner,
+            &KPluralHandlingSpinBox::selectAll);
+    connect(_ui->fixedSizeFileHistoryButton, &QAbstractButton::toggled, _ui->historyFileSizeSpinner, &QWidget::setEnabled);
+
+    _ui->historyFileSizeSpinner->setSuffix(ki18ncp("@label:textbox Unit of scrollback file size", " MiB", " MiB"));
+    setFileSize(HistorySizeWidget::DefaultFileSize);
+
+    connect(_ui->historyFileSizeSpinner,
+            static_cast<void (KPluralHandlingSpinBox::*)(int)>(&KPluralHandlingSpinBox::valueChanged),
+            this, &Konsole::HistorySizeWidget::historyFileSizeChanged);
+
     auto warningButtonSizePolicy = _ui->fixedSizeHistoryWarningButton->sizePolicy();
     warningButtonSizePolicy.setRetainSizeWhenHidden(true);
 
@@ -79,7 +93,7 @@ HistorySizeWidget::HistorySizeWidget(QWidget *parent) :
     _ui->unlimitedHistoryWarningButton->hide();
     connect(_ui->unlimitedHistoryButton, &QAbstractButton::toggled, _ui->unlimitedHistoryWarningButton, &QWidget::setVisible);
     connect(_ui->unlimitedHistoryWarningButton, &QToolButton::clicked, this, [this](bool) {
-                const auto message = xi18nc("@info:tooltip", "When using this option, the scrollback data will be written unencrypted to temporary files. Those temporary files will be deleted automatically when Konsole is closed in a normal manner.<nl/>Use <emphasis>Settings → Configure Konsole → File Location</emphasis> to select the location of the temporary files.");
+                const auto message = xi18nc("@info:tooltip", "When using this option, the scrollback data is kept compressed in memory. Its memory usage keeps growing as long as the terminal produces output.");
                 const QPoint pos = QPoint(_ui->unlimitedHistoryWrapper->width() / 2, _ui->unlimitedHistoryWrapper->height());
                 QWhatsThis::showText(_ui->unlimitedHistoryWrapper->mapToGlobal(pos), message, _ui->unlimitedHistoryWrapper);
             });
@@ -90,6 +104,7 @@ HistorySizeWidget::HistorySizeWidget(QWidget *parent) :
     // radio + toolbutton
     const int radioButtonHeight = _ui->fixedSizeHistoryWrapper->sizeHint().height();
     _ui->noHistoryButton->setMinimumHeight(radioButtonHeight);
+    _ui->fixedSizeFileHistoryButton->setMinimumHeight(radioButtonHeight);
     _ui->unlimitedHistoryButton->setMinimumHeight(radioButtonHeight);
 }
 
@@ -112,6 +127,8 @@ void HistorySizeWidget::setMode(Enum::HistoryModeEnum aMode)
         _ui->fixedSizeHistoryButton->setChecked(true);
     } else if (aMode == Enum::UnlimitedHistory) {
         _ui->unlimitedHistoryButton->setChecked(true);
+    } else if (aMode == Enum::FixedSizeFileHistory) {
+        _ui->fixedSizeFileHistoryButton->setChecked(true);
     }
 }
 
@@ -123,6 +140,8 @@ Enum::HistoryModeEnum HistorySizeWidget::mode() const
         return Enum::FixedSizeHistory;
     } else if (_ui->unlimitedHistoryButton->isChecked()) {
         return Enum::UnlimitedHistory;
+    } else if (_ui->fixedSizeFileHistoryButton->isChecked()) {
+        return Enum::FixedSizeFileHistory;
     }
 
     Q_ASSERT(false);
@@ -140,6 +159,17 @@ int HistorySizeWidget::lineCount() const
     return _ui->historyLineSpinner->value();
 }
 
+void HistorySizeWidget::setFileSize(int megabytes)
+{
+    _ui->historyFileSizeSpinner->setValue(megabytes);
+    _ui->historyFileSizeSpinner->setSingleStep(qMax(1, megabytes / 10));
+}
+
+int HistorySizeWidget::fileSize() const
+{
+    return _ui->historyFileSizeSpinner->value();
+}
+
 int HistorySizeWidget::preferredLabelHeight()
 {
     Q_ASSERT(_ui);
@@ -61,6 +61,15 @@ public:
      */
     int lineCount() const;
 
+    /** Sets the size in megabytes of the file for the fixed size file history mode. */
+    void setFileSize(int megabytes);
+
+    /**
+     * Returns the size in megabytes of the history file.
+     * This is only meaningful when mode() == FixedSizeFileHistory.
+     */
+    int fileSize() const;
+
     /**
      * Return height which should be set on the widget's label
      * to align with the first widget's item
@@ -74,6 +83,9 @@ Q_SIGNALS:
     /** Emitted when the history size is changed. */
     void historySizeChanged(int);
 
+    /** Emitted when the size of the history file is changed. */
+    void historyFileSizeChanged(int);
+
 private Q_SLOTS:
     void buttonClicked(QAbstractButton *);
 
@@ -82,6 +94,8 @@ private:
 
     // 1000 lines was the default in the KDE3 series
     static const int DefaultLineCount = 1000;
+
+    static const int DefaultFileSize = 100;
 };
 }
 
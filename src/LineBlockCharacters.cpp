@@ -27,6 +27,7 @@
 
 // Qt
 #include <QPainter>
+#include <QtMath>
 
 namespace Konsole {
 namespace LineBlockCharacters {
@@ -718,5 +719,54 @@ void draw(QPainter &paint, const QRect &cellRect, const QChar &chr, bool bold)
             || drawBlockCharacter(paint, x, y, w, h, code, bold);
 }
 
+Atlas::Atlas(int maxBytes) :
+    _glyphs(maxBytes)
+{
+}
+
+bool Atlas::draw(QPainter &paint, const QRect &cellRect, const QChar &chr, bool bold)
+{
+    Q_ASSERT(canDraw(chr.unicode()));
+    Q_ASSERT(paint.transform().type() <= QTransform::TxTranslate);
+
+    const qreal devicePixelRatio = paint.device()->devicePixelRatioF();
+    const Key key = {chr.unicode(), cellRect.size(), devicePixelRatio, paint.pen().color().rgba(), bold,
+                     paint.testRenderHint(QPainter::Antialiasing)};
+
+    const QImage *glyph = _glyphs.object(key);
+    if (glyph == nullptr) {
+        auto image = new QImage(qCeil(cellRect.width() * devicePixelRatio),
+                                qCeil(cellRect.height() * devicePixelRatio), QImage::Format_ARGB32_Premultiplied);
+        image->setDevicePixelRatio(devicePixelRatio);
+        image->fill(Qt::transparent);
+
+        const QRect glyphRect(QPoint(0, 0), cellRect.size());
+        QPainter glyphPainter(image);
+        glyphPainter.setRenderHint(QPainter::Antialiasing, key.antialiased);
+        glyphPainter.setPen(paint.pen().color());
+        glyphPainter.setClipRect(glyphRect);
+        LineBlockCharacters::draw(glyphPainter, glyphRect, chr, bold);
+        glyphPainter.end();
+
+        // the image is deleted if it is larger than the whole atlas
+        paint.drawImage(cellRect.topLeft(), *image);
+        _glyphs.insert(key, image, image->bytesPerLine() * image->height());
+        return false;
+    }
+
+    paint.drawImage(cellRect.topLeft(), *glyph);
+    return true;
+}
+
+void Atlas::clear()
+{
+    _glyphs.clear();
+}
+
+int Atlas::memory() const
+{
+    return _glyphs.totalCost();
+}
+
 } // namespace LineBlockCharacters
 } // namespace Konsole
@@ -23,9 +23,14 @@
 #define LINEBLOCKCHARACTERS_H
 
 // Qt
+#include <QCache>
+#include <QImage>
 #include <QPainter>
 #include <QtGlobal>
 
+// Konsole
+#include "konsoleprivate_export.h"
+
 namespace Konsole {
 
 /**
@@ -50,7 +55,66 @@ namespace LineBlockCharacters {
      * @param chr Character to be drawn
      * @param bold Whether the character should be boldface
      */
-    void draw(QPainter &paint, const QRect &cellRect, const QChar &chr, bool bold);
+    KONSOLEPRIVATE_EXPORT void draw(QPainter &paint, const QRect &cellRect, const QChar &chr, bool bold);
+
+    /**
+     * Pre-rasterized characters, which are drawn much faster than with
+     * draw().  Text user interfaces fill large parts of the screen with
+     * box drawing characters.
+     *
+     * Each character is rasterized on first use, separately for each cell
+     * size, device pixel ratio, color, boldness and antialiasing it is
+     * drawn with.  The least recently used characters are dropped when the
+     * memory they take exceeds the limit.
+     */
+    class KONSOLEPRIVATE_EXPORT Atlas
+    {
+    public:
+        explicit Atlas(int maxBytes = DefaultMaxBytes);
+
+        /**
+         * Draws the character like draw() with the pen color of @p paint.
+         * The painter must not be scaled or rotated.
+         *
+         * Returns true if the character was rasterized already, and false
+         * if it had to be rasterized first.
+         */
+        bool draw(QPainter &paint, const QRect &cellRect, const QChar &chr, bool bold);
+
+        /** Drops all rasterized characters, e.g. when the font changed. */
+        void clear();
+
+        /** Number of bytes taken by the rasterized characters */
+        int memory() const;
+
+        /** Default limit of the memory taken by the rasterized characters */
+        static const int DefaultMaxBytes = 8 * 1024 * 1024;
+
+    private:
+        struct Key {
+            ushort character;
+            QSize cellSize;
+            qreal devicePixelRatio;
+            QRgb color;
+            bool bold;
+            bool antialiased;
+
+            bool operator==(const Key &other) const
+            {
+                return character == other.character && cellSize == other.cellSize && devicePixelRatio == other.devicePixelRatio
+                       && color == other.color && bold == other.bold && antialiased == other.antialiased;
+            }
+
+            friend uint qHash(const Key &key, uint seed = 0)
+            {
+                return qHash(key.character, seed) ^ qHash(key.cellSize.width() | key.cellSize.height() << 16, seed)
+                       ^ qHash(key.devicePixelRatio, seed) ^ qHash(key.color, seed)
+                       ^ (uint(key.bold) << 1 | uint(key.antialiased));
+            }
+        };
+
+        QCache<Key, QImage> _glyphs;
+    };
 
 } // namespace LineBlockCharacters
 } // namespace Konsole
@@ -0,0 +1,138 @@
+/*
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+    02110-1301  USA.
+*/
+
+// Own
+#include "LineDiff.h"
+
+// System
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#if defined(Q_CC_GNU)
+#include <immintrin.h>
+#define LINEDIFF_AVX2
+#endif
+#endif
+
+namespace Konsole {
+namespace LineDiff {
+
+// The vector implementations compare the bytes of the cells, which are
+// the character and the word with the style ID and the extended flag.
+static_assert(sizeof(StylePalette::Cell) == 8, "two cells fill a 128 bit register");
+static const uint CELL_BYTES = 0xff;
+
+static int compareScalar(const StylePalette::Cell *line, const StylePalette::Cell *oldLine, int count, char *dirtyMask)
+{
+    int changed = 0;
+    for (int i = 0; i < count; i++) {
+        dirtyMask[i] = line[i] != oldLine[i] ? 1 : 0;
+        changed += dirtyMask[i];
+    }
+    return changed;
+}
+
+#if defined(__SSE2__)
+static int compareSse2(const StylePalette::Cell *line, const StylePalette::Cell *oldLine, int count, char *dirtyMask)
+{
+    int changed = 0;
+    int i = 0;
+    for (; i + 2 <= count; i += 2) {
+        const __m128i a = _mm_loadu_si128(reinterpret_cast<const __m128i *>(line + i));
+        const __m128i b = _mm_loadu_si128(reinterpret_cast<const __m128i *>(oldLine + i));
+        const uint equal = static_cast<uint>(_mm_movemask_epi8(_mm_cmpeq_epi8(a, b)));
+        for (int k = 0; k < 2; k++) {
+            dirtyMask[i + k] = ((equal >> (8 * k)) & CELL_BYTES) != CELL_BYTES ? 1 : 0;
+            changed += dirtyMask[i + k];
+        }
+    }
+    if (i < count) {
+        changed += compareScalar(line + i, oldLine + i, count - i, dirtyMask + i);
+    }
+    return changed;
+}
+#endif
+
+#if defined(LINEDIFF_AVX2)
+__attribute__((target("avx2")))
+static int compareAvx2(const StylePalette::Cell *line, const StylePalette::Cell *oldLine, int count, char *dirtyMask)
+{
+    int changed = 0;
+    int i = 0;
+    for (; i + 4 <= count; i += 4) {
+        const __m256i a = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(line + i));
+        const __m256i b = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(oldLine + i));
+        const uint equal = static_cast<uint>(_mm256_movemask_epi8(_mm256_cmpeq_epi8(a, b)));
+        for (int k = 0; k < 4; k++) {
+            dirtyMask[i + k] = ((equal >> (8 * k)) & CELL_BYTES) != CELL_BYTES ? 1 : 0;
+            changed += dirtyMask[i + k];
+        }
+    }
+    if (i < count) {
+        changed += compareSse2(line + i, oldLine + i, count - i, dirtyMask + i);
+    }
+    return changed;
+}
+#endif
+
+bool isSupported(Implementation implementation)
+{
+    switch (implementation) {
+    case Scalar:
+        return true;
+    case SSE2:
+#if defined(__SSE2__)
+        return true;
+#else
+        return false;
+#endif
+    case AVX2:
+#if defined(LINEDIFF_AVX2)
+        return __builtin_cpu_supports("avx2");
+#else
+        return false;
+#endif
+    }
+    return false;
+}
+
+int compare(Implementation implementation, const StylePalette::Cell *line, const StylePalette::Cell *oldLine,
+            int count, char *dirtyMask)
+{
+    Q_ASSERT(isSupported(implementation));
+
+    switch (implementation) {
+#if defined(LINEDIFF_AVX2)
+    case AVX2:
+        return compareAvx2(line, oldLine, count, dirtyMask);
+#endif
+#if defined(__SSE2__)
+    case SSE2:
+        return compareSse2(line, oldLine, count, dirtyMask);
+#endif
+    default:
+        return compareScalar(line, oldLine, count, dirtyMask);
+    }
+}
+
+int compare(const StylePalette::Cell *line, const StylePalette::Cell *oldLine, int count, char *dirtyMask)
+{
+    static const Implementation implementation = isSupported(AVX2) ? AVX2 : (isSupported(SSE2) ? SSE2 : Scalar);
+    return compare(implementation, line, oldLine, count, dirtyMask);
+}
+
+} // namespace LineDiff
+} // namespace Konsole
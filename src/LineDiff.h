@@ -0,0 +1,66 @@
+/*
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+    02110-1301  USA.
+*/
+
+#ifndef LINEDIFF_H
+#define LINEDIFF_H
+
+// Konsole
+#include "StylePalette.h"
+#include "konsoleprivate_export.h"
+
+namespace Konsole {
+
+/**
+ * Functions to find the cells of a line of the terminal image which
+ * changed, using the vector instructions the processor supports.  The
+ * cells of both lines must have their styles in the same palette.
+ */
+namespace LineDiff {
+
+    /** The ways to compare lines, from the slowest to the fastest. */
+    enum Implementation {
+        Scalar,
+        SSE2,
+        AVX2
+    };
+
+    /**
+     * Returns true if @p implementation is built in and supported by the
+     * processor.
+     */
+    KONSOLEPRIVATE_EXPORT bool isSupported(Implementation implementation);
+
+    /**
+     * Compares @p count cells of @p line with those of @p oldLine, and
+     * sets the bytes of @p dirtyMask of the cells which differ to 1 and
+     * the others to 0.  Returns the number of cells which differ, a line
+     * which did not change needs no further look.
+     *
+     * The fastest implementation the processor supports is used.
+     */
+    KONSOLEPRIVATE_EXPORT int compare(const StylePalette::Cell *line, const StylePalette::Cell *oldLine,
+                                      int count, char *dirtyMask);
+
+    /** Compares lines like above with the given @p implementation, which must be supported. */
+    KONSOLEPRIVATE_EXPORT int compare(Implementation implementation,
+                                      const StylePalette::Cell *line, const StylePalette::Cell *oldLine,
+                                      int count, char *dirtyMask);
+
+} // namespace LineDiff
+} // namespace Konsole
+
+#endif // LINEDIFF_H
@@ -45,6 +45,9 @@
 #include <KSharedConfig>
 #include <KUser>
 
+// Konsole
+#include "ProcessInfoSampler.h"
+
 #if defined(Q_OS_FREEBSD) || defined(Q_OS_OPENBSD) || defined(Q_OS_MACOS)
 #include <sys/sysctl.h>
 #endif
@@ -431,6 +434,18 @@ public:
 protected:
     bool readCurrentDir(int pid) Q_DECL_OVERRIDE
     {
+        // once the sampler knows the process, its directory is read in
+        // the background
+        const QSharedPointer<const ProcessInfoSampler::Sample> sample = ProcessInfoSampler::instance()->sample(pid);
+        if (!sample.isNull() && sample->valid) {
+            if (!sample->currentDirValid) {
+                setError(UnknownError);
+                return false;
+            }
+            setCurrentDir(sample->currentDir);
+            return true;
+        }
+
         char path_buffer[MAXPATHLEN + 1];
         path_buffer[MAXPATHLEN] = 0;
         QByteArray procCwd = QFile::encodeName(QStringLiteral("/proc/%1/cwd").arg(pid));
@@ -450,6 +465,24 @@ protected:
 private:
     bool readProcInfo(int pid) Q_DECL_OVERRIDE
     {
+        const QSharedPointer<const ProcessInfoSampler::Sample> sample = ProcessInfoSampler::instance()->sample(pid);
+        if (!sample.isNull() && sample->valid) {
+            if (sample->userIdValid) {
+                setUserId(sample->userId);
+            }
+            if (userNameRequired()) {
+                readUserName();
+                setUserNameRequired(false);
+            }
+            setForegroundPid(sample->foregroundPid);
+            setParentPid(sample->parentPid);
+            if (!sample->name.isEmpty()) {
+                setName(sample->name);
+            }
+            setPid(pid);
+            return true;
+        }
+
         // indicies of various fields within the process status file which
         // contain various information about the process
         const int PARENT_PID_FIELD = 3;
@@ -572,6 +605,14 @@ private:
 
     bool readArguments(int pid) Q_DECL_OVERRIDE
     {
+        const QSharedPointer<const ProcessInfoSampler::Sample> sample = ProcessInfoSampler::instance()->sample(pid);
+        if (!sample.isNull() && sample->valid) {
+            foreach (const QString &argument, sample->arguments) {
+                addArgument(argument);
+            }
+            return true;
+        }
+
         // read command-line arguments file found at /proc/<pid>/cmdline
         // the expected format is a list of strings delimited by null characters,
         // and ending in a double null character pair.
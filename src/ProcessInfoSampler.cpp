@@ -0,0 +1,325 @@
+/*
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+    02110-1301  USA.
+*/
+
+// Own
+#include "ProcessInfoSampler.h"
+
+// Unix
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/param.h>
+#include <cerrno>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+// Qt
+#include <QFile>
+#include <QMutexLocker>
+
+using namespace Konsole;
+
+// processes which nobody asked for in this many passes are not sampled anymore
+static const int EXPIRE_PASSES = 10;
+
+Q_GLOBAL_STATIC(ProcessInfoSampler, theProcessInfoSampler)
+
+ProcessInfoSampler::Sample::Sample() :
+    valid(false),
+    pid(0),
+    parentPid(0),
+    foregroundPid(0),
+    startTime(0),
+    userIdValid(false),
+    userId(0),
+    name(QString()),
+    arguments(QVector<QString>()),
+    currentDirValid(false),
+    currentDir(QString())
+{
+}
+
+static bool operator==(const ProcessInfoSampler::Sample &a, const ProcessInfoSampler::Sample &b)
+{
+    return a.valid == b.valid
+           && a.pid == b.pid
+           && a.parentPid == b.parentPid
+           && a.foregroundPid == b.foregroundPid
+           && a.startTime == b.startTime
+           && a.userIdValid == b.userIdValid
+           && a.userId == b.userId
+           && a.name == b.name
+           && a.arguments == b.arguments
+           && a.currentDirValid == b.currentDirValid
+           && a.currentDir == b.currentDir;
+}
+
+ProcessInfoSampler::ProcessInfoSampler(QObject *parent)
+    : QThread(parent)
+    , _mutex()
+    , _wake()
+    , _processes(QHash<int, Process>())
+    , _pass(0)
+    , _added(false)
+    , _stopped(false)
+{
+    // the ids are queued to the objects in the user interface thread
+    qRegisterMetaType<QVector<int> >("QVector<int>");
+}
+
+ProcessInfoSampler::~ProcessInfoSampler()
+{
+    stop();
+    wait();
+}
+
+ProcessInfoSampler *ProcessInfoSampler::instance()
+{
+    return theProcessInfoSampler;
+}
+
+QSharedPointer<const ProcessInfoSampler::Sample> ProcessInfoSampler::sample(int pid)
+{
+    if (pid <= 0) {
+        return QSharedPointer<const Sample>();
+    }
+
+    QSharedPointer<const Sample> result;
+    {
+        QMutexLocker locker(&_mutex);
+        if (_stopped) {
+            return result;
+        }
+
+        auto it = _processes.find(pid);
+        if (it == _processes.end()) {
+            Process process;
+            process.requested = _pass;
+            _processes.insert(pid, process);
+            _added = true;
+            _wake.wakeOne();
+        } else {
+            it->requested = _pass;
+            result = it->sample;
+        }
+    }
+
+    if (!isRunning()) {
+        start(QThread::LowPriority);
+    }
+    return result;
+}
+
+void ProcessInfoSampler::stop()
+{
+    QMutexLocker locker(&_mutex);
+    _stopped = true;
+    _wake.wakeOne();
+}
+
+// reads the file at path into buffer, which keeps its capacity for the
+// next file
+static bool readProcFile(const char *path, QByteArray &buffer)
+{
+    const int fd = ::open(path, O_RDONLY | O_CLOEXEC);
+    if (fd == -1) {
+        return false;
+    }
+
+    int length = 0;
+    forever {
+        if (buffer.size() - length < 1024) {
+            buffer.resize(qMax(4096, 2 * buffer.size()));
+        }
+        const ssize_t count = ::read(fd, buffer.data() + length, buffer.size() - length);
+        if (count == -1 && errno == EINTR) {
+            continue;
+        } else if (count == -1) {
+            ::close(fd);
+            return false;
+        } else if (count == 0) {
+            break;
+        }
+        length += static_cast<int>(count);
+    }
+    ::close(fd);
+
+    buffer.resize(length);
+    return true;
+}
+
+ProcessInfoSampler::Sample ProcessInfoSampler::readSample(int pid, const Sample *previous, QByteArray &buffer)
+{
+    Sample sample;
+    sample.pid = pid;
+    char path[64];
+
+    // the fields of /proc/<pid>/stat are separated by spaces, the name of
+    // the process in the second field is put in parentheses and may
+    // contain spaces and parentheses itself
+    snprintf(path, sizeof(path), "/proc/%d/stat", pid);
+    if (!readProcFile(path, buffer)) {
+        return sample;
+    }
+    const char *data = buffer.constData();
+    const char *nameStart = static_cast<const char *>(memchr(data, '(', buffer.size()));
+    const char *nameEnd = data + buffer.size();
+    while (nameEnd > data && *(nameEnd - 1) != ')') {
+        nameEnd--;
+    }
+    if (nameStart == nullptr || nameEnd <= nameStart + 1) {
+        return sample;
+    }
+    sample.name = QString::fromLocal8Bit(nameStart + 1, static_cast<int>(nameEnd - nameStart - 2));
+
+    // the fields after the name, starting with the state of the process
+    // as field 3
+    const int PARENT_PID_FIELD = 4;
+    const int FOREGROUND_PID_FIELD = 8;
+    const int START_TIME_FIELD = 22;
+    const int fieldsStart = static_cast<int>(nameEnd - data);
+    buffer.append('\0');
+    const char *pos = buffer.constData() + fieldsStart;
+    for (int field = 3; field <= START_TIME_FIELD && *pos != '\0'; field++) {
+        while (*pos == ' ') {
+            pos++;
+        }
+        char *end = nullptr;
+        if (field == PARENT_PID_FIELD) {
+            sample.parentPid = static_cast<int>(strtol(pos, &end, 10));
+        } else if (field == FOREGROUND_PID_FIELD) {
+            sample.foregroundPid = static_cast<int>(strtol(pos, &end, 10));
+        } else if (field == START_TIME_FIELD) {
+            sample.startTime = strtoull(pos, &end, 10);
+            sample.valid = true;
+        }
+        while (*pos != ' ' && *pos != '\0') {
+            pos++;
+        }
+    }
+    if (!sample.valid) {
+        return sample;
+    }
+
+    if ((previous != nullptr) && previous->valid && previous->startTime == sample.startTime
+        && previous->name == sample.name) {
+        sample.userIdValid = previous->userIdValid;
+        sample.userId = previous->userId;
+        sample.arguments = previous->arguments;
+    } else {
+        // the real user id is the first one of the "Uid:" line, getuid()
+        // can not be used since it does not work for 'su'
+        snprintf(path, sizeof(path), "/proc/%d/status", pid);
+        if (readProcFile(path, buffer)) {
+            buffer.append('\0');
+            const char *uidLine = strstr(buffer.constData(), "\nUid:");
+            if (uidLine != nullptr) {
+                char *end = nullptr;
+                const long uid = strtol(uidLine + 5, &end, 10);
+                if (end != uidLine + 5) {
+                    sample.userIdValid = true;
+                    sample.userId = static_cast<int>(uid);
+                }
+            }
+        }
+
+        // the arguments are separated by null characters
+        snprintf(path, sizeof(path), "/proc/%d/cmdline", pid);
+        if (readProcFile(path, buffer)) {
+            int start = 0;
+            for (int i = 0; i <= buffer.size(); i++) {
+                if (i == buffer.size() || buffer.at(i) == '\0') {
+                    if (i > start) {
+                        sample.arguments.append(QString::fromLocal8Bit(buffer.constData() + start, i - start));
+                    }
+                    start = i + 1;
+                }
+            }
+        }
+    }
+
+    char currentDir[MAXPATHLEN + 1];
+    snprintf(path, sizeof(path), "/proc/%d/cwd", pid);
+    const ssize_t length = readlink(path, currentDir, MAXPATHLEN);
+    if (length != -1) {
+        currentDir[length] = '\0';
+        sample.currentDirValid = true;
+        sample.currentDir = QFile::decodeName(currentDir);
+    }
+
+    return sample;
+}
+
+void ProcessInfoSampler::run()
+{
+    QByteArray buffer;
+
+    forever {
+        QVector<int> pids;
+        QVector<QSharedPointer<const Sample> > samples;
+        {
+            QMutexLocker locker(&_mutex);
+            if (!_stopped && !_added) {
+                if (_processes.isEmpty()) {
+                    _wake.wait(&_mutex);
+                } else {
+                    _wake.wait(&_mutex, SampleInterval);
+                }
+            }
+            if (_stopped) {
+                return;
+            }
+            _added = false;
+            _pass++;
+
+            for (auto it = _processes.begin(); it != _processes.end();) {
+                if (_pass - it->requested > EXPIRE_PASSES) {
+                    it = _processes.erase(it);
+                } else {
+                    pids.append(it.key());
+                    samples.append(it->sample);
+                    ++it;
+                }
+            }
+        }
+
+        // the files are read without holding the lock
+        QVector<int> changedPids;
+        QVector<QSharedPointer<const Sample> > changedSamples;
+        for (int i = 0; i < pids.size(); i++) {
+            const Sample sample = readSample(pids[i], samples[i].data(), buffer);
+            if (samples[i].isNull() || !(*samples[i] == sample)) {
+                changedPids.append(pids[i]);
+                changedSamples.append(QSharedPointer<const Sample>(new Sample(sample)));
+            }
+        }
+
+        if (changedPids.isEmpty()) {
+            continue;
+        }
+        {
+            QMutexLocker locker(&_mutex);
+            for (int i = 0; i < changedPids.size(); i++) {
+                auto it = _processes.find(changedPids[i]);
+                if (it != _processes.end()) {
+                    it->sample = changedSamples[i];
+                }
+            }
+        }
+        emit processesChanged(changedPids);
+    }
+}
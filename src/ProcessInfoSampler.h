@@ -0,0 +1,129 @@
+/*
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+    02110-1301  USA.
+*/
+
+#ifndef PROCESSINFOSAMPLER_H
+#define PROCESSINFOSAMPLER_H
+
+// Qt
+#include <QHash>
+#include <QMutex>
+#include <QSharedPointer>
+#include <QString>
+#include <QThread>
+#include <QVector>
+#include <QWaitCondition>
+
+// Konsole
+#include "konsoleprivate_export.h"
+
+namespace Konsole {
+/**
+ * Reads the state of the processes of all sessions from /proc in a
+ * thread of its own, so that keeping the titles of many sessions up to
+ * date does not make the user interface thread wait for the file system.
+ *
+ * A process is sampled from the first time sample() is asked for it until
+ * nobody asked for it for a while.  All of them are sampled in one pass
+ * every SampleInterval milliseconds.  The arguments and the user of a
+ * process are only read again when the start time or the name of the
+ * process in /proc/<pid>/stat changed.
+ *
+ * Each pass publishes new samples for the processes which changed, which
+ * are never modified afterwards, and emits processesChanged() with their
+ * ids.
+ */
+class KONSOLEPRIVATE_EXPORT ProcessInfoSampler : public QThread
+{
+    Q_OBJECT
+
+public:
+    /** The state of a process at the time it was sampled. */
+    struct Sample {
+        Sample();
+
+        /** False if the process could not be read, eg. it has exited */
+        bool valid;
+        int pid;
+        int parentPid;
+        // the foreground process group of the terminal of the process
+        int foregroundPid;
+        // clock ticks after boot at which the process started
+        quint64 startTime;
+        bool userIdValid;
+        int userId;
+        QString name;
+        QVector<QString> arguments;
+        bool currentDirValid;
+        QString currentDir;
+    };
+
+    explicit ProcessInfoSampler(QObject *parent = nullptr);
+    ~ProcessInfoSampler() Q_DECL_OVERRIDE;
+
+    /** Returns the sampler which is shared by all sessions. */
+    static ProcessInfoSampler *instance();
+
+    /**
+     * Returns the latest sample of the process @p pid, or a null pointer
+     * if the process has not been sampled yet.  In that case it is
+     * sampled as soon as possible.
+     */
+    QSharedPointer<const Sample> sample(int pid);
+
+    /**
+     * Reads the state of the process @p pid.  @p previous is the previous
+     * sample of the process, its arguments and user are reused if the
+     * process did not change.  @p buffer is used to read the files.
+     */
+    static Sample readSample(int pid, const Sample *previous, QByteArray &buffer);
+
+    /** Stops the thread after the pass which runs at the moment. */
+    void stop();
+
+    /** Time between two passes in milliseconds */
+    static const int SampleInterval = 1000;
+
+Q_SIGNALS:
+    /**
+     * Emitted after a pass with the ids of the processes whose samples
+     * changed.
+     */
+    void processesChanged(const QVector<int> &pids);
+
+protected:
+    void run() Q_DECL_OVERRIDE;
+
+private:
+    Q_DISABLE_COPY(ProcessInfoSampler)
+
+    struct Process {
+        QSharedPointer<const Sample> sample;
+        // the pass in which the process was last asked for
+        int requested;
+    };
+
+    QMutex _mutex;
+    QWaitCondition _wake;
+    QHash<int, Process> _processes;
+    int _pass;
+    // processes were added which have not been sampled yet
+    bool _added;
+    bool _stopped;
+};
+}
+
+#endif // PROCESSINFOSAMPLER_H
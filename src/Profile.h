@@ -140,6 +140,11 @@ public:
          * FixedSizeHistory
          */
         HistorySize,
+        /** (int) Specifies the size in megabytes of the file used to
+         * remember the output of terminal sessions using this profile
+         * if the HistoryMode property is FixedSizeFileHistory.
+         */
+        HistoryFileSize,
         /** (ScrollBarPositionEnum) Specifies the position of the scroll bar
          * in terminal displays using this profile.
          *
@@ -293,7 +298,12 @@ public:
         /** (int) Keyboard modifiers to show URL hints */
         UrlHintsModifiers,
         /** (bool) Reverse the order of URL hints */
-        ReverseUrlHints
+        ReverseUrlHints,
+        /** (int) Maximum number of times per second the terminal is
+         * redrawn while output is received.  0 uses the refresh rate
+         * of the screen.
+         */
+        MaximumFrameRate
     };
 
     /**
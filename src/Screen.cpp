@@ -23,13 +23,17 @@
 // Own
 #include "Screen.h"
 
+// System
+#include <algorithm>
+
 // Qt
 #include <QTextStream>
 
 // Konsole
 #include "TerminalCharacterDecoder.h"
 #include "History.h"
-#include "ExtendedCharTable.h"
+#include "HistoryReflow.h"
+#include "HistorySearchIndex.h"
 
 using namespace Konsole;
 
@@ -52,17 +56,54 @@ const Character Screen::DefaultChar = Character(' ',
                                       DEFAULT_RENDITION,
                                       false);
 
+// the cell of DefaultChar, whose style has the same ID in every palette
+static const StylePalette::Cell BLANK_CELL(' ', StylePalette::BlankStyle);
+
+// styles the palette of the screen may have before it is compacted, see
+// compactStyles()
+static const int MAX_STYLES = 4096;
+
+// history lines which are rewrapped when the number of columns changes, the
+// older ones are rewrapped a few at a time by rewrapHistory()
+static const int REWRAP_LINES = 1000;
+
+// lines of the history whose extended characters are recorded together,
+// see addHistoryGraphemes()
+static const int GRAPHEME_SEGMENT_LINES = 1024;
+
+// the generation of a history line is made of the number of the line since
+// the history was set, in the lower bits, and of _historyGeneration, with the
+// top bit set so that it differs from the generations of the screen lines
+static const int HISTORY_LINE_BITS = 40;
+static const quint64 HISTORY_LINE_MASK = (Q_UINT64_C(1) << HISTORY_LINE_BITS) - 1;
+static const quint64 HISTORY_GENERATION = Q_UINT64_C(1) << 63;
+
 Screen::Screen(int lines, int columns):
     _currentTerminalDisplay(nullptr),
     _lines(lines),
     _columns(columns),
     _screenLines(new ImageLine[_lines + 1]),
     _screenLinesSize(_lines),
+    _styles(new StylePalette()),
+    _styleLimit(MAX_STYLES),
     _scrolledLines(0),
     _lastScrolledRegion(QRect()),
     _droppedLines(0),
     _lineProperties(QVarLengthArray<LineProperty, 64>()),
+    _lineGenerations(QVector<quint64>()),
+    _lastGeneration(0),
+    _historyGeneration(0),
     _history(new HistoryScrollNone()),
+    _historyReflow(new HistoryReflow()),
+    _reflowLines(false),
+    _addedHistoryLines(0),
+    _searchIndex(new HistorySearchIndex(this)),
+    _historyLine(QVector<Character>()),
+    _graphemes(),
+    _graphemeSegments(QVector<GraphemeSegment>()),
+    _openSegmentKeys(QSet<uint>()),
+    _segmentKeyCounts(QHash<uint, int>()),
+    _graphemeLines(0),
     _cuX(0),
     _cuY(0),
     _currentForeground(CharacterColor()),
@@ -78,6 +119,7 @@ Screen::Screen(int lines, int columns):
     _effectiveForeground(CharacterColor()),
     _effectiveBackground(CharacterColor()),
     _effectiveRendition(DEFAULT_RENDITION),
+    _effectiveStyle(StylePalette::DefaultStyle),
     _lastPos(-1),
     _lastDrawnChar(0)
 {
@@ -85,6 +127,9 @@ Screen::Screen(int lines, int columns):
     for (int i = 0; i < _lines + 1; i++) {
         _lineProperties[i] = LINE_DEFAULT;
     }
+    resetLineGenerations();
+
+    _historyReflow->setHistory(_history);
 
     initTabStops();
     clearSelection();
@@ -95,6 +140,8 @@ Screen::~Screen()
 {
     delete[] _screenLines;
     delete _history;
+    delete _historyReflow;
+    delete _searchIndex;
 }
 
 void Screen::cursorUp(int n)
@@ -213,6 +260,8 @@ void Screen::deleteChars(int n)
         n = 1;
     }
 
+    compactStyles();
+
     // if cursor is beyond the end of the line there is nothing to do
     if (_cuX >= _screenLines[_cuY].count()) {
         return;
@@ -226,11 +275,12 @@ void Screen::deleteChars(int n)
     Q_ASSERT(_cuX + n <= _screenLines[_cuY].count());
 
     _screenLines[_cuY].remove(_cuX, n);
+    lineChanged(_cuY);
 
     // Append space(s) with current attributes
-    Character spaceWithCurrentAttrs(' ', _effectiveForeground,
-                                    _effectiveBackground,
-                                    _effectiveRendition, false);
+    const StylePalette::Cell spaceWithCurrentAttrs = _styles->intern(Character(' ', _effectiveForeground,
+                                                                               _effectiveBackground,
+                                                                               _effectiveRendition, false));
 
     for (int i = 0; i < n; i++) {
         _screenLines[_cuY].append(spaceWithCurrentAttrs);
@@ -247,11 +297,12 @@ void Screen::insertChars(int n)
         _screenLines[_cuY].resize(_cuX);
     }
 
-    _screenLines[_cuY].insert(_cuX, n, Character(' '));
+    _screenLines[_cuY].insert(_cuX, n, StylePalette::Cell());
 
     if (_screenLines[_cuY].count() > _columns) {
         _screenLines[_cuY].resize(_columns);
     }
+    lineChanged(_cuY);
 }
 
 void Screen::repeatChars(int n)
@@ -350,32 +401,37 @@ void Screen::resizeImage(int new_lines, int new_columns)
         return;
     }
 
-    if (_cuY > new_lines - 1) {
-        // attempt to preserve focus and _lines
-        _bottomMargin = _lines - 1; //FIXME: margin lost
-        for (int i = 0; i < _cuY - (new_lines - 1); i++) {
-            addHistLine();
-            scrollUp(0, 1);
+    const bool reflow = _reflowLines && new_columns != _columns;
+    if (reflow) {
+        reflowImage(new_lines, new_columns);
+    } else {
+        if (_cuY > new_lines - 1) {
+            // attempt to preserve focus and _lines
+            _bottomMargin = _lines - 1; //FIXME: margin lost
+            for (int i = 0; i < _cuY - (new_lines - 1); i++) {
+                addHistLine();
+                scrollUp(0, 1);
+            }
         }
-    }
 
-    // create new screen _lines and copy from old to new
+        // create new screen _lines and copy from old to new
 
-    auto newScreenLines = new ImageLine[new_lines + 1];
-    for (int i = 0; i < qMin(_lines, new_lines + 1) ; i++) {
-        newScreenLines[i] = _screenLines[i];
-    }
+        auto newScreenLines = new ImageLine[new_lines + 1];
+        for (int i = 0; i < qMin(_lines, new_lines + 1) ; i++) {
+            newScreenLines[i] = _screenLines[i];
+        }
 
-    _lineProperties.resize(new_lines + 1);
-    for (int i = _lines; (i > 0) && (i < new_lines + 1); i++) {
-        _lineProperties[i] = LINE_DEFAULT;
-    }
+        _lineProperties.resize(new_lines + 1);
+        for (int i = _lines; (i > 0) && (i < new_lines + 1); i++) {
+            _lineProperties[i] = LINE_DEFAULT;
+        }
 
-    clearSelection();
+        clearSelection();
 
-    delete[] _screenLines;
-    _screenLines = newScreenLines;
-    _screenLinesSize = new_lines;
+        delete[] _screenLines;
+        _screenLines = newScreenLines;
+        _screenLinesSize = new_lines;
+    }
 
     _lines = new_lines;
     _columns = new_columns;
@@ -387,6 +443,278 @@ void Screen::resizeImage(int new_lines, int new_columns)
     _bottomMargin = _lines - 1;
     initTabStops();
     clearSelection();
+    resetLineGenerations();
+
+    if (reflow) {
+        // only the newest lines of the history are rewrapped now, the
+        // search index keeps the lines as stored
+        const int oldHistLines = getHistLines();
+        _historyReflow->reflow(_columns, REWRAP_LINES);
+        _addedHistoryLines += getHistLines() - oldHistLines;
+    }
+}
+
+// returns the length of a line without the default characters at its end,
+// which are blanks of either of the styles every palette starts with
+static int textLength(const QVector<StylePalette::Cell> &line)
+{
+    const auto isDefault = [](const StylePalette::Cell &cell) {
+        return cell.character == ' ' && cell.extended == 0
+               && (cell.style == StylePalette::DefaultStyle || cell.style == StylePalette::BlankStyle);
+    };
+
+    int length = line.size();
+    while (length > 0 && isDefault(line[length - 1])) {
+        length--;
+    }
+    return length;
+}
+
+void Screen::reflowImage(int new_lines, int new_columns)
+{
+    clearSelection();
+
+    // the empty lines below the cursor are dropped
+    int lastLine = _cuY;
+    for (int line = _lines - 1; line > _cuY; line--) {
+        if (textLength(_screenLines[line]) > 0) {
+            lastLine = line;
+            break;
+        }
+    }
+
+    // split the lines and the lines they wrap into at the new width
+    QVector<ImageLine> rows;
+    QVector<LineProperty> rowProperties;
+    int cursorRow = 0;
+    int cursorColumn = 0;
+    int savedRow = -1;
+    int savedColumn = 0;
+
+    for (int line = 0; line <= lastLine; line++) {
+        const LineProperty properties = static_cast<LineProperty>(_lineProperties[line] & ~LINE_WRAPPED);
+        ImageLine text;
+        int cursorOffset = -1;
+        int savedOffset = -1;
+
+        forever {
+            if (line == _cuY) {
+                cursorOffset = text.size() + _cuX;
+            }
+            if (line == _savedState.cursorLine) {
+                savedOffset = text.size() + _savedState.cursorColumn;
+            }
+            if ((_lineProperties[line] & LINE_WRAPPED) == 0 || line == lastLine) {
+                break;
+            }
+            text += _screenLines[line];
+            line++;
+        }
+        text += _screenLines[line].mid(0, textLength(_screenLines[line]));
+
+        // a line which wraps into the dropped lines keeps wrapping
+        const bool wrapped = (_lineProperties[line] & LINE_WRAPPED) != 0;
+
+        // the styles tell the placeholders of double width characters
+        QVector<Character> characters(text.size());
+        for (int i = 0; i < text.size(); i++) {
+            characters[i] = _styles->character(text[i]);
+        }
+
+        // the rows past the text, which the cursor may be on, are empty
+        const QVector<int> starts = HistoryReflow::rowStarts(characters.constData(), characters.size(), new_columns);
+        const auto findRow = [&starts, new_columns](int offset, int *column) {
+            const int row = static_cast<int>(std::upper_bound(starts.constBegin(), starts.constEnd(), offset) - starts.constBegin()) - 1;
+            *column = offset - starts[row];
+            if (row == starts.size() - 1 && *column >= new_columns) {
+                const int rowsPast = *column / new_columns;
+                *column %= new_columns;
+                return row + rowsPast;
+            }
+            return row;
+        };
+
+        int rowCount = starts.size();
+        if (cursorOffset != -1) {
+            const int row = findRow(cursorOffset, &cursorColumn);
+            cursorRow = rows.size() + row;
+            rowCount = qMax(rowCount, row + 1);
+        }
+        if (savedOffset != -1) {
+            const int row = qMin(findRow(savedOffset, &savedColumn), rowCount - 1);
+            savedRow = rows.size() + row;
+        }
+
+        for (int row = 0; row < rowCount; row++) {
+            const int start = row < starts.size() ? starts[row] : text.size();
+            const int end = row < starts.size() - 1 ? starts[row + 1] : text.size();
+            rows.append(text.mid(start, end - start));
+            if (row < rowCount - 1 || wrapped) {
+                rowProperties.append(static_cast<LineProperty>(properties | LINE_WRAPPED));
+            } else {
+                rowProperties.append(properties);
+            }
+        }
+    }
+
+    // the lines which do not fit move into the history
+    const int overflow = qMax(0, rows.size() - new_lines);
+    for (int row = 0; row < overflow; row++) {
+        _screenLines[0] = rows[row];
+        _lineProperties[0] = rowProperties[row];
+        addHistLine();
+    }
+
+    auto newScreenLines = new ImageLine[new_lines + 1];
+    _lineProperties.resize(new_lines + 1);
+    for (int line = 0; line < new_lines + 1; line++) {
+        const int row = overflow + line;
+        if (line < new_lines && row < rows.size()) {
+            newScreenLines[line] = rows[row];
+            _lineProperties[line] = rowProperties[row];
+        } else {
+            _lineProperties[line] = LINE_DEFAULT;
+        }
+    }
+
+    delete[] _screenLines;
+    _screenLines = newScreenLines;
+    _screenLinesSize = new_lines;
+
+    _cuY = qMax(0, cursorRow - overflow);
+    _cuX = cursorColumn;
+
+    // DECRC restores the saved cursor to the cell it was saved at, the
+    // lines below the text keep their distance to it
+    if (savedRow == -1) {
+        savedRow = rows.size() + _savedState.cursorLine - lastLine - 1;
+        savedColumn = _savedState.cursorColumn;
+    }
+    _savedState.cursorLine = qMax(0, savedRow - overflow);
+    _savedState.cursorColumn = qMin(savedColumn, new_columns - 1);
+}
+
+uint Screen::addExtendedChar(const uint *unicodePoints, ushort length)
+{
+    const uint key = _graphemes.add(unicodePoints, length);
+    if (key != 0 || !_graphemes.shouldCompact()) {
+        return key;
+    }
+
+    _graphemes.compact(usedExtendedChars());
+    return _graphemes.add(unicodePoints, length);
+}
+
+QSet<uint> Screen::usedExtendedChars() const
+{
+    // the keys used by the history are known without reading it
+    QSet<uint> result = _openSegmentKeys;
+    for (auto it = _segmentKeyCounts.constBegin(); it != _segmentKeyCounts.constEnd(); ++it) {
+        result << it.key();
+    }
+
+    for (int i = 0; i < _lines; ++i) {
+        const ImageLine &il = _screenLines[i];
+        for (int j = 0; j < il.length(); ++j) {
+            if (il[j].extended != 0) {
+                result << il[j].character;
+            }
+        }
+    }
+    return result;
+}
+
+void Screen::addHistoryGraphemes(const QVector<Character> &line)
+{
+    if (_graphemeSegments.isEmpty() || _graphemeSegments.last().lineCount == GRAPHEME_SEGMENT_LINES) {
+        _graphemeSegments.append({_graphemeLines, 0, QVector<uint>()});
+    }
+
+    for (const Character &c : line) {
+        if ((c.rendition & RE_EXTENDED_CHAR) != 0) {
+            _openSegmentKeys << c.character;
+        }
+    }
+
+    GraphemeSegment &segment = _graphemeSegments.last();
+    segment.lineCount++;
+    _graphemeLines++;
+
+    // the keys of a segment are counted once it is complete
+    if (segment.lineCount == GRAPHEME_SEGMENT_LINES) {
+        segment.keys.reserve(_openSegmentKeys.size());
+        for (const uint key : qAsConst(_openSegmentKeys)) {
+            segment.keys.append(key);
+            _segmentKeyCounts[key]++;
+        }
+        _openSegmentKeys.clear();
+    }
+
+    // forget the segments which left the history, the next compaction
+    // drops their sequences unless other lines still use them
+    const qint64 firstLine = _graphemeLines - _history->getLines();
+    int dropped = 0;
+    while (dropped < _graphemeSegments.size() - 1
+           && _graphemeSegments[dropped].firstLine + _graphemeSegments[dropped].lineCount <= firstLine) {
+        for (const uint key : qAsConst(_graphemeSegments[dropped].keys)) {
+            const auto count = _segmentKeyCounts.find(key);
+            if (--count.value() == 0) {
+                _segmentKeyCounts.erase(count);
+            }
+        }
+        dropped++;
+    }
+    if (dropped > 0) {
+        _graphemeSegments.remove(0, dropped);
+    }
+}
+
+void Screen::resetHistoryGraphemes()
+{
+    _graphemeSegments.clear();
+    _openSegmentKeys.clear();
+    _segmentKeyCounts.clear();
+    _graphemeLines = 0;
+
+    // the lines copied from the previous history are read once
+    QVector<Character> cells;
+    for (int line = 0; line < _history->getLines(); ++line) {
+        cells.resize(_history->getLineLen(line));
+        _history->getCells(line, 0, cells.size(), cells.data());
+        addHistoryGraphemes(cells);
+    }
+}
+
+void Screen::setReflowLines(bool enable)
+{
+    _reflowLines = enable;
+}
+
+bool Screen::rewrapHistory(int maxLines)
+{
+    if (!_historyReflow->hasOlderLines()) {
+        return false;
+    }
+
+    const int addedLines = _historyReflow->rewrapOlderLines(maxLines);
+    _historyGeneration++;
+    if (addedLines != 0) {
+        // the older lines changed above all other lines, which move
+        // like lines dropped from the history
+        _droppedLines -= addedLines;
+        _addedHistoryLines += addedLines;
+
+        if (_selBegin != -1) {
+            _selBegin += addedLines * _columns;
+            _selTopLeft += addedLines * _columns;
+            _selBottomRight += addedLines * _columns;
+            if (_selTopLeft < 0) {
+                clearSelection();
+            }
+        }
+    }
+
+    return _historyReflow->hasOlderLines();
 }
 
 void Screen::setDefaultMargins()
@@ -416,13 +744,36 @@ void Screen::setDefaultMargins()
    in addition to a different color.
    */
 
-void Screen::reverseRendition(Character& p) const
+StylePalette::Cell Screen::reverseRendition(const StylePalette::Cell &cell) const
 {
+    Character p = _styles->character(cell);
     CharacterColor f = p.foregroundColor;
     CharacterColor b = p.backgroundColor;
 
     p.foregroundColor = b;
     p.backgroundColor = f; //p->r &= ~RE_TRANSPARENT;
+    return _styles->intern(p);
+}
+
+void Screen::compactStyles()
+{
+    if (_styles->count() <= _styleLimit) {
+        return;
+    }
+
+    // the windows keep the old palette for the images they have, and copy
+    // all lines again once they see the new one
+    QSharedPointer<StylePalette> styles(new StylePalette());
+    for (int line = 0; line < _lines + 1; line++) {
+        for (StylePalette::Cell &cell : _screenLines[line]) {
+            cell = styles->intern(_styles->character(cell));
+        }
+    }
+    _styles = styles;
+    updateEffectiveRendition();
+
+    // a screen which shows many styles is not compacted again too soon
+    _styleLimit = qMax(MAX_STYLES, 2 * _styles->count());
 }
 
 void Screen::updateEffectiveRendition()
@@ -445,66 +796,86 @@ void Screen::updateEffectiveRendition()
             _effectiveForeground.setFaint();
         }
     }
+
+    _effectiveStyle = _styles->intern(Character(' ', _effectiveForeground, _effectiveBackground,
+                                                _effectiveRendition, true)).style;
 }
 
-void Screen::copyFromHistory(Character* dest, int startLine, int count) const
+void Screen::copyFromHistory(StylePalette::Cell* dest, int startLine, int count) const
 {
-    Q_ASSERT(startLine >= 0 && count > 0 && startLine + count <= _history->getLines());
+    Q_ASSERT(startLine >= 0 && count > 0 && startLine + count <= _historyReflow->getLines());
+
+    // the history stores whole Characters, their styles are added to the
+    // palette of the screen
+    QVector<Character> characters(_columns);
 
     for (int line = startLine; line < startLine + count; line++) {
-        const int length = qMin(_columns, _history->getLineLen(line));
-        const int destLineOffset  = (line - startLine) * _columns;
+        const int length = qMin(_columns, _historyReflow->getLineLen(line));
+        StylePalette::Cell *destLine = dest + (line - startLine) * _columns;
 
-        _history->getCells(line, 0, length, dest + destLineOffset);
+        _historyReflow->getCells(line, 0, length, characters.data());
 
-        for (int column = length; column < _columns; column++) {
-            dest[destLineOffset + column] = Screen::DefaultChar;
+        for (int column = 0; column < length; column++) {
+            destLine[column] = _styles->intern(characters[column]);
         }
+        std::fill(destLine + length, destLine + _columns, BLANK_CELL);
 
         // invert selected text
-        if (_selBegin != -1) {
-            for (int column = 0; column < _columns; column++) {
-                if (isSelected(column, line)) {
-                    reverseRendition(dest[destLineOffset + column]);
-                }
+        int first = 0;
+        int last = 0;
+        if (selectedColumns(line, first, last)) {
+            for (int column = first; column <= last; column++) {
+                destLine[column] = reverseRendition(destLine[column]);
             }
         }
     }
 }
 
-void Screen::copyFromScreen(Character* dest , int startLine , int count) const
+void Screen::copyFromScreen(StylePalette::Cell* dest , int startLine , int count) const
 {
     Q_ASSERT(startLine >= 0 && count > 0 && startLine + count <= _lines);
 
     for (int line = startLine; line < (startLine + count) ; line++) {
-        int srcLineStartIndex  = line * _columns;
-        int destLineStartIndex = (line - startLine) * _columns;
+        const ImageLine &screenLine = _screenLines[line];
+        const int length = qMin(_columns, screenLine.size());
+        StylePalette::Cell *destLine = dest + (line - startLine) * _columns;
 
-        for (int column = 0; column < _columns; column++) {
-            int srcIndex = srcLineStartIndex + column;
-            int destIndex = destLineStartIndex + column;
+        std::copy(screenLine.constBegin(), screenLine.constBegin() + length, destLine);
+        std::fill(destLine + length, destLine + _columns, BLANK_CELL);
 
-            dest[destIndex] = _screenLines[srcIndex / _columns].value(srcIndex % _columns, Screen::DefaultChar);
-
-            // invert selected text
-            if (_selBegin != -1 && isSelected(column, line + _history->getLines())) {
-                reverseRendition(dest[destIndex]);
+        // invert selected text
+        int first = 0;
+        int last = 0;
+        if (selectedColumns(line + _historyReflow->getLines(), first, last)) {
+            for (int column = first; column <= last; column++) {
+                destLine[column] = reverseRendition(destLine[column]);
             }
         }
     }
 }
 
 void Screen::getImage(Character* dest, int size, int startLine, int endLine) const
+{
+    QVector<StylePalette::Cell> cells(size);
+    getImage(cells.data(), size, startLine, endLine);
+
+    const int count = (endLine - startLine + 1) * _columns;
+    for (int i = 0; i < count; i++) {
+        dest[i] = _styles->character(cells[i]);
+    }
+}
+
+void Screen::getImage(StylePalette::Cell* dest, int size, int startLine, int endLine) const
 {
     Q_ASSERT(startLine >= 0);
-    Q_ASSERT(endLine >= startLine && endLine < _history->getLines() + _lines);
+    Q_ASSERT(endLine >= startLine && endLine < _historyReflow->getLines() + _lines);
 
     const int mergedLines = endLine - startLine + 1;
 
     Q_ASSERT(size >= mergedLines * _columns);
     Q_UNUSED(size);
 
-    const int linesInHistoryBuffer = qBound(0, _history->getLines() - startLine, mergedLines);
+    const int linesInHistoryBuffer = qBound(0, _historyReflow->getLines() - startLine, mergedLines);
     const int linesInScreenBuffer = mergedLines - linesInHistoryBuffer;
 
     // copy _lines from history buffer
@@ -515,32 +886,67 @@ void Screen::getImage(Character* dest, int size, int startLine, int endLine) con
     // copy _lines from screen buffer
     if (linesInScreenBuffer > 0) {
         copyFromScreen(dest + linesInHistoryBuffer * _columns,
-                       startLine + linesInHistoryBuffer - _history->getLines(),
+                       startLine + linesInHistoryBuffer - _historyReflow->getLines(),
                        linesInScreenBuffer);
     }
 
     // invert display when in screen mode
     if (getMode(MODE_Screen)) {
         for (int i = 0; i < mergedLines * _columns; i++) {
-            reverseRendition(dest[i]); // for reverse display
+            dest[i] = reverseRendition(dest[i]); // for reverse display
         }
     }
 
-    int visX = qMin(_cuX, _columns - 1);
     // mark the character at the current cursor position
-    int cursorIndex = loc(visX, _cuY + linesInHistoryBuffer);
-    if (getMode(MODE_Cursor) && cursorIndex < _columns * mergedLines) {
-        dest[cursorIndex].rendition |= RE_CURSOR;
+    const int cursorLine = _historyReflow->getLines() + _cuY - startLine;
+    if (getMode(MODE_Cursor) && cursorLine >= 0 && cursorLine < mergedLines) {
+        StylePalette::Cell &cursor = dest[loc(qMin(_cuX, _columns - 1), cursorLine)];
+        Character character = _styles->character(cursor);
+        character.rendition |= RE_CURSOR;
+        cursor = _styles->intern(character);
     }
 }
 
+QVector<quint64> Screen::getLineGenerations(int startLine, int endLine) const
+{
+    Q_ASSERT(startLine >= 0);
+    Q_ASSERT(endLine >= startLine && endLine < _historyReflow->getLines() + _lines);
+
+    QVector<quint64> result(endLine - startLine + 1, 0);
+
+    // the whole image is inverted in screen mode
+    if (getMode(MODE_Screen)) {
+        return result;
+    }
+
+    const int histLines = _historyReflow->getLines();
+    const qint64 firstHistoryLine = _addedHistoryLines - histLines;
+    const quint64 historyGeneration = HISTORY_GENERATION | (_historyGeneration << HISTORY_LINE_BITS);
+    for (int line = startLine; line <= endLine; line++) {
+        if (line < histLines) {
+            result[line - startLine] = historyGeneration | (quint64(firstHistoryLine + line) & HISTORY_LINE_MASK);
+        } else {
+            result[line - startLine] = _lineGenerations[line - histLines];
+        }
+    }
+
+    if (_selBegin != -1) {
+        const int selectionEnd = qMin(endLine, _selBottomRight / _columns);
+        for (int line = qMax(startLine, _selTopLeft / _columns); line <= selectionEnd; line++) {
+            result[line - startLine] = 0;
+        }
+    }
+
+    return result;
+}
+
 QVector<LineProperty> Screen::getLineProperties(int startLine , int endLine) const
 {
     Q_ASSERT(startLine >= 0);
-    Q_ASSERT(endLine >= startLine && endLine < _history->getLines() + _lines);
+    Q_ASSERT(endLine >= startLine && endLine < _historyReflow->getLines() + _lines);
 
     const int mergedLines = endLine - startLine + 1;
-    const int linesInHistory = qBound(0, _history->getLines() - startLine, mergedLines);
+    const int linesInHistory = qBound(0, _historyReflow->getLines() - startLine, mergedLines);
     const int linesInScreen = mergedLines - linesInHistory;
 
     QVector<LineProperty> result(mergedLines);
@@ -549,14 +955,14 @@ QVector<LineProperty> Screen::getLineProperties(int startLine , int endLine) con
     // copy properties for _lines in history
     for (int line = startLine; line < startLine + linesInHistory; line++) {
         //TODO Support for line properties other than wrapped _lines
-        if (_history->isWrappedLine(line)) {
+        if (_historyReflow->isWrappedLine(line)) {
             result[index] = static_cast<LineProperty>(result[index] | LINE_WRAPPED);
         }
         index++;
     }
 
     // copy properties for _lines in screen buffer
-    const int firstScreenLine = startLine + linesInHistory - _history->getLines();
+    const int firstScreenLine = startLine + linesInHistory - _historyReflow->getLines();
     for (int line = firstScreenLine; line < firstScreenLine + linesInScreen; line++) {
         result[index] = _lineProperties[line];
         index++;
@@ -601,6 +1007,7 @@ void Screen::backspace()
 
     if (_screenLines[_cuY].size() < _cuX + 1) {
         _screenLines[_cuY].resize(_cuX + 1);
+        lineChanged(_cuY);
     }
 }
 
@@ -676,7 +1083,7 @@ void Screen::checkSelection(int from, int to)
     if (_selBegin == -1) {
         return;
     }
-    const int scr_TL = loc(0, _history->getLines());
+    const int scr_TL = loc(0, _historyReflow->getLines());
     //Clear entire selection if it overlaps region [from, to]
     if ((_selBottomRight >= (from + scr_TL)) && (_selTopLeft <= (to + scr_TL))) {
         clearSelection();
@@ -690,6 +1097,8 @@ void Screen::displayCharacter(uint c)
     // We indicate the fact that a newline has to be triggered by
     // putting the cursor one right to the last column of the screen.
 
+    compactStyles();
+
     int w = Character::width(c);
 
     if (w < 0) {
@@ -718,16 +1127,20 @@ void Screen::displayCharacter(uint c)
             if (charToCombineWithX < 0) {
                 return;
             }
-        } while(!_screenLines[charToCombineWithY][charToCombineWithX].isRealCharacter);
+        } while(!_styles->style(_screenLines[charToCombineWithY][charToCombineWithX].style).isRealCharacter);
 
-        Character& currentChar = _screenLines[charToCombineWithY][charToCombineWithX];
-        if ((currentChar.rendition & RE_EXTENDED_CHAR) == 0) {
+        StylePalette::Cell& currentChar = _screenLines[charToCombineWithY][charToCombineWithX];
+        lineChanged(charToCombineWithY);
+        if (currentChar.extended == 0) {
             const uint chars[2] = { currentChar.character, c };
-            currentChar.rendition |= RE_EXTENDED_CHAR;
-            currentChar.character = ExtendedCharTable::instance.createExtendedChar(chars, 2);
+            const uint key = addExtendedChar(chars, 2);
+            if (key != 0) {
+                currentChar.extended = 1;
+                currentChar.character = key;
+            }
         } else {
             ushort extendedCharLength;
-            const uint* oldChars = ExtendedCharTable::instance.lookupExtendedChar(currentChar.character, extendedCharLength);
+            const uint* oldChars = GraphemePool::lookup(currentChar.character, extendedCharLength);
             Q_ASSERT(oldChars);
             if (((oldChars) != nullptr) && extendedCharLength < 3) {
                 Q_ASSERT(extendedCharLength > 1);
@@ -735,7 +1148,10 @@ void Screen::displayCharacter(uint c)
                 auto chars = new uint[extendedCharLength + 1];
                 memcpy(chars, oldChars, sizeof(uint) * extendedCharLength);
                 chars[extendedCharLength] = c;
-                currentChar.character = ExtendedCharTable::instance.createExtendedChar(chars, extendedCharLength + 1);
+                const uint key = addExtendedChar(chars, extendedCharLength + 1);
+                if (key != 0) {
+                    currentChar.character = key;
+                }
                 delete[] chars;
             }
         }
@@ -765,35 +1181,84 @@ void Screen::displayCharacter(uint c)
     // check if selection is still valid.
     checkSelection(_lastPos, _lastPos);
 
-    Character& currentChar = _screenLines[_cuY][_cuX];
-
-    currentChar.character = c;
-    currentChar.foregroundColor = _effectiveForeground;
-    currentChar.backgroundColor = _effectiveBackground;
-    currentChar.rendition = _effectiveRendition;
-    currentChar.isRealCharacter = true;
+    lineChanged(_cuY);
+    _screenLines[_cuY][_cuX] = StylePalette::Cell(c, _effectiveStyle);
 
     _lastDrawnChar = c;
 
     int i = 0;
     const int newCursorX = _cuX + w--;
-    while (w != 0) {
-        i++;
+    if (w != 0) {
+        // the placeholders of a wide character are not real characters
+        const StylePalette::Cell placeholder = _styles->intern(Character(0, _effectiveForeground,
+                                                                         _effectiveBackground,
+                                                                         _effectiveRendition, false));
+        while (w != 0) {
+            i++;
+
+            if (_screenLines[_cuY].size() < _cuX + i + 1) {
+                _screenLines[_cuY].resize(_cuX + i + 1);
+            }
+
+            _screenLines[_cuY][_cuX + i] = placeholder;
 
-        if (_screenLines[_cuY].size() < _cuX + i + 1) {
-            _screenLines[_cuY].resize(_cuX + i + 1);
+            w--;
         }
+    }
+    _cuX = newCursorX;
+}
 
-        Character& ch = _screenLines[_cuY][_cuX + i];
-        ch.character = 0;
-        ch.foregroundColor = _effectiveForeground;
-        ch.backgroundColor = _effectiveBackground;
-        ch.rendition = _effectiveRendition;
-        ch.isRealCharacter = false;
+void Screen::displayCharacters(const uint *chars, int count)
+{
+    compactStyles();
+
+    int i = 0;
+    while (i < count) {
+        // everything but single-width characters in replace mode
+        // takes the general path
+        if (getMode(MODE_Insert) || Character::width(chars[i]) != 1) {
+            displayCharacter(chars[i]);
+            i++;
+            continue;
+        }
 
-        w--;
+        // wrap before putting the character, see displayCharacter()
+        if (_cuX + 1 > _columns) {
+            if (getMode(MODE_Wrap)) {
+                _lineProperties[_cuY] = static_cast<LineProperty>(_lineProperties[_cuY] | LINE_WRAPPED);
+                nextLine();
+            } else {
+                _cuX = qMax(_columns - 1, 0);
+            }
+        }
+
+        // take as many single-width characters as fit on this line
+        const int room = _columns - _cuX;
+        int end = i + 1;
+        while (end < count && end - i < room && Character::width(chars[end]) == 1) {
+            end++;
+        }
+        const int n = end - i;
+
+        ImageLine &line = _screenLines[_cuY];
+        if (line.size() < _cuX + n) {
+            line.resize(_cuX + n);
+        }
+
+        // check if selection is still valid.
+        checkSelection(loc(_cuX, _cuY), loc(_cuX + n - 1, _cuY));
+
+        lineChanged(_cuY);
+        StylePalette::Cell *data = line.data() + _cuX;
+        for (int j = 0; j < n; j++) {
+            data[j] = StylePalette::Cell(chars[i + j], _effectiveStyle);
+        }
+
+        _cuX += n;
+        _lastPos = loc(_cuX - 1, _cuY);
+        _lastDrawnChar = chars[end - 1];
+        i = end;
     }
-    _cuX = newCursorX;
 }
 
 int Screen::scrolledLines() const
@@ -916,7 +1381,7 @@ int Screen::getCursorY() const
 
 void Screen::clearImage(int loca, int loce, char c)
 {
-    const int scr_TL = loc(0, _history->getLines());
+    const int scr_TL = loc(0, _historyReflow->getLines());
     //FIXME: check positions
 
     //Clear entire selection if it overlaps region to be moved...
@@ -927,7 +1392,10 @@ void Screen::clearImage(int loca, int loce, char c)
     const int topLine = loca / _columns;
     const int bottomLine = loce / _columns;
 
+    compactStyles();
+
     Character clearCh(uint(c), _currentForeground, _currentBackground, DEFAULT_RENDITION, false);
+    const StylePalette::Cell clearCell = _styles->intern(clearCh);
 
     //if the character being used to clear the area is the same as the
     //default character, the affected _lines can simply be shrunk.
@@ -935,11 +1403,12 @@ void Screen::clearImage(int loca, int loce, char c)
 
     for (int y = topLine; y <= bottomLine; y++) {
         _lineProperties[y] = 0;
+        lineChanged(y);
 
         const int endCol = (y == bottomLine) ? loce % _columns : _columns - 1;
         const int startCol = (y == topLine) ? loca % _columns : 0;
 
-        QVector<Character>& line = _screenLines[y];
+        ImageLine& line = _screenLines[y];
 
         if (isDefaultCh && endCol == _columns - 1) {
             line.resize(startCol);
@@ -948,9 +1417,9 @@ void Screen::clearImage(int loca, int loce, char c)
                 line.resize(endCol + 1);
             }
 
-            Character* data = line.data();
+            StylePalette::Cell* data = line.data();
             for (int i = startCol; i <= endCol; i++) {
-                data[i] = clearCh;
+                data[i] = clearCell;
             }
         }
     }
@@ -971,11 +1440,13 @@ void Screen::moveImage(int dest, int sourceBegin, int sourceEnd)
         for (int i = 0; i <= lines; i++) {
             _screenLines[(dest / _columns) + i ] = _screenLines[(sourceBegin / _columns) + i ];
             _lineProperties[(dest / _columns) + i] = _lineProperties[(sourceBegin / _columns) + i];
+            _lineGenerations[(dest / _columns) + i] = _lineGenerations[(sourceBegin / _columns) + i];
         }
     } else {
         for (int i = lines; i >= 0; i--) {
             _screenLines[(dest / _columns) + i ] = _screenLines[(sourceBegin / _columns) + i ];
             _lineProperties[(dest / _columns) + i] = _lineProperties[(sourceBegin / _columns) + i];
+            _lineGenerations[(dest / _columns) + i] = _lineGenerations[(sourceBegin / _columns) + i];
         }
     }
 
@@ -991,7 +1462,7 @@ void Screen::moveImage(int dest, int sourceBegin, int sourceEnd)
     if (_selBegin != -1) {
         const bool beginIsTL = (_selBegin == _selTopLeft);
         const int diff = dest - sourceBegin; // Scroll by this amount
-        const int scr_TL = loc(0, _history->getLines());
+        const int scr_TL = loc(0, _historyReflow->getLines());
         const int srca = sourceBegin + scr_TL; // Translate index from screen to global
         const int srce = sourceEnd + scr_TL; // Translate index from screen to global
         const int desta = srca + diff;
@@ -1185,6 +1656,22 @@ void Screen::setSelectionEnd(const int x, const int y)
     }
 }
 
+bool Screen::selectedColumns(int line, int &first, int &last) const
+{
+    if (_selBegin == -1 || line < _selTopLeft / _columns || line > _selBottomRight / _columns) {
+        return false;
+    }
+
+    if (_blockSelectionMode) {
+        first = _selTopLeft % _columns;
+        last = _selBottomRight % _columns;
+    } else {
+        first = line == _selTopLeft / _columns ? _selTopLeft % _columns : 0;
+        last = line == _selBottomRight / _columns ? _selBottomRight % _columns : _columns - 1;
+    }
+    return first <= last;
+}
+
 bool Screen::isSelected(const int x, const int y) const
 {
     bool columnInSelection = true;
@@ -1306,8 +1793,8 @@ int Screen::copyLineToStream(int line ,
     LineProperty currentLineProperties = 0;
 
     //determine if the line is in the history buffer or the screen image
-    if (line < _history->getLines()) {
-        const int lineLength = _history->getLineLen(line);
+    if (line < _historyReflow->getLines()) {
+        const int lineLength = _historyReflow->getLineLen(line);
 
         // ensure that start position is before end of line
         start = qMin(start, qMax(0, lineLength - 1));
@@ -1324,11 +1811,11 @@ int Screen::copyLineToStream(int line ,
         // safety checks
         Q_ASSERT(start >= 0);
         Q_ASSERT(count >= 0);
-        Q_ASSERT((start + count) <= _history->getLineLen(line));
+        Q_ASSERT((start + count) <= _historyReflow->getLineLen(line));
 
-        _history->getCells(line, start, count, characterBuffer);
+        _historyReflow->getCells(line, start, count, characterBuffer);
 
-        if (_history->isWrappedLine(line)) {
+        if (_historyReflow->isWrappedLine(line)) {
             currentLineProperties |= LINE_WRAPPED;
         }
     } else {
@@ -1338,13 +1825,13 @@ int Screen::copyLineToStream(int line ,
 
         Q_ASSERT(count >= 0);
 
-        int screenLine = line - _history->getLines();
+        int screenLine = line - _historyReflow->getLines();
 
         Q_ASSERT(screenLine <= _screenLinesSize);
 
         screenLine = qMin(screenLine, _screenLinesSize);
 
-        Character* data = _screenLines[screenLine].data();
+        const StylePalette::Cell* data = _screenLines[screenLine].constData();
         int length = _screenLines[screenLine].count();
 
         // Don't remove end spaces in lines that wrap
@@ -1363,7 +1850,7 @@ int Screen::copyLineToStream(int line ,
 
         //retrieve line from screen image
         for (int i = start; i < qMin(start + count, length); i++) {
-            characterBuffer[i - start] = data[i];
+            characterBuffer[i - start] = _styles->character(data[i]);
         }
 
         // count cannot be any greater than length
@@ -1422,19 +1909,38 @@ void Screen::addHistLine()
     // we have to take care about scrolling, too...
 
     if (hasScroll()) {
-        const int oldHistLines = _history->getLines();
+        const int oldHistLines = getHistLines();
+        const int oldStoredLines = _history->getLines();
+
+        // the history stores whole Characters
+        const ImageLine &line = _screenLines[0];
+        _historyLine.resize(line.size());
+        for (int i = 0; i < line.size(); i++) {
+            _historyLine[i] = _styles->character(line[i]);
+        }
 
-        _history->addCellsVector(_screenLines[0]);
-        _history->addLine((_lineProperties[0] & LINE_WRAPPED) != 0);
+        const bool wrapped = (_lineProperties[0] & LINE_WRAPPED) != 0;
+        _history->addCellsVector(_historyLine);
+        _history->addLine(wrapped);
+        _historyReflow->lineAdded(oldStoredLines + 1 - _history->getLines());
+        _searchIndex->addLine(_historyLine.constData(), _historyLine.size(), wrapped, _history->getLines());
+        addHistoryGraphemes(_historyLine);
+        _addedHistoryLines++;
 
-        const int newHistLines = _history->getLines();
+        const int newHistLines = getHistLines();
 
         const bool beginIsTL = (_selBegin == _selTopLeft);
 
         // If the history is full, increment the count
         // of dropped _lines
-        if (newHistLines == oldHistLines) {
-            _droppedLines++;
+        if (newHistLines <= oldHistLines) {
+            _droppedLines += oldHistLines - newHistLines + 1;
+        }
+
+        // Histories which drop a block of lines at once move the
+        // selection too far, don't keep it
+        if (newHistLines < oldHistLines) {
+            clearSelection();
         }
 
         // Adjust selection for the new point of reference
@@ -1474,9 +1980,18 @@ void Screen::addHistLine()
     }
 }
 
+void Screen::resetLineGenerations()
+{
+    _lineGenerations.resize(_lines + 1);
+    for (int line = 0; line < _lines + 1; line++) {
+        lineChanged(line);
+    }
+    _historyGeneration++;
+}
+
 int Screen::getHistLines() const
 {
-    return _history->getLines();
+    return _historyReflow->getLines();
 }
 
 void Screen::setScroll(const HistoryType& t , bool copyPreviousScroll)
@@ -1490,6 +2005,27 @@ void Screen::setScroll(const HistoryType& t , bool copyPreviousScroll)
         _history = t.scroll(nullptr);
         delete oldScroll;
     }
+
+    // the copied lines are stored at the widths they had when they were added
+    _historyReflow->setHistory(_history);
+    if (_reflowLines) {
+        _historyReflow->reflow(_columns, REWRAP_LINES);
+    }
+
+    _addedHistoryLines = getHistLines();
+    _historyGeneration++;
+    _searchIndex->reset(_history->getLines());
+    resetHistoryGraphemes();
+}
+
+HistorySearchIndex *Screen::searchIndex()
+{
+    return _searchIndex;
+}
+
+void Screen::presentedHistoryLines(int storedLine, int *first, int *last) const
+{
+    _historyReflow->presentedLines(storedLine, first, last);
 }
 
 bool Screen::hasScroll() const
@@ -1510,9 +2046,7 @@ void Screen::setLineProperty(LineProperty property , bool enable)
         _lineProperties[_cuY] = static_cast<LineProperty>(_lineProperties[_cuY] & ~property);
     }
 }
-void Screen::fillWithDefaultChar(Character* dest, int count)
+void Screen::fillWithDefaultChar(StylePalette::Cell* dest, int count)
 {
-    for (int i = 0; i < count; i++) {
-        dest[i] = Screen::DefaultChar;
-    }
+    std::fill(dest, dest + count, BLANK_CELL);
 }
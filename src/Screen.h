@@ -24,14 +24,18 @@
 #define SCREEN_H
 
 // Qt
+#include <QHash>
 #include <QRect>
 #include <QSet>
+#include <QSharedPointer>
 #include <QVector>
 #include <QBitArray>
 #include <QVarLengthArray>
 
 // Konsole
 #include "Character.h"
+#include "GraphemePool.h"
+#include "StylePalette.h"
 
 #define MODE_Origin    0
 #define MODE_Wrap      1
@@ -46,6 +50,8 @@ class TerminalCharacterDecoder;
 class TerminalDisplay;
 class HistoryType;
 class HistoryScroll;
+class HistoryReflow;
+class HistorySearchIndex;
 
 /**
     \brief An image of characters with associated attributes.
@@ -69,6 +75,10 @@ class HistoryScroll;
     setSelectionStart() and setSelectionEnd().  The selected text can be retrieved
     using selectedText().  When getImage() is used to retrieve the visible image,
     characters which are part of the selection have their colors inverted.
+
+    The cells of the screen store the IDs of their styles in the palette
+    returned by styles(), which the windows and the display widget share,
+    so that they copy and compare cells of half the size of a Character.
 */
 class Screen
 {
@@ -362,30 +372,89 @@ public:
      */
     void displayCharacter(uint c);
 
+    /**
+     * Displays @p count characters from @p chars starting at the current cursor
+     * position, with the current rendition.  This has the same effect as calling
+     * displayCharacter() for each of them, but runs of single-width characters
+     * are written to each line in one go.
+     */
+    void displayCharacters(const uint *chars, int count);
+
     /**
      * Resizes the image to a new fixed size of @p new_lines by @p new_columns.
      * In the case that @p new_columns is smaller than the current number of columns,
      * existing lines are not truncated.  This prevents characters from being lost
      * if the terminal display is resized smaller and then larger again.
      *
+     * If reflowing lines is enabled, see setReflowLines(), and the number of
+     * columns changes, wrapped lines are rewrapped at the new width instead.
+     * Lines which no longer fit on the screen move into the history.  The
+     * newest lines of the history are rewrapped at once, the older ones by
+     * rewrapHistory().
+     *
      * The top and bottom margins are reset to the top and bottom of the new
      * screen size.  Tab stops are also reset and the current selection is
      * cleared.
      */
     void resizeImage(int new_lines, int new_columns);
 
+    /**
+     * Sets whether lines are rewrapped when the number of columns changes.
+     * This is off by default, programs which use the whole screen redraw
+     * it themselves.
+     */
+    void setReflowLines(bool enable);
+
+    /**
+     * Rewraps at least @p maxLines of the history lines which have not been
+     * rewrapped to the width of the screen since it was resized, if there
+     * are as many.  Returns true if lines are left to be rewrapped.
+     *
+     * The number of history lines may change, this is reported like lines
+     * dropped from the history, see droppedLines().
+     */
+    bool rewrapHistory(int maxLines);
+
     /**
      * Returns the current screen image.
-     * The result is an array of Characters of size [getLines()][getColumns()] which
-     * must be freed by the caller after use.
+     * The result is an array of cells of size [getLines()][getColumns()] which
+     * must be freed by the caller after use.  The styles of the cells are
+     * in the palette returned by styles().
      *
-     * @param dest Buffer to copy the characters into
-     * @param size Size of @p dest in Characters
+     * @param dest Buffer to copy the cells into
+     * @param size Size of @p dest in cells
      * @param startLine Index of first line to copy
      * @param endLine Index of last line to copy
      */
+    void getImage(StylePalette::Cell *dest, int size, int startLine, int endLine) const;
+
+    /** Like the above, but returns the image as Characters. */
     void getImage(Character *dest, int size, int startLine, int endLine) const;
 
+    /**
+     * Returns the palette of the styles of the cells on the screen and of
+     * the images returned by getImage().  The screen replaces it with a new
+     * one when it has grown too large, the old one stays valid for the
+     * images which use it.
+     */
+    QSharedPointer<const StylePalette> styles() const
+    {
+        return _styles;
+    }
+
+    /**
+     * Returns the generations of the lines from @p startLine to @p endLine,
+     * numbered like in getImage().
+     *
+     * A line keeps its generation as long as its image stays the same, also
+     * when it scrolls within the screen or the history, so lines with the
+     * same generation have the same image and an image only needs to copy
+     * the lines whose generation it has not seen yet.  The cursor is not
+     * covered, and lines which are inverted because of the selection or
+     * the screen mode have the generation 0, which is never the same.
+     */
+    QVector<quint64> getLineGenerations(int startLine, int endLine) const;
+
     /**
      * Returns the additional attributes associated with lines in the image.
      * The most important attribute is LINE_WRAPPED which specifies that the
@@ -408,6 +477,22 @@ public:
 
     /** Return the number of lines in the history buffer. */
     int getHistLines() const;
+    /**
+     * Returns the number of lines added to the history buffer since it was
+     * set with setScroll(), including the lines it has dropped since.
+     * When the history is rewrapped, this changes along with getHistLines().
+     */
+    qint64 addedHistoryLines() const
+    {
+        return _addedHistoryLines;
+    }
+    /** Returns the index used to search the history, see HistorySearchIndex. */
+    HistorySearchIndex *searchIndex();
+    /**
+     * Returns in @p first and @p last the lines of the history which show
+     * the line @p storedLine as the history stores it, see HistoryReflow.
+     */
+    void presentedHistoryLines(int storedLine, int *first, int *last) const;
     /**
      * Sets the type of storage used to keep lines in the history.
      * If @p copyPreviousScroll is true then the contents of the previous
@@ -567,9 +652,9 @@ public:
 
     /**
       * Fills the buffer @p dest with @p count instances of the default (ie. blank)
-      * Character style.
+      * Character style, which has the same ID in every palette.
       */
-    static void fillWithDefaultChar(Character *dest, int count);
+    static void fillWithDefaultChar(StylePalette::Cell *dest, int count);
 
     void setCurrentTerminalDisplay(TerminalDisplay *display)
     {
@@ -581,19 +666,8 @@ public:
         return _currentTerminalDisplay;
     }
 
-    QSet<uint> usedExtendedChars() const
-    {
-        QSet<uint> result;
-        for (int i = 0; i < _lines; ++i) {
-            const ImageLine &il = _screenLines[i];
-            for (int j = 0; j < il.length(); ++j) {
-                if (il[j].rendition & RE_EXTENDED_CHAR) {
-                    result << il[j].character;
-                }
-            }
-        }
-        return result;
-    }
+    /** Returns the keys of the extended characters on the screen and in the history. */
+    QSet<uint> usedExtendedChars() const;
 
     static const Character DefaultChar;
 
@@ -633,31 +707,62 @@ private:
 
     void addHistLine();
 
+    // gives a new generation to a line of the screen, see getLineGenerations()
+    void lineChanged(int line)
+    {
+        _lineGenerations[line] = ++_lastGeneration;
+    }
+    // gives new generations to all lines of the screen and the history
+    void resetLineGenerations();
+
+    // rewraps the lines of the screen at a new width, see resizeImage()
+    void reflowImage(int new_lines, int new_columns);
+
+    // adds a sequence to _graphemes, which is compacted when it is full
+    uint addExtendedChar(const uint *unicodePoints, ushort length);
+    // records the keys of the extended characters of a line which has
+    // been added to the history, and forgets the lines which left it
+    void addHistoryGraphemes(const QVector<Character> &line);
+    // records the keys of all lines of the history, when it is replaced
+    void resetHistoryGraphemes();
+
     void initTabStops();
 
     void updateEffectiveRendition();
-    void reverseRendition(Character &p) const;
+    // returns the cell with the colors of 'cell' swapped
+    StylePalette::Cell reverseRendition(const StylePalette::Cell &cell) const;
+
+    // replaces _styles with a palette of only the styles of the screen
+    // lines once it has more than _styleLimit styles
+    void compactStyles();
 
     bool isSelectionValid() const;
+    // returns the columns of 'line' which are selected from 'first' to 'last',
+    // or false if none are, the line is numbered like in getImage()
+    bool selectedColumns(int line, int &first, int &last) const;
     // copies text from 'startIndex' to 'endIndex' to a stream
     // startIndex and endIndex are positions generated using the loc(x,y) macro
     void writeToStream(TerminalCharacterDecoder *decoder, int startIndex, int endIndex,
                        const DecodingOptions options) const;
     // copies 'count' lines from the screen buffer into 'dest',
     // starting from 'startLine', where 0 is the first line in the screen buffer
-    void copyFromScreen(Character *dest, int startLine, int count) const;
+    void copyFromScreen(StylePalette::Cell *dest, int startLine, int count) const;
     // copies 'count' lines from the history buffer into 'dest',
     // starting from 'startLine', where 0 is the first line in the history
-    void copyFromHistory(Character *dest, int startLine, int count) const;
+    void copyFromHistory(StylePalette::Cell *dest, int startLine, int count) const;
 
     // screen image ----------------
     int _lines;
     int _columns;
 
-    typedef QVector<Character> ImageLine;      // [0..columns]
+    typedef QVector<StylePalette::Cell> ImageLine;      // [0..columns]
     ImageLine *_screenLines;             // [lines]
     int _screenLinesSize;                // _screenLines.size()
 
+    // the styles of the cells of _screenLines, see styles()
+    QSharedPointer<StylePalette> _styles;
+    int _styleLimit;
+
     int _scrolledLines;
     QRect _lastScrolledRegion;
 
@@ -665,8 +770,36 @@ private:
 
     QVarLengthArray<LineProperty, 64> _lineProperties;
 
+    QVector<quint64> _lineGenerations;   // [lines], see getLineGenerations()
+    quint64 _lastGeneration;             // the last generation given to a line
+    quint64 _historyGeneration;          // changes when the history lines change
+
     // history buffer ---------------
     HistoryScroll *_history;
+    HistoryReflow *_historyReflow;
+    bool _reflowLines;
+    qint64 _addedHistoryLines;
+    HistorySearchIndex *_searchIndex;
+    // the line which is added to the history, see addHistLine()
+    QVector<Character> _historyLine;
+
+    // sequences of the extended characters on the screen and in the history
+    GraphemePool _graphemes;
+
+    // the keys of the extended characters used by the lines of the history,
+    // kept for segments of lines so that compacting _graphemes does not
+    // need to read the history, see usedExtendedChars()
+    struct GraphemeSegment {
+        qint64 firstLine; // counted from the first line of _graphemeLines
+        int lineCount;
+        QVector<uint> keys;
+    };
+    QVector<GraphemeSegment> _graphemeSegments;
+    // the keys of the segment which is still added to
+    QSet<uint> _openSegmentKeys;
+    // the number of segments which use each key
+    QHash<uint, int> _segmentKeyCounts;
+    qint64 _graphemeLines;
 
     // cursor location
     int _cuX;
@@ -699,6 +832,7 @@ private:
     CharacterColor _effectiveForeground; // These are derived from
     CharacterColor _effectiveBackground; // the cu_* variables above
     RenditionFlags _effectiveRendition;  // to speed up operation
+    quint32 _effectiveStyle;             // the ID of the above in _styles
 
     class SavedState
     {
@@ -20,6 +20,13 @@
 // Own
 #include "ScreenWindow.h"
 
+// System
+#include <algorithm>
+
+// Qt
+#include <QHash>
+#include <QMutexLocker>
+
 // Konsole
 #include "Screen.h"
 
@@ -28,12 +35,21 @@ using namespace Konsole;
 ScreenWindow::ScreenWindow(Screen *screen, QObject *parent) :
     QObject(parent),
     _screen(nullptr),
+    _lock(nullptr),
     _windowBuffer(nullptr),
     _windowBufferSize(0),
     _bufferNeedsUpdate(true),
+    _previousBuffer(nullptr),
+    _styles(QSharedPointer<const StylePalette>()),
+    _lineGenerations(QVector<quint64>()),
+    _lineChanges(QVector<quint64>()),
+    _imageGeneration(0),
+    _cursorLine(-1),
     _windowLines(1),
     _currentLine(0),
     _currentResultLine(-1),
+    _resultLines(QVector<qint64>()),
+    _resultLinesSorted(true),
     _trackOutput(true),
     _scrollCount(0)
 {
@@ -43,12 +59,17 @@ ScreenWindow::ScreenWindow(Screen *screen, QObject *parent) :
 ScreenWindow::~ScreenWindow()
 {
     delete[] _windowBuffer;
+    delete[] _previousBuffer;
 }
 
 void ScreenWindow::setScreen(Screen *screen)
 {
     Q_ASSERT(screen);
 
+    // the generations of the lines of different screens are not related
+    if (screen != _screen) {
+        _lineGenerations.clear();
+    }
     _screen = screen;
 }
 
@@ -57,14 +78,36 @@ Screen *ScreenWindow::screen() const
     return _screen;
 }
 
-Character *ScreenWindow::getImage()
+void ScreenWindow::setLock(QMutex *lock)
+{
+    _lock = lock;
+}
+
+QMutex *ScreenWindow::lock() const
+{
+    return _lock;
+}
+
+StylePalette::Cell *ScreenWindow::getImage()
 {
+    QMutexLocker locker(_lock);
+
     // reallocate internal buffer if the window size has changed
     int size = windowLines() * windowColumns();
     if (_windowBuffer == nullptr || _windowBufferSize != size) {
         delete[] _windowBuffer;
+        delete[] _previousBuffer;
         _windowBufferSize = size;
-        _windowBuffer = new Character[size];
+        _windowBuffer = new StylePalette::Cell[size];
+        _previousBuffer = nullptr;
+        _lineGenerations.clear();
+        _bufferNeedsUpdate = true;
+    }
+
+    // the cells in the buffer do not mean the same in another palette
+    if (_styles != _screen->styles()) {
+        _styles = _screen->styles();
+        _lineGenerations.clear();
         _bufferNeedsUpdate = true;
     }
 
@@ -72,8 +115,12 @@ Character *ScreenWindow::getImage()
         return _windowBuffer;
     }
 
-    _screen->getImage(_windowBuffer, size,
-                      currentLine(), endWindowLine());
+    _imageGeneration++;
+    if (_lineChanges.size() != windowLines()) {
+        _lineChanges.fill(_imageGeneration, windowLines());
+    }
+
+    updateBuffer();
 
     // this window may look beyond the end of the screen, in which
     // case there will be an unused area which needs to be filled
@@ -84,6 +131,86 @@ Character *ScreenWindow::getImage()
     return _windowBuffer;
 }
 
+QSharedPointer<const StylePalette> ScreenWindow::styles() const
+{
+    return _styles;
+}
+
+void ScreenWindow::updateBuffer()
+{
+    const int columns = windowColumns();
+    const int startLine = currentLine();
+    const QVector<quint64> generations = _screen->getLineGenerations(startLine, endWindowLine());
+    // the cursor is marked in the image, but not covered by the generations
+    const int cursorLine = _screen->getHistLines() + _screen->getCursorY() - startLine;
+
+    // find the lines which are in the buffer already, at the same or
+    // at another line of the window
+    QHash<quint64, int> previousLines;
+    for (int line = 0; line < _lineGenerations.size(); line++) {
+        if (_lineGenerations[line] != 0 && line != _cursorLine) {
+            previousLines.insert(_lineGenerations[line], line);
+        }
+    }
+
+    QVector<int> sources(generations.size(), -1);
+    bool moved = false;
+    for (int line = 0; line < generations.size(); line++) {
+        if (line != cursorLine) {
+            sources[line] = previousLines.value(generations[line], -1);
+            moved |= sources[line] != -1 && sources[line] != line;
+        }
+    }
+
+    if (moved) {
+        if (_previousBuffer == nullptr) {
+            _previousBuffer = new StylePalette::Cell[_windowBufferSize];
+        }
+        std::copy(_windowBuffer, _windowBuffer + _windowBufferSize, _previousBuffer);
+    }
+
+    int line = 0;
+    while (line < generations.size()) {
+        if (sources[line] == line) {
+            line++;
+            continue;
+        }
+
+        if (sources[line] != -1) {
+            const StylePalette::Cell *source = _previousBuffer + sources[line] * columns;
+            std::copy(source, source + columns, _windowBuffer + line * columns);
+            _lineChanges[line] = _imageGeneration;
+            line++;
+            continue;
+        }
+
+        // copy the lines which are not in the buffer from the screen, as
+        // many at once as possible
+        int lastLine = line;
+        while (lastLine + 1 < generations.size() && sources[lastLine + 1] == -1) {
+            lastLine++;
+        }
+        _screen->getImage(_windowBuffer + line * columns, (lastLine - line + 1) * columns,
+                          startLine + line, startLine + lastLine);
+        for (; line <= lastLine; line++) {
+            _lineChanges[line] = _imageGeneration;
+        }
+    }
+
+    _lineGenerations = generations;
+    _cursorLine = cursorLine;
+}
+
+quint64 ScreenWindow::imageGeneration() const
+{
+    return _imageGeneration;
+}
+
+bool ScreenWindow::isLineChanged(int line, quint64 generation) const
+{
+    return line >= _lineChanges.size() || _lineChanges[line] > generation;
+}
+
 void ScreenWindow::fillUnusedArea()
 {
     int screenEndLine = _screen->getHistLines() + _screen->getLines() - 1;
@@ -100,6 +227,10 @@ void ScreenWindow::fillUnusedArea()
     int charsToFill = unusedLines * windowColumns();
 
     Screen::fillWithDefaultChar(_windowBuffer + _windowBufferSize - charsToFill, charsToFill);
+
+    for (int line = windowLines() - unusedLines; line < windowLines(); line++) {
+        _lineChanges[line] = _imageGeneration;
+    }
 }
 
 // return the index of the line at the end of this window, or if this window
@@ -117,6 +248,7 @@ int ScreenWindow::endWindowLine() const
 
 QVector<LineProperty> ScreenWindow::getLineProperties()
 {
+    QMutexLocker locker(_lock);
     QVector<LineProperty> result = _screen->getLineProperties(currentLine(), endWindowLine());
 
     if (result.count() != windowLines()) {
@@ -128,23 +260,27 @@ QVector<LineProperty> ScreenWindow::getLineProperties()
 
 QString ScreenWindow::selectedText(const Screen::DecodingOptions options) const
 {
+    QMutexLocker locker(_lock);
     return _screen->selectedText(options);
 }
 
 void ScreenWindow::getSelectionStart(int &column, int &line)
 {
+    QMutexLocker locker(_lock);
     _screen->getSelectionStart(column, line);
     line -= currentLine();
 }
 
 void ScreenWindow::getSelectionEnd(int &column, int &line)
 {
+    QMutexLocker locker(_lock);
     _screen->getSelectionEnd(column, line);
     line -= currentLine();
 }
 
 void ScreenWindow::setSelectionStart(int column, int line, bool columnMode)
 {
+    QMutexLocker locker(_lock);
     _screen->setSelectionStart(column, line + currentLine(), columnMode);
 
     _bufferNeedsUpdate = true;
@@ -153,6 +289,7 @@ void ScreenWindow::setSelectionStart(int column, int line, bool columnMode)
 
 void ScreenWindow::setSelectionEnd(int column, int line)
 {
+    QMutexLocker locker(_lock);
     _screen->setSelectionEnd(column, line + currentLine());
 
     _bufferNeedsUpdate = true;
@@ -161,6 +298,7 @@ void ScreenWindow::setSelectionEnd(int column, int line)
 
 void ScreenWindow::setSelectionByLineRange(int start, int end)
 {
+    QMutexLocker locker(_lock);
     clearSelection();
 
     _screen->setSelectionStart(0, start, false);
@@ -172,11 +310,13 @@ void ScreenWindow::setSelectionByLineRange(int start, int end)
 
 bool ScreenWindow::isSelected(int column, int line)
 {
+    QMutexLocker locker(_lock);
     return _screen->isSelected(column, qMin(line + currentLine(), endWindowLine()));
 }
 
 void ScreenWindow::clearSelection()
 {
+    QMutexLocker locker(_lock);
     _screen->clearSelection();
 
     emit selectionChanged();
@@ -195,21 +335,25 @@ int ScreenWindow::windowLines() const
 
 int ScreenWindow::windowColumns() const
 {
+    QMutexLocker locker(_lock);
     return _screen->getColumns();
 }
 
 int ScreenWindow::lineCount() const
 {
+    QMutexLocker locker(_lock);
     return _screen->getHistLines() + _screen->getLines();
 }
 
 int ScreenWindow::columnCount() const
 {
+    QMutexLocker locker(_lock);
     return _screen->getColumns();
 }
 
 QPoint ScreenWindow::cursorPosition() const
 {
+    QMutexLocker locker(_lock);
     QPoint position;
 
     position.setX(_screen->getCursorX());
@@ -220,6 +364,7 @@ QPoint ScreenWindow::cursorPosition() const
 
 int ScreenWindow::currentLine() const
 {
+    QMutexLocker locker(_lock);
     return qBound(0, _currentLine, lineCount() - windowLines());
 }
 
@@ -238,6 +383,44 @@ void ScreenWindow::setCurrentResultLine(int line)
     emit currentResultLineChanged();
 }
 
+void ScreenWindow::addResultLines(const QVector<qint64> &lines)
+{
+    _resultLines += lines;
+    _resultLinesSorted = false;
+    emit resultLinesChanged();
+}
+
+void ScreenWindow::clearResultLines()
+{
+    if (_resultLines.isEmpty()) {
+        return;
+    }
+
+    _resultLines.clear();
+    _resultLinesSorted = true;
+    emit resultLinesChanged();
+}
+
+QVector<int> ScreenWindow::resultLines(int fromLine, int toLine) const
+{
+    QMutexLocker locker(_lock);
+
+    // the lines arrive in the order they are searched
+    if (!_resultLinesSorted) {
+        std::sort(_resultLines.begin(), _resultLines.end());
+        _resultLines.erase(std::unique(_resultLines.begin(), _resultLines.end()), _resultLines.end());
+        _resultLinesSorted = true;
+    }
+
+    const qint64 firstLine = _screen->addedHistoryLines() - _screen->getHistLines();
+    QVector<int> lines;
+    for (auto line = std::lower_bound(_resultLines.constBegin(), _resultLines.constEnd(), firstLine + fromLine);
+         line != _resultLines.constEnd() && *line <= firstLine + toLine; ++line) {
+        lines.append(static_cast<int>(*line - firstLine));
+    }
+    return lines;
+}
+
 void ScreenWindow::scrollBy(RelativeScrollMode mode, int amount, bool fullPage)
 {
     if (mode == ScrollLines) {
@@ -253,11 +436,13 @@ void ScreenWindow::scrollBy(RelativeScrollMode mode, int amount, bool fullPage)
 
 bool ScreenWindow::atEndOfOutput() const
 {
+    QMutexLocker locker(_lock);
     return currentLine() == (lineCount() - windowLines());
 }
 
 void ScreenWindow::scrollTo(int line)
 {
+    QMutexLocker locker(_lock);
     int maxCurrentLineNumber = lineCount() - windowLines();
     line = qBound(0, line, maxCurrentLineNumber);
 
@@ -295,6 +480,7 @@ void ScreenWindow::resetScrollCount()
 
 QRect ScreenWindow::scrollRegion() const
 {
+    QMutexLocker locker(_lock);
     bool equalToScreenSize = windowLines() == _screen->getLines();
 
     if (atEndOfOutput() && equalToScreenSize) {
@@ -306,6 +492,8 @@ QRect ScreenWindow::scrollRegion() const
 
 void ScreenWindow::notifyOutputChanged()
 {
+    QMutexLocker locker(_lock);
+
     // move window to the bottom of the screen and update scroll count
     // if this window is currently tracking the bottom of the screen
     if (_trackOutput) {
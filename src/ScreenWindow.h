@@ -24,10 +24,15 @@
 #include <QObject>
 #include <QPoint>
 #include <QRect>
+#include <QSharedPointer>
+#include <QVector>
 
 // Konsole
 #include "Character.h"
 #include "Screen.h"
+#include "StylePalette.h"
+
+class QMutex;
 
 namespace Konsole {
 
@@ -70,14 +75,50 @@ public:
     /** Returns the screen which this window looks onto */
     Screen *screen() const;
 
+    /**
+     * Sets the lock which guards the screen when the emulation runs in
+     * another thread, see Emulation::enableLocking().  The methods of the
+     * window which access the screen hold it.
+     */
+    void setLock(QMutex *lock);
+    /**
+     * Returns the lock set by setLock() or nullptr.  Callers which access
+     * screen() directly, or need several calls to see the same state of
+     * the screen, should hold it with a QMutexLocker.
+     */
+    QMutex *lock() const;
+
     /**
      * Returns the image of characters which are currently visible through this window
-     * onto the screen.
+     * onto the screen, as cells whose styles are in the palette returned by styles().
      *
      * The returned buffer is managed by the ScreenWindow instance and does not need to be
      * deleted by the caller.
      */
-    Character *getImage();
+    StylePalette::Cell *getImage();
+
+    /**
+     * Returns the palette of the styles of the image returned by getImage().
+     * It changes when the screen replaces its palette or the window looks
+     * onto another screen, the cells of an image are only comparable with
+     * those of another image which uses the same palette.
+     */
+    QSharedPointer<const StylePalette> styles() const;
+
+    /**
+     * Returns the generation of the image returned by getImage(), which
+     * grows each time getImage() changes the image.
+     */
+    quint64 imageGeneration() const;
+
+    /**
+     * Returns true if @p line of the image returned by getImage() has
+     * changed since the image had the generation @p generation, see
+     * imageGeneration().  Only the lines of the screen which changed, or
+     * moved to another line of the window, are copied into the image,
+     * and views only need to compare those with the image they show.
+     */
+    bool isLineChanged(int line, quint64 generation) const;
 
     /**
      * Returns the line attributes associated with the lines of characters which
@@ -118,6 +159,21 @@ public:
     void setCurrentResultLine(int line);
     int currentResultLine() const;
 
+    /**
+     * Adds lines with a match of the search, which views highlight.  The
+     * lines are counted from the first line added to the history of the
+     * screen, see Screen::addedHistoryLines(), so that they stay with
+     * their text while the output scrolls.
+     */
+    void addResultLines(const QVector<qint64> &lines);
+    /** Removes the lines added by addResultLines(). */
+    void clearResultLines();
+    /**
+     * Returns the lines from @p fromLine to @p toLine which have a match
+     * of the search, numbered like currentLine(), in ascending order.
+     */
+    QVector<int> resultLines(int fromLine, int toLine) const;
+
     /**
      * Sets the start of the selection to the given @p line and @p column within
      * the window.
@@ -246,6 +302,8 @@ Q_SIGNALS:
     void outputChanged();
 
     void currentResultLineChanged();
+    /** Emitted when lines are added by addResultLines() or removed. */
+    void resultLinesChanged();
 
     /**
      * Emitted when the screen window is scrolled to a different position.
@@ -261,16 +319,32 @@ private:
     Q_DISABLE_COPY(ScreenWindow)
 
     int endWindowLine() const;
+    // copies the lines of the screen which changed into the buffer
+    void updateBuffer();
     void fillUnusedArea();
 
     Screen *_screen; // see setScreen() , screen()
-    Character *_windowBuffer;
+    QMutex *_lock;   // see setLock() , lock()
+    StylePalette::Cell *_windowBuffer;
     int _windowBufferSize;
     bool _bufferNeedsUpdate;
+    // copy of the buffer, for the lines which move to another line of it
+    StylePalette::Cell *_previousBuffer;
+    // the palette of the styles of the buffer, see styles()
+    QSharedPointer<const StylePalette> _styles;
+    // generations of the screen lines in the buffer, see Screen::getLineGenerations()
+    QVector<quint64> _lineGenerations;
+    // the generation of the image in which each line of the buffer last changed
+    QVector<quint64> _lineChanges;
+    quint64 _imageGeneration; // see imageGeneration()
+    int _cursorLine;          // the line of the buffer where the cursor is marked
 
     int _windowLines;
     int _currentLine;  // see scrollTo() , currentLine()
     int _currentResultLine;
+    // see addResultLines(), sorted when they are needed
+    mutable QVector<qint64> _resultLines;
+    mutable bool _resultLinesSorted;
     bool _trackOutput; // see setTrackOutput() , trackOutput()
     int _scrollCount;  // count of lines which the window has been scrolled by since
     // the last call to resetScrollCount()
@@ -20,14 +20,91 @@
 
 #include "SearchHistoryTask.h"
 
-#include <QApplication>
-#include <QTextStream>
+#include <algorithm>
+
+#include <QMutexLocker>
 
-#include "TerminalCharacterDecoder.h"
 #include "Emulation.h"
+#include "HistorySearchIndex.h"
+#include "Screen.h"
 
 namespace Konsole {
 
+SearchHistoryThread::SearchHistoryThread(const QRegularExpression &regExp, bool forwards, const Screen *screen,
+                                         QMutex *lock, const QVector<QPair<qint64, qint64> > &ranges, QObject *parent)
+    : QThread(parent)
+    , _regExp(regExp)
+    , _forwards(forwards)
+    , _screen(screen)
+    , _lock(lock)
+    , _ranges(ranges)
+    , _cancelled(0)
+{
+    // for the queued connections of matchesFound()
+    qRegisterMetaType<QVector<qint64> >("QVector<qint64>");
+}
+
+SearchHistoryThread::~SearchHistoryThread()
+{
+    cancel();
+    wait();
+}
+
+void SearchHistoryThread::cancel()
+{
+    _cancelled.storeRelease(1);
+}
+
+void SearchHistoryThread::run()
+{
+    // ranges overlap by a line, which is reported once
+    qint64 lastMatch = -1;
+
+    for (const QPair<qint64, qint64> &range : _ranges) {
+        if (_cancelled.loadAcquire() != 0) {
+            return;
+        }
+
+        qint64 firstLine;
+        QString text;
+        QList<int> linePositions;
+        {
+            QMutexLocker locker(_lock);
+
+            // skip the lines which left the history meanwhile
+            const qint64 screenLine = _screen->addedHistoryLines() - _screen->getHistLines();
+            const int lineCount = _screen->getHistLines() + _screen->getLines();
+            const int fromLine = static_cast<int>(qMax(range.first - screenLine, qint64(0)));
+            const int toLine = static_cast<int>(qMin(range.second - screenLine, qint64(lineCount - 1)));
+            if (fromLine > toLine) {
+                continue;
+            }
+
+            firstLine = screenLine + fromLine;
+            text = _screen->searchIndex()->plainText(fromLine, toLine, &linePositions);
+        }
+
+        const QVector<int> lines = HistorySearchIndex::findLinesInText(_regExp, text, linePositions, &_cancelled);
+        QVector<qint64> matches;
+        matches.reserve(lines.size());
+        for (int i = 0; i < lines.size(); i++) {
+            const qint64 line = firstLine + lines[_forwards ? i : lines.size() - 1 - i];
+            if (line != lastMatch) {
+                matches.append(line);
+            }
+        }
+
+        if (!matches.isEmpty() && _cancelled.loadAcquire() == 0) {
+            lastMatch = matches.last();
+            emit matchesFound(matches);
+        }
+    }
+
+    if (_cancelled.loadAcquire() == 0) {
+        emit searchFinished();
+    }
+}
+
 void SearchHistoryTask::addScreenWindow(Session* session , ScreenWindow* searchWindow)
 {
     _windows.insert(session, searchWindow);
@@ -35,136 +112,173 @@ void SearchHistoryTask::addScreenWindow(Session* session , ScreenWindow* searchW
 
 void SearchHistoryTask::execute()
 {
-    auto iter = QMapIterator<QPointer<Session>,ScreenWindowPtr>(_windows);
+    stopSearch();
 
-    while (iter.hasNext()) {
-        iter.next();
-        executeOnScreenWindow(iter.key() , iter.value());
-    }
+    _pendingSessions = _windows.keys();
+    searchNextWindow();
 }
 
-void SearchHistoryTask::executeOnScreenWindow(const QPointer<Session> &session , ScreenWindowPtr window)
+void SearchHistoryTask::cancel()
 {
-    Q_ASSERT(session);
-    Q_ASSERT(window);
+    stopSearch();
+    _pendingSessions.clear();
 
-    Emulation* emulation = session->emulation();
+    if (autoDelete()) {
+        deleteLater();
+    }
+}
 
-    if (!_regExp.pattern().isEmpty()) {
-        int pos = -1;
-        const bool forwards = (_direction == Enum::ForwardsSearch);
-        const int lastLine = window->lineCount() - 1;
+void SearchHistoryTask::searchNextWindow()
+{
+    while (!_pendingSessions.isEmpty()) {
+        const QPointer<Session> session = _pendingSessions.takeFirst();
+        const ScreenWindowPtr window = _windows.value(session);
+        if (session.isNull() || window.isNull()) {
+            continue;
+        }
 
-        int startLine;
-        if (forwards && (_startLine == lastLine)) {
-            startLine = 0;
-        } else if (!forwards && (_startLine == 0)) {
-            startLine = lastLine;
-        } else {
-            startLine = _startLine + (forwards ? 1 : -1);
+        if (!_regExp.pattern().isEmpty()) {
+            startSearch(session, window);
+            return;
         }
+        emit completed(false);
+    }
 
-        QString string;
-
-        //text stream to read history into string for pattern or regular expression searching
-        QTextStream searchStream(&string);
-
-        PlainTextDecoder decoder;
-        decoder.setRecordLinePositions(true);
-
-        //setup first and last lines depending on search direction
-        int line = startLine;
-
-        //read through and search history in blocks of 10K lines.
-        //this balances the need to retrieve lots of data from the history each time
-        //(for efficient searching)
-        //without using silly amounts of memory if the history is very large.
-        const int maxDelta = qMin(window->lineCount(), 10000);
-        int delta = forwards ? maxDelta : -maxDelta;
-
-        int endLine = line;
-        bool hasWrapped = false;  // set to true when we reach the top/bottom
-        // of the output and continue from the other
-        // end
-
-        //loop through history in blocks of <delta> lines.
-        do {
-            // ensure that application does not appear to hang
-            // if searching through a lengthy output
-            QApplication::processEvents();
-
-            // calculate lines to search in this iteration
-            if (hasWrapped) {
-                if (endLine == lastLine) {
-                    line = 0;
-                } else if (endLine == 0) {
-                    line = lastLine;
-                }
-
-                endLine += delta;
-
-                if (forwards) {
-                    endLine = qMin(startLine , endLine);
-                } else {
-                    endLine = qMax(startLine , endLine);
-                }
-            } else {
-                endLine += delta;
-
-                if (endLine > lastLine) {
-                    hasWrapped = true;
-                    endLine = lastLine;
-                } else if (endLine < 0) {
-                    hasWrapped = true;
-                    endLine = 0;
-                }
-            }
+    if (autoDelete()) {
+        deleteLater();
+    }
+}
 
-            decoder.begin(&searchStream);
-            emulation->writeToStream(&decoder, qMin(endLine, line) , qMax(endLine, line));
-            decoder.end();
+void SearchHistoryTask::startSearch(Session *session, ScreenWindowPtr window)
+{
+    const bool forwards = (_direction == Enum::ForwardsSearch);
+    const int lastLine = window->lineCount() - 1;
+
+    int startLine;
+    if (forwards && (_startLine == lastLine)) {
+        startLine = 0;
+    } else if (!forwards && (_startLine == 0)) {
+        startLine = lastLine;
+    } else {
+        startLine = qBound(0, _startLine + (forwards ? 1 : -1), lastLine);
+    }
 
-            // line number search below assumes that the buffer ends with a new-line
-            string.append(QLatin1Char('\n'));
+    // the thread reads the screen while the emulation may change it, on
+    // this thread or on an EmulationThread
+    session->emulation()->enableLocking();
+    QMutexLocker locker(window->lock());
+
+    _window = window;
+    _screen = window->screen();
+    _found = false;
+    window->clearResultLines();
+
+    // the index only returns the parts of the output which may contain
+    // a match, it is kept up to date as lines enter the history
+    const HistorySearchIndex *index = _screen->searchIndex();
+
+    // search from the start line to the bottom (or top) of the output
+    // and continue from the other end
+    QVector<QPair<int, int> > ranges;
+    if (forwards) {
+        ranges = index->candidateRanges(_regExp, startLine, lastLine);
+        ranges += index->candidateRanges(_regExp, 0, startLine - 1);
+    } else {
+        ranges = index->candidateRanges(_regExp, startLine + 1, lastLine);
+        ranges += index->candidateRanges(_regExp, 0, startLine);
+        std::reverse(ranges.begin(), ranges.end());
+    }
 
-            if (forwards) {
-                pos = string.indexOf(_regExp);
-            } else {
-                pos = string.lastIndexOf(_regExp);
-            }
+    // the lines may move while the search runs, count them from the
+    // first line ever added to the history instead
+    const qint64 firstLine = _screen->addedHistoryLines() - _screen->getHistLines();
+    QVector<QPair<qint64, qint64> > lineRanges;
+    lineRanges.reserve(ranges.size());
+    for (const QPair<int, int> &range : qAsConst(ranges)) {
+        lineRanges.append(qMakePair(firstLine + range.first, firstLine + range.second));
+    }
 
-            //if a match is found, position the cursor on that line and update the screen
-            if (pos != -1) {
-                int newLines = 0;
-                QList<int> linePositions = decoder.linePositions();
-                while (newLines < linePositions.count() && linePositions[newLines] <= pos) {
-                    newLines++;
-                }
+    const int searchId = ++_searchId;
+    _thread = new SearchHistoryThread(_regExp, forwards, _screen, window->lock(), lineRanges, this);
+    connect(_thread, &Konsole::SearchHistoryThread::matchesFound, this, [this, searchId](const QVector<qint64> &lines) {
+        if (searchId == _searchId) {
+            matchesFound(lines);
+        }
+    }, Qt::QueuedConnection);
+    connect(_thread, &Konsole::SearchHistoryThread::searchFinished, this, [this, searchId]() {
+        if (searchId == _searchId) {
+            searchFinished();
+        }
+    }, Qt::QueuedConnection);
+
+    // the screens are deleted after the windows, the thread must not
+    // outlive the window
+    connect(window, &QObject::destroyed, this, [this, searchId]() {
+        if (searchId == _searchId) {
+            const bool found = _found;
+            stopSearch();
+            if (!found) {
+                emit completed(false);
+            }
+            searchNextWindow();
+        }
+    });
 
-                // ignore the new line at the start of the buffer
-                newLines--;
+    _thread->start();
+}
 
-                int findPos = qMin(line, endLine) + newLines;
+void SearchHistoryTask::matchesFound(const QVector<qint64> &lines)
+{
+    // give up if the window shows another screen
+    if (_window.isNull() || _window->screen() != _screen) {
+        searchFinished();
+        return;
+    }
 
-                highlightResult(window, findPos);
+    QMutexLocker locker(_window->lock());
+    _window->addResultLines(lines);
 
-                emit completed(true);
+    if (!_found) {
+        //if a match is found, position the cursor on that line and update the screen
+        _found = true;
+        const qint64 firstLine = _screen->addedHistoryLines() - _screen->getHistLines();
+        highlightResult(_window, static_cast<int>(qMax(lines.first() - firstLine, qint64(0))));
 
-                return;
-            }
+        emit completed(true);
+    }
+}
 
-            //clear the current block of text and move to the next one
-            string.clear();
-            line = endLine;
-        } while (startLine != endLine);
+void SearchHistoryTask::searchFinished()
+{
+    const ScreenWindowPtr window = _window;
+    const bool found = _found;
+    stopSearch();
+
+    if (!found) {
+        if (!window.isNull()) {
+            // if no match was found, clear selection to indicate this
+            QMutexLocker locker(window->lock());
+            window->clearSelection();
+            window->notifyOutputChanged();
+        }
 
-        // if no match was found, clear selection to indicate this
-        window->clearSelection();
-        window->notifyOutputChanged();
+        emit completed(false);
     }
 
-    emit completed(false);
+    searchNextWindow();
 }
+
+void SearchHistoryTask::stopSearch()
+{
+    _searchId++;
+    _window.clear();
+    _screen = nullptr;
+
+    // the thread finishes decoding the lines it has started with
+    delete _thread;
+    _thread = nullptr;
+}
+
 void SearchHistoryTask::highlightResult(ScreenWindowPtr window , int findPos)
 {
     //work out how many lines into the current block of text the search result was found
@@ -192,7 +306,18 @@ SearchHistoryTask::SearchHistoryTask(QObject* parent)
     : SessionTask(parent)
     , _direction(Enum::BackwardsSearch)
     , _startLine(0)
+    , _pendingSessions(QList< QPointer<Session> >())
+    , _window(nullptr)
+    , _screen(nullptr)
+    , _thread(nullptr)
+    , _searchId(0)
+    , _found(false)
+{
+}
+
+SearchHistoryTask::~SearchHistoryTask()
 {
+    stopSearch();
 }
 
 void SearchHistoryTask::setSearchDirection(Enum::SearchDirection direction)
@@ -21,10 +21,15 @@
 #ifndef SEARCHHISTORYTASK_H
 #define SEARCHHISTORYTASK_H
 
+#include <QAtomicInt>
+#include <QMutex>
 #include <QPointer>
 #include <QMap>
 #include <QRegularExpression>
+#include <QThread>
+#include <QVector>
 
+#include "konsoleprivate_export.h"
 #include "SessionTask.h"
 #include "Enumeration.h"
 #include "ScreenWindow.h"
@@ -32,8 +37,58 @@
 
 namespace Konsole
 {
+class Screen;
+
+/**
+ * The thread which searches the lines of a Screen for a SearchHistoryTask.
+ *
+ * The thread decodes the ranges of lines to search one at a time while it
+ * holds the lock of the emulation, so that the text of each range is a
+ * snapshot of the screen, and matches the regular expression without the
+ * lock.  The lines with a match are reported as they are found.
+ */
+class KONSOLEPRIVATE_EXPORT SearchHistoryThread : public QThread
+{
+    Q_OBJECT
+
+public:
+    /**
+     * Constructs a thread which searches the lines of @p screen in
+     * @p ranges in the order given, reading the screen while it holds
+     * @p lock.  The lines are counted from the first line added to the
+     * history, see Screen::addedHistoryLines().
+     */
+    SearchHistoryThread(const QRegularExpression &regExp, bool forwards, const Screen *screen, QMutex *lock,
+                        const QVector<QPair<qint64, qint64> > &ranges, QObject *parent = nullptr);
+    ~SearchHistoryThread() Q_DECL_OVERRIDE;
+
+    /**
+     * Stops the search as soon as possible, no signals are emitted
+     * afterwards.
+     */
+    void cancel();
+
+Q_SIGNALS:
+    /**
+     * Emitted with the lines of a range which have a match, in the order
+     * they are searched.
+     */
+    void matchesFound(const QVector<qint64> &lines);
+    /** Emitted when all ranges have been searched. */
+    void searchFinished();
+
+protected:
+    void run() Q_DECL_OVERRIDE;
+
+private:
+    const QRegularExpression _regExp;
+    const bool _forwards;
+    const Screen *_screen;
+    QMutex *_lock;
+    const QVector<QPair<qint64, qint64> > _ranges;
+    QAtomicInt _cancelled;
+};
 
-//class SearchHistoryThread;
 /**
  * A task which searches through the output of sessions for matches for a given regular expression.
  * SearchHistoryTask operates on ScreenWindow instances rather than sessions added by addSession().
@@ -42,11 +97,15 @@ namespace Konsole
  * When execute() is called, the search begins in the direction specified by searchDirection(),
  * starting at the position of the current selection.
  *
+ * The search is asynchronous: the lines which may contain a match are
+ * decoded and searched by a SearchHistoryThread.  The window scrolls to
+ * the first match, and all matches are highlighted as they are found,
+ * see ScreenWindow::addResultLines().  completed() is emitted for each
+ * screen window when the first match has been found, or when its search
+ * has finished without a match.
+ *
  * FIXME - This is not a proper implementation of SessionTask, in that it ignores sessions specified
  * with addSession()
- *
- * TODO - Implementation requirements:
- *          May provide progress feedback to the user when searching very large output logs.
  */
 class SearchHistoryTask : public SessionTask
 {
@@ -57,6 +116,7 @@ public:
      * Constructs a new search task.
      */
     explicit SearchHistoryTask(QObject *parent = nullptr);
+    ~SearchHistoryTask() Q_DECL_OVERRIDE;
 
     /** Adds a screen window to the list to search when execute() is called. */
     void addScreenWindow(Session *session, ScreenWindow *searchWindow);
@@ -75,27 +135,47 @@ public:
     void setStartLine(int line);
 
     /**
-     * Performs a search through the session's history, starting at the position
+     * Starts a search through the session's history, starting at the position
      * of the current selection, in the direction specified by setSearchDirection().
      *
      * If it finds a match, the ScreenWindow specified in the constructor is
      * scrolled to the position where the match occurred and the selection
-     * is set to the matching text.  execute() then returns immediately.
+     * is set to the matching text.
      *
      * To continue the search looking for further matches, call execute() again.
      */
     void execute() Q_DECL_OVERRIDE;
 
+    /**
+     * Stops the search in progress without emitting completed(), the
+     * task is deleted if it is set to delete itself.
+     */
+    void cancel();
+
 private:
     using ScreenWindowPtr = QPointer<ScreenWindow>;
 
-    void executeOnScreenWindow(const QPointer<Session> &session, ScreenWindowPtr window);
+    void searchNextWindow();
+    void startSearch(Session *session, ScreenWindowPtr window);
+    void stopSearch();
+    void matchesFound(const QVector<qint64> &lines);
+    void searchFinished();
     void highlightResult(ScreenWindowPtr window, int findPos);
 
     QMap< QPointer<Session>, ScreenWindowPtr > _windows;
     QRegularExpression _regExp;
     Enum::SearchDirection _direction;
     int _startLine;
+
+    // the search in progress
+    QList< QPointer<Session> > _pendingSessions;
+    ScreenWindowPtr _window;
+    Screen *_screen;
+    SearchHistoryThread *_thread;
+    // identifies the search in progress, results of stopped searches are ignored
+    int _searchId;
+    // true once completed() has been emitted for the search in progress
+    bool _found;
 };
 
 }
@@ -44,12 +44,16 @@
 #include <KShell>
 #include <KProcess>
 #include <KConfigGroup>
+#include <KPtyDevice>
 
 // Konsole
 #include <sessionadaptor.h>
 
 #include "ProcessInfo.h"
+#include "ProcessInfoSampler.h"
 #include "Pty.h"
+#include "EmulationThread.h"
+#include "KonsoleSettings.h"
 #include "TerminalDisplay.h"
 #include "ShellCommand.h"
 #include "Vt102Emulation.h"
@@ -72,6 +76,7 @@ Session::Session(QObject* parent) :
     , _uniqueIdentifier(QUuid())
     , _shellProcess(nullptr)
     , _emulation(nullptr)
+    , _emulationThread(nullptr)
     , _views(QList<TerminalDisplay *>())
     , _monitorActivity(false)
     , _monitorSilence(false)
@@ -79,6 +84,7 @@ Session::Session(QObject* parent) :
     , _silenceSeconds(10)
     , _silenceTimer(nullptr)
     , _activityTimer(nullptr)
+    , _activityCheckTimer(nullptr)
     , _autoClose(true)
     , _closePerUserRequest(false)
     , _nameTitle(QString())
@@ -119,6 +125,14 @@ Session::Session(QObject* parent) :
     //create emulation backend
     _emulation = new Vt102Emulation();
 
+    // optionally interpret the output in a thread of its own
+    if (KonsoleSettings::threadedEmulation()) {
+        _emulation->enableLocking();
+        _emulationThread = new EmulationThread(_emulation, this);
+        connect(_emulationThread, &Konsole::EmulationThread::backlogChanged, this, &Konsole::Session::onEmulationBacklogChanged);
+        _emulationThread->start();
+    }
+
     connect(_emulation, &Konsole::Emulation::sessionAttributeChanged, this, &Konsole::Session::setSessionAttribute);
     connect(_emulation, &Konsole::Emulation::stateSet, this, &Konsole::Session::activityStateSet);
     connect(_emulation, &Konsole::Emulation::zmodemDownloadDetected, this, &Konsole::Session::fireZModemDownloadDetected);
@@ -142,12 +156,24 @@ Session::Session(QObject* parent) :
     _activityTimer = new QTimer(this);
     _activityTimer->setSingleShot(true);
     connect(_activityTimer, &QTimer::timeout, this, &Konsole::Session::activityTimerDone);
+
+    _activityCheckTimer = new QTimer(this);
+    _activityCheckTimer->setSingleShot(true);
+    connect(_activityCheckTimer, &QTimer::timeout, this, &Konsole::Session::activityCheckTimerDone);
+
+    connect(ProcessInfoSampler::instance(), &Konsole::ProcessInfoSampler::processesChanged, this, [this](const QVector<int> &pids) {
+        if (pids.contains(processId()) || pids.contains(_foregroundPid)) {
+            emit processInfoChanged();
+        }
+    });
 }
 
 Session::~Session()
 {
     delete _foregroundProcessInfo;
     delete _sessionProcessInfo;
+    // stop the thread before the emulation it works on goes away
+    delete _emulationThread;
     delete _emulation;
     delete _shellProcess;
     delete _zmodemProc;
@@ -395,17 +421,15 @@ QString Session::checkProgram(const QString& program)
 void Session::terminalWarning(const QString& message)
 {
     static const QByteArray warningText = i18nc("@info:shell Alert the user with red color text", "Warning: ").toLocal8Bit();
-    QByteArray messageText = message.toLocal8Bit();
+    const QByteArray messageText = message.toLocal8Bit();
 
     static const char redPenOn[] = "\033[1m\033[31m";
     static const char redPenOff[] = "\033[0m";
 
-    _emulation->receiveData(redPenOn, qstrlen(redPenOn));
-    _emulation->receiveData("\n\r\n\r", 4);
-    _emulation->receiveData(warningText.constData(), qstrlen(warningText.constData()));
-    _emulation->receiveData(messageText.constData(), qstrlen(messageText.constData()));
-    _emulation->receiveData("\n\r\n\r", 4);
-    _emulation->receiveData(redPenOff, qstrlen(redPenOff));
+    // queued behind the output of the terminal, like any other output
+    const QByteArray text = redPenOn + QByteArrayLiteral("\n\r\n\r") + warningText + messageText
+                            + QByteArrayLiteral("\n\r\n\r") + redPenOff;
+    onReceiveBlock(text.constData(), text.size());
 }
 
 QString Session::shellSessionId() const
@@ -640,6 +664,14 @@ void Session::activityTimerDone()
     _notifiedActivity = false;
 }
 
+void Session::activityCheckTimerDone()
+{
+    // the emulation signals output again once it has been idle
+    if (_emulation->takeActivity()) {
+        activityStateSet(NOTIFYACTIVITY);
+    }
+}
+
 void Session::updateFlowControlState(bool suspended)
 {
     if (suspended) {
@@ -687,10 +719,14 @@ void Session::activityStateSet(int state)
 {
     // TODO: should this hardcoded interval be user configurable?
     const int activityMaskInSeconds = 15;
+    // interval in which continued output is handled as a single activity
+    const int activityCheckMilliseconds = 500;
 
     if (state == NOTIFYBELL) {
         emit bellRequest(i18n("Bell in session '%1'", _nameTitle));
     } else if (state == NOTIFYACTIVITY) {
+        _activityCheckTimer->start(activityCheckMilliseconds);
+
         // Don't notify if the terminal is active
         bool hasFocus = false;
         foreach(TerminalDisplay *display, _views) {
@@ -1244,6 +1280,11 @@ void Session::clearHistory()
     _emulation->clearHistory();
 }
 
+void Session::setMaximumFrameRate(int framesPerSecond)
+{
+    _emulation->setMaximumFrameRate(framesPerSecond);
+}
+
 QStringList Session::arguments() const
 {
     return _arguments;
@@ -1465,7 +1506,16 @@ void Session::zmodemFinished()
 
 void Session::onReceiveBlock(const char* buf, int len)
 {
-    _emulation->receiveData(buf, len);
+    if (_emulationThread != nullptr) {
+        _emulationThread->addData(buf, len);
+    } else {
+        _emulation->receiveData(buf, len);
+    }
+}
+
+void Session::onEmulationBacklogChanged(bool full)
+{
+    _shellProcess->pty()->setSuspended(full);
 }
 
 QSize Session::size()
@@ -1558,7 +1608,7 @@ void Session::setHistorySize(int lines)
     }
 
     if (lines < 0) {
-        setHistoryType(HistoryTypeFile());
+        setHistoryType(CompressedHistoryType());
     } else if (lines == 0) {
         setHistoryType(HistoryTypeNone());
     } else {
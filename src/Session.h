@@ -45,6 +45,7 @@ class KProcess;
 
 namespace Konsole {
 class Emulation;
+class EmulationThread;
 class Pty;
 class ProcessInfo;
 class TerminalDisplay;
@@ -226,6 +227,13 @@ public:
      */
     void clearHistory();
 
+    /**
+     * Sets how often per second the views of this session are updated at
+     * most while output is received, 0 for the refresh rate of the screen.
+     * See Emulation::setMaximumFrameRate()
+     */
+    void setMaximumFrameRate(int framesPerSecond);
+
     /**
      * Sets the key bindings used by this session.  The bindings
      * specify how input key sequences are translated into
@@ -627,6 +635,12 @@ Q_SIGNALS:
      */
     void currentDirectoryChanged(const QString &dir);
 
+    /**
+     * Emitted when the state of the terminal process or of the foreground
+     * process, like its name or current directory, has changed.
+     */
+    void processInfoChanged();
+
     /** Emitted when a bell event occurs in the session. */
     void bellRequest(const QString &message);
 
@@ -708,8 +722,11 @@ private Q_SLOTS:
     void fireZModemUploadDetected();
 
     void onReceiveBlock(const char *buf, int len);
+    // suspends reading from the terminal while the emulation thread is behind
+    void onEmulationBacklogChanged(bool full);
     void silenceTimerDone();
     void activityTimerDone();
+    void activityCheckTimerDone();
 
     void onViewSizeChange(int height, int width);
 
@@ -764,6 +781,7 @@ private:
 
     Pty *_shellProcess;
     Emulation *_emulation;
+    EmulationThread *_emulationThread; // only used if the output is processed in a thread
 
     QList<TerminalDisplay *> _views;
 
@@ -774,6 +792,7 @@ private:
     int _silenceSeconds;
     QTimer *_silenceTimer;
     QTimer *_activityTimer;
+    QTimer *_activityCheckTimer; // checks for output while the terminal is active
 
     bool _autoClose;
     bool _closePerUserRequest;
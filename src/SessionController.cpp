@@ -60,6 +60,7 @@
 // Konsole
 #include "EditProfileDialog.h"
 #include "CopyInputDialog.h"
+#include "DirectoryCache.h"
 #include "Emulation.h"
 #include "Filter.h"
 #include "History.h"
@@ -122,6 +123,7 @@ SessionController::SessionController(Session* session , TerminalDisplay* view, Q
     , _isSearchBarEnabled(false)
     , _editProfileDialog(nullptr)
     , _searchBar(view->searchBar())
+    , _searchTask(nullptr)
 {
     Q_ASSERT(session);
     Q_ASSERT(view);
@@ -180,6 +182,9 @@ SessionController::SessionController(Session* session , TerminalDisplay* view, Q
     // update the title when the session starts
     connect(_session.data(), &Konsole::Session::started, this, &Konsole::SessionController::snapshot);
 
+    // and when the sampled state of its processes changes
+    connect(_session.data(), &Konsole::Session::processInfoChanged, this, &Konsole::SessionController::snapshot);
+
     // listen for output changes to set activity flag
     connect(_session->emulation(), &Konsole::Emulation::outputChanged, this, &Konsole::SessionController::fireActivity);
 
@@ -1129,12 +1134,20 @@ void SessionController::updateFilterList(Profile::Ptr profile)
     bool underlineFiles = profile->underlineFilesEnabled();
 
     if (!underlineFiles && (_fileFilter != nullptr)) {
+        if (_fileFilter->directoryCache() != nullptr) {
+            disconnect(_fileFilter->directoryCache(), &Konsole::DirectoryCache::updated,
+                       _view, &Konsole::TerminalDisplay::updateFilters);
+        }
         _view->filterChain()->removeFilter(_fileFilter);
         delete _fileFilter;
         _fileFilter = nullptr;
     } else if (underlineFiles && (_fileFilter == nullptr)) {
         _fileFilter = new FileFilter(_session);
         _view->filterChain()->addFilter(_fileFilter);
+        if (_fileFilter->directoryCache() != nullptr) {
+            connect(_fileFilter->directoryCache(), &Konsole::DirectoryCache::updated,
+                    _view, &Konsole::TerminalDisplay::updateFilters);
+        }
     }
 
     bool underlineLinks = profile->underlineLinksEnabled();
@@ -1220,6 +1233,7 @@ void SessionController::enableSearchBar(bool showSearchBar)
                    &Konsole::SessionController::findNextInHistory);
         if ((!_view.isNull()) && (_view->screenWindow() != nullptr)) {
             _view->screenWindow()->setCurrentResultLine(-1);
+            _view->screenWindow()->clearResultLines();
         }
     }
 }
@@ -1274,6 +1288,9 @@ void SessionController::searchHistory(bool showSearchBar)
         } else {
             setFindNextPrevEnabled(false);
 
+            if (!_searchTask.isNull()) {
+                _searchTask->cancel();
+            }
             removeSearchFilter();
 
             _view->setFocus(Qt::ActiveWindowFocusReason);
@@ -1330,9 +1347,16 @@ void SessionController::beginSearch(const QString& text, Enum::SearchDirection d
         }
     }
 
+    // the previous search is outdated
+    if (!_searchTask.isNull()) {
+        _searchTask->cancel();
+    }
+    _view->screenWindow()->clearResultLines();
+
     if (!regExp.pattern().isEmpty()) {
         _view->screenWindow()->setCurrentResultLine(-1);
         auto task = new SearchHistoryTask(this);
+        _searchTask = task;
 
         connect(task, &Konsole::SearchHistoryTask::completed, this, &Konsole::SessionController::searchCompleted);
 
@@ -1406,7 +1430,10 @@ void SessionController::showHistoryOptions()
     QScopedPointer<HistorySizeDialog> dialog(new HistorySizeDialog(QApplication::activeWindow()));
     const HistoryType& currentHistory = _session->historyType();
 
-    if (currentHistory.isEnabled()) {
+    if (currentHistory.fileSize() > 0) {
+        dialog->setMode(Enum::FixedSizeFileHistory);
+        dialog->setFileSize(currentHistory.fileSize());
+    } else if (currentHistory.isEnabled()) {
         if (currentHistory.isUnlimited()) {
             dialog->setMode(Enum::UnlimitedHistory);
         } else {
@@ -1424,7 +1451,7 @@ void SessionController::showHistoryOptions()
     }
 
     if (result != 0) {
-        scrollBackOptionsChanged(dialog->mode(), dialog->lineCount());
+        scrollBackOptionsChanged(dialog->mode(), dialog->lineCount(), dialog->fileSize());
     }
 }
 void SessionController::sessionResizeRequest(const QSize& size)
@@ -1432,7 +1459,7 @@ void SessionController::sessionResizeRequest(const QSize& size)
     ////qDebug() << "View resize requested to " << size;
     _view->setSize(size.width(), size.height());
 }
-void SessionController::scrollBackOptionsChanged(int mode, int lines)
+void SessionController::scrollBackOptionsChanged(int mode, int lines, int fileSize)
 {
     switch (mode) {
     case Enum::NoHistory:
@@ -1442,7 +1469,10 @@ void SessionController::scrollBackOptionsChanged(int mode, int lines)
         _session->setHistoryType(CompactHistoryType(lines));
         break;
     case Enum::UnlimitedHistory:
-        _session->setHistoryType(HistoryTypeFile());
+        _session->setHistoryType(CompressedHistoryType());
+        break;
+    case Enum::FixedSizeFileHistory:
+        _session->setHistoryType(HistoryTypeRingFile(fileSize));
         break;
     }
 }
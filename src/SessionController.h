@@ -60,6 +60,7 @@ class ProfileList;
 class RegExpFilter;
 class UrlFilter;
 class FileFilter;
+class SearchHistoryTask;
 class EditProfileDialog;
 
 using SessionPtr = QPointer<Session>;
@@ -276,7 +277,7 @@ private Q_SLOTS:
     // foreground process in the terminal
 
     void highlightMatches(bool highlight);
-    void scrollBackOptionsChanged(int mode, int lines);
+    void scrollBackOptionsChanged(int mode, int lines, int fileSize);
     void sessionResizeRequest(const QSize &size);
     void trackOutput(QKeyEvent *event);  // move view to end of current output
     // when a key press occurs in the
@@ -360,6 +361,7 @@ private:
 
     QString _searchText;
     QPointer<IncrementalSearchBar> _searchBar;
+    QPointer<SearchHistoryTask> _searchTask;
 };
 inline bool SessionController::isValid() const
 {
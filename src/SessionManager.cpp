@@ -252,7 +252,8 @@ void SessionManager::applyProfile(Session *session, const Profile::Ptr &profile,
     }
 
     // History
-    if (apply.shouldApply(Profile::HistoryMode) || apply.shouldApply(Profile::HistorySize)) {
+    if (apply.shouldApply(Profile::HistoryMode) || apply.shouldApply(Profile::HistorySize)
+        || apply.shouldApply(Profile::HistoryFileSize)) {
         const auto mode = profile->property<int>(Profile::HistoryMode);
         switch (mode) {
         case Enum::NoHistory:
@@ -267,7 +268,11 @@ void SessionManager::applyProfile(Session *session, const Profile::Ptr &profile,
         }
 
         case Enum::UnlimitedHistory:
-            session->setHistoryType(HistoryTypeFile());
+            session->setHistoryType(CompressedHistoryType());
+            break;
+
+        case Enum::FixedSizeFileHistory:
+            session->setHistoryType(HistoryTypeRingFile(profile->property<int>(Profile::HistoryFileSize)));
             break;
         }
     }
@@ -277,6 +282,10 @@ void SessionManager::applyProfile(Session *session, const Profile::Ptr &profile,
         session->setFlowControlEnabled(profile->flowControlEnabled());
     }
 
+    if (apply.shouldApply(Profile::MaximumFrameRate)) {
+        session->setMaximumFrameRate(profile->property<int>(Profile::MaximumFrameRate));
+    }
+
     // Encoding
     if (apply.shouldApply(Profile::DefaultEncoding)) {
         QByteArray name = profile->defaultEncoding().toUtf8();
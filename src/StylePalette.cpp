@@ -0,0 +1,65 @@
+/*
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+    02110-1301  USA.
+*/
+
+// Own
+#include "StylePalette.h"
+
+// System
+#include <cstddef>
+
+using namespace Konsole;
+
+// Key is hashed from all bytes of Character but the padding
+static_assert(sizeof(Character) == 16 && offsetof(Character, isRealCharacter) == 14,
+              "Character has one byte of padding at its end");
+
+const quint32 StylePalette::DefaultStyle;
+const quint32 StylePalette::BlankStyle;
+
+StylePalette::StylePalette() :
+    _styles(QVector<Character>()),
+    _ids(QHash<Key, quint32>()),
+    _lastStyle(0)
+{
+    intern(Character());
+    intern(Character(' ',
+                     CharacterColor(COLOR_SPACE_DEFAULT, DEFAULT_FORE_COLOR),
+                     CharacterColor(COLOR_SPACE_DEFAULT, DEFAULT_BACK_COLOR),
+                     DEFAULT_RENDITION,
+                     false));
+    Q_ASSERT(count() == 2);
+}
+
+StylePalette::Cell StylePalette::intern(const Character &character)
+{
+    const bool extended = (character.rendition & RE_EXTENDED_CHAR) != 0;
+    Key key = {character};
+    key.style.character = 0;
+    key.style.rendition &= ~RE_EXTENDED_CHAR;
+
+    if (_lastStyle < static_cast<quint32>(_styles.count()) && Key{_styles[_lastStyle]} == key) {
+        return Cell(character.character, _lastStyle, extended);
+    }
+
+    auto it = _ids.constFind(key);
+    if (it == _ids.constEnd()) {
+        it = _ids.insert(key, _styles.count());
+        _styles.append(key.style);
+    }
+    _lastStyle = it.value();
+    return Cell(character.character, _lastStyle, extended);
+}
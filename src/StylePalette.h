@@ -0,0 +1,132 @@
+/*
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+    02110-1301  USA.
+*/
+
+#ifndef STYLEPALETTE_H
+#define STYLEPALETTE_H
+
+// Qt
+#include <QHash>
+#include <QVector>
+
+// Konsole
+#include "Character.h"
+#include "konsoleprivate_export.h"
+
+namespace Konsole
+{
+/**
+ * An interned table of the styles of characters: their colors,
+ * rendition and whether they are real characters.
+ *
+ * Output rarely uses more than a few dozen styles, so a cell which
+ * stores the code point of a character and the ID of its style in the
+ * palette takes half the memory of a Character, and two cells have the
+ * same style if they have the same ID.  RE_EXTENDED_CHAR is kept in the
+ * cell rather than in the style, since it belongs to the character.
+ *
+ * Every palette starts with DefaultStyle and BlankStyle, so that cells
+ * with these styles mean the same in all palettes.  Styles are never
+ * removed, a store of cells which keeps getting new styles, such as the
+ * screen, replaces its palette once it has grown too large.
+ */
+class KONSOLEPRIVATE_EXPORT StylePalette
+{
+public:
+    /** The style of Character() */
+    static const quint32 DefaultStyle = 0;
+    /** The style of Screen::DefaultChar, which is not a real character */
+    static const quint32 BlankStyle = 1;
+
+    StylePalette();
+
+    /** A character stored with the ID of its style */
+    struct Cell {
+        explicit Cell(quint32 c = ' ', quint32 s = DefaultStyle, bool e = false) :
+            character(c),
+            style(s),
+            extended(e ? 1 : 0)
+        {
+        }
+
+        quint32 character;
+        quint32 style : 31;
+        // whether character is a key of the GraphemePool
+        quint32 extended : 1;
+    };
+
+    /** Returns the cell of @p character, adding its style if it is new. */
+    Cell intern(const Character &character);
+
+    /** Returns the character of @p cell. */
+    Character character(const Cell &cell) const
+    {
+        Character result = _styles[cell.style];
+        result.character = cell.character;
+        if (cell.extended != 0) {
+            result.rendition |= RE_EXTENDED_CHAR;
+        }
+        return result;
+    }
+
+    /** Returns the style with the ID @p id, with a zero code point. */
+    const Character &style(int id) const
+    {
+        return _styles[id];
+    }
+
+    /** Number of distinct styles */
+    int count() const
+    {
+        return _styles.count();
+    }
+
+private:
+    struct Key {
+        Character style;
+
+        bool operator==(const Key &other) const
+        {
+            return style == other.style && style.isRealCharacter == other.style.isRealCharacter;
+        }
+
+        // the style is held in the bytes before the padding of Character
+        friend uint qHash(const Key &key, uint seed = 0)
+        {
+            return qHashBits(&key.style, sizeof(Character) - 1, seed);
+        }
+    };
+
+    // the styles by ID, with a zero code point
+    QVector<Character> _styles;
+    QHash<Key, quint32> _ids;
+    // consecutive characters mostly have the same style
+    quint32 _lastStyle;
+};
+
+inline bool operator==(const StylePalette::Cell &a, const StylePalette::Cell &b)
+{
+    return a.character == b.character && a.style == b.style && a.extended == b.extended;
+}
+
+inline bool operator!=(const StylePalette::Cell &a, const StylePalette::Cell &b)
+{
+    return !operator==(a, b);
+}
+}
+Q_DECLARE_TYPEINFO(Konsole::StylePalette::Cell, Q_MOVABLE_TYPE);
+
+#endif // STYLEPALETTE_H
@@ -26,7 +26,7 @@
 #include <QTextStream>
 
 // Konsole
-#include "ExtendedCharTable.h"
+#include "GraphemePool.h"
 #include "ColorScheme.h"
 #include "ColorSchemeManager.h"
 #include "Profile.h"
@@ -137,7 +137,7 @@ void PlainTextDecoder::decodeLine(const Character* const characters, int count,
     for (int i = start; i < outputCount;) {
         if ((characters[i].rendition & RE_EXTENDED_CHAR) != 0) {
             ushort extendedCharLength = 0;
-            const uint* chars = ExtendedCharTable::instance.lookupExtendedChar(characters[i].character, extendedCharLength);
+            const uint* chars = GraphemePool::lookup(characters[i].character, extendedCharLength);
             if (chars != nullptr) {
                 const QString s = QString::fromUcs4(chars, extendedCharLength);
                 plainText.append(s);
@@ -293,7 +293,7 @@ void HTMLDecoder::decodeLine(const Character* const characters, int count, LineP
         if (spaceCount < 2) {
             if ((characters[i].rendition & RE_EXTENDED_CHAR) != 0) {
                 ushort extendedCharLength = 0;
-                const uint* chars = ExtendedCharTable::instance.lookupExtendedChar(characters[i].character, extendedCharLength);
+                const uint* chars = GraphemePool::lookup(characters[i].character, extendedCharLength);
                 if (chars != nullptr) {
                     text.append(QString::fromUcs4(chars, extendedCharLength));
                 }
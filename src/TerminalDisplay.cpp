@@ -37,6 +37,7 @@
 #include <QFontDatabase>
 #include <QLabel>
 #include <QMimeData>
+#include <QMutexLocker>
 #include <QPainter>
 #include <QPixmap>
 #include <QScrollBar>
@@ -65,7 +66,7 @@
 #include "TerminalCharacterDecoder.h"
 #include "Screen.h"
 #include "SessionController.h"
-#include "ExtendedCharTable.h"
+#include "GraphemePool.h"
 #include "TerminalDisplayAccessible.h"
 #include "SessionManager.h"
 #include "Session.h"
@@ -74,6 +75,7 @@
 #include "Profile.h"
 #include "ViewManager.h" // for colorSchemeForProfile. // TODO: Rewrite this.
 #include "LineBlockCharacters.h"
+#include "LineDiff.h"
 
 using namespace Konsole;
 
@@ -120,11 +122,15 @@ void TerminalDisplay::setScreenWindow(ScreenWindow* window)
     }
 
     _screenWindow = window;
+    _imageGeneration = 0;
 
     if (!_screenWindow.isNull()) {
         connect(_screenWindow.data() , &Konsole::ScreenWindow::outputChanged , this , &Konsole::TerminalDisplay::updateLineProperties);
         connect(_screenWindow.data() , &Konsole::ScreenWindow::outputChanged , this , &Konsole::TerminalDisplay::updateImage);
         connect(_screenWindow.data() , &Konsole::ScreenWindow::currentResultLineChanged , this , &Konsole::TerminalDisplay::updateImage);
+        connect(_screenWindow.data(), &Konsole::ScreenWindow::resultLinesChanged, this, [this]() {
+            update();
+        });
         connect(_screenWindow.data(), &Konsole::ScreenWindow::outputChanged, this, [this]() {
             _filterUpdateRequired = true;
         });
@@ -245,6 +251,11 @@ void TerminalDisplay::fontChange(const QFont&)
 
     _fontAscent = fm.ascent();
 
+    // glyphs shaped and characters rasterized for the old font are not
+    // drawn anymore
+    _glyphRunCache.clear();
+    _lineCharAtlas.clear();
+
     emit changedFontMetricSignal(_fontHeight, _fontWidth);
     propagateSize();
     update();
@@ -417,8 +428,11 @@ TerminalDisplay::TerminalDisplay(QWidget* parent)
     , _usedColumns(1)
     , _contentRect(QRect())
     , _image(nullptr)
+    , _styles(new StylePalette())
     , _imageSize(0)
     , _lineProperties(QVector<LineProperty>())
+    , _imageGeneration(0)
+    , _blinkingLines(QBitArray())
     , _randomSeed(0)
     , _resizing(false)
     , _showTerminalSizeHint(true)
@@ -484,6 +498,9 @@ TerminalDisplay::TerminalDisplay(QWidget* parent)
     , _scrollWheelState(ScrollState())
     , _searchBar(new IncrementalSearchBar(this))
     , _searchResultRect(QRect())
+    , _renderStatistics(RenderStatistics())
+    , _glyphRunCache()
+    , _lineCharAtlas()
 {
     // terminal applications are not designed with Right-To-Left in mind,
     // so the layout is forced to Left-To-Right
@@ -578,11 +595,25 @@ void TerminalDisplay::drawLineCharString(QPainter& painter, int x, int y, const
 {
     const bool useBoldPen = (attributes->rendition & RE_BOLD) != 0 && _boldIntense;
 
-    QRect cellRect = {x, y, _fontWidth, _fontHeight};
+    _renderStatistics.lineCharFragments++;
+
+    // characters drawn on the screen are rasterized once and then copied
+    // from the atlas, scaled lines and printers need the vector shapes
+    const bool useAtlas = painter.device()->devType() != QInternal::Printer
+                          && painter.transform().type() <= QTransform::TxTranslate;
+
+    const QRect cellRect = {x, y, _fontWidth, _fontHeight};
     for (int i = 0 ; i < str.length(); i++) {
-        LineBlockCharacters::draw(painter, cellRect.translated(i * _fontWidth, 0), str[i],
-                                        useBoldPen);
+        const QRect rect = cellRect.translated(i * _fontWidth, 0);
+        if (!useAtlas) {
+            LineBlockCharacters::draw(painter, rect, str[i], useBoldPen);
+        } else if (_lineCharAtlas.draw(painter, rect, str[i], useBoldPen)) {
+            _renderStatistics.lineCharAtlasHits++;
+        } else {
+            _renderStatistics.lineCharAtlasMisses++;
+        }
     }
+    _renderStatistics.lineCharAtlasBytes = _lineCharAtlas.memory();
 }
 
 void TerminalDisplay::setKeyboardCursorShape(Enum::CursorShapeEnum shape)
@@ -798,10 +829,17 @@ void TerminalDisplay::drawCharacters(QPainter& painter,
         // This still allows RTL characters to be rendered in the RTL way.
         painter.setLayoutDirection(Qt::LeftToRight);
 
-        if (_bidiEnabled) {
-            painter.drawText(rect.x(), rect.y() + _fontAscent + _lineSpacing, text);
+        const QString drawnText = _bidiEnabled ? text : LTR_OVERRIDE_CHAR + text;
+        const QPoint baseline(rect.x(), rect.y() + _fontAscent + _lineSpacing);
+
+        // text drawn on the screen is shaped once and then drawn from the
+        // cache, printers use their own font metrics
+        if (painter.device()->devType() == QInternal::Printer) {
+            painter.drawText(baseline, drawnText);
+        } else if (_glyphRunCache.drawText(painter, baseline, drawnText)) {
+            _renderStatistics.glyphRunCacheHits++;
         } else {
-            painter.drawText(rect.x(), rect.y() + _fontAscent + _lineSpacing, LTR_OVERRIDE_CHAR + text);
+            _renderStatistics.glyphRunCacheMisses++;
         }
     }
     painter.setClipRegion(origClipRegion);
@@ -813,6 +851,8 @@ void TerminalDisplay::drawTextFragment(QPainter& painter ,
                                        const QString& text,
                                        const Character* style)
 {
+    _renderStatistics.textFragments++;
+
     // setup painter
     const QColor foregroundColor = style->foregroundColor.color(_colorTable);
     const QColor backgroundColor = style->backgroundColor.color(_colorTable);
@@ -928,7 +968,7 @@ void TerminalDisplay::scrollImage(int lines , const QRect& screenWindowRegion)
 
     const int top = _contentRect.top() + (region.top() * _fontHeight);
     const int linesToMove = region.height() - abs(lines);
-    const int bytesToMove = linesToMove * _columns * sizeof(Character);
+    const int bytesToMove = linesToMove * _columns * sizeof(StylePalette::Cell);
 
     Q_ASSERT(linesToMove > 0);
     Q_ASSERT(bytesToMove > 0);
@@ -1013,7 +1053,13 @@ void TerminalDisplay::processFilters()
     // ScreenWindow emits a scrolled() signal - which will happen before
     // updateImage() is called on the display and therefore _image is
     // out of date at this point
-    _filterChain->setImage(_screenWindow->getImage(),
+    const StylePalette::Cell *cells = _screenWindow->getImage();
+    const QSharedPointer<const StylePalette> styles = _screenWindow->styles();
+    QVector<Character> image(_screenWindow->windowLines() * _screenWindow->windowColumns());
+    for (int i = 0; i < image.size(); i++) {
+        image[i] = styles->character(cells[i]);
+    }
+    _filterChain->setImage(image.constData(),
                            _screenWindow->windowLines(),
                            _screenWindow->windowColumns(),
                            _screenWindow->getLineProperties());
@@ -1025,19 +1071,33 @@ void TerminalDisplay::processFilters()
     _filterUpdateRequired = false;
 }
 
+void TerminalDisplay::updateFilters()
+{
+    _filterUpdateRequired = true;
+    processFilters();
+}
+
 void TerminalDisplay::updateImage()
 {
     if (_screenWindow.isNull()) {
         return;
     }
 
+    // take a consistent image of the screen if the output is
+    // processed in another thread
+    QMutexLocker locker(_screenWindow->lock());
+
     // optimization - scroll the existing image where possible and
     // avoid expensive text drawing for parts of the image that
     // can simply be moved up or down
     // disable this shortcut for transparent konsole with scaled pixels, otherwise we get rendering artifacts, see BUG 350651
+    QRect scrolledRegion;
     if (!(WindowSystemInfo::HAVE_TRANSPARENCY && (qApp->devicePixelRatio() > 1.0)) && _wallpaper->isNull() && !_searchBar->isVisible()) {
+        if (_screenWindow->scrollCount() != 0) {
+            scrolledRegion = _screenWindow->scrollRegion();
+        }
         scrollImage(_screenWindow->scrollCount() ,
-                    _screenWindow->scrollRegion());
+                    scrolledRegion);
     }
 
     if (_image == nullptr) {
@@ -1046,8 +1106,16 @@ void TerminalDisplay::updateImage()
         updateImageSize();
     }
 
-    Character* const newimg = _screenWindow->getImage();
+    StylePalette::Cell* const newimg = _screenWindow->getImage();
     const int lines = _screenWindow->windowLines();
+
+    // cells only compare within a palette, the whole image is redrawn
+    // when the screen window uses another one
+    const bool stylesChanged = _screenWindow->styles() != _styles;
+    if (stylesChanged) {
+        _styles = _screenWindow->styles();
+        clearImage();
+    }
     const int columns = _screenWindow->windowColumns();
 
     setScroll(_screenWindow->currentLine() , _screenWindow->lineCount());
@@ -1055,19 +1123,17 @@ void TerminalDisplay::updateImage()
     Q_ASSERT(_usedLines <= _lines);
     Q_ASSERT(_usedColumns <= _columns);
 
-    int y, x, len;
+    int y, x;
 
     const QPoint tL  = contentsRect().topLeft();
     const int    tLx = tL.x();
     const int    tLy = tL.y();
     _hasTextBlinker = false;
 
-    CharacterColor cf;       // undefined
-
     const int linesToUpdate = qMin(_lines, qMax(0, lines));
     const int columnsToUpdate = qMin(_columns, qMax(0, columns));
 
-    auto dirtyMask = new char[columnsToUpdate + 2];
+    auto dirtyMask = new char[columnsToUpdate];
     QRegion dirtyRegion;
 
     // debugging variable, this records the number of lines that are found to
@@ -1076,72 +1142,30 @@ void TerminalDisplay::updateImage()
     int dirtyLineCount = 0;
 
     for (y = 0; y < linesToUpdate; ++y) {
-        const Character* currentLine = &_image[y * _columns];
-        const Character* const newLine = &newimg[y * columns];
+        const StylePalette::Cell* currentLine = &_image[y * _columns];
+        const StylePalette::Cell* const newLine = &newimg[y * columns];
+
+        // lines which the screen window did not change since the last
+        // update are still the same in _image, unless they were scrolled
+        if (_imageGeneration != 0 && !stylesChanged && !_screenWindow->isLineChanged(y, _imageGeneration)
+            && (y < scrolledRegion.top() || y > scrolledRegion.bottom())
+            && (_lineProperties.count() <= y || (_lineProperties[y] & LINE_DOUBLEHEIGHT) == 0)) {
+            _hasTextBlinker |= _blinkingLines.testBit(y);
+            continue;
+        }
 
         bool updateLine = false;
-
-        // The dirty mask indicates which characters need repainting. We also
-        // mark surrounding neighbors dirty, in case the character exceeds
-        // its cell boundaries
-        memset(dirtyMask, 0, columnsToUpdate + 2);
-
-        for (x = 0 ; x < columnsToUpdate ; ++x) {
-            if (newLine[x] != currentLine[x]) {
-                dirtyMask[x] = 1;
-            }
-        }
+        bool lineHasBlinker = false;
 
         if (!_resizing) { // not while _resizing, we're expecting a paintEvent
-            for (x = 0; x < columnsToUpdate; ++x) {
-                _hasTextBlinker |= (newLine[x].rendition & RE_BLINK);
-
-                // Start drawing if this character or the next one differs.
-                // We also take the next one into account to handle the situation
-                // where characters exceed their cell width.
-                if (dirtyMask[x] != 0) {
-                    if (newLine[x + 0].character == 0u) {
-                        continue;
-                    }
-                    const bool lineDraw = LineBlockCharacters::canDraw(newLine[x + 0].character);
-                    const bool doubleWidth = (x + 1 == columnsToUpdate) ? false : (newLine[x + 1].character == 0);
-                    const RenditionFlags cr = newLine[x].rendition;
-                    const CharacterColor clipboard = newLine[x].backgroundColor;
-                    if (newLine[x].foregroundColor != cf) {
-                        cf = newLine[x].foregroundColor;
-                    }
-                    const int lln = columnsToUpdate - x;
-                    for (len = 1; len < lln; ++len) {
-                        const Character& ch = newLine[x + len];
-
-                        if (ch.character == 0u) {
-                            continue; // Skip trailing part of multi-col chars.
-                        }
-
-                        const bool nextIsDoubleWidth = (x + len + 1 == columnsToUpdate) ? false : (newLine[x + len + 1].character == 0);
-
-                        if (ch.foregroundColor != cf ||
-                                ch.backgroundColor != clipboard ||
-                                (ch.rendition & ~RE_EXTENDED_CHAR) != (cr & ~RE_EXTENDED_CHAR) ||
-                                (dirtyMask[x + len] == 0) ||
-                                LineBlockCharacters::canDraw(ch.character) != lineDraw ||
-                                nextIsDoubleWidth != doubleWidth) {
-                            break;
-                        }
-                    }
-
-                    const bool saveFixedFont = _fixedFont;
-                    if (lineDraw) {
-                        _fixedFont = false;
-                    }
-                    if (doubleWidth) {
-                        _fixedFont = false;
-                    }
-
-                    updateLine = true;
-
-                    _fixedFont = saveFixedFont;
-                    x += len - 1;
+            if (!stylesChanged && LineDiff::compare(newLine, currentLine, columnsToUpdate, dirtyMask) == 0) {
+                lineHasBlinker = _blinkingLines.testBit(y);
+            } else {
+                // repaint the line if a character which is not the trailing
+                // part of a double width character differs
+                for (x = 0; x < columnsToUpdate; ++x) {
+                    lineHasBlinker |= (_styles->style(newLine[x].style).rendition & RE_BLINK) != 0;
+                    updateLine |= stylesChanged || (dirtyMask[x] != 0 && newLine[x].character != 0u);
                 }
             }
         }
@@ -1171,7 +1195,10 @@ void TerminalDisplay::updateImage()
 
         // replace the line of characters in the old _image with the
         // current line of the new _image
-        memcpy((void*)currentLine, (const void*)newLine, columnsToUpdate * sizeof(Character));
+        memcpy((void*)currentLine, (const void*)newLine, columnsToUpdate * sizeof(StylePalette::Cell));
+
+        _blinkingLines.setBit(y, lineHasBlinker);
+        _hasTextBlinker |= lineHasBlinker;
     }
 
     // if the new _image is smaller than the previous _image, then ensure that the area
@@ -1192,6 +1219,9 @@ void TerminalDisplay::updateImage()
     }
     _usedColumns = columnsToUpdate;
 
+    // _image only follows the image of the screen window if it holds all of it
+    _imageGeneration = linesToUpdate == lines && columnsToUpdate == columns ? _screenWindow->imageGeneration() : 0;
+
     dirtyRegion |= _inputMethodData.previousPreeditRect;
 
     if ((_screenWindow->currentResultLine() != -1) && (_screenWindow->scrollCount() != 0)) {
@@ -1203,6 +1233,8 @@ void TerminalDisplay::updateImage()
     }
     _screenWindow->resetScrollCount();
 
+    _renderStatistics.dirtyLines += dirtyLineCount;
+    _renderStatistics.dirtyRegion |= dirtyRegion;
 
     // update the parts of the display which have changed
     update(dirtyRegion);
@@ -1224,6 +1256,17 @@ void TerminalDisplay::updateImage()
 #endif
 }
 
+void TerminalDisplay::resetRenderStatistics()
+{
+    _renderStatistics = RenderStatistics();
+}
+
+void TerminalDisplay::resetDirtyStatistics()
+{
+    _renderStatistics.dirtyLines = 0;
+    _renderStatistics.dirtyRegion = QRegion();
+}
+
 void TerminalDisplay::showResizeNotification()
 {
     if (_showTerminalSizeHint && isVisible()) {
@@ -1332,7 +1375,7 @@ void TerminalDisplay::paintFilters(QPainter& painter)
     int cursorColumn;
 
     getCharacterPosition(cursorPos, cursorLine, cursorColumn, false);
-    Character cursorCharacter = _image[loc(qMin(cursorColumn, _columns - 1), cursorLine)];
+    const Character cursorCharacter = _styles->character(_image[loc(qMin(cursorColumn, _columns - 1), cursorLine)]);
 
     painter.setPen(QPen(cursorCharacter.foregroundColor.color(_colorTable)));
 
@@ -1404,7 +1447,7 @@ void TerminalDisplay::paintFilters(QPainter& painter)
             }
 
             // ignore whitespace at the end of the lines
-            while (_image[loc(endColumn, line)].isSpace() && endColumn > 0) {
+            while (_styles->character(_image[loc(endColumn, line)]).isSpace() && endColumn > 0) {
                 endColumn--;
             }
 
@@ -1460,13 +1503,13 @@ void TerminalDisplay::paintFilters(QPainter& painter)
     }
 }
 
-inline static bool isRtl(const Character &chr) {
+inline static bool isRtl(const StylePalette::Cell &chr) {
     uint c = 0;
-    if ((chr.rendition & RE_EXTENDED_CHAR) == 0) {
+    if (chr.extended == 0) {
         c = chr.character;
     } else {
         ushort extendedCharLength = 0;
-        const uint* chars = ExtendedCharTable::instance.lookupExtendedChar(chr.character, extendedCharLength);
+        const uint* chars = GraphemePool::lookup(chr.character, extendedCharLength);
         if (chars != nullptr) {
             c = chars[0];
         }
@@ -1504,10 +1547,10 @@ void TerminalDisplay::drawContents(QPainter& paint, const QRect& rect)
             uint *disstrU = univec.data();
 
             // is this a single character or a sequence of characters ?
-            if ((_image[loc(x, y)].rendition & RE_EXTENDED_CHAR) != 0) {
+            if (_image[loc(x, y)].extended != 0) {
                 // sequence of characters
                 ushort extendedCharLength = 0;
-                const uint* chars = ExtendedCharTable::instance.lookupExtendedChar(_image[loc(x, y)].character, extendedCharLength);
+                const uint* chars = GraphemePool::lookup(_image[loc(x, y)].character, extendedCharLength);
                 if (chars != nullptr) {
                     Q_ASSERT(extendedCharLength > 1);
                     bufferSize += extendedCharLength - 1;
@@ -1529,19 +1572,16 @@ void TerminalDisplay::drawContents(QPainter& paint, const QRect& rect)
 
             const bool lineDraw = LineBlockCharacters::canDraw(_image[loc(x, y)].character);
             const bool doubleWidth = (_image[qMin(loc(x, y) + 1, _imageSize - 1)].character == 0);
-            const CharacterColor currentForeground = _image[loc(x, y)].foregroundColor;
-            const CharacterColor currentBackground = _image[loc(x, y)].backgroundColor;
-            const RenditionFlags currentRendition = _image[loc(x, y)].rendition;
+            const quint32 currentStyle = _image[loc(x, y)].style;
+            const Character &currentCharacterStyle = _styles->style(currentStyle);
             const bool rtl = isRtl(_image[loc(x, y)]);
 
             const auto isInsideDrawArea = [&](int column) { return column <= rect.right(); };
-            const auto hasSameColors = [&](int column) {
-                return _image[loc(column, y)].foregroundColor == currentForeground
-                    && _image[loc(column, y)].backgroundColor == currentBackground;
-            };
-            const auto hasSameRendition = [&](int column) {
-                return (_image[loc(column, y)].rendition & ~RE_EXTENDED_CHAR)
-                    == (currentRendition & ~RE_EXTENDED_CHAR);
+            // the IDs of the styles mostly tell, styles with other IDs may
+            // still only differ in whether the characters are real
+            const auto hasSameStyle = [&](int column) {
+                const quint32 style = _image[loc(column, y)].style;
+                return style == currentStyle || _styles->style(style).equalsFormat(currentCharacterStyle);
             };
             const auto hasSameWidth = [&](int column) {
                 const int characterLoc = qMin(loc(column, y) + 1, _imageSize - 1);
@@ -1552,14 +1592,13 @@ void TerminalDisplay::drawContents(QPainter& paint, const QRect& rect)
             };
 
             if (canBeGrouped(x)) {
-                while (isInsideDrawArea(x + len) && hasSameColors(x + len)
-                        && hasSameRendition(x + len) && hasSameWidth(x + len)
-                        && canBeGrouped(x + len)) {
+                while (isInsideDrawArea(x + len) && hasSameStyle(x + len)
+                        && hasSameWidth(x + len) && canBeGrouped(x + len)) {
                     const uint c = _image[loc(x + len, y)].character;
-                    if ((_image[loc(x + len, y)].rendition & RE_EXTENDED_CHAR) != 0) {
+                    if (_image[loc(x + len, y)].extended != 0) {
                         // sequence of characters
                         ushort extendedCharLength = 0;
-                        const uint* chars = ExtendedCharTable::instance.lookupExtendedChar(c, extendedCharLength);
+                        const uint* chars = GraphemePool::lookup(c, extendedCharLength);
                         if (chars != nullptr) {
                             Q_ASSERT(extendedCharLength > 1);
                             bufferSize += extendedCharLength - 1;
@@ -1587,8 +1626,7 @@ void TerminalDisplay::drawContents(QPainter& paint, const QRect& rect)
                 // Group spaces following any non-wide character with the character. This allows for
                 // rendering ambiguous characters with wide glyphs without clipping them.
                 while (!doubleWidth && isInsideDrawArea(x + len)
-                        && _image[loc(x + len, y)].character == ' ' && hasSameColors(x + len)
-                        && hasSameRendition(x + len)) {
+                        && _image[loc(x + len, y)].character == ' ' && hasSameStyle(x + len)) {
                     // disstrU intentionally not modified - trailing spaces are meaningless
                     len++;
                 }
@@ -1643,12 +1681,12 @@ void TerminalDisplay::drawContents(QPainter& paint, const QRect& rect)
                 drawPrinterFriendlyTextFragment(paint,
                                                 textArea,
                                                 unistr,
-                                                &_image[loc(x, y)]);
+                                                &currentCharacterStyle);
             } else {
                 drawTextFragment(paint,
                                  textArea,
                                  unistr,
-                                 &_image[loc(x, y)]);
+                                 &currentCharacterStyle);
             }
 
             _fixedFont = save__fixedFont;
@@ -1674,6 +1712,16 @@ void TerminalDisplay::drawContents(QPainter& paint, const QRect& rect)
 
 void TerminalDisplay::drawCurrentResultRect(QPainter& painter)
 {
+    // the other lines with a match of the search
+    const int currentLine = _screenWindow->currentLine();
+    const QVector<int> resultLines = _screenWindow->resultLines(currentLine, currentLine + _lines - 1);
+    for (const int line : resultLines) {
+        if (line != _screenWindow->currentResultLine()) {
+            painter.fillRect(0, _contentRect.top() + (line - currentLine) * _fontHeight,
+                             _columns * _fontWidth, _fontHeight, QColor(0, 0, 255, 40));
+        }
+    }
+
     if(_screenWindow->currentResultLine() == -1) {
         return;
     }
@@ -1813,7 +1861,7 @@ void TerminalDisplay::updateCursor()
     const int cursorLocation = loc(cursorPosition().x(), cursorPosition().y());
     Q_ASSERT(cursorLocation < _imageSize);
 
-    int charWidth = _image[cursorLocation].width();
+    int charWidth = Character::width(_image[cursorLocation].character);
     QRect cursorRect = imageToWidget(QRect(cursorPosition(), QSize(charWidth, 1)));
     update(cursorRect);
 }
@@ -1842,7 +1890,7 @@ void TerminalDisplay::propagateSize()
 
 void TerminalDisplay::updateImageSize()
 {
-    Character* oldImage = _image;
+    StylePalette::Cell* oldImage = _image;
     const int oldLines = _lines;
     const int oldColumns = _columns;
 
@@ -1855,7 +1903,7 @@ void TerminalDisplay::updateImageSize()
         for (int line = 0; line < lines; line++) {
             memcpy((void*)&_image[_columns * line],
                    (void*)&oldImage[oldColumns * line],
-                   columns * sizeof(Character));
+                   columns * sizeof(StylePalette::Cell));
         }
         delete[] oldImage;
     }
@@ -1887,16 +1935,16 @@ void TerminalDisplay::makeImage()
 
     _imageSize = _lines * _columns;
 
-    _image = new Character[_imageSize];
+    _image = new StylePalette::Cell[_imageSize];
+    _imageGeneration = 0;
+    _blinkingLines.fill(false, _lines);
 
     clearImage();
 }
 
 void TerminalDisplay::clearImage()
 {
-    for (int i = 0; i < _imageSize; ++i) {
-        _image[i] = Screen::DefaultChar;
-    }
+    Screen::fillWithDefaultChar(_image, _imageSize);
 }
 
 void TerminalDisplay::calcGeometry()
@@ -2666,7 +2714,10 @@ void TerminalDisplay::wheelEvent(QWheelEvent* ev)
             QKeyEvent keyEvent(QEvent::KeyPress, keyCode, Qt::NoModifier);
 
             for (int i = 0; i < abs(lines); i++) {
-                _screenWindow->screen()->setCurrentTerminalDisplay(this);
+                {
+                    QMutexLocker locker(_screenWindow->lock());
+                    _screenWindow->screen()->setCurrentTerminalDisplay(this);
+                }
                 emit keyPressedSignal(&keyEvent);
             }
         } else if (_usesMouseTracking) {
@@ -2699,6 +2750,7 @@ void TerminalDisplay::viewScrolledByUser()
 */
 QPoint TerminalDisplay::findLineStart(const QPoint &pnt)
 {
+    QMutexLocker locker(_screenWindow->lock());
     const int visibleScreenLines = _lineProperties.size();
     const int topVisibleLine = _screenWindow->currentLine();
     Screen *screen = _screenWindow->screen();
@@ -2732,6 +2784,7 @@ QPoint TerminalDisplay::findLineStart(const QPoint &pnt)
 */
 QPoint TerminalDisplay::findLineEnd(const QPoint &pnt)
 {
+    QMutexLocker locker(_screenWindow->lock());
     const int visibleScreenLines = _lineProperties.size();
     const int topVisibleLine = _screenWindow->currentLine();
     const int maxY = _screenWindow->lineCount() - 1;
@@ -2757,12 +2810,13 @@ QPoint TerminalDisplay::findLineEnd(const QPoint &pnt)
 
 QPoint TerminalDisplay::findWordStart(const QPoint &pnt)
 {
+    QMutexLocker locker(_screenWindow->lock());
     const int regSize = qMax(_screenWindow->windowLines(), 10);
     const int firstVisibleLine = _screenWindow->currentLine();
 
     Screen *screen = _screenWindow->screen();
-    Character *image = _image;
-    Character *tmp_image = nullptr;
+    StylePalette::Cell *image = _image;
+    StylePalette::Cell *tmp_image = nullptr;
 
     int imgLine = pnt.y();
     int x = pnt.x();
@@ -2812,7 +2866,7 @@ QPoint TerminalDisplay::findWordStart(const QPoint &pnt)
         imgLine = y - newRegStart;
 
         delete[] tmp_image;
-        tmp_image = new Character[imageSize];
+        tmp_image = new StylePalette::Cell[imageSize];
         image = tmp_image;
 
         screen->getImage(tmp_image, imageSize, newRegStart, y - 1);
@@ -2829,6 +2883,7 @@ out:
 
 QPoint TerminalDisplay::findWordEnd(const QPoint &pnt)
 {
+    QMutexLocker locker(_screenWindow->lock());
     const int regSize = qMax(_screenWindow->windowLines(), 10);
     const int curLine = _screenWindow->currentLine();
     int i = pnt.y();
@@ -2837,8 +2892,8 @@ QPoint TerminalDisplay::findWordEnd(const QPoint &pnt)
     int j = loc(x, i);
     QVector<LineProperty> lineProperties = _lineProperties;
     Screen *screen = _screenWindow->screen();
-    Character *image = _image;
-    Character *tmp_image = nullptr;
+    StylePalette::Cell *image = _image;
+    StylePalette::Cell *tmp_image = nullptr;
     const QChar selClass = charClass(image[j]);
     const int imageSize = regSize * _columns;
     const int maxY = _screenWindow->lineCount() - 1;
@@ -2878,7 +2933,7 @@ QPoint TerminalDisplay::findWordEnd(const QPoint &pnt)
         lineProperties = screen->getLineProperties(y, newRegEnd);
         i = 0;
         if (tmp_image == nullptr) {
-            tmp_image = new Character[imageSize];
+            tmp_image = new StylePalette::Cell[imageSize];
             image = tmp_image;
         }
         screen->getImage(tmp_image, imageSize, y, newRegEnd);
@@ -2888,7 +2943,7 @@ QPoint TerminalDisplay::findWordEnd(const QPoint &pnt)
 out:
     y -= curLine;
     // In word selection mode don't select @ (64) if at end of word.
-    if (((image[j].rendition & RE_EXTENDED_CHAR) == 0) &&
+    if ((image[j].extended == 0) &&
         (QChar(image[j].character) == QLatin1Char('@')) &&
         (y > pnt.y() || x > pnt.x())) {
         if (x > 0) {
@@ -2990,11 +3045,11 @@ bool TerminalDisplay::focusNextPrevChild(bool next)
     }
 }
 
-QChar TerminalDisplay::charClass(const Character& ch) const
+QChar TerminalDisplay::charClass(const StylePalette::Cell& ch) const
 {
-    if ((ch.rendition & RE_EXTENDED_CHAR) != 0) {
+    if (ch.extended != 0) {
         ushort extendedCharLength = 0;
-        const uint* chars = ExtendedCharTable::instance.lookupExtendedChar(ch.character, extendedCharLength);
+        const uint* chars = GraphemePool::lookup(ch.character, extendedCharLength);
         if ((chars != nullptr) && extendedCharLength > 0) {
             const QString s = QString::fromUcs4(chars, extendedCharLength);
             if (_wordCharacters.contains(s, Qt::CaseInsensitive)) {
@@ -3287,7 +3342,11 @@ QVariant TerminalDisplay::inputMethodQuery(Qt::InputMethodQuery query) const
         PlainTextDecoder decoder;
         decoder.begin(&stream);
         if (isCursorOnDisplay()) {
-            decoder.decodeLine(&_image[loc(0, cursorPos.y())], _usedColumns, LINE_DEFAULT);
+            QVector<Character> line(_usedColumns);
+            for (int x = 0; x < _usedColumns; x++) {
+                line[x] = _styles->character(_image[loc(x, cursorPos.y())]);
+            }
+            decoder.decodeLine(line.constData(), line.size(), LINE_DEFAULT);
         }
         decoder.end();
         return lineText;
@@ -3327,7 +3386,7 @@ void TerminalDisplay::drawInputMethodPreeditString(QPainter& painter , const QRe
     bool invertColors = false;
     const QColor background = _colorTable[DEFAULT_BACK_COLOR];
     const QColor foreground = _colorTable[DEFAULT_FORE_COLOR];
-    const Character* style = &_image[loc(cursorPos.x(), cursorPos.y())];
+    const Character* style = &_styles->style(_image[loc(cursorPos.x(), cursorPos.y())].style);
 
     drawBackground(painter, rect, background, true);
     drawCursor(painter, rect, foreground, background, invertColors);
@@ -3443,7 +3502,10 @@ void TerminalDisplay::keyPressEvent(QKeyEvent* event)
         }
     }
 
-    _screenWindow->screen()->setCurrentTerminalDisplay(this);
+    {
+        QMutexLocker locker(_screenWindow->lock());
+        _screenWindow->screen()->setCurrentTerminalDisplay(this);
+    }
 
     if (!_readOnly) {
         _actSel = 0; // Key stroke implies a screen update, so TerminalDisplay won't
@@ -3467,7 +3529,11 @@ void TerminalDisplay::keyPressEvent(QKeyEvent* event)
 
 #ifndef QT_NO_ACCESSIBILITY
     if (!_readOnly) {
-        QAccessibleTextCursorEvent textCursorEvent(this, _usedColumns * screenWindow()->screen()->getCursorY() + screenWindow()->screen()->getCursorX());
+        QMutexLocker locker(_screenWindow->lock());
+        const int cursorOffset = _usedColumns * screenWindow()->screen()->getCursorY() + screenWindow()->screen()->getCursorX();
+        locker.unlock();
+
+        QAccessibleTextCursorEvent textCursorEvent(this, cursorOffset);
         QAccessible::updateAccessibility(&textCursorEvent);
     }
 #endif
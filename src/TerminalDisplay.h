@@ -22,8 +22,11 @@
 #define TERMINALDISPLAY_H
 
 // Qt
+#include <QBitArray>
 #include <QColor>
 #include <QPointer>
+#include <QRegion>
+#include <QSharedPointer>
 #include <QWidget>
 
 // Konsole
@@ -32,7 +35,10 @@
 #include "ScreenWindow.h"
 #include "ColorScheme.h"
 #include "Enumeration.h"
+#include "GlyphRunCache.h"
+#include "LineBlockCharacters.h"
 #include "ScrollState.h"
+#include "StylePalette.h"
 #include "Profile.h"
 
 class QDrag;
@@ -142,6 +148,12 @@ public:
      */
     void processFilters();
 
+    /**
+     * Updates the filters although the image did not change, for filters
+     * whose hotspots depend on more than the text.
+     */
+    void updateFilters();
+
     /**
      * Returns a list of menu actions created by the filters for the content
      * at the given @p position.
@@ -353,6 +365,32 @@ public:
     /** See setAlternateScrolling() */
     bool alternateScrolling() const;
 
+    /**
+     * Counters of the rendering work, used by the rendering benchmark.
+     * The counters accumulate until resetRenderStatistics() is called,
+     * the dirty lines and region until resetDirtyStatistics() is called.
+     */
+    struct RenderStatistics {
+        int dirtyLines = 0;          // lines changed by updateImage()
+        QRegion dirtyRegion;         // area invalidated by updateImage()
+        int textFragments = 0;       // runs drawn by drawTextFragment()
+        int lineCharFragments = 0;   // runs of line graphics drawn by drawLineCharString()
+        int glyphRunCacheHits = 0;   // texts drawn from the glyph run cache
+        int glyphRunCacheMisses = 0; // texts shaped before they were drawn
+        int lineCharAtlasHits = 0;   // line graphics copied from the atlas
+        int lineCharAtlasMisses = 0; // line graphics rasterized before they were copied
+        int lineCharAtlasBytes = 0;  // memory taken by the atlas
+    };
+
+    const RenderStatistics &renderStatistics() const
+    {
+        return _renderStatistics;
+    }
+
+    void resetRenderStatistics();
+    /** Clears the dirty lines and region, eg. after a frame was recorded. */
+    void resetDirtyStatistics();
+
 public Q_SLOTS:
     /**
      * Scrolls current ScreenWindow
@@ -567,7 +605,7 @@ protected:
     //     - A space (returns ' ')
     //     - Part of a word (returns 'a')
     //     - Other characters (returns the input character)
-    QChar charClass(const Character &ch) const;
+    QChar charClass(const StylePalette::Cell &ch) const;
 
     void clearImage();
 
@@ -603,7 +641,8 @@ private:
     // drawTextFragment() or drawPrinterFriendlyTextFragment()
     // to draw the fragments
     void drawContents(QPainter &painter, const QRect &rect);
-    // draw a transparent rectangle over the line of the current match
+    // draw transparent rectangles over the lines with a match, the one of
+    // the current match stronger than the others
     void drawCurrentResultRect(QPainter &painter);
     // draws a section of text, all the text in this section
     // has a common color and style
@@ -722,11 +761,17 @@ private:
     // than the maximum image size which can be displayed
 
     QRect _contentRect;
-    Character *_image; // [lines][columns]
+    StylePalette::Cell *_image; // [lines][columns]
     // only the area [usedLines][usedColumns] in the image contains valid data
+    // the palette of the styles of _image, see ScreenWindow::styles()
+    QSharedPointer<const StylePalette> _styles;
 
     int _imageSize;
     QVector<LineProperty> _lineProperties;
+    // the generation of the screen window image which _image shows, or 0
+    // if any line may differ, see ScreenWindow::isLineChanged()
+    quint64 _imageGeneration;
+    QBitArray _blinkingLines; // the lines of _image with blinking characters
 
     ColorEntry _colorTable[TABLE_COLORS];
 
@@ -847,6 +892,9 @@ private:
     IncrementalSearchBar *_searchBar;
 
     QRect _searchResultRect;
+    RenderStatistics _renderStatistics;
+    GlyphRunCache _glyphRunCache;
+    LineBlockCharacters::Atlas _lineCharAtlas;
     friend class TerminalDisplayAccessible;
 };
 
@@ -21,7 +21,9 @@
 
 #include "TerminalDisplayAccessible.h"
 #include "SessionController.h"
+#include "ScreenWindow.h"
 #include <klocalizedstring.h>
+#include <QMutexLocker>
 
 using namespace Konsole;
 
@@ -49,6 +51,8 @@ int TerminalDisplayAccessible::cursorPosition() const
         return 0;
     }
 
+    // the screen may be changed by an emulation thread meanwhile
+    QMutexLocker locker(display()->screenWindow()->lock());
     int offset = display()->_usedColumns * display()->screenWindow()->screen()->getCursorY();
     return offset + display()->screenWindow()->screen()->getCursorX();
 }
@@ -98,6 +102,7 @@ QString TerminalDisplayAccessible::visibleText() const
         return QString();
     }
 
+    QMutexLocker locker(display->screenWindow()->lock());
     return display->screenWindow()->screen()->text(0, display->_usedColumns * display->_usedLines, Screen::PreserveLineBreaks);
 }
 
@@ -158,6 +163,7 @@ void TerminalDisplayAccessible::setCursorPosition(int position)
         return;
     }
 
+    QMutexLocker locker(display()->screenWindow()->lock());
     display()->screenWindow()->screen()->setCursorYX(lineForOffset(position),
                                                      columnForOffset(position));
 }
@@ -185,6 +191,7 @@ QString TerminalDisplayAccessible::text(int startOffset, int endOffset) const
         return QString();
     }
 
+    QMutexLocker locker(display()->screenWindow()->lock());
     return display()->screenWindow()->screen()->text(startOffset, endOffset, Screen::PreserveLineBreaks);
 }
 
@@ -31,6 +31,7 @@
 #include <QEvent>
 #include <QTimer>
 #include <QKeyEvent>
+#include <QMutexLocker>
 
 // KDE
 #include <KLocalizedString>
@@ -66,6 +67,7 @@ unsigned short Konsole::vt100_graphics[32] = {
 
 Vt102Emulation::Vt102Emulation() :
     Emulation(),
+    _parserState(Ground),
     _currentModes(TerminalState()),
     _savedModes(TerminalState()),
     _pendingSessionAttributesUpdates(QHash<int, QString>()),
@@ -76,7 +78,7 @@ Vt102Emulation::Vt102Emulation() :
     QObject::connect(_sessionAttributesUpdateTimer, &QTimer::timeout, this,
                      &Konsole::Vt102Emulation::updateSessionAttributes);
 
-    initTokenizer();
+    resetTokenizer();
     reset();
 }
 
@@ -84,12 +86,15 @@ Vt102Emulation::~Vt102Emulation() = default;
 
 void Vt102Emulation::clearEntireScreen()
 {
+    QMutexLocker locker(lock());
     _currentScreen->clearEntireScreen();
     bufferedUpdate();
 }
 
 void Vt102Emulation::reset()
 {
+    QMutexLocker locker(lock());
+
     // Save the current codec so we can set it later.
     // Ideally we would want to use the profile setting
     const QTextCodec *currentCodec = codec();
@@ -237,17 +242,20 @@ const int MAX_ARGUMENT = 4096;
 
 /* The tokenizer's state
 
-   The state is represented by the buffer (tokenBuffer, tokenBufferPos),
-   and accompanied by decoded arguments kept in (argv,argc).
+   The state is represented by the parser state (_parserState) and the
+   buffer (tokenBuffer, tokenBufferPos), and accompanied by decoded
+   arguments kept in (argv,argc).
    Note that they are kept internal in the tokenizer.
 */
 
 void Vt102Emulation::resetTokenizer()
 {
+    _parserState = Ground;
     tokenBufferPos = 0;
     argc = 0;
     argv[0] = 0;
     argv[1] = 0;
+    argv[2] = 0;
 }
 
 void Vt102Emulation::addDigit(int digit)
@@ -269,206 +277,512 @@ void Vt102Emulation::addToCurrentToken(int cc)
     tokenBufferPos = qMin(tokenBufferPos + 1, MAX_TOKEN_LENGTH - 1);
 }
 
-// Character Class flags used while decoding
-const int CTL = 1;   // Control character
-const int CHR = 2;   // Printable character
-const int CPN = 4;   // TODO: Document me
-const int DIG = 8;   // Digit
-const int SCS = 16;  // Select Character Set
-const int GRP = 32;  // TODO: Document me
-const int CPS = 64;  // Character which indicates end of window resize
+/* The parser
+
+   The tokenizer is a state machine after the DEC ANSI parser described by
+   Paul Williams (https://vt100.net/emu/dec_ansi_parser).  Every incoming
+   character is mapped to a character class, and the pair of the current
+   state and this class looks up an action and the next state in a
+   transition table.  Both tables are generated at compile time from the
+   rules below.
+
+   All characters of an escape sequence are kept in the token buffer, so
+   that the dispatch functions can look at the private marker and the
+   intermediate characters, and the whole sequence is available for OSC
+   strings and error reports.  Numeric parameters are accumulated in argv
+   as they arrive.
+
+   The VT52 mode is simple enough to be handled by receiveVt52Char().
+*/
+
+namespace {
+
+const int ESC = 27;
+const int CAN = 24;
+const int SUB = 26;
+const int DEL = 127;
+const int CSI8 = 155; // 8-bit C1 control, equivalent to <ESC>'['
+
+enum CharClass {
+    ClassControl = 0,   // C0 controls without special meaning for the parser
+    ClassBell,          // BEL, also terminates OSC strings
+    ClassCancel,        // CAN and SUB, abort the current sequence
+    ClassEscape,        // ESC
+    ClassSpace,         // SP, an intermediate
+    ClassIntermediate,  // ! " # $ % & ' ( ) * + , - . /
+    ClassDigit,         // 0 - 9
+    ClassColon,         // :
+    ClassSemicolon,     // ;
+    ClassPrivate,       // < = > ?
+    ClassCsi,           // [
+    ClassOsc,           // ]
+    ClassDcs,           // P
+    ClassSosPmApc,      // X ^ _
+    ClassFinal,         // the other characters from @ to ~
+    ClassDelete,        // DEL
+    ClassCsi8,          // 8-bit CSI
+    ClassPrintable,     // everything from 0x80 on
+    CharClassCount
+};
+
+enum ParserAction {
+    ActionNone = 0,     // ignore the character
+    ActionPrint,        // display the character
+    ActionExecute,      // process a control character
+    ActionCancel,       // abort the sequence and process the control character
+    ActionClear,        // start a new sequence with the character
+    ActionClearCsi8,    // start a new sequence as <ESC>'['
+    ActionStore,        // append the character to the sequence
+    ActionParam,        // append a digit or parameter separator
+    ActionEscDispatch,  // complete an escape sequence
+    ActionCsiDispatch,  // complete a control sequence
+    ActionIgnore,       // complete a sequence which is not understood
+    ActionOscEnd,       // complete an OSC string
+    ActionOscEndEscape  // complete an OSC string by an ESC starting the ST
+};
 
-void Vt102Emulation::initTokenizer()
+constexpr quint8 transition(int action, int state)
 {
-    int i;
-    quint8 *s;
-    for (i = 0; i < 256; ++i) {
-        charClass[i] = 0;
-    }
-    for (i = 0; i < 32; ++i) {
-        charClass[i] |= CTL;
-    }
-    for (i = 32; i < 256; ++i) {
-        charClass[i] |= CHR;
-    }
-    for (s = (quint8 *)"@ABCDGHILMPSTXZbcdfry"; *s != 0u; ++s) {
-        charClass[*s] |= CPN;
-    }
-    // resize = \e[8;<row>;<col>t
-    for (s = (quint8 *)"t"; *s != 0u; ++s) {
-        charClass[*s] |= CPS;
-    }
-    for (s = (quint8 *)"0123456789"; *s != 0u; ++s) {
-        charClass[*s] |= DIG;
-    }
-    for (s = (quint8 *)"()+*%"; *s != 0u; ++s) {
-        charClass[*s] |= SCS;
-    }
-    for (s = (quint8 *)"()+*#[]%"; *s != 0u; ++s) {
-        charClass[*s] |= GRP;
-    }
+    return static_cast<quint8>((action << 4) | state);
+}
 
-    resetTokenizer();
+constexpr int charClass(int c)
+{
+    return c == 0x07 ? ClassBell
+         : (c == CAN || c == SUB) ? ClassCancel
+         : c == ESC ? ClassEscape
+         : c < 0x20 ? ClassControl
+         : c == 0x20 ? ClassSpace
+         : c < 0x30 ? ClassIntermediate
+         : c < 0x3a ? ClassDigit
+         : c == 0x3a ? ClassColon
+         : c == 0x3b ? ClassSemicolon
+         : c < 0x40 ? ClassPrivate
+         : c == '[' ? ClassCsi
+         : c == ']' ? ClassOsc
+         : c == 'P' ? ClassDcs
+         : (c == 'X' || c == '^' || c == '_') ? ClassSosPmApc
+         : c < DEL ? ClassFinal
+         : c == DEL ? ClassDelete
+         : c == CSI8 ? ClassCsi8
+         : ClassPrintable;
 }
 
-/* Ok, here comes the nasty part of the decoder.
+constexpr bool isControl(int c)
+{
+    return c == ClassControl || c == ClassBell;
+}
 
-   Instead of keeping an explicit state, we deduce it from the
-   token scanned so far. It is then immediately combined with
-   the current character to form a scanning decision.
+constexpr bool isCsiFinal(int c)
+{
+    return c >= ClassCsi && c <= ClassFinal;
+}
 
-   This is done by the following defines.
+// ESC [
+constexpr quint8 escapeTransition(int c)
+{
+    return isControl(c) ? transition(ActionExecute, Vt102Emulation::Escape)
+         : (c == ClassSpace || c == ClassIntermediate) ? transition(ActionStore, Vt102Emulation::EscapeIntermediate)
+         : c == ClassCsi ? transition(ActionStore, Vt102Emulation::CsiEntry)
+         : c == ClassOsc ? transition(ActionStore, Vt102Emulation::OscString)
+         : (c == ClassDcs || c == ClassSosPmApc) ? transition(ActionStore, Vt102Emulation::IgnoreString)
+         : transition(ActionEscDispatch, Vt102Emulation::Ground);
+}
 
-   - P is the length of the token scanned so far.
-   - L (often P-1) is the position on which contents we base a decision.
-   - C is a character or a group of characters (taken from 'charClass').
+// ESC ( B
+constexpr quint8 escapeIntermediateTransition(int c)
+{
+    return isControl(c) ? transition(ActionExecute, Vt102Emulation::EscapeIntermediate)
+         : (c == ClassSpace || c == ClassIntermediate) ? transition(ActionStore, Vt102Emulation::EscapeIntermediate)
+         : transition(ActionEscDispatch, Vt102Emulation::Ground);
+}
 
-   - 'cc' is the current character
-   - 's' is a pointer to the start of the token buffer
-   - 'p' is the current position within the token buffer
+// ESC [ ? 25 h
+constexpr quint8 csiEntryTransition(int c)
+{
+    return isControl(c) ? transition(ActionExecute, Vt102Emulation::CsiEntry)
+         : (c == ClassSpace || c == ClassIntermediate) ? transition(ActionStore, Vt102Emulation::CsiIntermediate)
+         : (c == ClassDigit || c == ClassSemicolon) ? transition(ActionParam, Vt102Emulation::CsiParam)
+         : c == ClassPrivate ? transition(ActionStore, Vt102Emulation::CsiParam)
+         : isCsiFinal(c) ? transition(ActionCsiDispatch, Vt102Emulation::Ground)
+         : transition(ActionStore, Vt102Emulation::CsiIgnore);
+}
 
-   Note that they need to applied in proper order.
-*/
+constexpr quint8 csiParamTransition(int c)
+{
+    return isControl(c) ? transition(ActionExecute, Vt102Emulation::CsiParam)
+         : (c == ClassSpace || c == ClassIntermediate) ? transition(ActionStore, Vt102Emulation::CsiIntermediate)
+         : (c == ClassDigit || c == ClassSemicolon) ? transition(ActionParam, Vt102Emulation::CsiParam)
+         : isCsiFinal(c) ? transition(ActionCsiDispatch, Vt102Emulation::Ground)
+         : transition(ActionStore, Vt102Emulation::CsiIgnore);
+}
 
-#define lec(P,L,C) (p == (P) && s[(L)] == (C))
-#define lun(     ) (p ==  1  && cc >= 32 )
-#define les(P,L,C) (p == (P) && s[L] < 256 && (charClass[s[(L)]] & (C)) == (C))
-#define eec(C)     (p >=  3  && cc == (C))
-#define ees(C)     (p >=  3  && cc < 256 && (charClass[cc] & (C)) == (C))
-#define eps(C)     (p >=  3  && s[2] != '?' && s[2] != '!' && s[2] != '>' && cc < 256 && (charClass[cc] & (C)) == (C))
-#define epp( )     (p >=  3  && s[2] == '?')
-#define epe( )     (p >=  3  && s[2] == '!')
-#define egt( )     (p >=  3  && s[2] == '>')
-#define esp( )     (p >=  4  && s[2] == SP )
-#define epsp( )    (p >=  5  && s[3] == SP )
-#define Xpe        (tokenBufferPos >= 2 && tokenBuffer[1] == ']')
-#define Xte        (Xpe      && (cc ==  7 || cc == 27))
-#define ces(C)     (cc < 256 && (charClass[cc] & (C)) == (C) && !Xte)
-#define dcs        (p >= 2   && s[0] == ESC && s[1] == 'P')
+// ESC [ 2 SP q
+constexpr quint8 csiIntermediateTransition(int c)
+{
+    return isControl(c) ? transition(ActionExecute, Vt102Emulation::CsiIntermediate)
+         : (c == ClassSpace || c == ClassIntermediate) ? transition(ActionStore, Vt102Emulation::CsiIntermediate)
+         : isCsiFinal(c) ? transition(ActionCsiDispatch, Vt102Emulation::Ground)
+         : transition(ActionStore, Vt102Emulation::CsiIgnore);
+}
+
+// malformed control sequences, e.g. with ':' sub-parameters
+constexpr quint8 csiIgnoreTransition(int c)
+{
+    return isControl(c) ? transition(ActionExecute, Vt102Emulation::CsiIgnore)
+         : isCsiFinal(c) ? transition(ActionIgnore, Vt102Emulation::Ground)
+         : transition(ActionStore, Vt102Emulation::CsiIgnore);
+}
+
+// ESC ] 0 ; title BEL
+constexpr quint8 oscStringTransition(int c)
+{
+    return c == ClassBell ? transition(ActionOscEnd, Vt102Emulation::Ground)
+         : c == ClassEscape ? transition(ActionOscEndEscape, Vt102Emulation::Escape)
+         : c == ClassControl ? transition(ActionNone, Vt102Emulation::OscString)
+         : transition(ActionStore, Vt102Emulation::OscString);
+}
+
+constexpr quint8 parserTransition(int state, int c)
+{
+    return c == ClassCancel ? transition(ActionCancel, Vt102Emulation::Ground)
+         : c == ClassDelete ? transition(ActionNone, state)
+         : state == Vt102Emulation::OscString ? oscStringTransition(c)
+         : c == ClassEscape ? transition(ActionClear, Vt102Emulation::Escape)
+         // DCS, SOS, PM and APC strings are not supported and skipped up to the ST
+         : state == Vt102Emulation::IgnoreString ? transition(ActionNone, Vt102Emulation::IgnoreString)
+         : c == ClassCsi8 ? transition(ActionClearCsi8, Vt102Emulation::CsiEntry)
+         : state == Vt102Emulation::Ground ? (isControl(c) ? transition(ActionExecute, Vt102Emulation::Ground)
+                                                           : transition(ActionPrint, Vt102Emulation::Ground))
+         : state == Vt102Emulation::Escape ? escapeTransition(c)
+         : state == Vt102Emulation::EscapeIntermediate ? escapeIntermediateTransition(c)
+         : state == Vt102Emulation::CsiEntry ? csiEntryTransition(c)
+         : state == Vt102Emulation::CsiParam ? csiParamTransition(c)
+         : state == Vt102Emulation::CsiIntermediate ? csiIntermediateTransition(c)
+         : csiIgnoreTransition(c);
+}
+
+#define CHAR_CLASSES_16(c) \
+    charClass((c) + 0),  charClass((c) + 1),  charClass((c) + 2),  charClass((c) + 3),  \
+    charClass((c) + 4),  charClass((c) + 5),  charClass((c) + 6),  charClass((c) + 7),  \
+    charClass((c) + 8),  charClass((c) + 9),  charClass((c) + 10), charClass((c) + 11), \
+    charClass((c) + 12), charClass((c) + 13), charClass((c) + 14), charClass((c) + 15)
+
+// classes of the characters below 0xa0, all others are ClassPrintable
+constexpr quint8 charClasses[0xa0] = {
+    CHAR_CLASSES_16(0x00), CHAR_CLASSES_16(0x10), CHAR_CLASSES_16(0x20), CHAR_CLASSES_16(0x30),
+    CHAR_CLASSES_16(0x40), CHAR_CLASSES_16(0x50), CHAR_CLASSES_16(0x60), CHAR_CLASSES_16(0x70),
+    CHAR_CLASSES_16(0x80), CHAR_CLASSES_16(0x90)
+};
+
+#undef CHAR_CLASSES_16
+
+#define PARSER_TRANSITIONS(s) { \
+    parserTransition((s), 0),  parserTransition((s), 1),  parserTransition((s), 2),  \
+    parserTransition((s), 3),  parserTransition((s), 4),  parserTransition((s), 5),  \
+    parserTransition((s), 6),  parserTransition((s), 7),  parserTransition((s), 8),  \
+    parserTransition((s), 9),  parserTransition((s), 10), parserTransition((s), 11), \
+    parserTransition((s), 12), parserTransition((s), 13), parserTransition((s), 14), \
+    parserTransition((s), 15), parserTransition((s), 16), parserTransition((s), 17)  \
+}
+
+static_assert(CharClassCount == 18, "PARSER_TRANSITIONS has to cover all character classes");
+static_assert(Vt102Emulation::AnsiParserStateCount <= 16, "parser states have to fit into 4 bits");
+
+// the action (high nibble) and next state (low nibble) per [state][class]
+constexpr quint8 parserTransitions[Vt102Emulation::AnsiParserStateCount][CharClassCount] = {
+    PARSER_TRANSITIONS(Vt102Emulation::Ground),
+    PARSER_TRANSITIONS(Vt102Emulation::Escape),
+    PARSER_TRANSITIONS(Vt102Emulation::EscapeIntermediate),
+    PARSER_TRANSITIONS(Vt102Emulation::CsiEntry),
+    PARSER_TRANSITIONS(Vt102Emulation::CsiParam),
+    PARSER_TRANSITIONS(Vt102Emulation::CsiIntermediate),
+    PARSER_TRANSITIONS(Vt102Emulation::CsiIgnore),
+    PARSER_TRANSITIONS(Vt102Emulation::OscString),
+    PARSER_TRANSITIONS(Vt102Emulation::IgnoreString)
+};
+
+#undef PARSER_TRANSITIONS
+
+inline int charClassOf(uint cc)
+{
+    return cc < 0xa0 ? charClasses[cc] : static_cast<int>(ClassPrintable);
+}
+
+// final characters of control sequences which take up to two numeric
+// parameters (token_csi_pn)
+bool isCsiPnFinal(uint cc)
+{
+    switch (cc) {
+    case '@': case 'A': case 'B': case 'C': case 'D': case 'G': case 'H':
+    case 'I': case 'L': case 'M': case 'P': case 'S': case 'T': case 'X':
+    case 'Z': case 'b': case 'c': case 'd': case 'f': case 'r': case 'y':
+        return true;
+    default:
+        return false;
+    }
+}
+
+}
 
 #define CNTL(c) ((c)-'@')
-const int ESC = 27;
-const int DEL = 127;
-const int SP  = 32;
 
 // process an incoming unicode character
 void Vt102Emulation::receiveChar(uint cc)
 {
-  if (cc == DEL) {
-    return; //VT100: ignore.
+  if (!getMode(MODE_Ansi)) {
+    receiveVt52Char(cc);
+    return;
   }
 
-  if (ces(CTL))
-  {
-    // ignore control characters in the text part of Xpe (aka OSC) "ESC]"
-    // escape sequences; this matches what XTERM docs say
-    if (Xpe) {
-        return;
-    }
+  const quint8 next = parserTransitions[_parserState][charClassOf(cc)];
 
+  switch (next >> 4) {
+  case ActionNone:
+    break;
+  case ActionPrint:
+    processToken(token_chr(), applyCharset(cc), 0);
+    break;
+  case ActionExecute:
     // DEC HACK ALERT! Control Characters are allowed *within* esc sequences in VT100
     // This means, they do neither a resetTokenizer() nor a pushToToken(). Some of them, do
     // of course. Guess this originates from a weakly layered handling of the X-on
     // X-off protocol, which comes really below this level.
-    if (cc == CNTL('X') || cc == CNTL('Z') || cc == ESC) {
-        resetTokenizer(); //VT100: CAN or SUB
+    processToken(token_ctl(cc+'@'), 0, 0);
+    break;
+  case ActionCancel:
+    resetTokenizer(); //VT100: CAN or SUB
+    processToken(token_ctl(cc+'@'), 0, 0);
+    break;
+  case ActionClear:
+    resetTokenizer();
+    addToCurrentToken(cc);
+    break;
+  case ActionClearCsi8:
+    resetTokenizer();
+    addToCurrentToken(ESC);
+    addToCurrentToken('[');
+    break;
+  case ActionStore:
+    addToCurrentToken(cc);
+    break;
+  case ActionParam:
+    addToCurrentToken(cc);
+    if (cc == ';') {
+      addArgument();
+    } else {
+      addDigit(cc-'0');
     }
-    if (cc != ESC)
-    {
-        processToken(token_ctl(cc+'@'), 0, 0);
-        return;
+    break;
+  case ActionEscDispatch:
+    addToCurrentToken(cc);
+    dispatchEscape(cc);
+    resetTokenizer();
+    break;
+  case ActionCsiDispatch:
+    addToCurrentToken(cc);
+    dispatchCsi(cc);
+    resetTokenizer();
+    break;
+  case ActionIgnore:
+    addToCurrentToken(cc);
+    reportDecodingError();
+    resetTokenizer();
+    break;
+  case ActionOscEnd:
+    addToCurrentToken(cc);
+    processSessionAttributeRequest();
+    resetTokenizer();
+    break;
+  case ActionOscEndEscape:
+    // the ESC starts the string terminator <ESC>'\', which
+    // ends up as ignored escape sequence
+    addToCurrentToken(cc);
+    processSessionAttributeRequest();
+    resetTokenizer();
+    addToCurrentToken(cc);
+    break;
+  }
+
+  _parserState = static_cast<ParserState>(next & 0x0f);
+}
+
+// complete an escape sequence in the token buffer: <ESC> {I} F
+void Vt102Emulation::dispatchEscape(uint cc)
+{
+  const int* s = tokenBuffer;
+  const int p = tokenBufferPos;
+
+  if (cc > 0x7e) {
+    reportDecodingError();
+  } else if (p == 2) {
+    if (cc != '\\') { // ST, which terminates OSC, DCS and similar strings
+      processToken(token_esc(cc), 0, 0);
     }
+  } else if (p == 3 && s[1] == '#') {
+    processToken(token_esc_de(cc), 0, 0);
+  } else if (p == 3 && (s[1] == '(' || s[1] == ')' || s[1] == '+' || s[1] == '*' || s[1] == '%')) {
+    processToken(token_esc_cs(s[1], cc), 0, 0);
+  } else {
+    reportDecodingError();
   }
-  // advance the state
-  addToCurrentToken(cc);
+}
 
-  int* s = tokenBuffer;
-  const int  p = tokenBufferPos;
+// complete a control sequence in the token buffer: <ESC> '[' {P} {Pn ';'} {I} F
+void Vt102Emulation::dispatchCsi(uint cc)
+{
+  const int* s = tokenBuffer;
+  const int p = tokenBufferPos;
 
-  if (getMode(MODE_Ansi))
-  {
-    if (lec(1,0,ESC)) { return; }
-    if (lec(1,0,ESC+128)) { s[0] = ESC; receiveChar('['); return; }
-    if (les(2,1,GRP)) { return; }
-    if (Xte         ) { processSessionAttributeRequest(); resetTokenizer(); return; }
-    if (Xpe         ) { return; }
-    if (lec(3,2,'?')) { return; }
-    if (lec(3,2,'>')) { return; }
-    if (lec(3,2,'!')) { return; }
-    if (lec(3,2,SP )) { return; }
-    if (lec(4,3,SP )) { return; }
-    if (lun(       )) { processToken(token_chr(), applyCharset(cc), 0);   resetTokenizer(); return; }
-    if (dcs         ) { return; /* TODO We don't xterm DCS, so we just eat it */ }
-    if (lec(2,0,ESC)) { processToken(token_esc(s[1]), 0, 0);              resetTokenizer(); return; }
-    if (les(3,1,SCS)) { processToken(token_esc_cs(s[1],s[2]), 0, 0);      resetTokenizer(); return; }
-    if (lec(3,1,'#')) { processToken(token_esc_de(s[2]), 0, 0);           resetTokenizer(); return; }
-    if (eps(    CPN)) { processToken(token_csi_pn(cc), argv[0],argv[1]);  resetTokenizer(); return; }
-
-    // resize = \e[8;<row>;<col>t
-    if (eps(CPS))
-    {
-        processToken(token_csi_ps(cc, argv[0]), argv[1], argv[2]);
-        resetTokenizer();
-        return;
+  const int privateMarker = (s[2] >= '<' && s[2] <= '?') ? s[2] : 0;
+  const int intermediate = (p >= 4 && s[p-2] >= ' ' && s[p-2] <= '/') ? s[p-2] : 0;
+  const bool hasParameters = (p - (privateMarker != 0 ? 1 : 0) - (intermediate != 0 ? 1 : 0)) > 3;
+
+  if (intermediate != 0 && (privateMarker != 0 || (p >= 5 && s[p-3] >= ' ' && s[p-3] <= '/'))) {
+    reportDecodingError();
+    return;
+  }
+
+  if (privateMarker == '>') {
+    processToken(token_csi_pg(cc), 0, 0); // spec. case for ESC[>0c or ESC[>c
+    return;
+  }
+  if (privateMarker == '?') {
+    for (int i = 0; i <= argc; i++) {
+      processToken(token_csi_pr(cc,argv[i]), 0, 0);
     }
+    return;
+  }
+  if (privateMarker != 0) {
+    reportDecodingError();
+    return;
+  }
 
-    if (epe(   )) { processToken(token_csi_pe(cc), 0, 0); resetTokenizer(); return; }
+  switch (intermediate) {
+  case 0:
+    break;
+  case '!':
+    processToken(token_csi_pe(cc), 0, 0);
+    return;
+  case ' ':
+    if (hasParameters) {
+      processToken(token_csi_psp(cc, argv[0]), 0, 0);
+    } else {
+      processToken(token_csi_sp(cc), 0, 0);
+    }
+    return;
+  default:
+    reportDecodingError();
+    return;
+  }
+
+  if (isCsiPnFinal(cc)) {
+    processToken(token_csi_pn(cc), argv[0],argv[1]);
+    return;
+  }
 
-    if (esp (   )) { processToken(token_csi_sp(cc), 0, 0);           resetTokenizer(); return; }
-    if (epsp(   )) { processToken(token_csi_psp(cc, argv[0]), 0, 0); resetTokenizer(); return; }
+  // resize = \e[8;<row>;<col>t
+  if (cc == 't') {
+    processToken(token_csi_ps(cc, argv[0]), argv[1], argv[2]);
+    return;
+  }
 
-    if (ees(DIG)) { addDigit(cc-'0'); return; }
-    if (eec(';')) { addArgument();    return; }
-    for (int i = 0; i <= argc; i++)
+  for (int i = 0; i <= argc; i++)
+  {
+    if (cc == 'm' && argc - i >= 4 && (argv[i] == 38 || argv[i] == 48) && argv[i+1] == 2)
     {
-        if (epp()) {
-            processToken(token_csi_pr(cc,argv[i]), 0, 0);
-        } else if (egt()) {
-            processToken(token_csi_pg(cc), 0, 0); // spec. case for ESC]>0c or ESC]>c
-        } else if (cc == 'm' && argc - i >= 4 && (argv[i] == 38 || argv[i] == 48) && argv[i+1] == 2)
-        {
-            // ESC[ ... 48;2;<red>;<green>;<blue> ... m -or- ESC[ ... 38;2;<red>;<green>;<blue> ... m
-            i += 2;
-            processToken(token_csi_ps(cc, argv[i-2]), COLOR_SPACE_RGB, (argv[i] << 16) | (argv[i+1] << 8) | argv[i+2]);
-            i += 2;
-        }
-        else if (cc == 'm' && argc - i >= 2 && (argv[i] == 38 || argv[i] == 48) && argv[i+1] == 5)
-        {
-            // ESC[ ... 48;5;<index> ... m -or- ESC[ ... 38;5;<index> ... m
-            i += 2;
-            processToken(token_csi_ps(cc, argv[i-2]), COLOR_SPACE_256, argv[i]);
-        } else {
-            processToken(token_csi_ps(cc,argv[i]), 0, 0);
-        }
+        // ESC[ ... 48;2;<red>;<green>;<blue> ... m -or- ESC[ ... 38;2;<red>;<green>;<blue> ... m
+        i += 2;
+        processToken(token_csi_ps(cc, argv[i-2]), COLOR_SPACE_RGB, (argv[i] << 16) | (argv[i+1] << 8) | argv[i+2]);
+        i += 2;
     }
-    resetTokenizer();
-  } else {
-    // VT52 Mode
-    if (lec(1,0,ESC)) {
-        return;
-    }
-    if (les(1,0,CHR))
+    else if (cc == 'm' && argc - i >= 2 && (argv[i] == 38 || argv[i] == 48) && argv[i+1] == 5)
     {
-        processToken(token_chr(), s[0], 0);
-        resetTokenizer();
-        return;
+        // ESC[ ... 48;5;<index> ... m -or- ESC[ ... 38;5;<index> ... m
+        i += 2;
+        processToken(token_csi_ps(cc, argv[i-2]), COLOR_SPACE_256, argv[i]);
+    } else {
+        processToken(token_csi_ps(cc,argv[i]), 0, 0);
     }
-    if (lec(2,1,'Y')) {
-        return;
+  }
+}
+
+// process an incoming unicode character in VT52 mode
+void Vt102Emulation::receiveVt52Char(uint cc)
+{
+  if (cc == DEL) {
+    return; //VT100: ignore.
+  }
+
+  if (cc < 32) {
+    if (cc == CNTL('X') || cc == CNTL('Z') || cc == ESC) {
+      resetTokenizer(); //VT100: CAN or SUB
     }
-    if (lec(3,1,'Y')) {
-        return;
+    if (cc != ESC) {
+      processToken(token_ctl(cc+'@'), 0, 0);
+    } else {
+      addToCurrentToken(cc);
+      _parserState = Vt52Escape;
     }
-    if (p < 4)
-    {
-        processToken(token_vt52(s[1] ), 0, 0);
-        resetTokenizer();
-        return;
+    return;
+  }
+
+  switch (_parserState) {
+  case Vt52Escape:
+    addToCurrentToken(cc);
+    if (cc == 'Y') {
+      _parserState = Vt52CursorRow;
+    } else {
+      processToken(token_vt52(cc), 0, 0);
+      resetTokenizer();
     }
-    processToken(token_vt52(s[1]), s[2], s[3]);
+    break;
+  case Vt52CursorRow:
+    addToCurrentToken(cc);
+    _parserState = Vt52CursorColumn;
+    break;
+  case Vt52CursorColumn:
+    addToCurrentToken(cc);
+    processToken(token_vt52('Y'), tokenBuffer[2], cc);
     resetTokenizer();
+    break;
+  default:
+    processToken(token_chr(), cc, 0);
+    break;
+  }
+}
+
+// process a run of printable ASCII characters, see Emulation::receiveData()
+void Vt102Emulation::receiveAsciiRun(const char *text, int length)
+{
+  int i = 0;
+
+  // the run may continue an escape sequence, finish that one first
+  while (i < length && _parserState != Ground) {
+    receiveChar(static_cast<uchar>(text[i]));
+    i++;
+  }
+
+  // In ANSI mode every printable character which doesn't follow an ESC is
+  // a token_chr(), so the tokenizer can be skipped unless a VT100 charset
+  // would translate it.
+  const CharCodes &charset = _charset[_currentScreen == _screen[1]];
+  if (!getMode(MODE_Ansi) || charset.graphic || charset.pound) {
+    for (; i < length; i++) {
+      receiveChar(static_cast<uchar>(text[i]));
+    }
     return;
   }
+
+  uint chars[256];
+  while (i < length) {
+    const int count = qMin(length - i, int(sizeof(chars) / sizeof(chars[0])));
+    for (int j = 0; j < count; j++) {
+      chars[j] = static_cast<uchar>(text[i + j]);
+    }
+    _currentScreen->displayCharacters(chars, count);
+    i += count;
+  }
 }
 
 void Vt102Emulation::processSessionAttributeRequest()
@@ -502,11 +816,16 @@ void Vt102Emulation::processSessionAttributeRequest()
   }
 
   _pendingSessionAttributesUpdates[attribute] = value;
-  _sessionAttributesUpdateTimer->start(20);
+  if (calledFromOtherThread()) {
+      QMetaObject::invokeMethod(_sessionAttributesUpdateTimer, "start", Qt::QueuedConnection, Q_ARG(int, 20));
+  } else {
+      _sessionAttributesUpdateTimer->start(20);
+  }
 }
 
 void Vt102Emulation::updateSessionAttributes()
 {
+    QMutexLocker locker(lock());
     QListIterator<int> iter(_pendingSessionAttributesUpdates.keys());
     while (iter.hasNext()) {
         int arg = iter.next();
@@ -1034,6 +1353,8 @@ void Vt102Emulation::reportAnswerBack()
 
 void Vt102Emulation::sendMouseEvent(int cb, int cx, int cy, int eventType)
 {
+    QMutexLocker locker(lock());
+
     if (cx < 1 || cy < 1) {
         return;
     }
@@ -1122,6 +1443,8 @@ void Vt102Emulation::sendText(const QString &text)
 
 void Vt102Emulation::sendKeyEvent(QKeyEvent *event)
 {
+    QMutexLocker locker(lock());
+
     const Qt::KeyboardModifiers modifiers = event->modifiers();
     KeyboardTranslator::States states = KeyboardTranslator::NoState;
 
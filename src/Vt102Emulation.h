@@ -73,7 +73,7 @@ struct CharCodes {
  * sequences.
  *
  */
-class Vt102Emulation : public Emulation
+class KONSOLEPRIVATE_EXPORT Vt102Emulation : public Emulation
 {
     Q_OBJECT
 
@@ -87,6 +87,28 @@ public:
     void reset() Q_DECL_OVERRIDE;
     char eraseChar() const Q_DECL_OVERRIDE;
 
+    /**
+     * States of the escape sequence parser, see receiveChar().
+     * The first AnsiParserStateCount states are driven by the
+     * transition table of the ANSI mode, the others are used
+     * in VT52 mode only.
+     */
+    enum ParserState {
+        Ground = 0,
+        Escape,
+        EscapeIntermediate,
+        CsiEntry,
+        CsiParam,
+        CsiIntermediate,
+        CsiIgnore,
+        OscString,
+        IgnoreString,
+        AnsiParserStateCount,
+        Vt52Escape = AnsiParserStateCount,
+        Vt52CursorRow,
+        Vt52CursorColumn
+    };
+
 public Q_SLOTS:
     // reimplemented from Emulation
     void sendString(const QByteArray &string) Q_DECL_OVERRIDE;
@@ -101,6 +123,7 @@ protected:
     void setMode(int mode) Q_DECL_OVERRIDE;
     void resetMode(int mode) Q_DECL_OVERRIDE;
     void receiveChar(uint cc) Q_DECL_OVERRIDE;
+    void receiveAsciiRun(const char *text, int length) Q_DECL_OVERRIDE;
 
 private Q_SLOTS:
     // Causes sessionAttributeChanged() to be emitted for each (int,QString)
@@ -141,12 +164,11 @@ private:
     void addArgument();
     int argv[MAXARGS];
     int argc;
-    void initTokenizer();
+    ParserState _parserState;
 
-    // Set of flags for each of the ASCII characters which indicates
-    // what category they fall into (printable character, control, digit etc.)
-    // for the purposes of decoding terminal output
-    int charClass[256];
+    void receiveVt52Char(uint cc);
+    void dispatchEscape(uint cc);
+    void dispatchCsi(uint cc);
 
     void reportDecodingError();
 
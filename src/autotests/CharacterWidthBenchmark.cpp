@@ -0,0 +1,63 @@
+/*
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+    02110-1301  USA.
+*/
+
+// Own
+#include "CharacterWidthBenchmark.h"
+
+#include "qtest.h"
+
+// Qt
+#include <QFile>
+
+// Konsole
+#include "../Character.h"
+
+using namespace Konsole;
+
+/*
+   Character width benchmark: the widths of all code points of the
+   test files in tests/ are looked up, as Screen::displayCharacter()
+   does for every printed character:
+
+     ./CharacterWidthBenchmark
+*/
+
+void CharacterWidthBenchmark::benchmarkWidth_data()
+{
+    QTest::addColumn<QString>("fileName");
+
+    QTest::newRow("UTF-8 demo") << QFINDTESTDATA(QStringLiteral("../../tests/UTF-8-demo.txt"));
+    QTest::newRow("emoji") << QFINDTESTDATA(QStringLiteral("../../tests/emoji_test.txt"));
+}
+
+void CharacterWidthBenchmark::benchmarkWidth()
+{
+    QFETCH(QString, fileName);
+
+    QFile file(fileName);
+    QVERIFY(file.open(QIODevice::ReadOnly));
+    const QVector<uint> text = QString::fromUtf8(file.readAll()).toUcs4();
+    QVERIFY(!text.isEmpty());
+
+    int width = 0;
+    QBENCHMARK {
+        width += Character::stringWidth(text.constData(), text.size());
+    }
+    QVERIFY(width != 0);
+}
+
+QTEST_GUILESS_MAIN(CharacterWidthBenchmark)
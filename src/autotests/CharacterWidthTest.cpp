@@ -67,6 +67,11 @@ void CharacterWidthTest::testWidth_data()
     QTest::newRow("0x26EA  church (BUG 392171)") << uint(0x026EA) << 2;
     QTest::newRow("0x1D11E musical symbol g clef (BUG 339439)") << uint(0x1D11E) << 1;
 
+    QTest::newRow("0x20000 first character of the ideographic plane") << uint(0x20000) << 2;
+    QTest::newRow("0xE0100 variation selector") << uint(0xE0100) << 0;
+    QTest::newRow("0x10FFFF last code point") << uint(0x10FFFF) << 1;
+    QTest::newRow("0x110000 beyond the last code point") << uint(0x110000) << 1;
+
 }
 
 void CharacterWidthTest::testWidth()
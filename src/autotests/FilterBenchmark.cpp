@@ -0,0 +1,172 @@
+/*
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+    02110-1301  USA.
+*/
+
+// Own
+#include "FilterBenchmark.h"
+
+#include "qtest.h"
+
+// Qt
+#include <QFile>
+#include <QSignalSpy>
+#include <QTemporaryDir>
+
+// Konsole
+#include "../DirectoryCache.h"
+#include "../Filter.h"
+#include "../Session.h"
+
+using namespace Konsole;
+
+/*
+   Hotspot extraction benchmark: the filters of a large screen of build
+   output, with a few urls, email addresses and names of files in it, are
+   processed as if every line of the screen was new.  The url filter, a
+   filter for compiler messages and the file filter are run once with and
+   once without their required literals, both must find the same hotspots
+   as a filter without required literals:
+
+     ./FilterBenchmark -iterations 50
+*/
+
+static const int Lines = 200;
+static const int Columns = 250;
+
+enum FilterType {
+    UrlFilterType,
+    MessageFilterType,
+    FileFilterType
+};
+
+static QVector<Character> screenImage()
+{
+    QVector<Character> image(Lines * Columns);
+    for (int line = 0; line < Lines; line++) {
+        QString text;
+        if (line % 20 == 0) {
+            text = QStringLiteral("See https://bugs.kde.org/show_bug.cgi?id=%1 for details.").arg(line);
+        } else if (line % 50 == 1) {
+            text = QStringLiteral("Reported-by: user%1@example.org").arg(line);
+        } else if (line % 10 == 5) {
+            text = QStringLiteral("src/file%1.cpp:%2:7: warning: unused variable 'x' [-Wunused-variable]").arg(line).arg(line * 3);
+        } else if (line % 10 == 7) {
+            text = QStringLiteral("In file included from file%1.h:12, ").arg(line);
+        } else {
+            text = QStringLiteral("[ %1%] Building CXX object src/CMakeFiles/konsoleprivate.dir/File%2.cpp.o").arg(line / 2).arg(line);
+        }
+        for (int column = 0; column < Columns; column++) {
+            image[line * Columns + column] = Character(text[column % text.size()].unicode());
+        }
+    }
+    return image;
+}
+
+static RegExpFilter *createFilter(int type, Session *session)
+{
+    switch (type) {
+    case UrlFilterType:
+        return new UrlFilter();
+    case MessageFilterType:
+    {
+        auto filter = new RegExpFilter();
+        filter->setRegExp(QRegularExpression(QStringLiteral("\\b(error|warning): [^\\[]*")));
+        filter->setRequiredLiterals(QStringList() << QStringLiteral("error: ")
+                                                  << QStringLiteral("warning: "));
+        return filter;
+    }
+    default:
+        return new FileFilter(session);
+    }
+}
+
+// describes the hotspots of the chain as "startLine,startColumn-endLine,endColumn"
+static QStringList hotSpots(const TerminalImageFilterChain &chain)
+{
+    QStringList result;
+    foreach (Filter::HotSpot *spot, chain.hotSpots()) {
+        result << QStringLiteral("%1,%2-%3,%4").arg(spot->startLine()).arg(spot->startColumn())
+                                               .arg(spot->endLine()).arg(spot->endColumn());
+    }
+    result.sort();
+    return result;
+}
+
+void FilterBenchmark::benchmarkHotSpots_data()
+{
+    QTest::addColumn<int>("type");
+    QTest::addColumn<bool>("requiredLiterals");
+
+    QTest::newRow("urls, regular expression") << int(UrlFilterType) << false;
+    QTest::newRow("urls, required literals") << int(UrlFilterType) << true;
+    QTest::newRow("messages, regular expression") << int(MessageFilterType) << false;
+    QTest::newRow("messages, required literals") << int(MessageFilterType) << true;
+    QTest::newRow("files, regular expression") << int(FileFilterType) << false;
+    QTest::newRow("files, required literals") << int(FileFilterType) << true;
+}
+
+void FilterBenchmark::benchmarkHotSpots()
+{
+    QFETCH(int, type);
+    QFETCH(bool, requiredLiterals);
+
+    const QVector<Character> image = screenImage();
+    const QVector<LineProperty> lineProperties(Lines, LINE_DEFAULT);
+
+    // the files named in the image, which the file filter finds in the
+    // directory of the session
+    QTemporaryDir dir;
+    QVERIFY(dir.isValid());
+    for (int line = 7; line < Lines; line += 10) {
+        QFile file(dir.path() + QStringLiteral("/file%1.h").arg(line));
+        QVERIFY(file.open(QIODevice::WriteOnly));
+    }
+    Session session;
+    DirectoryCache *directoryCache = DirectoryCache::forSession(&session);
+    QSignalSpy updatedSpy(directoryCache, &DirectoryCache::updated);
+    directoryCache->setDirectory(dir.path());
+    QVERIFY(updatedSpy.wait());
+
+    // the hotspots which are found by matching every line
+    TerminalImageFilterChain referenceChain;
+    RegExpFilter *referenceFilter = createFilter(type, &session);
+    referenceFilter->setRequiredLiterals(QStringList());
+    referenceChain.addFilter(referenceFilter);
+    referenceChain.setImage(image.constData(), Lines, Columns, lineProperties);
+    referenceChain.process();
+    const QStringList expectedHotSpots = hotSpots(referenceChain);
+    QVERIFY(!expectedHotSpots.isEmpty());
+
+    TerminalImageFilterChain chain;
+    RegExpFilter *filter = createFilter(type, &session);
+    if (!requiredLiterals) {
+        filter->setRequiredLiterals(QStringList());
+    }
+    chain.addFilter(filter);
+
+    QBENCHMARK {
+        // forget the matches of the previous pass, as if all lines were new
+        filter->setRegExp(filter->regExp());
+
+        chain.setImage(image.constData(), Lines, Columns, lineProperties);
+        chain.process();
+    }
+
+    QCOMPARE(hotSpots(chain), expectedHotSpots);
+    qDebug("%s: %d hotspots", QTest::currentDataTag(), expectedHotSpots.size());
+}
+
+QTEST_MAIN(FilterBenchmark)
@@ -0,0 +1,209 @@
+/*
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+    02110-1301  USA.
+*/
+
+// Own
+#include "FilterTest.h"
+
+// Qt
+#include <QDir>
+#include <QFile>
+#include <QSignalSpy>
+#include <QTemporaryDir>
+#include <QTest>
+
+// Konsole
+#include "../DirectoryCache.h"
+#include "../Filter.h"
+
+using namespace Konsole;
+
+static const int COLUMNS = 16;
+
+// sets the lines of text as the image of the chain, the lines whose
+// number is in wrappedLines continue in the next line
+static void setImage(TerminalImageFilterChain &chain, const QStringList &lines,
+                     const QList<int> &wrappedLines = QList<int>())
+{
+    QVector<Character> image(lines.size() * COLUMNS);
+    QVector<LineProperty> lineProperties(lines.size(), LINE_DEFAULT);
+    for (int line = 0; line < lines.size(); line++) {
+        const QString &text = lines[line];
+        for (int column = 0; column < text.size() && column < COLUMNS; column++) {
+            image[line * COLUMNS + column] = Character(text[column].unicode());
+        }
+        if (wrappedLines.contains(line)) {
+            lineProperties[line] = LINE_WRAPPED;
+        }
+    }
+
+    chain.setImage(image.constData(), lines.size(), COLUMNS, lineProperties);
+    chain.process();
+}
+
+// describes the hotspots of the chain as "startLine,startColumn-endLine,endColumn:text"
+static QStringList hotSpots(const TerminalImageFilterChain &chain)
+{
+    QStringList result;
+    foreach (Filter::HotSpot *spot, chain.hotSpots()) {
+        result << QStringLiteral("%1,%2-%3,%4:%5").arg(spot->startLine()).arg(spot->startColumn())
+                  .arg(spot->endLine()).arg(spot->endColumn())
+                  .arg(static_cast<RegExpFilter::HotSpot *>(spot)->capturedTexts().first());
+    }
+    result.sort();
+    return result;
+}
+
+void FilterTest::testRegExpFilter()
+{
+    TerminalImageFilterChain chain;
+    auto filter = new RegExpFilter();
+    filter->setRegExp(QRegularExpression(QStringLiteral("foo\\w*")));
+    chain.addFilter(filter);
+
+    setImage(chain, QStringList() << QStringLiteral("a foo and foox") << QStringLiteral("")
+                                  << QStringLiteral("foobar"));
+    QCOMPARE(hotSpots(chain), QStringList() << QStringLiteral("0,10-0,14:foox")
+                                            << QStringLiteral("0,2-0,5:foo")
+                                            << QStringLiteral("2,0-2,6:foobar"));
+
+    QVERIFY(chain.hotSpotAt(0, 3) != nullptr);
+    QVERIFY(chain.hotSpotAt(0, 7) == nullptr);
+    QVERIFY(chain.hotSpotAt(2, 5) != nullptr);
+}
+
+void FilterTest::testWrappedLine()
+{
+    TerminalImageFilterChain chain;
+    auto filter = new RegExpFilter();
+    filter->setRegExp(QRegularExpression(QStringLiteral("foo\\w*")));
+    chain.addFilter(filter);
+
+    // a match continues in the next line only if the line is wrapped
+    setImage(chain, QStringList() << QStringLiteral("            food") << QStringLiteral("ie")
+                                  << QStringLiteral("            food") << QStringLiteral("ie"),
+             QList<int>() << 0);
+    QCOMPARE(hotSpots(chain), QStringList() << QStringLiteral("0,12-1,2:foodie")
+                                            << QStringLiteral("2,12-2,16:food"));
+}
+
+void FilterTest::testChangedLines()
+{
+    TerminalImageFilterChain chain;
+    auto filter = new RegExpFilter();
+    filter->setRegExp(QRegularExpression(QStringLiteral("foo\\w*")));
+    chain.addFilter(filter);
+
+    setImage(chain, QStringList() << QStringLiteral("foo1") << QStringLiteral("bar")
+                                  << QStringLiteral("foo2"));
+    QCOMPARE(hotSpots(chain), QStringList() << QStringLiteral("0,0-0,4:foo1")
+                                            << QStringLiteral("2,0-2,4:foo2"));
+
+    // the lines scrolled up, a changed line and a repeated line
+    setImage(chain, QStringList() << QStringLiteral("bar") << QStringLiteral("foo2")
+                                  << QStringLiteral("foo3") << QStringLiteral("foo2"));
+    QCOMPARE(hotSpots(chain), QStringList() << QStringLiteral("1,0-1,4:foo2")
+                                            << QStringLiteral("2,0-2,4:foo3")
+                                            << QStringLiteral("3,0-3,4:foo2"));
+
+    // the matches of a previous regular expression are not reused
+    filter->setRegExp(QRegularExpression(QStringLiteral("bar")));
+    setImage(chain, QStringList() << QStringLiteral("bar") << QStringLiteral("foo2"));
+    QCOMPARE(hotSpots(chain), QStringList() << QStringLiteral("0,0-0,3:bar"));
+}
+
+void FilterTest::testRequiredLiterals()
+{
+    TerminalImageFilterChain chain;
+    auto filter = new RegExpFilter();
+    filter->setRegExp(QRegularExpression(QStringLiteral("\\w+(\\.|::)\\w+")));
+    chain.addFilter(filter);
+
+    // a line is only searched if it contains one of the literals
+    filter->setRequiredLiterals(QStringList() << QStringLiteral("::"));
+    setImage(chain, QStringList() << QStringLiteral("a.b c::d") << QStringLiteral("e.f"));
+    QCOMPARE(hotSpots(chain), QStringList() << QStringLiteral("0,0-0,3:a.b")
+                                            << QStringLiteral("0,4-0,8:c::d"));
+
+    filter->setRequiredLiterals(QStringList() << QStringLiteral("::") << QStringLiteral("."));
+    setImage(chain, QStringList() << QStringLiteral("a.b c::d") << QStringLiteral("e.f"));
+    QCOMPARE(hotSpots(chain), QStringList() << QStringLiteral("0,0-0,3:a.b")
+                                            << QStringLiteral("0,4-0,8:c::d")
+                                            << QStringLiteral("1,0-1,3:e.f"));
+
+    // a literal at the end of a line, and a literal which does not fit
+    filter->setRequiredLiterals(QStringList() << QStringLiteral("f") << QStringLiteral("b c::"));
+    setImage(chain, QStringList() << QStringLiteral("a.b c:") << QStringLiteral("e.f"));
+    QCOMPARE(hotSpots(chain), QStringList() << QStringLiteral("1,0-1,3:e.f"));
+
+    // literals starting with other than ASCII characters
+    filter->setRequiredLiterals(QStringList() << QStringLiteral("\u00e9."));
+    setImage(chain, QStringList() << QStringLiteral("a.b \u00e9.b") << QStringLiteral("e.f"));
+    QCOMPARE(hotSpots(chain), QStringList() << QStringLiteral("0,0-0,3:a.b")
+                                            << QStringLiteral("0,4-0,7:\u00e9.b"));
+
+    // no literals
+    filter->setRequiredLiterals(QStringList());
+    setImage(chain, QStringList() << QStringLiteral("e.f"));
+    QCOMPARE(hotSpots(chain), QStringList() << QStringLiteral("0,0-0,3:e.f"));
+}
+
+void FilterTest::testUrlFilter()
+{
+    TerminalImageFilterChain chain;
+    chain.addFilter(new UrlFilter());
+
+    setImage(chain, QStringList() << QStringLiteral("see kde.org") << QStringLiteral("www.kde.org")
+                                  << QStringLiteral("a@kde.org") << QStringLiteral("x http://a.b"));
+    QCOMPARE(hotSpots(chain), QStringList() << QStringLiteral("1,0-1,11:www.kde.org")
+                                            << QStringLiteral("2,0-2,9:a@kde.org")
+                                            << QStringLiteral("3,2-3,12:http://a.b"));
+}
+
+void FilterTest::testDirectoryCache()
+{
+    QTemporaryDir dir;
+    QVERIFY(dir.isValid());
+    QFile file(dir.path() + QStringLiteral("/old.txt"));
+    QVERIFY(file.open(QIODevice::WriteOnly));
+    file.close();
+    QVERIFY(QDir(dir.path()).mkdir(QStringLiteral("subdir")));
+
+    DirectoryCache cache;
+    QSignalSpy updatedSpy(&cache, &DirectoryCache::updated);
+
+    // the directory is listed in the background
+    cache.setDirectory(dir.path());
+    QVERIFY(cache.files().isEmpty());
+    QVERIFY(updatedSpy.wait());
+    QCOMPARE(cache.canonicalPath(), QDir(dir.path()).canonicalPath() + QLatin1Char('/'));
+    QCOMPARE(cache.files(), QSet<QString>() << QStringLiteral("old.txt"));
+
+    // a new file is found without setting the directory again
+    file.setFileName(dir.path() + QStringLiteral("/new.txt"));
+    QVERIFY(file.open(QIODevice::WriteOnly));
+    file.close();
+    QVERIFY(updatedSpy.wait());
+    QCOMPARE(cache.files(), QSet<QString>() << QStringLiteral("old.txt") << QStringLiteral("new.txt"));
+
+    // the files of the previous directory are forgotten at once
+    updatedSpy.clear();
+    cache.setDirectory(dir.path() + QStringLiteral("/subdir"));
+    QCOMPARE(updatedSpy.count(), 1);
+    QVERIFY(cache.files().isEmpty());
+}
+
+QTEST_GUILESS_MAIN(FilterTest)
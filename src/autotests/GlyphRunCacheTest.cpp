@@ -0,0 +1,76 @@
+/*
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+    02110-1301  USA.
+*/
+
+// Own
+#include "GlyphRunCacheTest.h"
+
+// Qt
+#include <QFontDatabase>
+#include <QImage>
+#include <QPainter>
+
+// KDE
+#include <qtest.h>
+
+// Konsole
+#include "../GlyphRunCache.h"
+
+using namespace Konsole;
+
+void GlyphRunCacheTest::testCachedTexts()
+{
+    QImage image(200, 50, QImage::Format_ARGB32_Premultiplied);
+    QPainter painter(&image);
+    painter.setFont(QFontDatabase::systemFont(QFontDatabase::FixedFont));
+
+    GlyphRunCache cache;
+    QVERIFY(!cache.drawText(painter, QPointF(0, 20), QStringLiteral("$ make")));
+    QVERIFY(cache.drawText(painter, QPointF(0, 40), QStringLiteral("$ make")));
+    QVERIFY(!cache.drawText(painter, QPointF(0, 20), QStringLiteral("$ make install")));
+
+    // the text is shaped again for another font
+    QFont boldFont = painter.font();
+    boldFont.setBold(true);
+    painter.setFont(boldFont);
+    QVERIFY(!cache.drawText(painter, QPointF(0, 20), QStringLiteral("$ make")));
+    QVERIFY(cache.drawText(painter, QPointF(0, 20), QStringLiteral("$ make")));
+    QCOMPARE(cache.count(), 3);
+
+    cache.clear();
+    QCOMPARE(cache.count(), 0);
+    QVERIFY(!cache.drawText(painter, QPointF(0, 20), QStringLiteral("$ make")));
+}
+
+void GlyphRunCacheTest::testEviction()
+{
+    QImage image(200, 50, QImage::Format_ARGB32_Premultiplied);
+    QPainter painter(&image);
+    painter.setFont(QFontDatabase::systemFont(QFontDatabase::FixedFont));
+
+    GlyphRunCache cache(2);
+    QVERIFY(!cache.drawText(painter, QPointF(0, 20), QStringLiteral("a")));
+    QVERIFY(!cache.drawText(painter, QPointF(0, 20), QStringLiteral("b")));
+    QVERIFY(cache.drawText(painter, QPointF(0, 20), QStringLiteral("a")));
+
+    // the least recently drawn text is dropped
+    QVERIFY(!cache.drawText(painter, QPointF(0, 20), QStringLiteral("c")));
+    QCOMPARE(cache.count(), 2);
+    QVERIFY(cache.drawText(painter, QPointF(0, 20), QStringLiteral("a")));
+    QVERIFY(!cache.drawText(painter, QPointF(0, 20), QStringLiteral("b")));
+}
+
+QTEST_MAIN(GlyphRunCacheTest)
@@ -0,0 +1,213 @@
+/*
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+    02110-1301  USA.
+*/
+
+// Own
+#include "GraphemePoolTest.h"
+
+// KDE
+#include <qtest.h>
+
+// Konsole
+#include "../GraphemePool.h"
+#include "../History.h"
+#include "../Screen.h"
+
+using namespace Konsole;
+
+static QVector<uint> sequence(uint key)
+{
+    ushort length = 0;
+    const uint *chars = GraphemePool::lookup(key, length);
+    QVector<uint> result;
+    for (ushort i = 0; i < length; i++) {
+        result.append(chars[i]);
+    }
+    return result;
+}
+
+void GraphemePoolTest::testAddAndLookup()
+{
+    GraphemePool pool;
+    const uint e[2] = { 'e', 0x0301 };
+    const uint a[3] = { 'a', 0x0308, 0x0304 };
+
+    const uint eKey = pool.add(e, 2);
+    const uint aKey = pool.add(a, 3);
+    QVERIFY(eKey != 0);
+    QVERIFY(aKey != 0);
+    QVERIFY(eKey != aKey);
+    QCOMPARE(sequence(eKey), QVector<uint>({ 'e', 0x0301 }));
+    QCOMPARE(sequence(aKey), QVector<uint>({ 'a', 0x0308, 0x0304 }));
+    QCOMPARE(pool.count(), 2);
+}
+
+void GraphemePoolTest::testSharedSequences()
+{
+    GraphemePool pool;
+    const uint e[2] = { 'e', 0x0301 };
+    const uint eLonger[3] = { 'e', 0x0301, 0x0302 };
+
+    const uint key = pool.add(e, 2);
+    QCOMPARE(pool.add(e, 2), key);
+    QVERIFY(pool.add(eLonger, 3) != key);
+    QCOMPARE(pool.add(e, 2), key);
+    QCOMPARE(pool.count(), 2);
+}
+
+void GraphemePoolTest::testSeparatePools()
+{
+    GraphemePool first;
+    GraphemePool second;
+    const uint e[2] = { 'e', 0x0301 };
+    const uint o[2] = { 'o', 0x0303 };
+
+    const uint firstKey = first.add(e, 2);
+    const uint secondKey = second.add(o, 2);
+    QVERIFY(firstKey != secondKey);
+    QCOMPARE(sequence(firstKey), QVector<uint>({ 'e', 0x0301 }));
+    QCOMPARE(sequence(secondKey), QVector<uint>({ 'o', 0x0303 }));
+}
+
+void GraphemePoolTest::testDestroyedPool()
+{
+    const uint e[2] = { 'e', 0x0301 };
+    uint key;
+    {
+        GraphemePool pool;
+        key = pool.add(e, 2);
+        QVERIFY(key != 0);
+    }
+
+    ushort length = 1;
+    QCOMPARE(GraphemePool::lookup(key, length), static_cast<const uint *>(nullptr));
+    QCOMPARE(length, ushort(0));
+
+    // keys which were never returned are unknown as well
+    GraphemePool pool;
+    QCOMPARE(GraphemePool::lookup(0, length), static_cast<const uint *>(nullptr));
+    QCOMPARE(GraphemePool::lookup(pool.add(e, 2) + 100, length), static_cast<const uint *>(nullptr));
+}
+
+void GraphemePoolTest::testManyPools()
+{
+    // more pools than two screens of a few hundred sessions
+    const uint e[2] = { 'e', 0x0301 };
+    QVector<GraphemePool *> pools;
+    for (int i = 0; i < 3000; i++) {
+        pools.append(new GraphemePool);
+        QCOMPARE(sequence(pools.last()->add(e, 2)), QVector<uint>({ 'e', 0x0301 }));
+    }
+    qDeleteAll(pools);
+}
+
+void GraphemePoolTest::testCompact()
+{
+    GraphemePool pool;
+    QVERIFY(!pool.shouldCompact());
+
+    QVector<uint> keys;
+    for (uint i = 0; i < GraphemePool::MaxSequences; i++) {
+        const uint chars[2] = { 'a', 0x10000 + i };
+        keys.append(pool.add(chars, 2));
+        QVERIFY(keys.last() != 0);
+    }
+    const uint full[2] = { 'b', 0x0301 };
+    QCOMPARE(pool.add(full, 2), 0u);
+    QVERIFY(pool.shouldCompact());
+
+    // the used sequences keep their keys, the others are dropped
+    QSet<uint> usedKeys;
+    for (int i = 0; i < keys.size(); i += 2) {
+        usedKeys.insert(keys[i]);
+    }
+    pool.compact(usedKeys);
+    QCOMPARE(pool.count(), GraphemePool::MaxSequences / 2);
+    QVERIFY(!pool.shouldCompact());
+    QCOMPARE(sequence(keys[0]), QVector<uint>({ 'a', 0x10000 }));
+    QCOMPARE(sequence(keys[2]), QVector<uint>({ 'a', 0x10002 }));
+    QCOMPARE(sequence(keys[1]), QVector<uint>());
+
+    // a reused entry does not answer to the key of the dropped sequence
+    const uint key = pool.add(full, 2);
+    QVERIFY(key != 0);
+    QCOMPARE(sequence(key), QVector<uint>({ 'b', 0x0301 }));
+    for (int i = 1; i < keys.size(); i += 2) {
+        QVERIFY(keys[i] != key);
+        QCOMPARE(sequence(keys[i]), QVector<uint>());
+    }
+}
+
+void GraphemePoolTest::testCompactionDelay()
+{
+    GraphemePool pool;
+    QSet<uint> usedKeys;
+    for (uint i = 0; i < GraphemePool::MaxSequences; i++) {
+        const uint chars[2] = { 'a', 0x10000 + i };
+        usedKeys.insert(pool.add(chars, 2));
+    }
+
+    // a compaction which frees nothing is not repeated for every sequence
+    pool.compact(usedKeys);
+    QVERIFY(!pool.shouldCompact());
+    for (uint i = 0; i < GraphemePool::MaxSequences / 8; i++) {
+        const uint chars[2] = { 'b', 0x10000 + i };
+        QCOMPARE(pool.add(chars, 2), 0u);
+    }
+    QVERIFY(pool.shouldCompact());
+}
+
+void GraphemePoolTest::testChunks()
+{
+    // enough sequences to fill several chunks of the arena
+    GraphemePool pool;
+    QVector<uint> keys;
+    for (uint i = 0; i < 20000; i++) {
+        const uint chars[3] = { 'a' + i % 26, 0x0300 + i % 112, 0x10000 + i };
+        keys.append(pool.add(chars, 3));
+    }
+    for (uint i = 0; i < 20000; i++) {
+        QCOMPARE(sequence(keys[i]), QVector<uint>({ 'a' + i % 26, 0x0300 + i % 112, 0x10000 + i }));
+    }
+}
+
+void GraphemePoolTest::testScreenHistory()
+{
+    Screen screen(10, 40);
+    screen.setScroll(CompactHistoryType(2000));
+    auto addLine = [&screen](const QVector<uint> &chars) {
+        for (const uint c : chars) {
+            screen.displayCharacter(c);
+        }
+        screen.nextLine();
+    };
+
+    // the keys of the history are known while its lines are kept
+    addLine({ 'a', 0x0301 });
+    QCOMPARE(screen.usedExtendedChars().size(), 1);
+    for (int i = 0; i < 1000; i++) {
+        addLine({ 'b' });
+    }
+    QCOMPARE(screen.usedExtendedChars().size(), 1);
+
+    // and forgotten once the lines have left it
+    for (int i = 0; i < 3000; i++) {
+        addLine({ 'b' });
+    }
+    QCOMPARE(screen.usedExtendedChars().size(), 0);
+}
+
+QTEST_GUILESS_MAIN(GraphemePoolTest)
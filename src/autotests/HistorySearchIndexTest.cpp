@@ -0,0 +1,258 @@
+/*
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+    02110-1301  USA.
+*/
+
+// Own
+#include "HistorySearchIndexTest.h"
+
+// Qt
+#include <QSignalSpy>
+#include <QTest>
+
+// Konsole
+#include "../History.h"
+#include "../HistorySearchIndex.h"
+#include "../Screen.h"
+#include "../SearchHistoryTask.h"
+
+using namespace Konsole;
+
+static void addLine(Screen &screen, const QString &text)
+{
+    const QVector<uint> chars = text.toUcs4();
+    screen.displayCharacters(chars.constData(), chars.size());
+    screen.nextLine();
+}
+
+// lines "line <n>" with the text "Needle" added to lines 1234 and 4321,
+// so both are in the indexed history
+static void addLines(Screen &screen)
+{
+    for (int n = 0; n < 5000; n++) {
+        QString text = QStringLiteral("line %1").arg(n);
+        if (n == 1234 || n == 4321) {
+            text += QStringLiteral(" Needle");
+        }
+        addLine(screen, text);
+    }
+}
+
+void HistorySearchIndexTest::testFindLine_data()
+{
+    QTest::addColumn<QString>("pattern");
+    QTest::addColumn<bool>("caseSensitive");
+    QTest::addColumn<bool>("found");
+
+    QTest::newRow("literal") << QStringLiteral("Needle") << true << true;
+    QTest::newRow("case insensitive") << QStringLiteral("nEEDLE") << false << true;
+    QTest::newRow("wrong case") << QStringLiteral("nEEDLE") << true << false;
+    QTest::newRow("quantifier") << QStringLiteral("Ne+dle") << true << true;
+    QTest::newRow("optional") << QStringLiteral("Nex?edle") << true << true;
+    QTest::newRow("class") << QStringLiteral("N[aeiou]edle") << true << true;
+    QTest::newRow("group") << QStringLiteral("N(ee|oo)dle") << true << true;
+    QTest::newRow("alternative") << QStringLiteral("Haystack|Needle") << true << true;
+    QTest::newRow("escapes") << QStringLiteral("\\d+\\sNeedle") << true << true;
+    QTest::newRow("missing") << QStringLiteral("Haystack") << true << false;
+}
+
+void HistorySearchIndexTest::testFindLine()
+{
+    QFETCH(QString, pattern);
+    QFETCH(bool, caseSensitive);
+    QFETCH(bool, found);
+
+    Screen screen(10, 40);
+    screen.setScroll(CompactHistoryType(100000));
+    addLines(screen);
+
+    QRegularExpression regExp(pattern);
+    if (!caseSensitive) {
+        regExp.setPatternOptions(QRegularExpression::CaseInsensitiveOption);
+    }
+
+    const int lastLine = screen.getHistLines() + screen.getLines() - 1;
+    HistorySearchIndex *index = screen.searchIndex();
+    QCOMPARE(index->findLine(regExp, 0, lastLine, true), found ? 1234 : -1);
+    QCOMPARE(index->findLine(regExp, 1235, lastLine, true), found ? 4321 : -1);
+    QCOMPARE(index->findLine(regExp, 0, lastLine, false), found ? 4321 : -1);
+    QCOMPARE(index->findLine(regExp, 0, 4320, false), found ? 1234 : -1);
+    QCOMPARE(index->findLine(regExp, 1235, 4320, true), -1);
+
+    // new output is found by the next search
+    addLine(screen, QStringLiteral("more Needle"));
+    addLines(screen);
+    QCOMPARE(index->findLine(regExp, 4322, lastLine + 5001, true), found ? 5000 : -1);
+}
+
+void HistorySearchIndexTest::testWrappedLine()
+{
+    Screen screen(10, 40);
+    screen.setScroll(CompactHistoryType(100000));
+
+    // "Needle" wraps to the next line at the end of line 1023, the
+    // last line of the 16th block
+    for (int n = 0; n < 2000; n++) {
+        addLine(screen, n == 1023 ? QString(37, QLatin1Char('x')) + QStringLiteral("Needle") : QStringLiteral("line"));
+    }
+
+    const int lastLine = screen.getHistLines() + screen.getLines() - 1;
+    HistorySearchIndex *index = screen.searchIndex();
+    const QRegularExpression regExp(QStringLiteral("Needle"));
+    QCOMPARE(index->findLine(regExp, 0, lastLine, true), 1023);
+    QCOMPARE(index->findLine(regExp, 0, lastLine, false), 1023);
+}
+
+void HistorySearchIndexTest::testDroppedLines()
+{
+    Screen screen(10, 40);
+    screen.setScroll(CompactHistoryType(1000));
+    addLines(screen);
+
+    // only "line 3991" to "line 4999" are left
+    const int lastLine = screen.getHistLines() + screen.getLines() - 1;
+    HistorySearchIndex *index = screen.searchIndex();
+    const QRegularExpression regExp(QStringLiteral("Needle"));
+    QCOMPARE(index->findLine(regExp, 0, lastLine, true), 4321 - 3991);
+
+    // the indexed lines with the match leave the history
+    for (int n = 0; n < 500; n++) {
+        addLine(screen, QStringLiteral("line"));
+    }
+    QCOMPARE(index->findLine(regExp, 0, lastLine, true), -1);
+    QCOMPARE(index->findLine(QRegularExpression(QStringLiteral("line 4999")), 0, lastLine, true), 4999 - 4490);
+}
+
+void HistorySearchIndexTest::testClearedHistory()
+{
+    Screen screen(10, 40);
+    screen.setScroll(CompactHistoryType(100000));
+    addLines(screen);
+
+    HistorySearchIndex *index = screen.searchIndex();
+    const QRegularExpression regExp(QStringLiteral("Needle"));
+    QCOMPARE(index->findLine(regExp, 0, 4999, true), 1234);
+
+    screen.setScroll(CompactHistoryType(100000), false);
+    for (int n = 0; n < 1000; n++) {
+        addLine(screen, QStringLiteral("line"));
+    }
+    QCOMPARE(index->findLine(regExp, 0, 999, true), -1);
+}
+
+void HistorySearchIndexTest::testMatchAcrossBlocks()
+{
+    Screen screen(10, 40);
+    screen.setScroll(CompactHistoryType(100000));
+    addLines(screen);
+
+    // "line 63" ends the first block, "line 64" starts the second one
+    const int lastLine = screen.getHistLines() + screen.getLines() - 1;
+    HistorySearchIndex *index = screen.searchIndex();
+    const QRegularExpression regExp(QStringLiteral("line 63\\nline 64"));
+    QCOMPARE(index->findLine(regExp, 0, lastLine, true), 63);
+    QCOMPARE(index->findLine(regExp, 0, lastLine, false), 63);
+}
+
+void HistorySearchIndexTest::testRewrappedHistory()
+{
+    Screen screen(10, 40);
+    screen.setReflowLines(true);
+    screen.setScroll(CompactHistoryType(100000));
+    for (int n = 0; n < 5000; n++) {
+        QString text = QStringLiteral("line %1 ").arg(n).leftJustified(30, QLatin1Char('.'));
+        if (n == 1234 || n == 4321) {
+            text.replace(24, 6, QStringLiteral("Needle"));
+        }
+        addLine(screen, text);
+    }
+
+    // the lines found are those of a search of the whole text, while the
+    // history is rewrapped and afterwards
+    HistorySearchIndex *index = screen.searchIndex();
+    const QRegularExpression regExp(QStringLiteral("Needle"));
+    auto check = [&screen, index, &regExp]() {
+        const int lastLine = screen.getHistLines() + screen.getLines() - 1;
+        QList<int> linePositions;
+        const QString text = index->plainText(0, lastLine, &linePositions);
+        const int first = HistorySearchIndex::findInText(regExp, text, linePositions, true);
+        const int last = HistorySearchIndex::findInText(regExp, text, linePositions, false);
+        QVERIFY(first != -1);
+        QVERIFY(first != last);
+        QCOMPARE(index->findLine(regExp, 0, lastLine, true), first);
+        QCOMPARE(index->findLine(regExp, 0, lastLine, false), last);
+
+        linePositions.clear();
+        const QString rest = index->plainText(first + 1, lastLine, &linePositions);
+        const int next = first + 1 + HistorySearchIndex::findInText(regExp, rest, linePositions, true);
+        QCOMPARE(index->findLine(regExp, first + 1, lastLine, true), next);
+    };
+
+    screen.resizeImage(10, 20);
+    check();
+    while (screen.rewrapHistory(1000)) {
+    }
+    check();
+
+    // lines added after the history has been rewrapped
+    addLine(screen, QStringLiteral("Needle"));
+    check();
+}
+
+void HistorySearchIndexTest::testSearchThread_data()
+{
+    QTest::addColumn<bool>("forwards");
+
+    QTest::newRow("forwards") << true;
+    QTest::newRow("backwards") << false;
+}
+
+void HistorySearchIndexTest::testSearchThread()
+{
+    QFETCH(bool, forwards);
+
+    Screen screen(10, 40);
+    screen.setScroll(CompactHistoryType(100000));
+    addLines(screen);
+
+    // the ranges are searched in the order given and overlap by a line,
+    // lines are counted from the first line added to the history
+    const qint64 firstLine = screen.addedHistoryLines() - screen.getHistLines();
+    const int lineCount = screen.getHistLines() + screen.getLines();
+    QVector<QPair<qint64, qint64> > ranges;
+    for (int i = 0; i < lineCount; i += HistorySearchIndex::BlockLines) {
+        const int first = forwards ? i : qMax(0, lineCount - i - HistorySearchIndex::BlockLines);
+        const int last = forwards ? qMin(lineCount - 1, i + HistorySearchIndex::BlockLines) : lineCount - i - 1;
+        ranges.append(qMakePair(firstLine + first, firstLine + last));
+    }
+
+    QMutex lock;
+    SearchHistoryThread thread(QRegularExpression(QStringLiteral("Needle")), forwards, &screen, &lock, ranges);
+    QSignalSpy matchesSpy(&thread, &SearchHistoryThread::matchesFound);
+    QSignalSpy finishedSpy(&thread, &SearchHistoryThread::searchFinished);
+    thread.start();
+
+    QVERIFY(thread.wait(10000));
+    QCOMPARE(finishedSpy.count(), 1);
+
+    QVector<qint64> lines;
+    for (const QList<QVariant> &arguments : qAsConst(matchesSpy)) {
+        lines += arguments.at(0).value<QVector<qint64> >();
+    }
+    QCOMPARE(lines, forwards ? QVector<qint64>({firstLine + 1234, firstLine + 4321})
+                             : QVector<qint64>({firstLine + 4321, firstLine + 1234}));
+}
+
+QTEST_GUILESS_MAIN(HistorySearchIndexTest)
@@ -26,6 +26,8 @@
 #include "../Session.h"
 #include "../Emulation.h"
 #include "../History.h"
+#include "../HistoryReflow.h"
+#include "../Screen.h"
 
 using namespace Konsole;
 
@@ -140,4 +142,381 @@ void HistoryTest::testHistoryScroll()
     delete historyScroll;
 }
 
+void HistoryTest::testCompactHistoryScroll()
+{
+    // enough lines to recycle blocks several times, line n has
+    // (n % 150) cells with a format change every 7 cells
+    const int maxLines = 10000;
+    const int lineCount = 5 * maxLines;
+    CompactHistoryScroll historyScroll(maxLines);
+    QVector<Character> line;
+    for (int n = 0; n < lineCount; n++) {
+        line.resize(n % 150);
+        for (int k = 0; k < line.size(); k++) {
+            line[k] = Character(n + k, CharacterColor(COLOR_SPACE_DEFAULT, k / 7 % 2));
+        }
+        historyScroll.addCellsVector(line);
+        historyScroll.addLine(n % 3 == 0);
+    }
+    QCOMPARE(historyScroll.getLines(), maxLines);
+
+    Character cells[150];
+    for (int i = 0; i < maxLines; i++) {
+        const int n = lineCount - maxLines + i;
+        const int length = n % 150;
+        QCOMPARE(historyScroll.getLineLen(i), length);
+        QCOMPARE(historyScroll.isWrappedLine(i), n % 3 == 0);
+        historyScroll.getCells(i, length / 2, length - length / 2, cells);
+        for (int k = length / 2; k < length; k++) {
+            QCOMPARE(cells[k - length / 2].character, static_cast<uint>(n + k));
+            QCOMPARE(cells[k - length / 2].foregroundColor, CharacterColor(COLOR_SPACE_DEFAULT, k / 7 % 2));
+        }
+    }
+
+    // shrinking keeps the newest lines
+    historyScroll.setMaxNbLines(10);
+    QCOMPARE(historyScroll.getLines(), 10);
+    QCOMPARE(historyScroll.getLineLen(9), (lineCount - 1) % 150);
+    QCOMPARE(historyScroll.isWrappedLine(9), (lineCount - 1) % 3 == 0);
+}
+
+void HistoryTest::testFileHistoryScroll()
+{
+    // line n has (n % 50) cells in a few styles
+    HistoryScrollFile historyScroll(QStringLiteral("test.log"));
+    const int lineCount = 500;
+    auto cellOf = [](int n, int k) {
+        return Character(n + k, CharacterColor(COLOR_SPACE_256, k % 3),
+                         CharacterColor(COLOR_SPACE_RGB, 0x102030 * (k % 2)),
+                         (k % 4 == 0) ? RE_BOLD : DEFAULT_RENDITION, k != 5);
+    };
+    QVector<Character> line;
+    for (int n = 0; n < lineCount; n++) {
+        line.resize(n % 50);
+        for (int k = 0; k < line.size(); k++) {
+            line[k] = cellOf(n, k);
+        }
+        historyScroll.addCellsVector(line);
+        historyScroll.addLine(n % 3 == 0);
+    }
+    QCOMPARE(historyScroll.getLines(), lineCount);
+
+    Character cells[50];
+    for (int n = 0; n < lineCount; n++) {
+        const int length = n % 50;
+        QCOMPARE(historyScroll.getLineLen(n), length);
+        QCOMPARE(historyScroll.isWrappedLine(n), n % 3 == 0);
+        historyScroll.getCells(n, length / 2, length - length / 2, cells);
+        for (int k = length / 2; k < length; k++) {
+            const Character expected = cellOf(n, k);
+            QVERIFY(cells[k - length / 2] == expected);
+            QCOMPARE(cells[k - length / 2].isRealCharacter, expected.isRealCharacter);
+        }
+    }
+}
+
+void HistoryTest::testRingFileHistory()
+{
+    HistoryScrollRingFile historyScroll(2);
+    QVERIFY(historyScroll.hasScroll());
+    QCOMPARE(historyScroll.getLines(), 0);
+    QCOMPARE(historyScroll.getLineLen(0), 0);
+
+    const HistoryType &historyType = historyScroll.getType();
+    QCOMPARE(historyType.isEnabled(), true);
+    QCOMPARE(historyType.isUnlimited(), false);
+    QCOMPARE(historyType.maximumLineCount(), 2 * HistoryScrollRingFile::SegmentSize / 4);
+    QCOMPARE(historyType.fileSize(), 2);
+    QCOMPARE(HistoryTypeNone().fileSize(), 0);
+    QCOMPARE(CompactHistoryType(42).fileSize(), 0);
+
+    // line n has (n % 100) cells holding n, every third line is wrapped
+    const int lineCount = 100000;
+    QVector<Character> line;
+    for (int n = 0; n < lineCount; n++) {
+        line.fill(Character(n), n % 100);
+        historyScroll.addCellsVector(line);
+        historyScroll.addLine(n % 3 == 0);
+    }
+
+    // the two segments of the 2 MB file cannot hold all lines
+    const int lines = historyScroll.getLines();
+    QVERIFY(lines > 0);
+    QVERIFY(lines < lineCount);
+
+    Character cells[100];
+    for (int i = 0; i < lines; i++) {
+        const int n = lineCount - lines + i;
+        QCOMPARE(historyScroll.getLineLen(i), n % 100);
+        QCOMPARE(historyScroll.isWrappedLine(i), n % 3 == 0);
+        if (n % 100 > 0) {
+            historyScroll.getCells(i, 0, n % 100, cells);
+            QCOMPARE(cells[0].character, static_cast<uint>(n));
+            QCOMPARE(cells[n % 100 - 1].character, static_cast<uint>(n));
+        }
+    }
+}
+
+void HistoryTest::testCompressedHistory()
+{
+    CompressedHistoryScroll historyScroll;
+    QVERIFY(historyScroll.hasScroll());
+    QCOMPARE(historyScroll.getLines(), 0);
+
+    const HistoryType &historyType = historyScroll.getType();
+    QCOMPARE(historyType.isEnabled(), true);
+    QCOMPARE(historyType.isUnlimited(), true);
+
+    // line n has (n % 100) cells, the first half of them bold and
+    // colored, the second one a placeholder, every third line is wrapped
+    const int lineCount = 5 * CompressedHistoryScroll::SegmentLines + 10;
+    const CharacterColor color(COLOR_SPACE_RGB, 0x123456);
+    QVector<Character> line;
+    for (int n = 0; n < lineCount; n++) {
+        line.resize(n % 100);
+        for (int k = 0; k < line.size(); k++) {
+            line[k] = k < line.size() / 2 ? Character(n + k, color, CharacterColor(), RE_BOLD, k != 1)
+                                          : Character(n + k);
+        }
+        historyScroll.addCellsVector(line);
+        historyScroll.addLine(n % 3 == 0);
+    }
+
+    // nothing is dropped
+    QCOMPARE(historyScroll.getLines(), lineCount);
+
+    Character cells[100];
+    for (int n = 0; n < lineCount; n++) {
+        QCOMPARE(historyScroll.getLineLen(n), n % 100);
+        QCOMPARE(historyScroll.isWrappedLine(n), n % 3 == 0);
+        historyScroll.getCells(n, 0, n % 100, cells);
+        for (int k = 0; k < n % 100; k++) {
+            QCOMPARE(cells[k].character, static_cast<uint>(n + k));
+            const bool formatted = k < (n % 100) / 2;
+            QCOMPARE(cells[k].rendition, static_cast<RenditionFlags>(formatted ? RE_BOLD : DEFAULT_RENDITION));
+            QCOMPARE(cells[k].foregroundColor == color, formatted);
+            QCOMPARE(cells[k].isRealCharacter, !formatted || k != 1);
+        }
+    }
+
+    // reading part of a sealed line
+    historyScroll.getCells(99, 10, 5, cells);
+    QCOMPARE(cells[0].character, static_cast<uint>(99 + 10));
+    QCOMPARE(cells[4].character, static_cast<uint>(99 + 14));
+
+    // switching to compressed history keeps the lines
+    auto *compactScroll = new CompactHistoryScroll(10);
+    for (int n = 0; n < 3; n++) {
+        line.fill(Character('a' + n), 5);
+        compactScroll->addCellsVector(line);
+        compactScroll->addLine(n == 1);
+    }
+    HistoryScroll *compressedScroll = CompressedHistoryType().scroll(compactScroll);
+    QCOMPARE(compressedScroll->getLines(), 3);
+    QCOMPARE(compressedScroll->isWrappedLine(1), true);
+    compressedScroll->getCells(2, 0, 5, cells);
+    QCOMPARE(cells[4].character, static_cast<uint>('c'));
+    QCOMPARE(CompressedHistoryType().scroll(compressedScroll), compressedScroll);
+    delete compressedScroll;
+}
+
+static void addHistoryLine(HistoryScroll &historyScroll, const QString &text, bool wrapped)
+{
+    QVector<Character> line;
+    for (const QChar c : text) {
+        line.append(Character(c.unicode()));
+    }
+    historyScroll.addCellsVector(line);
+    historyScroll.addLine(wrapped);
+}
+
+// returns the text of a line presented by a HistoryReflow, followed by a
+// '+' if the line is wrapped
+static QString reflowedLine(const HistoryReflow &reflow, int line)
+{
+    QVector<Character> cells(reflow.getLineLen(line));
+    reflow.getCells(line, 0, cells.size(), cells.data());
+    QString text;
+    for (const Character &c : qAsConst(cells)) {
+        if (c.isRealCharacter) {
+            text.append(QChar(c.character));
+        }
+    }
+    return reflow.isWrappedLine(line) ? text + QLatin1Char('+') : text;
+}
+
+void HistoryTest::testHistoryReflow()
+{
+    CompactHistoryScroll historyScroll(6);
+    addHistoryLine(historyScroll, QStringLiteral("0123456789"), true);
+    addHistoryLine(historyScroll, QStringLiteral("abcde"), false);
+    addHistoryLine(historyScroll, QStringLiteral("xyz"), false);
+
+    HistoryReflow reflow;
+    reflow.setHistory(&historyScroll);
+    QCOMPARE(reflow.getLines(), 3);
+
+    // only the newest line is rewrapped at once
+    reflow.reflow(4, 1);
+    QVERIFY(reflow.hasOlderLines());
+    QCOMPARE(reflow.getLines(), 3);
+    QCOMPARE(reflowedLine(reflow, 0), QStringLiteral("0123456789+"));
+    QCOMPARE(reflowedLine(reflow, 1), QStringLiteral("abcde"));
+    QCOMPARE(reflowedLine(reflow, 2), QStringLiteral("xyz"));
+
+    // the older lines are joined and split at the new width
+    QCOMPARE(reflow.rewrapOlderLines(10), 2);
+    QVERIFY(!reflow.hasOlderLines());
+    QCOMPARE(reflow.getLines(), 5);
+    QCOMPARE(reflowedLine(reflow, 0), QStringLiteral("0123+"));
+    QCOMPARE(reflowedLine(reflow, 1), QStringLiteral("4567+"));
+    QCOMPARE(reflowedLine(reflow, 2), QStringLiteral("89ab+"));
+    QCOMPARE(reflowedLine(reflow, 3), QStringLiteral("cde"));
+    QCOMPARE(reflowedLine(reflow, 4), QStringLiteral("xyz"));
+
+    // lines added later are presented as stored
+    for (int i = 0; i < 3; i++) {
+        addHistoryLine(historyScroll, QStringLiteral("new%1").arg(i), false);
+        reflow.lineAdded(0);
+    }
+    QCOMPARE(reflow.getLines(), 8);
+    QCOMPARE(reflowedLine(reflow, 7), QStringLiteral("new2"));
+
+    // dropping the first stored line shortens the logical line it started
+    addHistoryLine(historyScroll, QStringLiteral("new3"), false);
+    reflow.lineAdded(1);
+    QCOMPARE(historyScroll.getLines(), 6);
+    QCOMPARE(reflow.getLines(), 7);
+    QCOMPARE(reflowedLine(reflow, 0), QStringLiteral("abcd+"));
+    QCOMPARE(reflowedLine(reflow, 1), QStringLiteral("e"));
+    QCOMPARE(reflowedLine(reflow, 6), QStringLiteral("new3"));
+
+    // a double width character which does not fit starts the next line
+    CompactHistoryScroll wideScroll(2);
+    QVector<Character> wide;
+    for (const QChar c : QStringLiteral("abc")) {
+        wide.append(Character(c.unicode()));
+    }
+    wide.append(Character(0x4e00));
+    wide.append(Character(0, CharacterColor(COLOR_SPACE_DEFAULT, DEFAULT_FORE_COLOR),
+                          CharacterColor(COLOR_SPACE_DEFAULT, DEFAULT_BACK_COLOR), DEFAULT_RENDITION, false));
+    wide.append(Character('d'));
+    wideScroll.addCellsVector(wide);
+    wideScroll.addLine(false);
+
+    reflow.setHistory(&wideScroll);
+    reflow.reflow(4, 1);
+    QCOMPARE(reflow.getLines(), 2);
+    QCOMPARE(reflowedLine(reflow, 0), QStringLiteral("abc+"));
+    QCOMPARE(reflowedLine(reflow, 1), QString(QChar(0x4e00)) + QLatin1Char('d'));
+}
+
+void HistoryTest::testLongLineReflow()
+{
+    // a logical line of more stored lines than are rewrapped together
+    const int storedLines = 3 * HistoryReflow::MaxWrappedLines + 10;
+    CompactHistoryScroll historyScroll(storedLines + 1);
+    for (int i = 0; i < storedLines; i++) {
+        addHistoryLine(historyScroll, QStringLiteral("0123456789"), i < storedLines - 1);
+    }
+    addHistoryLine(historyScroll, QStringLiteral("xyz"), false);
+
+    HistoryReflow reflow;
+    reflow.setHistory(&historyScroll);
+    reflow.reflow(4, 1);
+    while (reflow.hasOlderLines()) {
+        reflow.rewrapOlderLines(1);
+    }
+
+    // every piece holds a multiple of 4 cells here, so the rows are full
+    QCOMPARE(reflow.getLines(), storedLines * 10 / 4 + 1);
+    QString text;
+    for (int line = 0; line < reflow.getLines() - 1; line++) {
+        QString row = reflowedLine(reflow, line);
+        if (line < reflow.getLines() - 2) {
+            QVERIFY(row.endsWith(QLatin1Char('+')));
+            row.chop(1);
+        }
+        QCOMPARE(row.size(), 4);
+        text += row;
+    }
+    QCOMPARE(text, QStringLiteral("0123456789").repeated(storedLines));
+    QCOMPARE(reflowedLine(reflow, reflow.getLines() - 1), QStringLiteral("xyz"));
+}
+
+// returns the text of a line of the screen or its history, see reflowedLine()
+static QString screenLine(const Screen &screen, int line)
+{
+    QVector<Character> cells(screen.getColumns());
+    screen.getImage(cells.data(), cells.size(), line, line);
+    QString text;
+    for (const Character &c : qAsConst(cells)) {
+        if (c.isRealCharacter) {
+            text.append(QChar(c.character));
+        }
+    }
+    text = text.trimmed();
+    return (screen.getLineProperties(line, line).at(0) & LINE_WRAPPED) != 0 ? text + QLatin1Char('+') : text;
+}
+
+void HistoryTest::testScreenReflow()
+{
+    Screen screen(3, 10);
+    screen.setReflowLines(true);
+    screen.setScroll(CompactHistoryType(100000));
+
+    const QVector<uint> text = QStringLiteral("0123456789abc").toUcs4();
+    screen.displayCharacters(text.constData(), text.size());
+    screen.toStartOfLine();
+    screen.newLine();
+    screen.displayCharacter('x');
+    screen.displayCharacter('y');
+    QCOMPARE(screenLine(screen, 0), QStringLiteral("0123456789+"));
+    QCOMPARE(screenLine(screen, 1), QStringLiteral("abc"));
+
+    // the first line moves into the history
+    screen.resizeImage(3, 5);
+    QCOMPARE(screen.getHistLines(), 1);
+    QCOMPARE(screenLine(screen, 0), QStringLiteral("01234+"));
+    QCOMPARE(screenLine(screen, 1), QStringLiteral("56789+"));
+    QCOMPARE(screenLine(screen, 2), QStringLiteral("abc"));
+    QCOMPARE(screenLine(screen, 3), QStringLiteral("xy"));
+    QCOMPARE(screen.getCursorY(), 2);
+    QCOMPARE(screen.getCursorX(), 2);
+
+    // the older lines of a long history are rewrapped later
+    for (int i = 0; i < 20000; i++) {
+        screen.displayCharacter('z');
+    }
+    const int histLines = screen.getHistLines();
+    screen.resizeImage(3, 10);
+    QVERIFY(screen.rewrapHistory(0));
+    QCOMPARE(screenLine(screen, 0), QStringLiteral("01234+"));
+    while (screen.rewrapHistory(1000)) {
+    }
+    QVERIFY(screen.getHistLines() < histLines);
+    QCOMPARE(screenLine(screen, 0), QStringLiteral("0123456789+"));
+    QCOMPARE(screenLine(screen, 1), QStringLiteral("abc"));
+    QCOMPARE(screenLine(screen, 2), QStringLiteral("xyzzzzzzzz+"));
+
+    // a double width character is not split from its placeholder, and the
+    // saved cursor stays at the cell it was saved at
+    Screen wideScreen(3, 6);
+    wideScreen.setReflowLines(true);
+    const QVector<uint> wideText = QStringLiteral("abc").toUcs4();
+    wideScreen.displayCharacters(wideText.constData(), wideText.size());
+    wideScreen.saveCursor();
+    wideScreen.displayCharacter(0x4e00);
+    wideScreen.displayCharacter('d');
+
+    wideScreen.resizeImage(3, 4);
+    QCOMPARE(screenLine(wideScreen, 0), QStringLiteral("abc+"));
+    QCOMPARE(screenLine(wideScreen, 1), QString(QChar(0x4e00)) + QLatin1Char('d'));
+    QCOMPARE(wideScreen.getCursorY(), 1);
+    QCOMPARE(wideScreen.getCursorX(), 3);
+    wideScreen.restoreCursor();
+    QCOMPARE(wideScreen.getCursorY(), 1);
+    QCOMPARE(wideScreen.getCursorX(), 0);
+}
+
 QTEST_MAIN(HistoryTest)
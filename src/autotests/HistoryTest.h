@@ -35,6 +35,13 @@ private Q_SLOTS:
     void testCompactHistory();
     void testEmulationHistory();
     void testHistoryScroll();
+    void testCompactHistoryScroll();
+    void testFileHistoryScroll();
+    void testRingFileHistory();
+    void testCompressedHistory();
+    void testHistoryReflow();
+    void testLongLineReflow();
+    void testScreenReflow();
 
 private:
 };
@@ -0,0 +1,151 @@
+/*
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+    02110-1301  USA.
+*/
+
+// Own
+#include "LineBlockCharactersTest.h"
+
+// Qt
+#include <QImage>
+#include <QPainter>
+
+// KDE
+#include <qtest.h>
+
+// Konsole
+#include "../LineBlockCharacters.h"
+
+using namespace Konsole;
+
+static QImage drawCell(const QSize &cellSize, QChar chr, bool bold, bool antialiased,
+                       LineBlockCharacters::Atlas *atlas, bool *rasterized = nullptr)
+{
+    QImage image(cellSize, QImage::Format_ARGB32_Premultiplied);
+    image.fill(QColor(0x20, 0x20, 0x40));
+
+    QPainter painter(&image);
+    painter.setRenderHint(QPainter::Antialiasing, antialiased);
+    painter.setPen(QColor(0xe0, 0xc0, 0x30));
+    if (atlas != nullptr) {
+        const bool result = atlas->draw(painter, QRect(QPoint(0, 0), cellSize), chr, bold);
+        if (rasterized != nullptr) {
+            *rasterized = result;
+        }
+    } else {
+        LineBlockCharacters::draw(painter, QRect(QPoint(0, 0), cellSize), chr, bold);
+    }
+    return image;
+}
+
+// antialiased edges are rounded differently when the character is
+// blended from the atlas instead of drawn on the background
+static bool isAlmostEqual(const QImage &image, const QImage &expected)
+{
+    for (int y = 0; y < image.height(); y++) {
+        for (int x = 0; x < image.width(); x++) {
+            const QRgb a = image.pixel(x, y);
+            const QRgb b = expected.pixel(x, y);
+            if (qAbs(qRed(a) - qRed(b)) > 2 || qAbs(qGreen(a) - qGreen(b)) > 2
+                || qAbs(qBlue(a) - qBlue(b)) > 2) {
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+void LineBlockCharactersTest::testAtlas_data()
+{
+    QTest::addColumn<QSize>("cellSize");
+    QTest::addColumn<bool>("bold");
+    QTest::addColumn<bool>("antialiased");
+
+    // the width is a multiple of the size of the shade patterns, so they
+    // are aligned in the atlas like on the screen
+    QTest::newRow("8x16") << QSize(8, 16) << false << false;
+    QTest::newRow("8x16 bold") << QSize(8, 16) << true << false;
+    QTest::newRow("11x23 antialiased") << QSize(11, 23) << false << true;
+    QTest::newRow("11x23 antialiased bold") << QSize(11, 23) << true << true;
+}
+
+void LineBlockCharactersTest::testAtlas()
+{
+    QFETCH(QSize, cellSize);
+    QFETCH(bool, bold);
+    QFETCH(bool, antialiased);
+
+    LineBlockCharacters::Atlas atlas;
+    for (uint c = 0x2500; c <= 0x259f; c++) {
+        const QChar chr(c);
+        const QImage expected = drawCell(cellSize, chr, bold, antialiased, nullptr);
+
+        bool rasterized = true;
+        QVERIFY2(isAlmostEqual(drawCell(cellSize, chr, bold, antialiased, &atlas, &rasterized), expected),
+                 qPrintable(QString::number(c, 16)));
+        QVERIFY(!rasterized);
+        QVERIFY(isAlmostEqual(drawCell(cellSize, chr, bold, antialiased, &atlas, &rasterized), expected));
+        QVERIFY(rasterized);
+    }
+}
+
+void LineBlockCharactersTest::testAtlasGlyphs()
+{
+    const QSize cellSize(10, 20);
+    const QChar chr(0x2502);
+
+    LineBlockCharacters::Atlas atlas;
+    QCOMPARE(atlas.memory(), 0);
+
+    bool rasterized = true;
+    drawCell(cellSize, chr, false, true, &atlas, &rasterized);
+    QVERIFY(!rasterized);
+    const int glyphBytes = atlas.memory();
+    QCOMPARE(glyphBytes, cellSize.width() * cellSize.height() * 4);
+
+    // another glyph for each character, cell size and boldness
+    drawCell(cellSize, QChar(0x2500), false, true, &atlas, &rasterized);
+    QVERIFY(!rasterized);
+    drawCell(cellSize, chr, true, true, &atlas, &rasterized);
+    QVERIFY(!rasterized);
+    drawCell(QSize(12, 24), chr, false, true, &atlas, &rasterized);
+    QVERIFY(!rasterized);
+    drawCell(cellSize, chr, false, true, &atlas, &rasterized);
+    QVERIFY(rasterized);
+    QVERIFY(atlas.memory() > 3 * glyphBytes);
+
+    atlas.clear();
+    QCOMPARE(atlas.memory(), 0);
+    drawCell(cellSize, chr, false, true, &atlas, &rasterized);
+    QVERIFY(!rasterized);
+
+    // the least recently used glyph is dropped when the atlas is full
+    LineBlockCharacters::Atlas smallAtlas(2 * glyphBytes);
+    drawCell(cellSize, chr, false, true, &smallAtlas, &rasterized);
+    drawCell(cellSize, chr, true, true, &smallAtlas, &rasterized);
+    drawCell(cellSize, chr, false, false, &smallAtlas, &rasterized);
+    QCOMPARE(smallAtlas.memory(), 2 * glyphBytes);
+    drawCell(cellSize, chr, false, true, &smallAtlas, &rasterized);
+    QVERIFY(!rasterized);
+
+    // a glyph larger than the atlas is still drawn
+    LineBlockCharacters::Atlas tinyAtlas(glyphBytes - 1);
+    const QImage expected = drawCell(cellSize, chr, false, false, nullptr);
+    QVERIFY(isAlmostEqual(drawCell(cellSize, chr, false, false, &tinyAtlas, &rasterized), expected));
+    QVERIFY(!rasterized);
+    QCOMPARE(tinyAtlas.memory(), 0);
+}
+
+QTEST_MAIN(LineBlockCharactersTest)
@@ -0,0 +1,108 @@
+/*
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+    02110-1301  USA.
+*/
+
+// Own
+#include "LineDiffTest.h"
+
+// KDE
+#include <qtest.h>
+
+// Konsole
+#include "../LineDiff.h"
+
+using namespace Konsole;
+
+static void addImplementations()
+{
+    QTest::addColumn<int>("implementation");
+
+    QTest::newRow("scalar") << int(LineDiff::Scalar);
+    QTest::newRow("sse2") << int(LineDiff::SSE2);
+    QTest::newRow("avx2") << int(LineDiff::AVX2);
+}
+
+void LineDiffTest::testCompare_data()
+{
+    addImplementations();
+}
+
+void LineDiffTest::testCompare()
+{
+    QFETCH(int, implementation);
+    if (!LineDiff::isSupported(LineDiff::Implementation(implementation))) {
+        QSKIP("Not supported by this processor or build");
+    }
+
+    qsrand(1);
+    // odd lengths exercise the tails of the vector loops
+    for (int count = 0; count < 40; count++) {
+        for (int round = 0; round < 20; round++) {
+            QVector<StylePalette::Cell> line(count);
+            QVector<StylePalette::Cell> oldLine(count);
+            for (int i = 0; i < count; i++) {
+                line[i] = StylePalette::Cell(qrand() % 3, qrand() % 3, qrand() % 2 != 0);
+                oldLine[i] = qrand() % 2 ? line[i] : StylePalette::Cell(qrand() % 3);
+            }
+
+            QVector<char> dirtyMask(count + 1, 2);
+            const int dirty = LineDiff::compare(LineDiff::Implementation(implementation),
+                                                line.constData(), oldLine.constData(), count, dirtyMask.data());
+
+            int expected = 0;
+            for (int i = 0; i < count; i++) {
+                const bool differs = line[i] != oldLine[i];
+                QCOMPARE(dirtyMask[i], char(differs ? 1 : 0));
+                expected += differs ? 1 : 0;
+            }
+            QCOMPARE(dirty, expected);
+            // nothing is written after the last character
+            QCOMPARE(dirtyMask[count], char(2));
+        }
+    }
+}
+
+void LineDiffTest::testStyleBits_data()
+{
+    addImplementations();
+}
+
+void LineDiffTest::testStyleBits()
+{
+    QFETCH(int, implementation);
+    if (!LineDiff::isSupported(LineDiff::Implementation(implementation))) {
+        QSKIP("Not supported by this processor or build");
+    }
+
+    // the style ID and the extended flag share a word, each cell differs
+    // in one of them at another place of the vectors
+    const int count = 9;
+    QVector<StylePalette::Cell> line(count);
+    QVector<StylePalette::Cell> oldLine(count);
+    for (int i = 0; i < count; i++) {
+        if (i % 2 == 0) {
+            oldLine[i].style = 1u << (i * 3);
+        } else {
+            oldLine[i].extended = 1;
+        }
+    }
+
+    QVector<char> dirtyMask(count);
+    QCOMPARE(LineDiff::compare(LineDiff::Implementation(implementation),
+                               line.constData(), oldLine.constData(), count, dirtyMask.data()), count);
+}
+
+QTEST_GUILESS_MAIN(LineDiffTest)
@@ -0,0 +1,106 @@
+/*
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+    02110-1301  USA.
+*/
+
+// Own
+#include "ProcessInfoSamplerTest.h"
+
+// System
+#include <climits>
+#include <unistd.h>
+
+// Qt
+#include <QCoreApplication>
+#include <QDir>
+#include <QFile>
+#include <QSignalSpy>
+
+// KDE
+#include <qtest.h>
+
+// Konsole
+#include "../ProcessInfoSampler.h"
+
+using namespace Konsole;
+
+void ProcessInfoSamplerTest::initTestCase()
+{
+    if (!QFile::exists(QStringLiteral("/proc/self/stat"))) {
+        QSKIP("The /proc file system is not available");
+    }
+}
+
+void ProcessInfoSamplerTest::testReadSample()
+{
+    const int pid = static_cast<int>(QCoreApplication::applicationPid());
+    QByteArray buffer;
+    const ProcessInfoSampler::Sample sample = ProcessInfoSampler::readSample(pid, nullptr, buffer);
+
+    QVERIFY(sample.valid);
+    QCOMPARE(sample.pid, pid);
+    QCOMPARE(sample.parentPid, static_cast<int>(getppid()));
+    QVERIFY(sample.startTime > 0);
+    QVERIFY(!sample.name.isEmpty());
+    QVERIFY(sample.userIdValid);
+    QCOMPARE(sample.userId, static_cast<int>(getuid()));
+    QVERIFY(!sample.arguments.isEmpty());
+    QVERIFY(sample.arguments[0].endsWith(QLatin1String("ProcessInfoSamplerTest")));
+    QVERIFY(sample.currentDirValid);
+    QCOMPARE(sample.currentDir, QDir::current().canonicalPath());
+}
+
+void ProcessInfoSamplerTest::testUnchangedProcess()
+{
+    const int pid = static_cast<int>(QCoreApplication::applicationPid());
+    QByteArray buffer;
+    ProcessInfoSampler::Sample previous = ProcessInfoSampler::readSample(pid, nullptr, buffer);
+    previous.arguments = QVector<QString>({QStringLiteral("unchanged")});
+
+    // the arguments are only read again for another process
+    ProcessInfoSampler::Sample sample = ProcessInfoSampler::readSample(pid, &previous, buffer);
+    QCOMPARE(sample.arguments, previous.arguments);
+
+    previous.startTime++;
+    sample = ProcessInfoSampler::readSample(pid, &previous, buffer);
+    QVERIFY(sample.arguments != previous.arguments);
+}
+
+void ProcessInfoSamplerTest::testExitedProcess()
+{
+    QByteArray buffer;
+    const ProcessInfoSampler::Sample sample = ProcessInfoSampler::readSample(INT_MAX, nullptr, buffer);
+    QVERIFY(!sample.valid);
+    QVERIFY(!sample.currentDirValid);
+}
+
+void ProcessInfoSamplerTest::testSample()
+{
+    const int pid = static_cast<int>(QCoreApplication::applicationPid());
+    ProcessInfoSampler sampler;
+    QSignalSpy spy(&sampler, &ProcessInfoSampler::processesChanged);
+
+    // a process is sampled after it was asked for the first time
+    QVERIFY(sampler.sample(pid).isNull());
+    QTRY_VERIFY(!sampler.sample(pid).isNull());
+    QVERIFY(sampler.sample(pid)->valid);
+    QCOMPARE(sampler.sample(pid)->currentDir, QDir::current().canonicalPath());
+    QTRY_COMPARE(spy.count(), 1);
+    QCOMPARE(spy.at(0).at(0).value<QVector<int> >(), QVector<int>({pid}));
+
+    QVERIFY(sampler.sample(0).isNull());
+}
+
+QTEST_GUILESS_MAIN(ProcessInfoSamplerTest)
@@ -0,0 +1,200 @@
+/*
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+    02110-1301  USA.
+*/
+
+// Own
+#include "ScreenWindowTest.h"
+
+// Qt
+#include <QTest>
+
+// Konsole
+#include "../History.h"
+#include "../Screen.h"
+#include "../ScreenWindow.h"
+
+using namespace Konsole;
+
+static const int LINES = 5;
+static const int COLUMNS = 20;
+
+static void addLine(Screen &screen, const QString &text)
+{
+    const QVector<uint> chars = text.toUcs4();
+    screen.nextLine();
+    screen.toStartOfLine();
+    screen.displayCharacters(chars.constData(), chars.size());
+}
+
+// returns the text of a line of the window image
+static QString imageLine(const StylePalette::Cell *image, int line)
+{
+    QString text;
+    for (int column = 0; column < COLUMNS; column++) {
+        text.append(QChar(image[line * COLUMNS + column].character));
+    }
+    return text.trimmed();
+}
+
+// compares the window image with the image of the screen
+static void compareImage(ScreenWindow &window)
+{
+    StylePalette::Cell *image = window.getImage();
+    QVERIFY(window.styles() == window.screen()->styles());
+    QVector<StylePalette::Cell> expected(LINES * COLUMNS);
+    window.screen()->getImage(expected.data(), expected.size(), window.currentLine(), window.currentLine() + LINES - 1);
+    for (int i = 0; i < expected.size(); i++) {
+        QVERIFY(image[i] == expected[i]);
+    }
+}
+
+void ScreenWindowTest::testChangedLines()
+{
+    Screen screen(LINES, COLUMNS);
+    const QVector<uint> first = QStringLiteral("line 0").toUcs4();
+    screen.displayCharacters(first.constData(), first.size());
+    for (int n = 1; n < LINES; n++) {
+        addLine(screen, QStringLiteral("line %1").arg(n));
+    }
+
+    ScreenWindow window(&screen);
+    window.setWindowLines(LINES);
+    window.notifyOutputChanged();
+    window.getImage();
+    const quint64 generation = window.imageGeneration();
+
+    // nothing changed, only the line of the cursor is copied again
+    window.notifyOutputChanged();
+    window.getImage();
+    for (int line = 0; line < LINES - 1; line++) {
+        QVERIFY(!window.isLineChanged(line, generation));
+    }
+
+    // the line written to, and the lines the cursor moved from and to
+    screen.setCursorYX(2, 1);
+    screen.displayCharacter('X');
+    window.notifyOutputChanged();
+    const StylePalette::Cell *image = window.getImage();
+    QVERIFY(window.imageGeneration() > generation);
+    QVERIFY(!window.isLineChanged(0, generation));
+    QVERIFY(window.isLineChanged(1, generation));
+    QVERIFY(!window.isLineChanged(2, generation));
+    QVERIFY(!window.isLineChanged(3, generation));
+    QVERIFY(window.isLineChanged(4, generation));
+    QCOMPARE(imageLine(image, 1), QStringLiteral("Xine 1"));
+    QVERIFY((window.styles()->character(image[1 * COLUMNS + 1]).rendition & RE_CURSOR) != 0);
+    QVERIFY((window.styles()->character(image[4 * COLUMNS + 6]).rendition & RE_CURSOR) == 0);
+    compareImage(window);
+}
+
+void ScreenWindowTest::testScrolledLines()
+{
+    Screen screen(LINES, COLUMNS);
+    screen.setScroll(CompactHistoryType(1000));
+    ScreenWindow window(&screen);
+    window.setWindowLines(LINES);
+
+    for (int n = 0; n < 20; n++) {
+        addLine(screen, QStringLiteral("line %1").arg(n));
+        window.notifyOutputChanged();
+        compareImage(window);
+    }
+    QCOMPARE(imageLine(window.getImage(), LINES - 1), QStringLiteral("line 19"));
+
+    // the lines which move up are changed, the history is kept when the
+    // window does not follow the output
+    window.setTrackOutput(false);
+    window.scrollTo(5);
+    compareImage(window);
+    const quint64 generation = window.imageGeneration();
+    addLine(screen, QStringLiteral("line 20"));
+    window.notifyOutputChanged();
+    compareImage(window);
+    for (int line = 0; line < LINES; line++) {
+        QVERIFY(!window.isLineChanged(line, generation));
+    }
+
+    window.scrollTo(6);
+    compareImage(window);
+    for (int line = 0; line < LINES; line++) {
+        QVERIFY(window.isLineChanged(line, generation));
+    }
+
+    // a changed history starts over
+    screen.setScroll(CompactHistoryType(1000));
+    window.notifyOutputChanged();
+    compareImage(window);
+}
+
+void ScreenWindowTest::testSelection()
+{
+    Screen screen(LINES, COLUMNS);
+    for (int n = 0; n < LINES; n++) {
+        addLine(screen, QStringLiteral("line %1").arg(n));
+    }
+    ScreenWindow window(&screen);
+    window.setWindowLines(LINES);
+    window.getImage();
+
+    // selected lines are inverted
+    quint64 generation = window.imageGeneration();
+    window.setSelectionStart(2, 1, false);
+    window.setSelectionEnd(3, 2);
+    compareImage(window);
+    QVERIFY(!window.isLineChanged(0, generation));
+    QVERIFY(window.isLineChanged(1, generation));
+    QVERIFY(window.isLineChanged(2, generation));
+    QVERIFY(!window.isLineChanged(3, generation));
+
+    // and copied again when the selection is cleared
+    generation = window.imageGeneration();
+    window.clearSelection();
+    window.notifyOutputChanged();
+    compareImage(window);
+    QVERIFY(!window.isLineChanged(0, generation));
+    QVERIFY(window.isLineChanged(1, generation));
+    QVERIFY(window.isLineChanged(2, generation));
+    QVERIFY(!window.isLineChanged(3, generation));
+}
+
+void ScreenWindowTest::testReplacedStyles()
+{
+    Screen screen(LINES, COLUMNS);
+    addLine(screen, QStringLiteral("line 0"));
+    ScreenWindow window(&screen);
+    window.setWindowLines(LINES);
+    compareImage(window);
+    const QSharedPointer<const StylePalette> styles = window.styles();
+
+    // a character in another color each, until the screen replaces its
+    // palette with one of the styles on the screen
+    for (int n = 0; screen.styles() == styles; n++) {
+        QVERIFY(n < 100000);
+        screen.setForeColor(COLOR_SPACE_RGB, n);
+        screen.displayCharacter('x');
+    }
+    QVERIFY(screen.styles()->count() < styles->count());
+
+    // the window copies all lines again
+    const quint64 generation = window.imageGeneration();
+    window.notifyOutputChanged();
+    compareImage(window);
+    for (int line = 0; line < LINES; line++) {
+        QVERIFY(window.isLineChanged(line, generation));
+    }
+}
+
+QTEST_GUILESS_MAIN(ScreenWindowTest)
@@ -0,0 +1,236 @@
+/*
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+    02110-1301  USA.
+*/
+
+// Own
+#include "TerminalDisplayBenchmark.h"
+
+#include "qtest.h"
+
+// Qt
+#include <QElapsedTimer>
+#include <QImage>
+#include <QTextCodec>
+
+// Konsole
+#include "../LineDiff.h"
+#include "../TerminalDisplay.h"
+#include "../Vt102Emulation.h"
+
+using namespace Konsole;
+
+/*
+   Rendering benchmark: the frames of each workload are fed into an
+   emulation, and the TerminalDisplay attached to it updates its image
+   and paints the invalidated region into a QImage.  Besides the time
+   per pass over all frames, the average frame time, the dirty area and
+   the number of drawn text and line graphics runs per frame, the share
+   of texts and line graphics drawn from the glyph run cache and the
+   atlas, and the memory taken by the atlas are reported.  Run it
+   without a display server with
+
+     ./TerminalDisplayBenchmark -platform offscreen
+*/
+
+static const int FrameCount = 100;
+
+// one new line per frame, the whole screen scrolls
+static QList<QByteArray> scrollFrames()
+{
+    QList<QByteArray> frames;
+    for (int i = 0; i < FrameCount; i++) {
+        frames << "\r\n\033[32m" + QByteArray::number(i) + "\033[m: the quick brown fox jumps over the lazy dog";
+    }
+    return frames;
+}
+
+// typing at a prompt, a single cell and the cursor change per frame
+static QList<QByteArray> cursorFrames()
+{
+    QList<QByteArray> frames;
+    frames << QByteArray("\033[12;1H$ ");
+    for (int i = 1; i < FrameCount; i++) {
+        frames << QByteArray(1, static_cast<char>('a' + i % 26));
+    }
+    return frames;
+}
+
+// a TUI with box-drawing frames around panels whose contents change
+static QList<QByteArray> boxDrawingFrames()
+{
+    QByteArray border("\033[H\033[44;37m\xe2\x94\x8c");
+    for (int i = 0; i < 38; i++) {
+        border += "\xe2\x94\x80";
+    }
+    border += "\xe2\x94\xac";
+    for (int i = 0; i < 39; i++) {
+        border += "\xe2\x94\x80";
+    }
+    border += "\xe2\x94\x90";
+    for (int row = 2; row < 24; row++) {
+        const QByteArray line = QByteArray::number(row);
+        border += "\033[" + line + ";1H\xe2\x94\x82\033[" + line + ";40H\xe2\x94\x82\033[" + line + ";80H\xe2\x94\x82";
+    }
+
+    QList<QByteArray> frames;
+    frames << border;
+    for (int i = 1; i < FrameCount; i++) {
+        QByteArray frame;
+        for (int row = 2; row < 24; row++) {
+            const QByteArray line = QByteArray::number(row);
+            frame += "\033[" + line + ";2H" + QByteArray::number(i * row).rightJustified(10, '.');
+            frame += "\033[" + line + ";41H\xe2\x96\x88\xe2\x96\x88\xe2\x96\x93\xe2\x96\x92\xe2\x96\x91 " + QByteArray::number(i + row);
+        }
+        frames << frame;
+    }
+    return frames;
+}
+
+// CJK and right-to-left text scrolling through the screen
+static QList<QByteArray> wideAndRtlFrames()
+{
+    QList<QByteArray> frames;
+    for (int i = 0; i < FrameCount; i++) {
+        if (i % 2 == 0) {
+            frames << QByteArray("\r\n\xe6\xbc\xa2\xe5\xad\x97\xe3\x81\xa8\xe4\xbb\xae\xe5\x90\x8d\xe3\x81\xae\xe6\xb7\xb7\xe5\x9c\xa8 "
+                                 "\xed\x95\x9c\xea\xb5\xad\xec\x96\xb4 \xe4\xb8\xad\xe6\x96\x87\xe5\xad\x97\xe7\xac\xa6");
+        } else {
+            frames << QByteArray("\r\n\xd7\xa9\xd7\x9c\xd7\x95\xd7\x9d \xd7\xa2\xd7\x95\xd7\x9c\xd7\x9d "
+                                 "\xd9\x85\xd8\xb1\xd8\xad\xd8\xa8\xd8\xa7 \xd8\xa8\xd8\xa7\xd9\x84\xd8\xb9\xd8\xa7\xd9\x84\xd9\x85");
+        }
+    }
+    return frames;
+}
+
+void TerminalDisplayBenchmark::benchmarkRendering_data()
+{
+    QTest::addColumn<QList<QByteArray>>("frames");
+
+    QTest::newRow("scroll") << scrollFrames();
+    QTest::newRow("cursor") << cursorFrames();
+    QTest::newRow("box drawing") << boxDrawingFrames();
+    QTest::newRow("wide and rtl") << wideAndRtlFrames();
+}
+
+void TerminalDisplayBenchmark::benchmarkRendering()
+{
+    QFETCH(QList<QByteArray>, frames);
+
+    Vt102Emulation emulation;
+    emulation.setCodec(QTextCodec::codecForName("UTF-8"));
+
+    TerminalDisplay display;
+    display.setSize(80, 24);
+    display.resize(display.sizeHint());
+    display.setScreenWindow(emulation.createWindow());
+    display.updateImage();
+    emulation.setImageSize(display.lines(), display.columns());
+
+    QImage image(display.size(), QImage::Format_ARGB32_Premultiplied);
+    display.render(&image);
+
+    int passes = 0;
+    qint64 dirtyArea = 0;
+    QElapsedTimer timer;
+    display.resetRenderStatistics();
+    timer.start();
+    QBENCHMARK {
+        for (const QByteArray &frame : frames) {
+            emulation.receiveData(frame.constData(), frame.size());
+            // flush the output immediately instead of waiting for the
+            // emulation's bulk timers, this calls updateImage()
+            QMetaObject::invokeMethod(&emulation, "showBulk", Qt::DirectConnection);
+
+            const QRegion dirtyRegion = display.renderStatistics().dirtyRegion;
+            for (const QRect &rect : dirtyRegion) {
+                dirtyArea += rect.width() * rect.height();
+            }
+            if (!dirtyRegion.isEmpty()) {
+                display.render(&image, dirtyRegion.boundingRect().topLeft(), dirtyRegion);
+            }
+            // a frame without an update must not count this one again
+            display.resetDirtyStatistics();
+        }
+        passes++;
+    }
+    const qint64 elapsed = timer.nsecsElapsed();
+
+    const int frameCount = passes * frames.size();
+    const TerminalDisplay::RenderStatistics &statistics = display.renderStatistics();
+    const int shapedTexts = statistics.glyphRunCacheHits + statistics.glyphRunCacheMisses;
+    const int lineChars = statistics.lineCharAtlasHits + statistics.lineCharAtlasMisses;
+    qDebug("%s: %.1f us/frame, %lld px dirty/frame, %.1f text runs/frame, %.1f line graphics runs/frame, "
+           "%.1f%% glyph run cache hits, %.1f%% line graphics atlas hits, %d kB atlas",
+           QTest::currentDataTag(),
+           elapsed / 1000.0 / frameCount,
+           dirtyArea / frameCount,
+           static_cast<double>(statistics.textFragments) / frameCount,
+           static_cast<double>(statistics.lineCharFragments) / frameCount,
+           shapedTexts > 0 ? 100.0 * statistics.glyphRunCacheHits / shapedTexts : 0.0,
+           lineChars > 0 ? 100.0 * statistics.lineCharAtlasHits / lineChars : 0.0,
+           statistics.lineCharAtlasBytes / 1024);
+}
+
+void TerminalDisplayBenchmark::benchmarkLineDiff_data()
+{
+    QTest::addColumn<int>("implementation");
+    QTest::addColumn<bool>("changed");
+
+    QTest::newRow("scalar, unchanged") << int(LineDiff::Scalar) << false;
+    QTest::newRow("scalar, changed") << int(LineDiff::Scalar) << true;
+    QTest::newRow("sse2, unchanged") << int(LineDiff::SSE2) << false;
+    QTest::newRow("sse2, changed") << int(LineDiff::SSE2) << true;
+    QTest::newRow("avx2, unchanged") << int(LineDiff::AVX2) << false;
+    QTest::newRow("avx2, changed") << int(LineDiff::AVX2) << true;
+}
+
+void TerminalDisplayBenchmark::benchmarkLineDiff()
+{
+    QFETCH(int, implementation);
+    QFETCH(bool, changed);
+
+    if (!LineDiff::isSupported(LineDiff::Implementation(implementation))) {
+        QSKIP("Not supported by this processor or build");
+    }
+
+    // the comparison of a 300x100 image with the previous one, in
+    // which every fourth character changed or nothing did
+    const int columns = 300;
+    const int lines = 100;
+    QVector<Character> image(columns * lines);
+    for (int i = 0; i < image.size(); i++) {
+        image[i].character = 'a' + i % 26;
+    }
+    QVector<Character> oldImage = image;
+    if (changed) {
+        for (int i = 0; i < oldImage.size(); i += 4) {
+            oldImage[i].rendition = RE_BOLD;
+        }
+    }
+
+    QVector<char> dirtyMask(columns);
+    int dirty = 0;
+    QBENCHMARK {
+        for (int y = 0; y < lines; y++) {
+            dirty += LineDiff::compare(LineDiff::Implementation(implementation),
+                                       image.constData() + y * columns, oldImage.constData() + y * columns,
+                                       columns, dirtyMask.data());
+        }
+    }
+    QVERIFY(changed ? dirty > 0 : dirty == 0);
+}
+
+QTEST_MAIN(TerminalDisplayBenchmark)
@@ -0,0 +1,287 @@
+/*
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+    02110-1301  USA.
+*/
+
+// Own
+#include "Vt102EmulationBenchmark.h"
+
+#include "qtest.h"
+
+// Qt
+#include <QElapsedTimer>
+#include <QFile>
+#include <QTextCodec>
+
+// Konsole
+#include "../History.h"
+#include "../Vt102Emulation.h"
+
+using namespace Konsole;
+
+/*
+   Headless benchmarks of the terminal emulation, no TerminalDisplay is
+   involved.  The corpora are generated or read from the files in tests/
+   so that runs are reproducible; each is about 1 MB.  To compare two
+   builds, run this benchmark on both revisions:
+
+     ./Vt102EmulationBenchmark benchmarkEscapeSequences -iterations 20
+     ./Vt102EmulationBenchmark benchmarkThroughput
+*/
+
+static const int CorpusSize = 1024 * 1024;
+
+// repeats a text file up to the corpus size, with CR LF line endings
+static QByteArray fileCorpus(const QString &fileName)
+{
+    QFile file(fileName);
+    if (!file.open(QIODevice::ReadOnly)) {
+        return QByteArray();
+    }
+    QByteArray text = file.readAll();
+    if (text.isEmpty()) {
+        return QByteArray();
+    }
+    text.replace('\n', "\r\n");
+
+    QByteArray data;
+    while (data.size() < CorpusSize) {
+        data += text;
+    }
+    return data;
+}
+
+// plain text, the best case for the emulation
+static QByteArray asciiCorpus()
+{
+    const QByteArray line("The quick brown fox jumps over the lazy dog. 0123456789 ~!@#$%^&*()_+-=[]{}\r\n");
+    QByteArray data;
+    while (data.size() < CorpusSize) {
+        data += line;
+    }
+    return data;
+}
+
+// a color gradient which changes the 24-bit foreground and background on every character
+static QByteArray trueColorCorpus()
+{
+    QByteArray data;
+    for (int i = 0; data.size() < CorpusSize; i++) {
+        const int r = i % 256;
+        const int g = (i / 3) % 256;
+        const int b = 255 - r;
+        data += "\033[38;2;" + QByteArray::number(r) + ';' + QByteArray::number(g) + ';' + QByteArray::number(b) + 'm';
+        data += "\033[48;2;" + QByteArray::number(b) + ';' + QByteArray::number(r) + ';' + QByteArray::number(g) + 'm';
+        data += static_cast<char>('A' + i % 26);
+        if (i % 80 == 79) {
+            data += "\033[m\r\n";
+        }
+    }
+    return data;
+}
+
+// scrolling within a region: a pager or a chat client with a status line
+static QByteArray scrollRegionCorpus()
+{
+    QByteArray data("\033[2;23r");
+    for (int i = 0; data.size() < CorpusSize; i++) {
+        switch (i % 8) {
+        case 0:
+            data += "\033[2;1H\033M"; // reverse index at the top
+            break;
+        case 1:
+            data += "\033[12;1H\033[3L"; // insert lines
+            break;
+        case 2:
+            data += "\033[12;1H\033[2M"; // delete lines
+            break;
+        case 3:
+            data += "\033[3S\033[2T"; // scroll up and down
+            break;
+        default:
+            data += "\033[23;1H\n"; // scroll at the bottom
+            break;
+        }
+        data += "message " + QByteArray::number(i) + " in the scroll region";
+        data += "\033[24;1H\033[7mstatus " + QByteArray::number(i) + "\033[m\033[K";
+    }
+    data += "\033[r";
+    return data;
+}
+
+// ls --color: short SGR sequences around file names
+static QByteArray colorLsCorpus()
+{
+    static const char *const colors[] = {"01;34", "01;32", "00", "01;36", "40;33;01", "01;35"};
+    QByteArray data;
+    for (int i = 0; data.size() < CorpusSize; i++) {
+        data += "\033[0m\033[" + QByteArray(colors[i % 6]) + "m";
+        data += "file-" + QByteArray::number(i) + ".txt";
+        data += (i % 6 == 5) ? "\033[0m\r\n" : "\033[0m  ";
+    }
+    return data;
+}
+
+// compiler diagnostics: bold and colored prefixes, long plain text
+static QByteArray compilerCorpus()
+{
+    QByteArray data;
+    for (int i = 0; data.size() < CorpusSize; i++) {
+        data += "\033[01m\033[Ksrc/Screen.cpp:" + QByteArray::number(i % 4000) + ":12:\033[m\033[K ";
+        data += "\033[01;35m\033[Kwarning: \033[m\033[Kcomparison of integer expressions of different signedness ";
+        data += "[\033[01;35m\033[K-Wsign-compare\033[m\033[K]\r\n";
+    }
+    return data;
+}
+
+// vim redraws: cursor addressing, erase and syntax highlighting in 256 colors
+static QByteArray vimCorpus()
+{
+    QByteArray data;
+    for (int i = 0; data.size() < CorpusSize; i++) {
+        const int row = i % 24;
+        if (row == 0) {
+            data += "\033[?25l\033[H\033[2J";
+        }
+        data += "\033[" + QByteArray::number(row + 1) + ";1H\033[K";
+        data += "\033[38;5;130m" + QByteArray::number(i).rightJustified(4) + " \033[m";
+        data += "\033[38;5;121mif\033[m (\033[38;5;224mx\033[m > \033[38;5;219m42\033[m) {";
+        data += "\033[" + QByteArray::number(row + 1) + ";60H\033[1m-- INSERT --\033[m";
+        if (row == 23) {
+            data += "\033[?12l\033[?25h";
+        }
+    }
+    return data;
+}
+
+// htop: absolute positioning, truecolor meters and frequent SGR changes
+static QByteArray htopCorpus()
+{
+    QByteArray data;
+    for (int i = 0; data.size() < CorpusSize; i++) {
+        const int row = i % 24;
+        data += "\033[" + QByteArray::number(row + 1) + ";3H\033[38;2;0;135;175m" + QByteArray::number(row) + "\033[39m[";
+        data += "\033[38;2;0;175;0m" + QByteArray(row % 20, '|') + "\033[38;2;175;0;0m" + QByteArray(20 - row % 20, '|');
+        data += "\033[39;49m\033[30G" + QByteArray::number(i % 100) + ".0%]\033[m";
+        data += "\033[" + QByteArray::number(row + 1) + ";40H\033[7m" + QByteArray::number(1000 + i) + "\033[27m root\033[K";
+    }
+    return data;
+}
+
+// shell prompts which update the window title on every command
+static QByteArray titleCorpus()
+{
+    QByteArray data;
+    for (int i = 0; data.size() < CorpusSize; i++) {
+        data += "\033]0;user@host: ~/src/konsole/" + QByteArray::number(i) + "\007";
+        data += "\033]7;file://host/home/user/src\033\\";
+        data += "\033[01;32muser@host\033[00m:\033[01;34m~/src\033[00m$ make\r\n";
+    }
+    return data;
+}
+
+void Vt102EmulationBenchmark::benchmarkEscapeSequences_data()
+{
+    QTest::addColumn<QByteArray>("data");
+
+    QTest::newRow("ls --color") << colorLsCorpus();
+    QTest::newRow("compiler") << compilerCorpus();
+    QTest::newRow("vim") << vimCorpus();
+    QTest::newRow("htop") << htopCorpus();
+    QTest::newRow("titles") << titleCorpus();
+}
+
+void Vt102EmulationBenchmark::benchmarkEscapeSequences()
+{
+    QFETCH(QByteArray, data);
+
+    Vt102Emulation emulation;
+    emulation.setCodec(QTextCodec::codecForName("UTF-8"));
+    emulation.setImageSize(24, 80);
+
+    QBENCHMARK {
+        emulation.receiveData(data.constData(), data.size());
+    }
+}
+
+void Vt102EmulationBenchmark::benchmarkThroughput_data()
+{
+    QTest::addColumn<QByteArray>("data");
+    QTest::addColumn<int>("history");
+
+    const QByteArray utf8Demo = fileCorpus(QFINDTESTDATA(QStringLiteral("../../tests/UTF-8-demo.txt")));
+    const QByteArray emoji = fileCorpus(QFINDTESTDATA(QStringLiteral("../../tests/emoji_test.txt")));
+
+    const QList<QPair<const char *, QByteArray>> corpora = {
+        qMakePair("ascii", asciiCorpus()),
+        qMakePair("sgr", colorLsCorpus() + compilerCorpus()),
+        qMakePair("truecolor", trueColorCorpus()),
+        qMakePair("utf-8 demo", utf8Demo),
+        qMakePair("emoji", emoji),
+        qMakePair("redraw", vimCorpus() + htopCorpus()),
+        qMakePair("scroll region", scrollRegionCorpus())
+    };
+    const char *const histories[] = {"none", "file", "compact"};
+
+    for (const auto &corpus : corpora) {
+        for (int history = 0; history < 3; history++) {
+            const QByteArray name = QByteArray(corpus.first) + '/' + histories[history];
+            QTest::newRow(name.constData()) << corpus.second << history;
+        }
+    }
+}
+
+void Vt102EmulationBenchmark::benchmarkThroughput()
+{
+    QFETCH(QByteArray, data);
+    QFETCH(int, history);
+
+    // the files of the corpora may be missing or empty
+    if (data.isEmpty()) {
+        QSKIP("The corpus could not be read");
+    }
+
+    Vt102Emulation emulation;
+    emulation.setCodec(QTextCodec::codecForName("UTF-8"));
+    emulation.setImageSize(24, 80);
+    switch (history) {
+    case 0:
+        emulation.setHistory(HistoryTypeNone());
+        break;
+    case 1:
+        emulation.setHistory(HistoryTypeFile());
+        break;
+    default:
+        emulation.setHistory(CompactHistoryType(10000));
+        break;
+    }
+
+    // the throughput is reported next to the QBENCHMARK result, which
+    // gives the time per pass over the corpus
+    qint64 bytes = 0;
+    QElapsedTimer timer;
+    timer.start();
+    QBENCHMARK {
+        emulation.receiveData(data.constData(), data.size());
+        bytes += data.size();
+    }
+    const qint64 elapsed = timer.nsecsElapsed();
+
+    const double megabytesPerSecond = (bytes / (1024.0 * 1024.0)) / (elapsed / 1e9);
+    const double nanosecondsPerByte = static_cast<double>(elapsed) / bytes;
+    qDebug("%s: %.1f MB/s, %.2f ns/byte", QTest::currentDataTag(), megabytesPerSecond, nanosecondsPerByte);
+}
+
+QTEST_GUILESS_MAIN(Vt102EmulationBenchmark)
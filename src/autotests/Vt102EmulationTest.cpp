@@ -22,6 +22,15 @@
 
 #include "qtest.h"
 
+// Qt
+#include <QSignalSpy>
+#include <QTextCodec>
+#include <QTextStream>
+
+// Konsole
+#include "../Vt102Emulation.h"
+#include "../TerminalCharacterDecoder.h"
+
 // The below is to verify the old #defines match the new constexprs
 // Just copy/paste for now from Vt102Emulation.cpp
 #define TY_CONSTRUCT(T,A,N) ( ((((int)(N)) & 0xffff) << 16) | ((((int)(A)) & 0xff) << 8) | (((int)(T)) & 0xff) )
@@ -117,4 +126,147 @@ void Vt102EmulationTest::testTokenFunctions()
     QCOMPARE(token_vt52('>'), TY_VT52('>'));
 }
 
+static QString screenText(Vt102Emulation &emulation)
+{
+    QString text;
+    QTextStream stream(&text);
+    PlainTextDecoder decoder;
+    decoder.begin(&stream);
+    emulation.writeToStream(&decoder, 0, emulation.lineCount() - 1);
+    decoder.end();
+    return text;
+}
+
+void Vt102EmulationTest::testReceiveDataChunking()
+{
+    // printable runs, escape sequences, multibyte sequences and VT100
+    // graphics which all have to come out the same however the PTY
+    // happens to split them
+    const QByteArray data("plain text\r\n"
+                          "\033[1;31mred\033[0m and \xc3\xa9t\xc3\xa9 \xe2\x94\x80\xe2\x94\x80\r\n"
+                          "\033]2;a title\007after title\r\n"
+                          "\033(0lqqk\033(B done\r\n"
+                          "a line which is longer than the forty columns\r\n"
+                          "\xe6\xbc\xa2\xe5\xad\x97 wide\033[4h inserted\033[4l\r\n");
+
+    Vt102Emulation whole;
+    whole.setCodec(QTextCodec::codecForName("UTF-8"));
+    whole.setImageSize(10, 40);
+    whole.receiveData(data.constData(), data.size());
+
+    const QString expected = screenText(whole);
+    QVERIFY(expected.contains(QString::fromUtf8("red and \xc3\xa9t\xc3\xa9 \xe2\x94\x80\xe2\x94\x80")));
+    QVERIFY(expected.contains(QStringLiteral("after title")));
+    QVERIFY(expected.contains(QStringLiteral("a line which is longer than the forty columns")));
+    QVERIFY(!expected.contains(QStringLiteral("a title")));
+
+    for (int chunkSize = 1; chunkSize < 8; chunkSize++) {
+        Vt102Emulation split;
+        split.setCodec(QTextCodec::codecForName("UTF-8"));
+        split.setImageSize(10, 40);
+        for (int i = 0; i < data.size(); i += chunkSize) {
+            split.receiveData(data.constData() + i, qMin(chunkSize, data.size() - i));
+        }
+        QCOMPARE(screenText(split), expected);
+    }
+}
+
+void Vt102EmulationTest::testParserRecovery_data()
+{
+    QTest::addColumn<QByteArray>("data");
+    QTest::addColumn<QString>("text");
+
+    QTest::newRow("sgr") << QByteArray("a\033[1;38;5;100;48;2;1;2;3mb") << QStringLiteral("ab");
+    QTest::newRow("sgr sub-parameters") << QByteArray("a\033[38:2:1:2:3mb") << QStringLiteral("ab");
+    QTest::newRow("osc bel") << QByteArray("a\033]0;title\007b") << QStringLiteral("ab");
+    QTest::newRow("osc st") << QByteArray("a\033]0;title\033\\b") << QStringLiteral("ab");
+    QTest::newRow("dcs") << QByteArray("a\033P1$r0m\033\\b") << QStringLiteral("ab");
+    QTest::newRow("apc") << QByteArray("a\033_Gf=24\033\\b") << QStringLiteral("ab");
+    QTest::newRow("unknown private marker") << QByteArray("a\033[=1ub") << QStringLiteral("ab");
+    QTest::newRow("delete in sequence") << QByteArray("a\033[\1771mb") << QStringLiteral("ab");
+    QTest::newRow("escape restarts") << QByteArray("a\033[1\033[mb") << QStringLiteral("ab");
+    QTest::newRow("8-bit csi") << QByteArray("a\2331mb") << QStringLiteral("ab");
+}
+
+void Vt102EmulationTest::testParserRecovery()
+{
+    QFETCH(QByteArray, data);
+    QFETCH(QString, text);
+
+    // malformed and unsupported sequences must not leave parts of
+    // themselves on the screen
+    Vt102Emulation emulation;
+    emulation.setCodec(QTextCodec::codecForName("ISO 8859-1"));
+    emulation.setImageSize(5, 20);
+    emulation.receiveData(data.constData(), data.size());
+
+    QCOMPARE(screenText(emulation).trimmed(), text);
+}
+
+static qint64 frameClockTime = 0;
+
+static qint64 frameClock()
+{
+    return frameClockTime;
+}
+
+void Vt102EmulationTest::testFramePacing()
+{
+    Vt102Emulation emulation;
+    emulation.setMaximumFrameRate(10);
+    QCOMPARE(emulation.frameInterval(), 100);
+    emulation.setClock(frameClock);
+
+    QSignalSpy outputChanged(&emulation, &Emulation::outputChanged);
+
+    // the update scheduled by the constructor
+    QTRY_COMPARE(outputChanged.count(), 1);
+
+    // after an idle period the output is shown in a frame of its own
+    frameClockTime += 1000;
+    Emulation::FrameStatistics before = emulation.frameStatistics();
+    emulation.receiveData("a", 1);
+    QVERIFY(outputChanged.wait(5000));
+    Emulation::FrameStatistics after = emulation.frameStatistics();
+    QCOMPARE(after.framesEmitted - before.framesEmitted, quint64(1));
+    QCOMPARE(after.framesSkipped - before.framesSkipped, quint64(0));
+
+    // output received within the frame interval is shown in a single
+    // frame, the clock does not advance so it is always within
+    before = after;
+    for (int i = 0; i < 10; i++) {
+        emulation.receiveData("b", 1);
+    }
+    QCOMPARE(outputChanged.count(), 2);
+    QVERIFY(outputChanged.wait(5000));
+
+    after = emulation.frameStatistics();
+    QCOMPARE(after.chunksReceived - before.chunksReceived, quint64(10));
+    QCOMPARE(after.framesEmitted - before.framesEmitted, quint64(1));
+    QCOMPARE(after.framesSkipped - before.framesSkipped, quint64(9));
+    QCOMPARE(outputChanged.count(), 3);
+}
+
+void Vt102EmulationTest::testActivity()
+{
+    Vt102Emulation emulation;
+    QSignalSpy stateSet(&emulation, &Emulation::stateSet);
+
+    // only the first output is signalled
+    emulation.receiveData("a", 1);
+    emulation.receiveData("b", 1);
+    QCOMPARE(stateSet.count(), 1);
+    QCOMPARE(stateSet.at(0).at(0).toInt(), int(NOTIFYACTIVITY));
+
+    // the rest is found by polling until there is no more
+    QVERIFY(emulation.takeActivity());
+    QVERIFY(!emulation.takeActivity());
+
+    // then the next output is signalled again
+    emulation.receiveData("c", 1);
+    QCOMPARE(stateSet.count(), 2);
+    QVERIFY(!emulation.takeActivity());
+    QVERIFY(!emulation.takeActivity());
+}
+
 QTEST_GUILESS_MAIN(Vt102EmulationTest)
@@ -31,6 +31,11 @@ class Vt102EmulationTest : public QObject
 
 private Q_SLOTS:
     void testTokenFunctions();
+    void testReceiveDataChunking();
+    void testParserRecovery_data();
+    void testParserRecovery();
+    void testFramePacing();
+    void testActivity();
 
 private:
 };
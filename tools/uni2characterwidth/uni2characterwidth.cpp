@@ -24,6 +24,7 @@
 #include <QEventLoop>
 #include <QFile>
 #include <QFileInfo>
+#include <QHash>
 #include <QLoggingCategory>
 #include <QMap>
 #include <QRegularExpression>
@@ -551,6 +552,8 @@ using GeneratorFunc = bool (*)(QTextStream &, const QVector<CharacterProperties>
 bool code(QTextStream &out, const QVector<CharacterProperties> &props, const QVector<CharacterWidth> &widths,
           const QMap<QString, QString> &args) {
     static constexpr int DIRECT_LUT_SIZE = 256;
+    static constexpr int TRIE_BLOCK_BITS = 8;
+    static constexpr int TRIE_BLOCK_SIZE = 1 << TRIE_BLOCK_BITS;
 
     Q_UNUSED(props);
     QTextStream eout(stderr, QIODevice::WriteOnly);
@@ -576,6 +579,11 @@ bool code(QTextStream &out, const QVector<CharacterProperties> &props, const QVe
         {QStringLiteral("ranges-luts"),          Var::Vector()},
         {QStringLiteral("ranges-lut-list"),      Var::Vector()},
         {QStringLiteral("ranges-lut-list-size"), 0},
+        {QStringLiteral("trie-index"),           Var::Vector()},
+        {QStringLiteral("trie-index-type"),      QStringLiteral("uint8_t")},
+        {QStringLiteral("trie-blocks"),          Var::Vector()},
+        {QStringLiteral("trie-block-bits"),      TRIE_BLOCK_BITS},
+        {QStringLiteral("default-width"),        0},
     };
 
     // Fill direct-lut with widths of 0x00-0xFF
@@ -627,6 +635,40 @@ bool code(QTextStream &out, const QVector<CharacterProperties> &props, const QVe
         {QStringLiteral("size"),    1},
     });
     data[QStringLiteral("ranges-lut-list-size")] = mergedRanges.size();
+    data[QStringLiteral("default-width")] = widthsSortOrder[lastWidthId].width();
+
+    // Two-stage lookup table of all code points, giving the same widths as
+    // the direct LUT and the ranges LUTs searched in the order of the list.
+    // The index has the number of the block of widths of every
+    // TRIE_BLOCK_SIZE code points, equal blocks are stored once.
+    QVector<int> allWidths(CODE_POINTS_NUM, widthsSortOrder[lastWidthId].width());
+    for(unsigned i = 0; i < DIRECT_LUT_SIZE; ++i) {
+        allWidths[i] = int(widths[i]);
+    }
+    for(int wi = lastWidthId - 1; wi >= 0; --wi) {
+        const auto currentMergedRangesIt = mergedRanges.find(widthsSortOrder[wi]);
+        if(currentMergedRangesIt == mergedRanges.end())
+            continue;
+        for(const auto &range: *currentMergedRangesIt) {
+            for(uint cp = range.first; cp <= range.second; ++cp)
+                allWidths[cp] = int(widthsSortOrder[wi]);
+        }
+    }
+    QHash<QVector<int>, int> blockIds;
+    auto &trieIndex = data[QStringLiteral("trie-index")].vec;
+    auto &trieBlocks = data[QStringLiteral("trie-blocks")].vec;
+    for(uint first = 0; first < CODE_POINTS_NUM; first += TRIE_BLOCK_SIZE) {
+        const QVector<int> block = allWidths.mid(first, TRIE_BLOCK_SIZE);
+        auto blockIdIt = blockIds.constFind(block);
+        if(blockIdIt == blockIds.constEnd()) {
+            blockIdIt = blockIds.insert(block, blockIds.size());
+            for(const int width: block)
+                trieBlocks.append(width);
+        }
+        trieIndex.append(blockIdIt.value());
+    }
+    if(blockIds.size() > 256)
+        data[QStringLiteral("trie-index-type")] = QStringLiteral("uint16_t");
 
     Template t(templateText);
     t.parse();